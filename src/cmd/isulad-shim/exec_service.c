@@ -0,0 +1,312 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ * Description: exec service of the container shim
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include "exec_service.h"
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#define EXEC_REQUEST_TIMEOUT 10 // sec
+
+extern int g_log_fd;
+
+static int send_exec_msg(int conn, int type, int value)
+{
+    exec_msg_t msg = { .type = type, .value = value };
+    ssize_t nret;
+
+    do {
+        nret = send(conn, &msg, sizeof(msg), MSG_NOSIGNAL);
+    } while (nret < 0 && errno == EINTR);
+
+    if (nret != (ssize_t)sizeof(msg)) {
+        return SHIM_ERR;
+    }
+
+    return SHIM_OK;
+}
+
+int exec_service_read_request(int conn, char *buf, size_t len)
+{
+    struct timeval tv = { .tv_sec = EXEC_REQUEST_TIMEOUT, .tv_usec = 0 };
+    size_t total = 0;
+
+    if (setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0) {
+        return SHIM_ERR;
+    }
+
+    while (total < len - 1) {
+        ssize_t nread = read_nointr(conn, buf + total, len - 1 - total);
+        if (nread <= 0) {
+            return SHIM_ERR;
+        }
+        total += (size_t)nread;
+        if (memchr(buf, '\0', total) != NULL) {
+            return SHIM_OK;
+        }
+    }
+
+    return SHIM_ERR;
+}
+
+bool exec_service_is_exec_dir(const char *service_dir, const char *workdir)
+{
+    char prefix[PATH_MAX] = { 0 };
+    int nret;
+
+    nret = snprintf(prefix, sizeof(prefix), "%s/%s/", service_dir, EXEC_DIR_NAME);
+    if (nret < 0 || nret >= (int)sizeof(prefix)) {
+        return false;
+    }
+
+    return strncmp(workdir, prefix, (size_t)nret) == 0 && strchr(workdir + nret, '/') == NULL &&
+           workdir[nret] != '\0';
+}
+
+static process_t *new_exec_process(const char *id, const char *bundle, const char *runtime)
+{
+    char *p_id = strdup(id);
+    char *p_bundle = strdup(bundle);
+    char *p_runtime = strdup(runtime);
+    process_t *p = NULL;
+
+    if (p_id == NULL || p_bundle == NULL || p_runtime == NULL) {
+        goto err_out;
+    }
+
+    p = new_process(p_id, p_bundle, p_runtime);
+    if (p == NULL) {
+        goto err_out;
+    }
+
+    return p;
+
+err_out:
+    free(p_id);
+    free(p_bundle);
+    free(p_runtime);
+    return NULL;
+}
+
+/*
+ * Serve one exec in a child of the service, the same as a new exec shim started
+ * in the exec working directory, except that pid and exit status are sent to isulad.
+ */
+static void serve_exec(int conn, const char *service_dir, const process_t *ctr)
+{
+    char request[PATH_MAX] = { 0 };
+    char workdir[PATH_MAX] = { 0 };
+    process_t *p = NULL;
+    pthread_t tid_accept;
+    int status;
+
+    signal(SIGCHLD, SIG_DFL);
+
+    if (exec_service_read_request(conn, request, sizeof(request)) != SHIM_OK) {
+        write_message(g_log_fd, ERR_MSG, "read exec request failed:%d", SHIM_SYS_ERR(errno));
+        _exit(EXIT_FAILURE);
+    }
+
+    if (realpath(request, workdir) == NULL || !exec_service_is_exec_dir(service_dir, workdir)) {
+        write_message(g_log_fd, ERR_MSG, "invalid exec workdir");
+        _exit(EXIT_FAILURE);
+    }
+
+    if (chdir(workdir) != 0) {
+        write_message(g_log_fd, ERR_MSG, "chdir exec workdir failed:%d", SHIM_SYS_ERR(errno));
+        _exit(EXIT_FAILURE);
+    }
+
+    close_fd(&g_log_fd);
+    g_log_fd = open_no_inherit(SHIM_LOG_NAME, O_CREAT | O_WRONLY | O_APPEND | O_SYNC, 0640);
+    if (g_log_fd < 0) {
+        _exit(EXIT_FAILURE);
+    }
+
+    if (setsid() < 0) {
+        write_message(g_log_fd, ERR_MSG, "setsid failed:%d", SHIM_SYS_ERR(errno));
+        _exit(EXIT_FAILURE);
+    }
+
+    if (prctl(PR_SET_CHILD_SUBREAPER, 1) != 0) {
+        write_message(g_log_fd, ERR_MSG, "set subreaper failed:%d", SHIM_SYS_ERR(errno));
+        _exit(EXIT_FAILURE);
+    }
+
+    if (send_exec_msg(conn, EXEC_MSG_SHIM_PID, (int)getpid()) != SHIM_OK) {
+        write_message(g_log_fd, ERR_MSG, "send shim pid failed:%d", SHIM_SYS_ERR(errno));
+        _exit(EXIT_FAILURE);
+    }
+
+    (void)alarm(DEFAULT_TIMEOUT);
+
+    p = new_exec_process(ctr->id, ctr->bundle, ctr->runtime);
+    if (p == NULL) {
+        write_message(g_log_fd, ERR_MSG, "new process failed");
+        _exit(EXIT_FAILURE);
+    }
+
+    if (process_io_init(p) != SHIM_OK) {
+        write_message(g_log_fd, ERR_MSG, "process io init failed");
+        _exit(EXIT_FAILURE);
+    }
+
+    if (open_io(p, &tid_accept) != SHIM_OK) {
+        _exit(EXIT_FAILURE);
+    }
+
+    if (create_process(p) != SHIM_OK) {
+        if (p->console_sock_path != NULL) {
+            (void)unlink(p->console_sock_path);
+        }
+        _exit(EXIT_FAILURE);
+    }
+
+    (void)alarm(0);
+
+    if (send_exec_msg(conn, EXEC_MSG_PID, p->ctr_pid) != SHIM_OK) {
+        write_message(g_log_fd, WARN_MSG, "send exec pid failed:%d", SHIM_SYS_ERR(errno));
+    }
+
+    status = process_signal_handle_routine(p, tid_accept);
+
+    // isulad does not wait for detached exec, ignore the error
+    (void)send_exec_msg(conn, EXEC_MSG_EXIT, status);
+    exit(status);
+}
+
+static int exec_service_listen(void)
+{
+    struct sockaddr_un addr;
+    int fd = -1;
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    (void)memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    (void)strcpy(addr.sun_path, EXEC_SOCK_NAME);
+
+    (void)unlink(EXEC_SOCK_NAME);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        goto err_out;
+    }
+
+    if (chmod(EXEC_SOCK_NAME, 0600) != 0) {
+        goto err_out;
+    }
+
+    if (listen(fd, SOMAXCONN) != 0) {
+        goto err_out;
+    }
+
+    return fd;
+
+err_out:
+    close(fd);
+    (void)unlink(EXEC_SOCK_NAME);
+    return -1;
+}
+
+static void exec_service_loop(const process_t *ctr)
+{
+    char *service_dir = NULL;
+    int listen_fd = -1;
+
+    service_dir = getcwd(NULL, 0);
+    if (service_dir == NULL) {
+        write_message(g_log_fd, ERR_MSG, "exec service get cwd failed:%d", SHIM_SYS_ERR(errno));
+        return;
+    }
+
+    listen_fd = exec_service_listen();
+    if (listen_fd < 0) {
+        write_message(g_log_fd, ERR_MSG, "exec service listen failed:%d", SHIM_SYS_ERR(errno));
+        free(service_dir);
+        return;
+    }
+
+    // children serving exec are reaped automatically
+    signal(SIGCHLD, SIG_IGN);
+
+    for (;;) {
+        pid_t pid;
+        int conn = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            write_message(g_log_fd, ERR_MSG, "exec service accept failed:%d", SHIM_SYS_ERR(errno));
+            break;
+        }
+
+        pid = fork();
+        if (pid == (pid_t)0) {
+            close(listen_fd);
+            serve_exec(conn, service_dir, ctr);
+        }
+        if (pid < 0) {
+            write_message(g_log_fd, ERR_MSG, "exec service fork failed:%d", SHIM_SYS_ERR(errno));
+        }
+        close(conn);
+    }
+
+    close(listen_fd);
+    (void)unlink(EXEC_SOCK_NAME);
+    free(service_dir);
+}
+
+pid_t exec_service_start(process_t *p)
+{
+    pid_t ppid = getpid();
+    pid_t pid;
+
+    pid = fork();
+    if (pid < 0) {
+        write_message(g_log_fd, WARN_MSG, "fork exec service failed:%d", SHIM_SYS_ERR(errno));
+        return -1;
+    }
+    if (pid != (pid_t)0) {
+        return pid;
+    }
+
+    // the service goes with the container shim
+    if (prctl(PR_SET_PDEATHSIG, SIGKILL) != 0 || getppid() != ppid) {
+        _exit(EXIT_FAILURE);
+    }
+
+    if (p->terminal != NULL) {
+        close_fd(&p->terminal->fd);
+        close_fd(&p->terminal->idx_fd);
+    }
+
+    exec_service_loop(p);
+    _exit(EXIT_FAILURE);
+}
@@ -0,0 +1,46 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ * Description: exec service definition
+ ******************************************************************************/
+
+#ifndef CMD_ISULAD_SHIM_EXEC_SERVICE_H
+#define CMD_ISULAD_SHIM_EXEC_SERVICE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "process.h"
+#include "container_exec_service.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// read the exec request from conn, returns SHIM_OK once buf holds a path ended with '\0'
+int exec_service_read_request(int conn, char *buf, size_t len);
+
+// whether workdir is an exec working directory of the container shim working in service_dir
+bool exec_service_is_exec_dir(const char *service_dir, const char *workdir);
+
+/*
+ * Fork the exec service of the container, it must be called before any thread is created.
+ * Returns pid of the service, or -1 if it can not be started, exec falls back to new shims then.
+ */
+pid_t exec_service_start(process_t *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -25,6 +25,7 @@
 
 #include "common.h"
 #include "process.h"
+#include "exec_service.h"
 
 int g_log_fd = -1;
 
@@ -129,6 +130,14 @@ int main(int argc, char **argv)
         exit(EXIT_FAILURE);
     }
 
+    /*
+     * Start exec service of the container before any thread is created,
+     * exec falls back to a new shim process if it is not available.
+     */
+    if (!p->state->exec) {
+        p->exec_service_pid = exec_service_start(p);
+    }
+
     /*
      * Open exit pipe
      * The exit pipe exists only when the container is started,
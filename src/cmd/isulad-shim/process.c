@@ -16,6 +16,7 @@
 #define _GNU_SOURCE
 #include "process.h"
 #include <sys/epoll.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -23,6 +24,8 @@
 #include <unistd.h>
 #include <limits.h>
 #include <sys/wait.h>
+#include <poll.h>
+#include <signal.h>
 #include <semaphore.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,6 +47,8 @@
 #define MAX_EVENTS 100
 #define DEFAULT_IO_COPY_BUF (16 * 1024)
 #define DEFAULT_LOG_FILE_SIZE (4 * 1024)
+// pending log lines are flushed if no output is read in this time, in nanoseconds
+#define LOG_FLUSH_IDLE_TIMEOUT (50 * 1000 * 1000L)
 
 extern int g_log_fd;
 
@@ -131,6 +136,17 @@ static bool check_fd(int fd)
     return true;
 }
 
+static bool is_pipe_fd(int fd)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) != 0) {
+        return false;
+    }
+
+    return S_ISFIFO(st.st_mode);
+}
+
 static int add_io_dispatch(int epfd, io_thread_t *io_thd, int from, int to)
 {
     int ret = SHIM_ERR;
@@ -147,8 +163,10 @@ static int add_io_dispatch(int epfd, io_thread_t *io_thd, int from, int to)
     /* add src fd */
     if (from != -1 && ioc->fd_from == -1) {
         ioc->fd_from = from;
+        ioc->from_is_pipe = is_pipe_fd(from);
         struct epoll_event ev;
-        ev.events = EPOLLIN;
+        /* the stream thread watches it again after copied, so the loop does not spin while the thread is busy */
+        ev.events = EPOLLIN | EPOLLONESHOT;
         ev.data.ptr = io_thd;
 
         ret = epoll_ctl(epfd, EPOLL_CTL_ADD, from, &ev);
@@ -172,6 +190,7 @@ static int add_io_dispatch(int epfd, io_thread_t *io_thd, int from, int to)
         if (io_thd->terminal != NULL && to == io_thd->terminal->fd) {
             fn->is_log = true;
         }
+        fn->is_pipe = !fn->is_log && is_pipe_fd(to);
         fn->next = NULL;
 
         if (ioc->fd_to == NULL) {
@@ -264,6 +283,222 @@ out:
     return ret;
 }
 
+/*
+ * Get the only non-log destination of the stream and the log destination, data can be moved
+ * between pipes by splice/tee without copying into user space only if there is one destination pipe.
+ */
+static bool get_zero_copy_dest(const io_copy_t *ioc, fd_node_t **dest, fd_node_t **log)
+{
+    fd_node_t *fn = NULL;
+
+    *dest = NULL;
+    *log = NULL;
+    if (!ioc->from_is_pipe || ioc->zero_copy_disabled) {
+        return false;
+    }
+
+    for (fn = ioc->fd_to; fn != NULL; fn = fn->next) {
+        if (fn->is_log) {
+            *log = fn;
+            continue;
+        }
+        if (*dest != NULL || !fn->is_pipe) {
+            return false;
+        }
+        *dest = fn;
+    }
+
+    return *dest != NULL;
+}
+
+/* wait until the nonblocking destination is writable instead of retrying write in a busy loop */
+static int wait_fd_writable(int fd, int timeout)
+{
+    int nret = 0;
+    struct pollfd pfd = { 0 };
+
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    do {
+        nret = poll(&pfd, 1, timeout);
+    } while (nret < 0 && errno == EINTR);
+
+    return nret > 0 ? 0 : -1;
+}
+
+static ssize_t write_to_fd_in_total(int fd, const char *buf, size_t count)
+{
+    ssize_t nret = 0;
+    size_t nwritten = 0;
+
+    while (nwritten < count) {
+        nret = write(fd, buf + nwritten, count - nwritten);
+        if (nret >= 0) {
+            nwritten += (size_t)nret;
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN || wait_fd_writable(fd, -1) != 0) {
+            return -1;
+        }
+    }
+
+    return (ssize_t)nwritten;
+}
+
+static void write_to_dispatch(io_thread_t *io_thd, const char *buf, int r_count)
+{
+    io_copy_t *ioc = io_thd->ioc;
+    fd_node_t *fn = ioc->fd_to;
+    fd_node_t *next = NULL;
+
+    for (; fn != NULL; fn = next) {
+        next = fn->next;
+        if (fn->is_log) {
+            shim_write_container_log_file(io_thd->terminal, ioc->id, (char *)buf, r_count);
+        } else {
+            ssize_t w_count = write_to_fd_in_total(fn->fd, buf, (size_t)r_count);
+            if (w_count < 0) {
+                /* When any error occurs, remove the write fd */
+                remove_io_dispatch(io_thd, -1, fn->fd);
+            }
+        }
+    }
+}
+
+/*
+ * Move data into the destination pipe by splice, or duplicate it by tee and then read the
+ * same bytes for the log file. Returns the same as read(), errno is EINVAL if not supported.
+ */
+static ssize_t zero_copy_to_dispatch(io_thread_t *io_thd, char *buf, fd_node_t *dest, fd_node_t *log)
+{
+    io_copy_t *ioc = io_thd->ioc;
+    ssize_t n = 0;
+    ssize_t r = 0;
+
+    for (;;) {
+        if (log == NULL) {
+            n = splice(ioc->fd_from, NULL, dest->fd, NULL, DEFAULT_IO_COPY_BUF, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        } else {
+            n = tee(ioc->fd_from, dest->fd, DEFAULT_IO_COPY_BUF, SPLICE_F_NONBLOCK);
+        }
+        if (n >= 0) {
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        /* EAGAIN is returned if the source is empty or the destination is full, wait only for the latter */
+        if (errno != EAGAIN || wait_fd_writable(dest->fd, 0) == 0 || wait_fd_writable(dest->fd, -1) != 0) {
+            break;
+        }
+    }
+
+    if (n < 0) {
+        if (errno == EPIPE) {
+            /* the reader of destination is gone, remove it and copy the data in next round */
+            remove_io_dispatch(io_thd, -1, dest->fd);
+            errno = EAGAIN;
+        }
+        return -1;
+    }
+
+    if (n == 0 && log != NULL) {
+        /* tee does not tell eof of source, read it to find out */
+        return read(ioc->fd_from, buf, DEFAULT_IO_COPY_BUF);
+    }
+
+    if (log != NULL) {
+        /* consume the bytes duplicated into destination pipe, and write them into log file */
+        r = read_nointr(ioc->fd_from, buf, (size_t)n);
+        if (r > 0) {
+            shim_write_container_log_file(io_thd->terminal, ioc->id, buf, (int)r);
+        }
+    }
+
+    return n;
+}
+
+/* copy one chunk of the stream, returns the same as read() */
+static ssize_t io_copy_once(io_thread_t *io_thd, char *buf)
+{
+    io_copy_t *ioc = io_thd->ioc;
+    fd_node_t *dest = NULL;
+    fd_node_t *log = NULL;
+    ssize_t r_count = 0;
+
+    if (pthread_mutex_lock(&(ioc->mutex)) != 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    if (ioc->id != EXEC_RESIZE && get_zero_copy_dest(ioc, &dest, &log)) {
+        r_count = zero_copy_to_dispatch(io_thd, buf, dest, log);
+        if (r_count >= 0 || errno != EINVAL) {
+            goto out;
+        }
+        /* splice is not supported between these files, always copy by read and write */
+        ioc->zero_copy_disabled = true;
+    }
+
+    r_count = read(ioc->fd_from, buf, DEFAULT_IO_COPY_BUF);
+    if (r_count <= 0) {
+        goto out;
+    }
+
+    if (ioc->id != EXEC_RESIZE) {
+        write_to_dispatch(io_thd, buf, (int)r_count);
+    } else {
+        int resize_fd = ioc->fd_to->fd;
+        struct winsize wsize = { 0x00 };
+        buf[r_count] = '\0';
+        if (get_exec_winsize(buf, &wsize) < 0 || ioctl(resize_fd, TIOCSWINSZ, &wsize) < 0) {
+            r_count = -1;
+            errno = EIO;
+        }
+    }
+
+out:
+    pthread_mutex_unlock(&(ioc->mutex));
+    return r_count;
+}
+
+/* wait for io event, return -1 if timeout when there are log lines waiting to be flushed */
+static int wait_io_copy_event(io_thread_t *io_thd)
+{
+    int ret = 0;
+    struct timespec ts = { 0 };
+
+    if (!shim_container_log_has_pending(io_thd->terminal) || clock_gettime(CLOCK_REALTIME, &ts) != 0) {
+        (void)sem_wait(&(io_thd->sem_thd));
+        return 0;
+    }
+
+    ts.tv_nsec += LOG_FLUSH_IDLE_TIMEOUT;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    do {
+        ret = sem_timedwait(&(io_thd->sem_thd), &ts);
+    } while (ret != 0 && errno == EINTR);
+
+    return (ret != 0 && errno == ETIMEDOUT) ? -1 : 0;
+}
+
+/* the source is watched in oneshot mode, watch it again after the stream thread has copied it */
+static void rearm_io_copy(io_thread_t *io_thd)
+{
+    struct epoll_event ev;
+
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = io_thd;
+    (void)epoll_ctl(io_thd->epfd, EPOLL_CTL_MOD, io_thd->ioc->fd_from, &ev);
+}
+
 static void *do_io_copy(void *data)
 {
     io_thread_t *io_thd = (io_thread_t *)data;
@@ -277,65 +512,31 @@ static void *do_io_copy(void *data)
     }
 
     for (;;) {
-        memset(buf, 0, DEFAULT_IO_COPY_BUF);
-        (void)sem_wait(&(io_thd->sem_thd));
-        if (io_thd->is_stdin && io_thd->shutdown) {
-            break;
+        if (wait_io_copy_event(io_thd) != 0) {
+            // no output for a while, write the pending log lines into log file
+            shim_flush_container_log_file(io_thd->terminal);
+            continue;
         }
-
-        int r_count = read(ioc->fd_from, buf, DEFAULT_IO_COPY_BUF);
-        if (r_count == -1) {
-            if (errno == EAGAIN || errno == EINTR) {
-                continue;
-            }
-            break;
-        } else if (r_count == 0) {
-            /* End of file. The remote has closed the connection */
+        if (io_thd->is_stdin && io_thd->shutdown) {
             break;
-        } else if (ioc->id != EXEC_RESIZE) {
-            if (pthread_mutex_lock(&(ioc->mutex)) != 0) {
-                continue;
-            }
-
-            fd_node_t *fn = ioc->fd_to;
-            fd_node_t *next = NULL;
-            for (; fn != NULL; fn = next) {
-                next = fn->next;
-                if (fn->is_log) {
-                    shim_write_container_log_file(io_thd->terminal, ioc->id, buf, r_count);
-                } else {
-                    int w_count = write_nointr_in_total(fn->fd, buf, r_count);
-                    if (w_count < 0) {
-                        /* When any error occurs, remove the write fd */
-                        remove_io_dispatch(io_thd, -1, fn->fd);
-                    }
-                }
-            }
-            pthread_mutex_unlock(&(ioc->mutex));
-        } else {
-            if (pthread_mutex_lock(&(ioc->mutex)) != 0) {
-                continue;
-            }
-
-            int resize_fd = ioc->fd_to->fd;
-            struct winsize wsize = { 0x00 };
-            if (get_exec_winsize(buf, &wsize) < 0) {
-                break;
-            }
-            if (ioctl(resize_fd, TIOCSWINSZ, &wsize) < 0) {
-                break;
-            }
-            pthread_mutex_unlock(&(ioc->mutex));
         }
 
+        ssize_t r_count = io_copy_once(io_thd, buf);
         /*
          In the case of stdout and stderr, maybe numbers of read bytes are not the last msg in pipe.
          So, when the value of r_count is larger than zero, we need to try reading again to avoid loss msgs.
         */
-        if (io_thd->shutdown && r_count <= 0) {
+        if (io_thd->shutdown && r_count > 0) {
+            (void)sem_post(&io_thd->sem_thd);
+            continue;
+        }
+        if (io_thd->shutdown || r_count == 0 || (r_count < 0 && errno != EAGAIN && errno != EINTR)) {
             break;
         }
+        rearm_io_copy(io_thd);
     }
+    shim_flush_container_log_file(io_thd->terminal);
+
     struct epoll_event ev;
     ev.events = EPOLLIN;
     ev.data.fd = ioc->fd_from;
@@ -355,7 +556,7 @@ static void sem_post_inotify_io_copy(int fd, uint32_t event, void *data)
 
     if (event & EPOLLIN) {
         (void)sem_post(&thd->sem_thd);
-    } else if (event & EPOLLHUP) {
+    } else if (event & (EPOLLHUP | EPOLLERR)) {
         thd->shutdown = true;
         (void)sem_post(&thd->sem_thd);
     }
@@ -450,8 +651,10 @@ static void destroy_io_thread(process_t *p, int std_id)
     (void)sem_post(&io_thd->sem_thd);
     pthread_join(io_thd->tid, NULL);
     if (io_thd->ioc != NULL) {
+        pthread_mutex_destroy(&(io_thd->ioc->mutex));
         free(io_thd->ioc);
     }
+    (void)sem_destroy(&io_thd->sem_thd);
     free(io_thd);
     p->io_threads[std_id] = NULL;
 }
@@ -834,6 +1037,7 @@ static int terminal_init(log_terminal **terminal, shim_client_process_state *p_s
     log_term->log_path = p_state->log_path;
     /* Default to disable log. */
     log_term->fd = -1;
+    log_term->idx_fd = -1;
     log_term->log_maxfile = 1;
     /* Default value 4k, the min size of a single log file */
     log_term->log_maxsize = DEFAULT_LOG_FILE_SIZE;
@@ -897,6 +1101,7 @@ process_t *new_process(char *id, char *bundle, char *runtime)
     p->exit_fd = -1;
     p->io_loop_fd = -1;
     p->ctr_pid = -1;
+    p->exec_service_pid = -1;
     p->stdio = NULL;
     p->shim_io = NULL;
 
@@ -1248,6 +1453,9 @@ int process_signal_handle_routine(process_t *p, const pthread_t tid_accept)
             continue;
         }
         if (exit_shim) {
+            if (p->exec_service_pid > 0) {
+                (void)kill(p->exec_service_pid, SIGKILL);
+            }
             process_kill_all(p);
 
             // wait atmost 120 seconds
@@ -43,6 +43,7 @@ typedef struct {
 typedef struct fd_node {
     int fd;
     bool is_log;
+    bool is_pipe;
     struct fd_node *next;
 } fd_node_t;
 
@@ -51,6 +52,9 @@ typedef struct {
     fd_node_t *fd_to;
     int id;// 0,1,2,3
     pthread_mutex_t mutex;
+    bool from_is_pipe;
+    // splice failed with EINVAL, copy by read and write
+    bool zero_copy_disabled;
 } io_copy_t;
 
 typedef struct {
@@ -72,6 +76,7 @@ typedef struct process {
     int io_loop_fd;
     int exit_fd;
     int ctr_pid;
+    int exec_service_pid;// serves exec of the container, -1 for exec process
     log_terminal *terminal;
     stdio_t *stdio;// shim to on runtime side, in:r out/err: w
     stdio_t *shim_io; // shim io on isulad side, in: w  out/err: r
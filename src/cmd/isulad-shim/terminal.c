@@ -19,8 +19,6 @@
 #include <sys/stat.h>
 #include <limits.h>
 #include <termios.h> // IWYU pragma: keep
-#include <isula_libutils/json_common.h>
-#include <isula_libutils/logger_json_file.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,6 +33,32 @@
 #define BUF_CACHE_SIZE (32 * 1024)
 #define STDOUT_STR "stdout"
 #define STDERR_STR "stderr"
+// pending log lines are flushed when they reach this size or the oldest one is older than the interval
+#define LOG_BATCH_FLUSH_SIZE (64 * 1024)
+#define LOG_BATCH_FLUSH_INTERVAL (50 * 1000 * 1000LL)
+// bytes of a log line except the escaped log content: keys, stream, time and newline
+#define LOG_LINE_MAX_OVERHEAD 128
+
+/* move index of log file along with it, a stale index of the destination is removed */
+static void shim_rename_log_index(const char *from_log, const char *to_log)
+{
+    int ret;
+    char from[PATH_MAX] = { 0 };
+    char to[PATH_MAX] = { 0 };
+
+    ret = snprintf(from, PATH_MAX, "%s%s", from_log, CONTAINER_LOG_INDEX_SUFFIX);
+    if (ret < 0 || ret >= PATH_MAX) {
+        return;
+    }
+    ret = snprintf(to, PATH_MAX, "%s%s", to_log, CONTAINER_LOG_INDEX_SUFFIX);
+    if (ret < 0 || ret >= PATH_MAX) {
+        return;
+    }
+
+    if (rename(from, to) < 0) {
+        (void)unlink(to);
+    }
+}
 
 static int shim_rename_old_log_file(log_terminal *terminal)
 {
@@ -63,6 +87,7 @@ static int shim_rename_old_log_file(log_terminal *terminal)
             free(rename_fname);
             return SHIM_ERR;
         }
+        shim_rename_log_index(tmp, rename_fname);
     }
 
     free(rename_fname);
@@ -103,7 +128,12 @@ static int shim_dump_log_file(log_terminal *terminal)
      */
     close(terminal->fd);
     terminal->fd = -1;
+    if (terminal->idx_fd >= 0) {
+        close(terminal->idx_fd);
+        terminal->idx_fd = -1;
+    }
     (void)rename(terminal->log_path, file_newname);
+    shim_rename_log_index(terminal->log_path, file_newname);
     ret = shim_create_container_log_file(terminal);
 clean_out:
     free(file_newname);
@@ -127,135 +157,415 @@ static int64_t get_log_file_size(int fd)
     return log_st.st_size;
 }
 
-static int shim_json_data_write(log_terminal *terminal, const char *buf, int read_count)
+static int64_t get_monotonic_nanos(void)
 {
-    int ret = 0;
-    int nret = 0;
-    int64_t available_space = -1;
-    int64_t file_size;
+    struct timespec ts = { 0 };
 
-    (void)pthread_rwlock_wrlock(&terminal->log_terminal_rwlock);
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
 
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
-    file_size = get_log_file_size(terminal->fd);
-    if (file_size < 0) {
-        ret = -1;
-        goto out;
+static int shim_log_index_path(const log_terminal *terminal, char *path, size_t len)
+{
+    int ret = snprintf(path, len, "%s%s", terminal->log_path, CONTAINER_LOG_INDEX_SUFFIX);
+
+    return (ret < 0 || (size_t)ret >= len) ? SHIM_ERR : SHIM_OK;
+}
+
+/* stop indexing current log file, readers fall back to scan it */
+static void shim_drop_log_index(log_terminal *terminal)
+{
+    char path[PATH_MAX] = { 0 };
+
+    terminal->idx_batch_len = 0;
+    if (terminal->idx_fd < 0) {
+        return;
+    }
+    close(terminal->idx_fd);
+    terminal->idx_fd = -1;
+    if (shim_log_index_path(terminal, path, sizeof(path)) == SHIM_OK) {
+        (void)unlink(path);
     }
+}
 
-    available_space = terminal->log_maxsize - file_size;
-    if (read_count <= available_space) {
-        ret = write_nointr_in_total(terminal->fd, buf, read_count);
-        goto out;
+/* count lines of log file from offset to the end */
+static int64_t shim_count_log_lines(int fd, uint64_t offset, uint64_t end)
+{
+    char buf[4096];
+    int64_t lines = 0;
+    ssize_t n, i;
+
+    while (offset < end) {
+        n = pread(fd, buf, sizeof(buf), (off_t)offset);
+        if (n <= 0) {
+            return n < 0 ? -1 : lines;
+        }
+        for (i = 0; i < n; i++) {
+            if (buf[i] == '\n') {
+                lines++;
+            }
+        }
+        offset += (uint64_t)n;
     }
 
-    if (shim_dump_log_file(terminal) < 0) {
-        ret = -1;
-        goto out;
+    return lines;
+}
+
+/* continue the index of a log file written by previous shim, return SHIM_ERR if it can not be trusted */
+static int shim_load_log_index(log_terminal *terminal, int fd)
+{
+    container_log_index_header header = { 0 };
+    container_log_index_entry last = { 0 };
+    int64_t size = get_log_file_size(fd);
+    int64_t lines;
+
+    if (size < (int64_t)(sizeof(header) + sizeof(last)) ||
+        (size - (int64_t)sizeof(header)) % (int64_t)sizeof(last) != 0) {
+        return SHIM_ERR;
+    }
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, CONTAINER_LOG_INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CONTAINER_LOG_INDEX_VERSION || header.interval != CONTAINER_LOG_INDEX_INTERVAL) {
+        return SHIM_ERR;
+    }
+    if (pread(fd, &last, sizeof(last), (off_t)(size - (int64_t)sizeof(last))) != (ssize_t)sizeof(last) ||
+        last.offset >= (uint64_t)terminal->log_size) {
+        return SHIM_ERR;
     }
 
-    /*
-     * Now file is new, then write the max bytes that will be wrote to log file.
-     * We have set the log file min size 16k, so the scenario of log_maxsize < read_count
-     * shouldn't happen, otherwise, discard some last bytes.
-     */
-    nret = write_nointr_in_total(terminal->fd, buf,
-                                 terminal->log_maxsize < read_count ? terminal->log_maxsize : read_count);
+    lines = shim_count_log_lines(terminal->fd, last.offset, (uint64_t)terminal->log_size);
+    if (lines < 0) {
+        return SHIM_ERR;
+    }
+    terminal->log_lines = last.line + (uint64_t)lines;
+
+    return SHIM_OK;
+}
+
+/* open index of current log file, log file is still written if the index is not available */
+static void shim_open_log_index(log_terminal *terminal)
+{
+    int fd = -1;
+    char path[PATH_MAX] = { 0 };
+    container_log_index_header header = { 0 };
+
+    terminal->idx_fd = -1;
+    terminal->idx_batch_len = 0;
+    terminal->log_lines = 0;
+
+    if (shim_log_index_path(terminal, path, sizeof(path)) != SHIM_OK) {
+        return;
+    }
+
+    if (terminal->log_size > 0) {
+        // the log file is appended by a new shim after container restarted
+        fd = open(path, O_CLOEXEC | O_RDWR | O_APPEND);
+        if (fd < 0) {
+            return;
+        }
+        if (shim_load_log_index(terminal, fd) != SHIM_OK) {
+            close(fd);
+            (void)unlink(path);
+            return;
+        }
+        terminal->idx_fd = fd;
+        return;
+    }
+
+    fd = open(path, O_CLOEXEC | O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+    if (fd < 0) {
+        return;
+    }
+    memcpy(header.magic, CONTAINER_LOG_INDEX_MAGIC, sizeof(header.magic));
+    header.version = CONTAINER_LOG_INDEX_VERSION;
+    header.interval = CONTAINER_LOG_INDEX_INTERVAL;
+    if (write_nointr_in_total(fd, (const char *)&header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        close(fd);
+        (void)unlink(path);
+        return;
+    }
+    terminal->idx_fd = fd;
+}
+
+/* add index entry of the line which will be appended to the batch */
+static void shim_log_index_add(log_terminal *terminal, int64_t time)
+{
+    size_t new_cap;
+    container_log_index_entry *new_batch = NULL;
+
+    if (terminal->idx_fd < 0 || terminal->log_lines % CONTAINER_LOG_INDEX_INTERVAL != 0) {
+        return;
+    }
+
+    if (terminal->idx_batch_len == terminal->idx_batch_cap) {
+        new_cap = terminal->idx_batch_cap > 0 ? terminal->idx_batch_cap * 2 : 16;
+        new_batch = realloc(terminal->idx_batch, new_cap * sizeof(container_log_index_entry));
+        if (new_batch == NULL) {
+            shim_drop_log_index(terminal);
+            return;
+        }
+        terminal->idx_batch = new_batch;
+        terminal->idx_batch_cap = new_cap;
+    }
+
+    terminal->idx_batch[terminal->idx_batch_len].offset = (uint64_t)terminal->log_size + terminal->batch_len;
+    terminal->idx_batch[terminal->idx_batch_len].line = terminal->log_lines;
+    terminal->idx_batch[terminal->idx_batch_len].time = time;
+    terminal->idx_batch_len++;
+}
+
+/* write all pending lines into log file, must be called with log_terminal_rwlock held */
+static int shim_log_batch_flush_locked(log_terminal *terminal)
+{
+    ssize_t nret = 0;
+
+    if (terminal->batch_len == 0) {
+        return SHIM_OK;
+    }
+
+    nret = write_nointr_in_total(terminal->fd, terminal->batch, terminal->batch_len);
+    if (nret > 0) {
+        terminal->log_size += nret;
+    }
+    terminal->batch_len = 0;
+
     if (nret < 0) {
-        ret = -1;
-        goto out;
+        // index can not match the log file anymore
+        shim_drop_log_index(terminal);
+        return SHIM_ERR;
     }
 
-    ret = read_count - nret;
+    // index entries point to lines written above
+    if (terminal->idx_fd >= 0 && terminal->idx_batch_len > 0) {
+        nret = write_nointr_in_total(terminal->idx_fd, (const char *)terminal->idx_batch,
+                                     terminal->idx_batch_len * sizeof(container_log_index_entry));
+        if (nret < 0) {
+            shim_drop_log_index(terminal);
+        }
+    }
+    terminal->idx_batch_len = 0;
 
-out:
-    (void)pthread_rwlock_unlock(&terminal->log_terminal_rwlock);
-    return ret;
+    return SHIM_OK;
 }
 
-static bool util_get_time_buffer(struct timespec *timestamp, char *timebuffer, size_t maxsize)
+static int shim_log_batch_reserve(log_terminal *terminal, size_t size)
 {
-    struct tm tm_utc = { 0 };
-    int32_t nanos = 0;
-    time_t seconds;
-    size_t len = 0;
-    int ret = 0;
+    size_t new_cap = 0;
+    char *new_batch = NULL;
 
-    if (!timebuffer || !maxsize) {
-        return false;
+    if (terminal->batch_cap - terminal->batch_len >= size) {
+        return SHIM_OK;
     }
 
-    seconds = (time_t)timestamp->tv_sec;
-    gmtime_r(&seconds, &tm_utc);
-    strftime(timebuffer, maxsize, "%Y-%m-%dT%H:%M:%S", &tm_utc);
+    new_cap = terminal->batch_cap > 0 ? terminal->batch_cap : LOG_BATCH_FLUSH_SIZE;
+    while (new_cap - terminal->batch_len < size) {
+        new_cap *= 2;
+    }
 
-    nanos = (int32_t)timestamp->tv_nsec;
-    len = strlen(timebuffer);
-    ret = snprintf(timebuffer + len, (maxsize - len), ".%09dZ", nanos);
-    if (ret < 0 || ret >= (maxsize - len)) {
-        return false;
+    new_batch = realloc(terminal->batch, new_cap);
+    if (new_batch == NULL) {
+        return SHIM_ERR;
     }
+    terminal->batch = new_batch;
+    terminal->batch_cap = new_cap;
 
-    return true;
+    return SHIM_OK;
 }
 
-static bool util_get_now_time_buffer(char *timebuffer, size_t maxsize)
+/* escape bytes as json string content, same as the json generator without utf8 validation */
+static size_t shim_json_escape(char *dst, const char *src, size_t len)
 {
-    int err = 0;
-    struct timespec ts;
+    static const char hex[] = "0123456789ABCDEF";
+    size_t i;
+    char *p = dst;
+
+    for (i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)src[i];
+        switch (c) {
+            case '"':
+                *p++ = '\\';
+                *p++ = '"';
+                break;
+            case '\\':
+                *p++ = '\\';
+                *p++ = '\\';
+                break;
+            case '\n':
+                *p++ = '\\';
+                *p++ = 'n';
+                break;
+            case '\r':
+                *p++ = '\\';
+                *p++ = 'r';
+                break;
+            case '\t':
+                *p++ = '\\';
+                *p++ = 't';
+                break;
+            case '\b':
+                *p++ = '\\';
+                *p++ = 'b';
+                break;
+            case '\f':
+                *p++ = '\\';
+                *p++ = 'f';
+                break;
+            default:
+                if (c < 0x20) {
+                    memcpy(p, "\\u00", 4);
+                    p += 4;
+                    *p++ = hex[c >> 4];
+                    *p++ = hex[c & 0xf];
+                } else {
+                    *p++ = (char)c;
+                }
+                break;
+        }
+    }
 
-    err = clock_gettime(CLOCK_REALTIME, &ts);
-    if (err != 0) {
-        return false;
+    return (size_t)(p - dst);
+}
+
+/* format time as 2006-01-02T15:04:05.999999999Z, the part of seconds is cached */
+static size_t shim_log_time(log_terminal *terminal, char *dst, int64_t *time)
+{
+    struct timespec ts = { 0 };
+    struct tm tm_utc = { 0 };
+    long nanos;
+    int i;
+
+    (void)clock_gettime(CLOCK_REALTIME, &ts);
+    *time = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    if (terminal->time_cache_len == 0 || terminal->time_cache_sec != ts.tv_sec) {
+        gmtime_r(&ts.tv_sec, &tm_utc);
+        terminal->time_cache_len = strftime(terminal->time_cache, sizeof(terminal->time_cache),
+                                            "%Y-%m-%dT%H:%M:%S", &tm_utc);
+        terminal->time_cache_sec = ts.tv_sec;
     }
 
-    return util_get_time_buffer(&ts, timebuffer, maxsize);
+    memcpy(dst, terminal->time_cache, terminal->time_cache_len);
+    dst += terminal->time_cache_len;
+    *dst++ = '.';
+    nanos = ts.tv_nsec;
+    for (i = 8; i >= 0; i--) {
+        dst[i] = (char)('0' + nanos % 10);
+        nanos /= 10;
+    }
+    dst[9] = 'Z';
+
+    return terminal->time_cache_len + 11;
 }
 
-static ssize_t shim_logger_write(log_terminal *terminal, const char *type, const char *buf, int read_count)
+/*
+ * Encode one log line as {"log":"...","stream":"...","time":"..."}\n into the batch, which is
+ * flushed when it is large or old enough. The file size is tracked here instead of fstat per write.
+ */
+static int shim_logger_write(log_terminal *terminal, const char *type, const char *buf, int read_count)
 {
-    logger_json_file *msg = NULL;
-    ssize_t ret = -1;
-    size_t len;
-    char *json = NULL;
-    char timebuffer[64] = { 0 };
-    parser_error err = NULL;
-    struct parser_context ctx = { OPT_GEN_SIMPLIFY | OPT_GEN_NO_VALIDATE_UTF8, stderr };
+    int ret = SHIM_OK;
+    size_t line_len;
+    char *line = NULL;
+    char *p = NULL;
+    int64_t now;
+    int64_t time = 0;
 
     if (read_count < 0 || read_count >= INT_MAX) {
         return SHIM_ERR;
     }
 
-    msg = calloc(sizeof(logger_json_file), 1);
-    if (msg == NULL) {
-        return SHIM_ERR;
+    (void)pthread_rwlock_wrlock(&terminal->log_terminal_rwlock);
+
+    if (terminal->fd < 0) {
+        ret = SHIM_ERR;
+        goto out;
+    }
+
+    if (shim_log_batch_reserve(terminal, LOG_LINE_MAX_OVERHEAD + (size_t)read_count * 6) != SHIM_OK) {
+        ret = SHIM_ERR;
+        goto out;
     }
 
-    msg->log = calloc(read_count, 1);
-    if (!msg->log) {
-        goto cleanup;
+    line = terminal->batch + terminal->batch_len;
+    p = line;
+    memcpy(p, "{\"log\":\"", 8);
+    p += 8;
+    p += shim_json_escape(p, buf, (size_t)read_count);
+    memcpy(p, "\",\"stream\":\"", 12);
+    p += 12;
+    memcpy(p, type, strlen(type));
+    p += strlen(type);
+    memcpy(p, "\",\"time\":\"", 10);
+    p += 10;
+    p += shim_log_time(terminal, p, &time);
+    memcpy(p, "\"}\n", 3);
+    p += 3;
+    line_len = (size_t)(p - line);
+
+    if ((uint64_t)terminal->log_size + terminal->batch_len + line_len > terminal->log_maxsize) {
+        // lines before this one still fit in current file
+        if (shim_log_batch_flush_locked(terminal) != SHIM_OK) {
+            ret = SHIM_ERR;
+        }
+        if (shim_dump_log_file(terminal) < 0) {
+            ret = SHIM_ERR;
+            goto out;
+        }
+        memmove(terminal->batch, line, line_len);
+        /*
+         * Now file is new, then write the max bytes that will be wrote to log file.
+         * We have set the log file min size 16k, so the scenario of log_maxsize < line_len
+         * shouldn't happen, otherwise, discard some last bytes.
+         */
+        if (line_len > terminal->log_maxsize) {
+            line_len = terminal->log_maxsize;
+        }
     }
-    memcpy(msg->log, buf, read_count);
-    msg->log_len = read_count;
-    msg->stream = type ? safe_strdup(type) : safe_strdup("stdout");
 
-    util_get_now_time_buffer(timebuffer, sizeof(timebuffer));
-    msg->time = safe_strdup(timebuffer);
-    json = logger_json_file_generate_json(msg, &ctx, &err);
-    if (!json) {
-        goto cleanup;
+    if (terminal->batch_len == 0) {
+        terminal->batch_since = get_monotonic_nanos();
     }
-    len = strlen(json);
-    json[len] = '\n';
-    if (terminal->fd < 0) {
-        goto cleanup;
+    shim_log_index_add(terminal, time);
+    terminal->batch_len += line_len;
+    terminal->log_lines++;
+
+    now = get_monotonic_nanos();
+    if (terminal->batch_len >= LOG_BATCH_FLUSH_SIZE || now - terminal->batch_since >= LOG_BATCH_FLUSH_INTERVAL) {
+        ret = shim_log_batch_flush_locked(terminal);
     }
 
-    ret = shim_json_data_write(terminal, json, len + 1);
-cleanup:
-    free(json);
-    free_logger_json_file(msg);
-    free(err);
+out:
+    (void)pthread_rwlock_unlock(&terminal->log_terminal_rwlock);
+    return ret;
+}
+
+void shim_flush_container_log_file(log_terminal *terminal)
+{
+    if (terminal == NULL) {
+        return;
+    }
+
+    (void)pthread_rwlock_wrlock(&terminal->log_terminal_rwlock);
+    if (terminal->fd >= 0) {
+        (void)shim_log_batch_flush_locked(terminal);
+    }
+    (void)pthread_rwlock_unlock(&terminal->log_terminal_rwlock);
+}
+
+bool shim_container_log_has_pending(log_terminal *terminal)
+{
+    bool ret = false;
+
+    if (terminal == NULL) {
+        return false;
+    }
+
+    (void)pthread_rwlock_rdlock(&terminal->log_terminal_rwlock);
+    ret = terminal->batch_len > 0;
+    (void)pthread_rwlock_unlock(&terminal->log_terminal_rwlock);
+
     return ret;
 }
 
@@ -353,5 +663,15 @@ int shim_create_container_log_file(log_terminal *terminal)
         return SHIM_ERR;
     }
 
+    // the size is only read once here, then maintained by the log writer
+    terminal->log_size = get_log_file_size(terminal->fd);
+    if (terminal->log_size < 0) {
+        close(terminal->fd);
+        terminal->fd = -1;
+        return SHIM_ERR;
+    }
+
+    shim_open_log_index(terminal);
+
     return SHIM_OK;
 }
@@ -18,9 +18,11 @@
 
 #include <pthread.h>
 #include <unistd.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 
-#include "isula_libutils/logger_json_file.h"
+#include "container_log_index.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,11 +34,35 @@ typedef struct {
     int fd;
     unsigned int log_maxfile;
     pthread_rwlock_t log_terminal_rwlock;
+    // size of current log file, read once when the file is opened
+    int64_t log_size;
+    // encoded log lines waiting to be written into log file
+    char *batch;
+    size_t batch_len;
+    size_t batch_cap;
+    // monotonic time when the oldest pending line was encoded, in nanoseconds
+    int64_t batch_since;
+    // utc time formatted to seconds, reused by log lines in the same second
+    time_t time_cache_sec;
+    char time_cache[32];
+    size_t time_cache_len;
+    // sidecar index of current log file, -1 if the file is not indexed
+    int idx_fd;
+    // number of lines in current log file
+    uint64_t log_lines;
+    // index entries of pending lines, written after the lines
+    container_log_index_entry *idx_batch;
+    size_t idx_batch_len;
+    size_t idx_batch_cap;
 } log_terminal;
 
 void shim_write_container_log_file(log_terminal *terminal, int type, char *buf,
                                    int bytes_read);
 
+void shim_flush_container_log_file(log_terminal *terminal);
+
+bool shim_container_log_has_pending(log_terminal *terminal);
+
 int shim_create_container_log_file(log_terminal *terminal);
 
 #ifdef __cplusplus
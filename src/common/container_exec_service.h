@@ -0,0 +1,50 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ * Description: provide protocol of the exec service in the container shim
+ ******************************************************************************/
+
+#ifndef COMMON_CONTAINER_EXEC_SERVICE_H
+#define COMMON_CONTAINER_EXEC_SERVICE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// socket of the exec service in the working directory of the container shim
+#define EXEC_SOCK_NAME "exec.sock"
+// exec working directories are created in this directory of the container shim working directory
+#define EXEC_DIR_NAME "exec"
+
+/*
+ * Protocol of one exec: isulad connects and sends the absolute exec working directory
+ * ended with '\0', which contains process.json as for a new exec shim. The service
+ * replies with messages of exec_msg_t: the pid of the shim serving the exec, the pid
+ * of the exec process once it is created, and its exit status at last. The connection
+ * is closed without the message of the exec pid if the exec fails.
+ */
+enum {
+    EXEC_MSG_SHIM_PID = 1,
+    EXEC_MSG_PID,
+    EXEC_MSG_EXIT
+};
+
+typedef struct {
+    int type;
+    int value;
+} exec_msg_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
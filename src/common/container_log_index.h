@@ -0,0 +1,55 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-07-14
+ * Description: provide layout of the sidecar index of json-file container logs
+ ******************************************************************************/
+
+#ifndef COMMON_CONTAINER_LOG_INDEX_H
+#define COMMON_CONTAINER_LOG_INDEX_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The index of log file "path" is "path.idx", it is written by isulad-shim and rotated with the
+ * log file. It starts with a header, followed by one entry every CONTAINER_LOG_INDEX_INTERVAL
+ * lines, the first entry is the first line of the log file. Entries are only written after the
+ * lines they point to are written into log file.
+ */
+#define CONTAINER_LOG_INDEX_SUFFIX ".idx"
+#define CONTAINER_LOG_INDEX_MAGIC "ISLOGIDX"
+#define CONTAINER_LOG_INDEX_VERSION 1
+#define CONTAINER_LOG_INDEX_INTERVAL 64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t interval;
+} container_log_index_header;
+
+typedef struct {
+    // offset of the start of line in log file
+    uint64_t offset;
+    // number of lines before this line in log file
+    uint64_t line;
+    // time of the line, unix nanoseconds
+    int64_t time;
+} container_log_index_entry;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMON_CONTAINER_LOG_INDEX_H
@@ -533,7 +533,7 @@ auto CniNetworkPlugin::GetNetNS(const std::string &podSandboxID, Errors &err) ->
     std::string result;
     const std::string NetNSFmt { "/proc/%d/ns/net" };
 
-    container_inspect *inspect_data = CRIHelpers::InspectContainer(podSandboxID, err, false);
+    container_inspect *inspect_data = CRIHelpers::InspectContainerStatus(podSandboxID, err, false);
     if (inspect_data == nullptr) {
         return result;
     }
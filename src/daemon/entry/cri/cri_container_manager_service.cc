@@ -845,7 +845,12 @@ void ContainerManagerService::SetFsUsage(const imagetool_fs_info *fs_usage, int6
         container->mutable_writable_layer()->mutable_inodes_used()->set_value(
             fs_usage->image_filesystems[0]->inodes_used->value);
     }
-    container->mutable_writable_layer()->set_timestamp(timestamp);
+    // usage may be served from cache, report when it was measured so that kubelet can tell its staleness
+    if (fs_usage->image_filesystems[0]->timestamp > 0) {
+        container->mutable_writable_layer()->set_timestamp(fs_usage->image_filesystems[0]->timestamp);
+    } else {
+        container->mutable_writable_layer()->set_timestamp(timestamp);
+    }
 
     if (fs_usage->image_filesystems[0]->fs_id != nullptr &&
         fs_usage->image_filesystems[0]->fs_id->mountpoint != nullptr) {
@@ -1171,7 +1176,7 @@ ContainerManagerService::ContainerStatus(const std::string &containerID, Errors
         return nullptr;
     }
 
-    container_inspect *inspect = CRIHelpers::InspectContainer(realContainerID, error, false);
+    container_inspect *inspect = CRIHelpers::InspectContainerStatus(realContainerID, error, false);
     if (error.NotEmpty()) {
         return nullptr;
     }
@@ -833,6 +833,17 @@ auto InspectContainer(const std::string &Id, Errors &err, bool with_host_config)
     return inspect_data;
 }
 
+auto InspectContainerStatus(const std::string &Id, Errors &err, bool with_network) -> container_inspect *
+{
+    container_inspect *inspect_data { nullptr };
+    inspect_data = inspect_container_status((const char *)Id.c_str(), INSPECT_TIMEOUT_SEC, with_network);
+    if (inspect_data == nullptr) {
+        err.Errorf("Failed to call inspect service %s", Id.c_str());
+    }
+
+    return inspect_data;
+}
+
 int32_t ToInt32Timeout(int64_t timeout)
 {
     if (timeout > INT32_MAX) {
@@ -846,7 +857,7 @@ int32_t ToInt32Timeout(int64_t timeout)
 
 void GetContainerLogPath(const std::string &containerID, char **path, char **realPath, Errors &error)
 {
-    container_inspect *info = InspectContainer(containerID, error, false);
+    container_inspect *info = InspectContainerStatus(containerID, error, false);
     if (info == nullptr || error.NotEmpty()) {
         error.Errorf("failed to inspect container %s: %s", containerID.c_str(), error.GetCMessage());
         return;
@@ -138,6 +138,8 @@ void GetCheckpoint(const std::string &jsonCheckPoint, CRI::PodSandboxCheckpoint
 
 auto InspectContainer(const std::string &Id, Errors &err, bool with_host_config) -> container_inspect *;
 
+auto InspectContainerStatus(const std::string &Id, Errors &err, bool with_network) -> container_inspect *;
+
 auto ToInt32Timeout(int64_t timeout) -> int32_t;
 
 void GetContainerLogPath(const std::string &containerID, char **path, char **realPath, Errors &error);
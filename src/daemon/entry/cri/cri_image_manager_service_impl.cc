@@ -252,8 +252,9 @@ cleanup:
     return out;
 }
 
-auto ImageManagerServiceImpl::PullImage(const runtime::v1alpha2::ImageSpec &image,
-                                        const runtime::v1alpha2::AuthConfig &auth, Errors &error) -> std::string
+auto ImageManagerServiceImpl::pull_image(const runtime::v1alpha2::ImageSpec &image,
+                                         const runtime::v1alpha2::AuthConfig &auth, bool highPriority,
+                                         Errors &error) -> std::string
 {
     std::string out_str;
     im_pull_request *request { nullptr };
@@ -264,6 +265,7 @@ auto ImageManagerServiceImpl::PullImage(const runtime::v1alpha2::ImageSpec &imag
         goto cleanup;
     }
     request->type = util_strdup_s(IMAGE_TYPE_OCI);
+    request->high_priority = highPriority;
 
     ret = im_pull_image(request, &response);
     if (ret != 0) {
@@ -286,6 +288,18 @@ cleanup:
     return out_str;
 }
 
+auto ImageManagerServiceImpl::PullImage(const runtime::v1alpha2::ImageSpec &image,
+                                        const runtime::v1alpha2::AuthConfig &auth, Errors &error) -> std::string
+{
+    return pull_image(image, auth, false, error);
+}
+
+auto ImageManagerServiceImpl::PullSandboxImage(const runtime::v1alpha2::ImageSpec &image,
+                                               const runtime::v1alpha2::AuthConfig &auth, Errors &error) -> std::string
+{
+    return pull_image(image, auth, true, error);
+}
+
 auto ImageManagerServiceImpl::remove_request_from_grpc(const runtime::v1alpha2::ImageSpec *image,
                                                        im_rmi_request **request,
                                                        Errors &error) -> int
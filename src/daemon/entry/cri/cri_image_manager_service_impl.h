@@ -38,11 +38,18 @@ public:
     std::string PullImage(const runtime::v1alpha2::ImageSpec &image, const runtime::v1alpha2::AuthConfig &auth,
                           Errors &error) override;
 
+    // pull the image ahead of other pulls, sandboxes of all pods wait for it
+    std::string PullSandboxImage(const runtime::v1alpha2::ImageSpec &image, const runtime::v1alpha2::AuthConfig &auth,
+                                 Errors &error);
+
     void RemoveImage(const runtime::v1alpha2::ImageSpec &image, Errors &error) override;
 
     void ImageFsInfo(std::vector<std::unique_ptr<runtime::v1alpha2::FilesystemUsage>> *usages, Errors &error) override;
 
 private:
+    std::string pull_image(const runtime::v1alpha2::ImageSpec &image, const runtime::v1alpha2::AuthConfig &auth,
+                           bool highPriority, Errors &error);
+
     int pull_request_from_grpc(const runtime::v1alpha2::ImageSpec *image, const runtime::v1alpha2::AuthConfig *auth,
                                im_pull_request **request, Errors &error);
 
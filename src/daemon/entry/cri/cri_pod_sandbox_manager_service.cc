@@ -48,7 +48,7 @@ auto PodSandboxManagerService::EnsureSandboxImageExists(const std::string &image
     imageStatus.reset();
 
     imageRef.set_image(image);
-    std::string outRef = imageService.PullImage(imageRef, auth, error);
+    std::string outRef = imageServiceImpl.PullSandboxImage(imageRef, auth, error);
     return !(!error.Empty() || outRef.empty());
 }
 
@@ -1184,7 +1184,7 @@ PodSandboxManagerService::PodSandboxStatus(const std::string &podSandboxID, Erro
         error.Errorf("Failed to find sandbox id %s: %s", podSandboxID.c_str(), error.GetCMessage());
         return nullptr;
     }
-    inspect = CRIHelpers::InspectContainer(realSandboxID, error, true);
+    inspect = CRIHelpers::InspectContainerStatus(realSandboxID, error, true);
     if (error.NotEmpty()) {
         ERROR("Inspect pod failed: %s", error.GetCMessage());
         return nullptr;
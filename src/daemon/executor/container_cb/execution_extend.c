@@ -133,31 +133,43 @@ out:
 
 static int dup_container_stats_request(const container_stats_request *src, container_stats_request **dest)
 {
-    int ret = -1;
-    char *json = NULL;
-    parser_error err = NULL;
+    container_stats_request *tmp = NULL;
 
     if (src == NULL) {
         *dest = NULL;
         return 0;
     }
 
-    json = container_stats_request_generate_json(src, NULL, &err);
-    if (json == NULL) {
-        ERROR("Failed to generate json: %s", err);
-        goto out;
+    tmp = util_common_calloc_s(sizeof(container_stats_request));
+    if (tmp == NULL) {
+        ERROR("Out of memory");
+        return -1;
     }
-    *dest = container_stats_request_parse_data(json, NULL, &err);
-    if (*dest == NULL) {
-        ERROR("Failed to parse json: %s", err);
-        goto out;
+
+    if (src->containers_len > 0) {
+        tmp->containers = util_str_array_dup((const char **)src->containers, src->containers_len);
+        if (tmp->containers == NULL) {
+            ERROR("Out of memory");
+            goto err_out;
+        }
+        tmp->containers_len = src->containers_len;
     }
-    ret = 0;
+    tmp->all = src->all;
 
-out:
-    free(err);
-    free(json);
-    return ret;
+    if (src->filters != NULL) {
+        tmp->filters = dup_defs_filters(src->filters);
+        if (tmp->filters == NULL) {
+            ERROR("Failed to dup filters");
+            goto err_out;
+        }
+    }
+
+    *dest = tmp;
+    return 0;
+
+err_out:
+    free_container_stats_request(tmp);
+    return -1;
 }
 
 static void free_stats_context(struct stats_context *ctx)
@@ -438,7 +450,12 @@ static int get_containers_stats(char **idsarray, size_t ids_len, const struct st
             params.rootpath = cont->root_path;
             params.state = cont->state_path;
 
-            nret = runtime_resources_stats(cont->common_config->id, cont->runtime, &params, &einfo);
+            // stats are served from the collector cache, query runtime only if the cgroup is not accessible
+            nret = container_stats_collector_get(cont->common_config->id, container_state_get_pid(cont->state),
+                                                 &einfo);
+            if (nret != 0) {
+                nret = runtime_resources_stats(cont->common_config->id, cont->runtime, &params, &einfo);
+            }
             if (nret != 0) {
                 container_unref(cont);
                 continue;
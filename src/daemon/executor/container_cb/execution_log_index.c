@@ -0,0 +1,195 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ * Description: provide container log file index reading functions
+ ********************************************************************************/
+#define _GNU_SOURCE
+#include "execution_log_index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "isula_libutils/log.h"
+#include "utils.h"
+#include "utils_file.h"
+
+void container_log_index_free(struct container_log_index *index)
+{
+    free(index->entries);
+    index->entries = NULL;
+    index->len = 0;
+}
+
+bool container_log_index_load(const char *path, FILE *fp, struct container_log_index *index)
+{
+    int fd = -1;
+    bool ret = false;
+    char idx_path[PATH_MAX] = { 0 };
+    char prev = 0;
+    struct stat st;
+    struct stat log_st;
+    container_log_index_header header = { 0 };
+    container_log_index_entry *last = NULL;
+    size_t size;
+    int nret;
+
+    nret = snprintf(idx_path, sizeof(idx_path), "%s%s", path, CONTAINER_LOG_INDEX_SUFFIX);
+    if (nret < 0 || (size_t)nret >= sizeof(idx_path)) {
+        return false;
+    }
+
+    fd = util_open(idx_path, O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0 || fstat(fileno(fp), &log_st) != 0 || st.st_size <= (off_t)sizeof(header)) {
+        goto out;
+    }
+    if (util_read_nointr(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, CONTAINER_LOG_INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CONTAINER_LOG_INDEX_VERSION) {
+        goto out;
+    }
+
+    // entries may be appended when reading, only use complete ones
+    size = (size_t)(st.st_size - (off_t)sizeof(header)) / sizeof(container_log_index_entry);
+    index->entries = util_smart_calloc_s(sizeof(container_log_index_entry), size);
+    if (index->entries == NULL) {
+        goto out;
+    }
+    if (util_read_nointr(fd, index->entries, size * sizeof(container_log_index_entry)) !=
+        (ssize_t)(size * sizeof(container_log_index_entry))) {
+        goto out;
+    }
+    index->len = size;
+
+    // the last entry must point to the start of a line in this log file
+    last = &index->entries[index->len - 1];
+    if (index->entries[0].offset != 0 || last->offset >= (uint64_t)log_st.st_size) {
+        goto out;
+    }
+    if (last->offset > 0 && (pread(fileno(fp), &prev, 1, (off_t)(last->offset - 1)) != 1 || prev != '\n')) {
+        goto out;
+    }
+
+    ret = true;
+
+out:
+    if (!ret) {
+        container_log_index_free(index);
+    }
+    close(fd);
+    return ret;
+}
+
+/* index of the last entry whose line is not after the line */
+static size_t log_index_search_line(const struct container_log_index *index, uint64_t line)
+{
+    size_t lo = 0;
+    size_t hi = index->len;
+
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->entries[mid].line <= line) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+size_t container_log_index_search_time(const struct container_log_index *index, int64_t since)
+{
+    size_t lo = 0;
+    size_t hi = index->len;
+
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->entries[mid].time < since) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/*
+ * Scan the log file from pos, count all lines if skip < 0, otherwise stop after skip lines.
+ * lines is set to the number of lines scanned, pos is set to the position after them.
+ */
+static int scan_log_lines(FILE *fp, long *pos, int64_t skip, int64_t *lines)
+{
+#define SCAN_SECTION_SIZE 4096
+    char buffer[SCAN_SECTION_SIZE];
+    size_t read_size, i;
+
+    *lines = 0;
+    if (fseek(fp, *pos, SEEK_SET) != 0) {
+        ERROR("Fseek failed: %s", strerror(errno));
+        return -1;
+    }
+
+    while ((read_size = fread(buffer, sizeof(char), sizeof(buffer), fp)) > 0) {
+        for (i = 0; i < read_size; i++) {
+            if (buffer[i] != '\n') {
+                continue;
+            }
+            (*lines)++;
+            if (*lines == skip) {
+                *pos += (long)(i + 1);
+                return 0;
+            }
+        }
+        *pos += (long)read_size;
+    }
+
+    return ferror(fp) ? -1 : 0;
+}
+
+int container_log_index_tail_find(FILE *fp, const struct container_log_index *index, int64_t require_line,
+                                  int64_t *get_line, long *get_pos)
+{
+    const container_log_index_entry *entry = &index->entries[index->len - 1];
+    long pos = (long)entry->offset;
+    int64_t lines = 0;
+    uint64_t total, target;
+
+    if (scan_log_lines(fp, &pos, -1, &lines) != 0) {
+        return -1;
+    }
+    total = entry->line + (uint64_t)lines;
+    if (total <= (uint64_t)require_line) {
+        (*get_line) += (int64_t)total;
+        return 0;
+    }
+
+    target = total - (uint64_t)require_line;
+    entry = &index->entries[log_index_search_line(index, target)];
+    pos = (long)entry->offset;
+    if (target > entry->line && scan_log_lines(fp, &pos, (int64_t)(target - entry->line), &lines) != 0) {
+        return -1;
+    }
+
+    (*get_pos) = pos;
+    (*get_line) = require_line;
+    return 0;
+}
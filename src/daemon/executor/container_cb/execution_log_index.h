@@ -0,0 +1,53 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ * Description: provide container log file index reading functions
+ ********************************************************************************/
+#ifndef DAEMON_EXECUTOR_CONTAINER_CB_EXECUTION_LOG_INDEX_H
+#define DAEMON_EXECUTOR_CONTAINER_CB_EXECUTION_LOG_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "container_log_index.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct container_log_index {
+    container_log_index_entry *entries;
+    size_t len;
+};
+
+void container_log_index_free(struct container_log_index *index);
+
+/*
+ * Load sidecar index of the opened log file written by isulad-shim. The index is ignored if it
+ * is missing or does not match the log file, then callers scan the log file instead.
+ */
+bool container_log_index_load(const char *path, FILE *fp, struct container_log_index *index);
+
+/* index of the last entry whose time is before since, all lines before it are before since */
+size_t container_log_index_search_time(const struct container_log_index *index, int64_t since);
+
+/* find the position of the last require_line lines by the index, same result as scanning backwards */
+int container_log_index_tail_find(FILE *fp, const struct container_log_index *index, int64_t require_line,
+                                  int64_t *get_line, long *get_pos);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DAEMON_EXECUTOR_CONTAINER_CB_EXECUTION_LOG_INDEX_H
@@ -52,6 +52,7 @@
 #include "error.h"
 #include "isula_libutils/logger_json_file.h"
 #include "constants.h"
+#include "execution_log_index.h"
 #include "runtime_api.h"
 #include "events_sender_api.h"
 #include "service_container_api.h"
@@ -1020,10 +1021,28 @@ static int container_logs_cb_check(const struct isulad_logs_request *request, st
     return 0;
 }
 
-static int do_decode_write_log_entry(const char *json_str, const stream_func_wrapper *stream)
+/* filter of log entries by time, 0 means not set */
+struct log_time_filter {
+    int64_t since;
+    int64_t until;
+    /* a log entry after until is read, stop reading newer log files */
+    bool until_reached;
+};
+
+#define LOG_ENTRY_FILTERED 1
+
+/*
+ * return:
+ *      <  0, decode or write failed
+ *      == 0, log entry is written
+ *      == LOG_ENTRY_FILTERED, log entry is filtered out by time
+ * */
+static int do_decode_write_log_entry(const char *json_str, const stream_func_wrapper *stream,
+                                     struct log_time_filter *filter)
 {
     bool write_ok = false;
     int ret = -1;
+    int64_t time = 0;
     parser_error jerr = NULL;
     logger_json_file *logentry = NULL;
     struct parser_context ctx = { OPT_GEN_SIMPLIFY | OPT_GEN_NO_VALIDATE_UTF8, stderr };
@@ -1034,6 +1053,19 @@ static int do_decode_write_log_entry(const char *json_str, const stream_func_wra
         goto out;
     }
 
+    if (filter != NULL && (filter->since > 0 || filter->until > 0) &&
+        util_to_unix_nanos_from_str(logentry->time, &time) == 0) {
+        if (filter->since > 0 && time < filter->since) {
+            ret = LOG_ENTRY_FILTERED;
+            goto out;
+        }
+        if (filter->until > 0 && time > filter->until) {
+            filter->until_reached = true;
+            ret = LOG_ENTRY_FILTERED;
+            goto out;
+        }
+    }
+
     /* send to client */
     write_ok = stream->write_func(stream->writer, logentry);
     if (!write_ok) {
@@ -1055,14 +1087,16 @@ out:
  *      >  0, mean read many lines
  * */
 static int64_t do_read_log_file(const char *path, int64_t require_line, long pos, const stream_func_wrapper *stream,
-                                long *last_pos)
+                                struct log_time_filter *filter, long *last_pos)
 {
 #define MAX_JSON_DECODE_RETRY 20
     int retries = 0;
     int decode_retries = 0;
+    int nret = 0;
     int64_t read_lines = 0;
     FILE *fp = NULL;
     char buffer[MAXLINE + 1] = { 0 };
+    struct container_log_index index = { 0 };
 
     for (retries = 0; retries <= LOG_MAX_RETRIES; retries++) {
         fp = util_fopen(path, "r");
@@ -1076,6 +1110,14 @@ static int64_t do_read_log_file(const char *path, int64_t require_line, long pos
         ERROR("open file: %s failed: %s", path, strerror(errno));
         return -1;
     }
+    /* skip lines before since by the index instead of decoding them */
+    if (filter != NULL && filter->since > 0 && container_log_index_load(path, fp, &index)) {
+        const container_log_index_entry *entry = &index.entries[container_log_index_search_time(&index, filter->since)];
+        if ((long)entry->offset > pos) {
+            pos = (long)entry->offset;
+        }
+        container_log_index_free(&index);
+    }
     if (pos > 0 && fseek(fp, pos, SEEK_SET) != 0) {
         ERROR("fseek to %ld failed: %s", pos, strerror(errno));
         read_lines = -1;
@@ -1086,7 +1128,8 @@ static int64_t do_read_log_file(const char *path, int64_t require_line, long pos
     while (fgets(buffer, MAXLINE, fp) != NULL) {
         (*last_pos) += (long)strlen(buffer);
 
-        if (do_decode_write_log_entry(buffer, stream) != 0) {
+        nret = do_decode_write_log_entry(buffer, stream, filter);
+        if (nret < 0) {
             /* read a incomplete json object, try again */
             decode_retries++;
             if (decode_retries < MAX_JSON_DECODE_RETRY) {
@@ -1096,6 +1139,12 @@ static int64_t do_read_log_file(const char *path, int64_t require_line, long pos
             goto out;
         }
         decode_retries = 0;
+        if (nret == LOG_ENTRY_FILTERED) {
+            if (filter->until_reached) {
+                break;
+            }
+            continue;
+        }
 
         read_lines++;
         if (read_lines == require_line) {
@@ -1116,7 +1165,7 @@ struct last_log_file_position {
 };
 
 static int do_read_all_container_logs(int64_t require_line, const char *path, const stream_func_wrapper *stream,
-                                      struct last_log_file_position *position)
+                                      struct log_time_filter *filter, struct last_log_file_position *position)
 {
     int ret = -1;
     int i = position->file_index;
@@ -1131,7 +1180,7 @@ static int do_read_all_container_logs(int64_t require_line, const char *path, co
             ERROR("Sprintf failed");
             goto out;
         }
-        read_lines = do_read_log_file(log_path, left_lines, pos, stream, &(position->pos));
+        read_lines = do_read_log_file(log_path, left_lines, pos, stream, filter, &(position->pos));
         if (read_lines < 0) {
             if (errno == ENOENT) {
                 continue;
@@ -1140,6 +1189,10 @@ static int do_read_all_container_logs(int64_t require_line, const char *path, co
         }
         /* only last file need pos */
         pos = 0;
+        if (filter != NULL && filter->until_reached) {
+            ret = 0;
+            goto out;
+        }
         if (require_line < 0) {
             continue;
         }
@@ -1150,7 +1203,7 @@ static int do_read_all_container_logs(int64_t require_line, const char *path, co
             goto out;
         }
     }
-    read_lines = do_read_log_file(path, left_lines, pos, stream, &(position->pos));
+    read_lines = do_read_log_file(path, left_lines, pos, stream, filter, &(position->pos));
     ret = read_lines < 0 ? -1 : 0;
 out:
     position->file_index = i;
@@ -1158,7 +1211,7 @@ out:
 }
 
 static int do_show_all_logs(const struct container_log_config *conf, const stream_func_wrapper *stream,
-                            struct last_log_file_position *last_pos)
+                            struct log_time_filter *filter, struct last_log_file_position *last_pos)
 {
     int ret = 0;
     int index = conf->rotate - 1;
@@ -1178,7 +1231,7 @@ static int do_show_all_logs(const struct container_log_config *conf, const strea
     }
     last_pos->file_index = index;
     last_pos->pos = 0;
-    ret = do_read_all_container_logs(-1, conf->path, stream, last_pos);
+    ret = do_read_all_container_logs(-1, conf->path, stream, filter, last_pos);
 out:
     return ret;
 }
@@ -1245,6 +1298,7 @@ static int util_find_tail_position(const char *file_name, int64_t require_line,
 {
     FILE *fp = NULL;
     int ret = -1;
+    struct container_log_index index = { 0 };
 
     if (file_name == NULL) {
         return 0;
@@ -1260,14 +1314,20 @@ static int util_find_tail_position(const char *file_name, int64_t require_line,
         return -1;
     }
 
-    ret = do_tail_find(fp, require_line, get_line, pos);
+    if (container_log_index_load(file_name, fp, &index)) {
+        ret = container_log_index_tail_find(fp, &index, require_line, get_line, pos);
+        container_log_index_free(&index);
+    } else {
+        ret = do_tail_find(fp, require_line, get_line, pos);
+    }
 
     fclose(fp);
     return ret;
 }
 
 static int do_tail_container_logs(int64_t require_line, const struct container_log_config *conf,
-                                  const stream_func_wrapper *stream, struct last_log_file_position *last_pos)
+                                  const stream_func_wrapper *stream, struct log_time_filter *filter,
+                                  struct last_log_file_position *last_pos)
 {
     int i, ret;
     int64_t left = require_line;
@@ -1277,7 +1337,7 @@ static int do_tail_container_logs(int64_t require_line, const struct container_l
 
     if (require_line < 0) {
         /* read all logs */
-        return do_show_all_logs(conf, stream, last_pos);
+        return do_show_all_logs(conf, stream, filter, last_pos);
     }
     if (require_line == 0) {
         /* require empty logs */
@@ -1289,7 +1349,7 @@ static int do_tail_container_logs(int64_t require_line, const struct container_l
     }
     if (pos != 0) {
         /* first line in first log file */
-        get_line = do_read_log_file(conf->path, require_line, pos, stream, &(last_pos->pos));
+        get_line = do_read_log_file(conf->path, require_line, pos, stream, filter, &(last_pos->pos));
         last_pos->file_index = 0;
         return get_line < 0 ? -1 : 0;
     }
@@ -1321,7 +1381,7 @@ static int do_tail_container_logs(int64_t require_line, const struct container_l
 
     last_pos->pos = pos;
     last_pos->file_index = i;
-    ret = do_read_all_container_logs(require_line, conf->path, stream, last_pos);
+    ret = do_read_all_container_logs(require_line, conf->path, stream, filter, last_pos);
 out:
     return ret;
 }
@@ -1424,7 +1484,7 @@ static int hanlde_events(int fd, const struct follow_args *farg)
         }
 
         last_pos.file_index = rename_cnt;
-        if (do_read_all_container_logs(write_cnt, farg->path, farg->stream, &last_pos) != 0) {
+        if (do_read_all_container_logs(write_cnt, farg->path, farg->stream, NULL, &last_pos) != 0) {
             ERROR("Read all new logs failed");
             goto out;
         }
@@ -1616,6 +1676,7 @@ static int container_logs_cb(const struct isulad_logs_request *request, stream_f
     container_t *cont = NULL;
     struct container_log_config *log_config = NULL;
     struct last_log_file_position last_pos = { 0 };
+    struct log_time_filter filter = { 0 };
     Container_Status status = CONTAINER_STATUS_UNKNOWN;
 
     *response = (struct isulad_logs_response *)util_common_calloc_s(sizeof(struct isulad_logs_response));
@@ -1672,14 +1733,21 @@ static int container_logs_cb(const struct isulad_logs_request *request, stream_f
         goto out;
     }
 
+    if (util_to_unix_nanos_from_str(request->since, &filter.since) != 0 ||
+        util_to_unix_nanos_from_str(request->until, &filter.until) != 0) {
+        isulad_set_error_message("Invalid since or until time");
+        cc = ISULAD_ERR_INPUT;
+        goto out;
+    }
+
     /* tail of container log file */
-    if (do_tail_container_logs(request->tail, log_config, stream, &last_pos) != 0) {
+    if (do_tail_container_logs(request->tail, log_config, stream, &filter, &last_pos) != 0) {
         isulad_set_error_message("do tail log file failed");
         cc = ISULAD_ERR_EXEC;
         goto out;
     }
 
-    if (!request->follow) {
+    if (!request->follow || filter.until_reached) {
         goto out;
     }
 
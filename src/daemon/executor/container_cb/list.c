@@ -43,31 +43,32 @@ struct list_context {
 
 static int dup_container_list_request(const container_list_request *src, container_list_request **dest)
 {
-    int ret = -1;
-    char *json = NULL;
-    parser_error err = NULL;
+    container_list_request *tmp = NULL;
 
     if (src == NULL) {
         *dest = NULL;
         return 0;
     }
 
-    json = container_list_request_generate_json(src, NULL, &err);
-    if (json == NULL) {
-        ERROR("Failed to generate json: %s", err);
-        goto out;
+    tmp = util_common_calloc_s(sizeof(container_list_request));
+    if (tmp == NULL) {
+        ERROR("Out of memory");
+        return -1;
     }
-    *dest = container_list_request_parse_data(json, NULL, &err);
-    if (*dest == NULL) {
-        ERROR("Failed to parse json: %s", err);
-        goto out;
+
+    tmp->all = src->all;
+
+    if (src->filters != NULL) {
+        tmp->filters = dup_defs_filters(src->filters);
+        if (tmp->filters == NULL) {
+            ERROR("Failed to dup filters");
+            free_container_list_request(tmp);
+            return -1;
+        }
     }
-    ret = 0;
 
-out:
-    free(err);
-    free(json);
-    return ret;
+    *dest = tmp;
+    return 0;
 }
 
 static void free_list_context(struct list_context *ctx)
@@ -15,10 +15,13 @@
  ******************************************************************************/
 #define _GNU_SOURCE
 #include "metrics_cb.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "callback.h"
+#include "container_api.h"
+#include "image_api.h"
 #include "utils.h"
 #include "isula_libutils/log.h"
 
@@ -58,6 +61,8 @@ typedef struct isula_metrics {
 #define ISULA_CONT_CPU_STAT     ISULA_PREFIX "container_cpu_stat"
 #define ISULA_CONT_PIDS         ISULA_PREFIX "container_pids"
 #define DAEMON_CALLOC_TOTAL     ISULA_PREFIX "daemon_calloced_memory_total"
+#define ISULA_HEALTH_CHECK_STAT ISULA_PREFIX "health_check_stat"
+#define ISULA_IMAGE_PULL_STAT   ISULA_PREFIX "image_pull_stat"
 
 /* metric help info */
 static const char g_isula_daemon_mem_desc[] = "is isula daemon memory occupied";
@@ -66,6 +71,8 @@ static const char g_cpu_stat_desc[] = "is containers's cpu stats";
 static const char g_req_count_desc[] = "is metrics server accepted request count";
 static const char g_cont_pids_desc[] = "is containers's pid count";
 static const char g_daemon_calloc_desc[] = "is isula deamon calloced total";
+static const char g_health_check_desc[] = "is containers's health check scheduler stats, times in milliseconds";
+static const char g_image_pull_desc[] = "is image pull scheduler stats, times in milliseconds";
 
 static unsigned long long g_mem_alloced_total;
 
@@ -290,6 +297,64 @@ static int metrics_daemon_alloced_mem_total(const char *name, char *buffer, int
     return len;
 }
 
+static int metrics_health_check_stat(const char *name, char *buffer, int size)
+{
+    health_check_metrics_t metrics = { 0 };
+    double latency_avg = 0;
+    double queue_delay_avg = 0;
+
+    container_health_check_get_metrics(&metrics);
+    if (metrics.probes_total > 0) {
+        latency_avg = (double)metrics.latency_total / metrics.probes_total / Time_Milli;
+        queue_delay_avg = (double)metrics.queue_delay_total / metrics.probes_total / Time_Milli;
+    }
+
+    return snprintf(buffer, size,
+                    "%s{section=\"workers\"} %" PRIu64 "\n"
+                    "%s{section=\"scheduled\"} %" PRIu64 "\n"
+                    "%s{section=\"queued\"} %" PRIu64 "\n"
+                    "%s{section=\"running\"} %" PRIu64 "\n"
+                    "%s{section=\"probes_total\"} %" PRIu64 "\n"
+                    "%s{section=\"probes_timeout\"} %" PRIu64 "\n"
+                    "%s{section=\"latency_avg\"} %.2f\n"
+                    "%s{section=\"latency_max\"} %.2f\n"
+                    "%s{section=\"queue_delay_avg\"} %.2f\n"
+                    "%s{section=\"queue_delay_max\"} %.2f\n",
+                    name, metrics.workers, name, metrics.scheduled, name, metrics.queued,
+                    name, metrics.running, name, metrics.probes_total, name, metrics.probes_timeout,
+                    name, latency_avg, name, (double)metrics.latency_max / Time_Milli,
+                    name, queue_delay_avg, name, (double)metrics.queue_delay_max / Time_Milli);
+}
+
+static int metrics_image_pull_stat(const char *name, char *buffer, int size)
+{
+    im_pull_metrics metrics = { 0 };
+    double fetch_time_avg = 0;
+    double queue_delay_avg = 0;
+
+    im_get_pull_metrics(&metrics);
+    if (metrics.tasks_total > 0) {
+        fetch_time_avg = (double)metrics.fetch_time_total / metrics.tasks_total / Time_Milli;
+        queue_delay_avg = (double)metrics.queue_delay_total / metrics.tasks_total / Time_Milli;
+    }
+
+    return snprintf(buffer, size,
+                    "%s{section=\"workers\"} %" PRIu64 "\n"
+                    "%s{section=\"pulls\"} %" PRIu64 "\n"
+                    "%s{section=\"queued\"} %" PRIu64 "\n"
+                    "%s{section=\"running\"} %" PRIu64 "\n"
+                    "%s{section=\"tasks_total\"} %" PRIu64 "\n"
+                    "%s{section=\"tasks_failed\"} %" PRIu64 "\n"
+                    "%s{section=\"fetch_time_avg\"} %.2f\n"
+                    "%s{section=\"fetch_time_max\"} %.2f\n"
+                    "%s{section=\"queue_delay_avg\"} %.2f\n"
+                    "%s{section=\"queue_delay_max\"} %.2f\n",
+                    name, metrics.workers, name, metrics.pulls, name, metrics.queued,
+                    name, metrics.running, name, metrics.tasks_total, name, metrics.tasks_failed,
+                    name, fetch_time_avg, name, (double)metrics.fetch_time_max / Time_Milli,
+                    name, queue_delay_avg, name, (double)metrics.queue_delay_max / Time_Milli);
+}
+
 static isula_metrics_t g_metrics[] = {
     {NULL, METRICS_REQUEST_COUNT, COUNTER, g_req_count_desc, metrics_http_req_count_info}, /* export default */
     {"sys", ISULA_DAEMON_MEM_STAT, GAUGE, g_isula_daemon_mem_desc, metrics_get_isulad_mem_stat},
@@ -297,6 +362,8 @@ static isula_metrics_t g_metrics[] = {
     {"cpu", ISULA_CONT_CPU_STAT, GAUGE, g_cpu_stat_desc, metrics_containers_cpu_stats},
     {"pids", ISULA_CONT_PIDS, GAUGE, g_cont_pids_desc, metrics_containers_pids},
     {"sys", DAEMON_CALLOC_TOTAL, COUNTER, g_daemon_calloc_desc, metrics_daemon_alloced_mem_total},
+    {"health", ISULA_HEALTH_CHECK_STAT, GAUGE, g_health_check_desc, metrics_health_check_stat},
+    {"pull", ISULA_IMAGE_PULL_STAT, GAUGE, g_image_pull_desc, metrics_image_pull_stat},
 };
 
 static int metrics_msg_get_by_type(const char *url, char **metrics, int *len)
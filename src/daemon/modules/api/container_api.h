@@ -51,8 +51,27 @@ typedef struct health_check_manager {
     health_check_monitor_status_t monitor_status;
     // Used to wait for the health check minotor thread to close
     bool monitor_exist;
+    // generation of the current monitor, the end of an older one is ignored
+    uint64_t monitor_generation;
 } health_check_manager_t;
 
+typedef struct health_check_metrics {
+    uint64_t workers;
+    // monitors waiting for their next probe
+    uint64_t scheduled;
+    // probes due but waiting for a free worker
+    uint64_t queued;
+    uint64_t running;
+    uint64_t probes_total;
+    // probes running over their timeout
+    uint64_t probes_timeout;
+    // in nanoseconds
+    int64_t latency_total;
+    int64_t latency_max;
+    int64_t queue_delay_total;
+    int64_t queue_delay_max;
+} health_check_metrics_t;
+
 typedef struct _container_state_t_ {
     pthread_mutex_t mutex;
     container_state *state;
@@ -272,9 +291,16 @@ extern int container_exit_fifo_open(const char *cont_exit_fifo);
 
 void container_init_health_monitor(const char *id);
 void container_stop_health_checks(container_t *cont);
+void container_health_check_get_metrics(health_check_metrics_t *metrics);
 
 bool container_is_in_gc_progress(const char *id);
 
+struct runtime_container_resources_stats_info;
+
+int container_stats_collector_get(const char *id, int pid, struct runtime_container_resources_stats_info *info);
+
+void container_stats_collector_remove(const char *id);
+
 int container_module_init();
 
 #if defined(__cplusplus) || defined(c_plusplus)
@@ -150,6 +150,9 @@ typedef struct {
     char *server_address;
     char *identity_token;
     char *registry_token;
+
+    /* blobs of high priority pulls are fetched before those of other pulls, e.g. sandbox images */
+    bool high_priority;
 } im_pull_request;
 
 typedef struct {
@@ -157,6 +160,21 @@ typedef struct {
     char *errmsg;
 } im_pull_response;
 
+typedef struct {
+    uint64_t workers;
+    // pulls with blobs queued or being fetched
+    uint64_t pulls;
+    uint64_t queued;
+    uint64_t running;
+    uint64_t tasks_total;
+    uint64_t tasks_failed;
+    // in nanoseconds
+    int64_t queue_delay_total;
+    int64_t queue_delay_max;
+    int64_t fetch_time_total;
+    int64_t fetch_time_max;
+} im_pull_metrics;
+
 typedef struct {
     char *server;
     char *username;
@@ -310,6 +328,8 @@ void free_im_pull_request(im_pull_request *req);
 
 void free_im_pull_response(im_pull_response *resp);
 
+void im_get_pull_metrics(im_pull_metrics *metrics);
+
 char *im_get_image_type(const char *image, const char *external_rootfs);
 
 bool im_config_image_exist(const char *image_name);
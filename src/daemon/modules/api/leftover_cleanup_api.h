@@ -29,6 +29,9 @@ void clean_module_fill_ctx(cleanup_ctx_data_t data_type, void *data);
 
 void clean_module_do_clean();
 
+// path is moved into trash and removed in background, or removed directly if it can not be moved
+int clean_module_remove_dir_async(const char *path);
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }
 #endif
@@ -50,6 +50,13 @@ int exec_container(const container_t *cont, const container_exec_request *reques
 container_inspect *inspect_container(const char *id, int timeout, bool with_host_config);
 container_inspect_state *inspect_container_state(const char *id, int timeout);
 
+/*
+ * Narrow inspect for the status of CRI: id, created, log path, image, labels, annotations,
+ * mounts and state, which are read without the container lock. Network settings and
+ * namespace modes of host config are packed under the lock only if with_network is true.
+ */
+container_inspect *inspect_container_status(const char *id, int timeout, bool with_network);
+
 #ifdef __cplusplus
 }
 #endif
@@ -38,6 +38,8 @@
 #include "containers_gc.h"
 #include "supervisor.h"
 #include "restore.h"
+#include "stats_collector.h"
+#include "state_journal.h"
 #include "err_msg.h"
 #include "util_atomic.h"
 #include "utils_array.h"
@@ -706,6 +708,7 @@ out:
 static int container_save_container_state_config(const container_t *cont)
 {
     int ret = 0;
+    struct parser_context ctx = { OPT_GEN_SIMPLIFY, 0 };
     parser_error err = NULL;
     char *json_container_state = NULL;
 
@@ -715,13 +718,18 @@ static int container_save_container_state_config(const container_t *cont)
 
     container_state_lock(cont->state);
 
-    json_container_state = container_state_generate_json(cont->state->state, NULL, &err);
+    // journal records are one line each
+    json_container_state = container_state_generate_json(cont->state->state, &ctx, &err);
     if (json_container_state == NULL) {
         ERROR("Failed to generate container state json string:%s", err ? err : " ");
         ret = -1;
         goto out;
     }
 
+    if (container_state_journal_append(cont->root_path, cont->common_config->id, json_container_state) == 0) {
+        goto out;
+    }
+
     ret = save_container_state_config(cont->common_config->id, cont->root_path, json_container_state);
     if (ret != 0) {
         ERROR("Failed to save container state json to file");
@@ -1459,6 +1467,21 @@ int container_module_init()
         return -1;
     }
 
+    if (new_stats_collector()) {
+        ERROR("Create stats collector failed");
+        return -1;
+    }
+
+    if (health_check_init()) {
+        ERROR("Create health check scheduler failed");
+        return -1;
+    }
+
+    // must replay before restore, containers are loaded from the state files
+    if (container_state_journal_init() != 0) {
+        WARN("Failed to init container state journal, write state files directly");
+    }
+
     containers_restore();
 
     if (start_gchandler()) {
@@ -1466,6 +1489,11 @@ int container_module_init()
         return -1;
     }
 
+    if (start_stats_collector()) {
+        ERROR("Failed to start stats collector");
+        return -1;
+    }
+
     INFO("Container module started");
     return 0;
 }
@@ -27,6 +27,7 @@ restart_manager_t *get_restart_manager(container_t *cont);
 
 int save_host_config(const char *id, const char *rootpath, const char *hostconfigstr);
 int save_config_v2_json(const char *id, const char *rootpath, const char *v2configstr);
+int save_container_state_config(const char *id, const char *rootpath, const char *state_configstr);
 
 #if defined(__cplusplus) || defined(c_plusplus)
 }
@@ -24,20 +24,56 @@
 #include "map.h"
 #include "utils_array.h"
 
-typedef struct memory_store_t {
+// number of lock stripes of container store and name index, must be power of 2
+#define CONTAINERS_STORE_STRIPES 64
+#define PREFIX_INDEX_INIT_CAP 64
+
+typedef struct memory_store_stripe_t {
     map_t *map; // map string container_t
     pthread_rwlock_t rwlock;
+} memory_store_stripe;
+
+typedef struct memory_store_t {
+    memory_store_stripe stripes[CONTAINERS_STORE_STRIPES];
 } memory_store;
 
-typedef struct name_index_t {
+typedef struct name_index_stripe_t {
     map_t *map;
     pthread_rwlock_t rwlock;
+} name_index_stripe;
+
+typedef struct name_index_t {
+    name_index_stripe stripes[CONTAINERS_STORE_STRIPES];
 } name_index;
 
+// sorted array of all container ids, used for short id lookup
+typedef struct prefix_index_t {
+    char **ids;
+    size_t len;
+    size_t cap;
+    pthread_rwlock_t rwlock;
+} prefix_index;
+
 static memory_store *g_containers_store = NULL;
 
+static prefix_index *g_prefix_index = NULL;
+
 static name_index *g_indexs = NULL;
 
+/* FNV-1a hash of key, used to select the stripe */
+static inline size_t stripe_of(const char *key)
+{
+    uint32_t hash = 2166136261U;
+    const unsigned char *p = (const unsigned char *)key;
+
+    for (; *p != '\0'; p++) {
+        hash ^= *p;
+        hash *= 16777619U;
+    }
+
+    return (size_t)(hash & (CONTAINERS_STORE_STRIPES - 1));
+}
+
 /* memory store map kvfree */
 static void memory_store_map_kvfree(void *key, void *value)
 {
@@ -49,19 +85,26 @@ static void memory_store_map_kvfree(void *key, void *value)
 /* memory store free */
 static void memory_store_free(memory_store *store)
 {
+    size_t i;
+
     if (store == NULL) {
         return;
     }
-    map_free(store->map);
-    store->map = NULL;
-    pthread_rwlock_destroy(&(store->rwlock));
+    for (i = 0; i < CONTAINERS_STORE_STRIPES; i++) {
+        if (store->stripes[i].map == NULL) {
+            continue;
+        }
+        map_free(store->stripes[i].map);
+        store->stripes[i].map = NULL;
+        pthread_rwlock_destroy(&(store->stripes[i].rwlock));
+    }
     free(store);
 }
 
 /* memory store new */
 static memory_store *memory_store_new(void)
 {
-    int ret;
+    size_t i;
     memory_store *store = NULL;
 
     store = util_common_calloc_s(sizeof(memory_store));
@@ -69,16 +112,17 @@ static memory_store *memory_store_new(void)
         ERROR("Out of memory");
         return NULL;
     }
-    ret = pthread_rwlock_init(&(store->rwlock), NULL);
-    if (ret != 0) {
-        ERROR("Failed to init memory store rwlock");
-        free(store);
-        return NULL;
-    }
-    store->map = map_new(MAP_STR_PTR, MAP_DEFAULT_CMP_FUNC, memory_store_map_kvfree);
-    if (store->map == NULL) {
-        ERROR("Out of memory");
-        goto error_out;
+    for (i = 0; i < CONTAINERS_STORE_STRIPES; i++) {
+        if (pthread_rwlock_init(&(store->stripes[i].rwlock), NULL) != 0) {
+            ERROR("Failed to init memory store rwlock");
+            goto error_out;
+        }
+        store->stripes[i].map = map_new(MAP_STR_PTR, MAP_DEFAULT_CMP_FUNC, memory_store_map_kvfree);
+        if (store->stripes[i].map == NULL) {
+            ERROR("Out of memory");
+            pthread_rwlock_destroy(&(store->stripes[i].rwlock));
+            goto error_out;
+        }
     }
     return store;
 error_out:
@@ -86,38 +130,242 @@ error_out:
     return NULL;
 }
 
+/* lock all stripes of memory store in order, to get a consistent view of all containers */
+static int memory_store_rdlock_all(void)
+{
+    size_t i;
+
+    for (i = 0; i < CONTAINERS_STORE_STRIPES; i++) {
+        if (pthread_rwlock_rdlock(&g_containers_store->stripes[i].rwlock) != 0) {
+            ERROR("lock memory store failed");
+            goto unlock_out;
+        }
+    }
+    return 0;
+
+unlock_out:
+    while (i > 0) {
+        i--;
+        (void)pthread_rwlock_unlock(&g_containers_store->stripes[i].rwlock);
+    }
+    return -1;
+}
+
+static void memory_store_unlock_all(void)
+{
+    size_t i;
+
+    for (i = CONTAINERS_STORE_STRIPES; i > 0; i--) {
+        if (pthread_rwlock_unlock(&g_containers_store->stripes[i - 1].rwlock) != 0) {
+            ERROR("unlock memory store failed");
+        }
+    }
+}
+
+static size_t memory_store_size_locked(void)
+{
+    size_t i;
+    size_t size = 0;
+
+    for (i = 0; i < CONTAINERS_STORE_STRIPES; i++) {
+        size += map_size(g_containers_store->stripes[i].map);
+    }
+    return size;
+}
+
+/* prefix index new */
+static prefix_index *prefix_index_new(void)
+{
+    prefix_index *index = NULL;
+
+    index = util_common_calloc_s(sizeof(prefix_index));
+    if (index == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+    if (pthread_rwlock_init(&(index->rwlock), NULL) != 0) {
+        ERROR("Failed to init prefix index rwlock");
+        free(index);
+        return NULL;
+    }
+    return index;
+}
+
+/* find the first position whose id is not less than key */
+static size_t prefix_index_lower_bound(const prefix_index *index, const char *key)
+{
+    size_t low = 0;
+    size_t high = index->len;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (strcmp(index->ids[mid], key) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/* prefix index add, adding an existing id is a no-op */
+static bool prefix_index_add(const char *id)
+{
+    bool ret = false;
+    size_t pos;
+
+    if (pthread_rwlock_wrlock(&g_prefix_index->rwlock) != 0) {
+        ERROR("lock prefix index failed");
+        return false;
+    }
+
+    pos = prefix_index_lower_bound(g_prefix_index, id);
+    if (pos < g_prefix_index->len && strcmp(g_prefix_index->ids[pos], id) == 0) {
+        ret = true;
+        goto unlock;
+    }
+
+    if (g_prefix_index->len == g_prefix_index->cap) {
+        size_t new_cap = g_prefix_index->cap == 0 ? PREFIX_INDEX_INIT_CAP : g_prefix_index->cap * 2;
+        char **new_ids = NULL;
+
+        if (new_cap > SIZE_MAX / sizeof(char *) ||
+            util_mem_realloc((void **)&new_ids, new_cap * sizeof(char *), (void *)g_prefix_index->ids,
+                             g_prefix_index->cap * sizeof(char *)) != 0) {
+            ERROR("Out of memory");
+            goto unlock;
+        }
+        g_prefix_index->ids = new_ids;
+        g_prefix_index->cap = new_cap;
+    }
+
+    (void)memmove(&g_prefix_index->ids[pos + 1], &g_prefix_index->ids[pos],
+                  (g_prefix_index->len - pos) * sizeof(char *));
+    g_prefix_index->ids[pos] = util_strdup_s(id);
+    g_prefix_index->len++;
+    ret = true;
+
+unlock:
+    if (pthread_rwlock_unlock(&g_prefix_index->rwlock) != 0) {
+        ERROR("unlock prefix index failed");
+    }
+    return ret;
+}
+
+/* prefix index remove */
+static void prefix_index_remove(const char *id)
+{
+    size_t pos;
+
+    if (pthread_rwlock_wrlock(&g_prefix_index->rwlock) != 0) {
+        ERROR("lock prefix index failed");
+        return;
+    }
+
+    pos = prefix_index_lower_bound(g_prefix_index, id);
+    if (pos < g_prefix_index->len && strcmp(g_prefix_index->ids[pos], id) == 0) {
+        free(g_prefix_index->ids[pos]);
+        (void)memmove(&g_prefix_index->ids[pos], &g_prefix_index->ids[pos + 1],
+                      (g_prefix_index->len - pos - 1) * sizeof(char *));
+        g_prefix_index->len--;
+        g_prefix_index->ids[g_prefix_index->len] = NULL;
+    }
+
+    if (pthread_rwlock_unlock(&g_prefix_index->rwlock) != 0) {
+        ERROR("unlock prefix index failed");
+    }
+}
+
+/* find the only id matching the prefix, return NULL if no id or multiple ids match */
+static char *prefix_index_get_unique(const char *prefix)
+{
+    char *id = NULL;
+    size_t pos;
+    size_t prefix_len = strlen(prefix);
+
+    if (pthread_rwlock_rdlock(&g_prefix_index->rwlock) != 0) {
+        ERROR("lock prefix index failed");
+        return NULL;
+    }
+
+    // all ids with the prefix are adjacent in the sorted array
+    pos = prefix_index_lower_bound(g_prefix_index, prefix);
+    if (pos >= g_prefix_index->len || strncmp(g_prefix_index->ids[pos], prefix, prefix_len) != 0) {
+        goto unlock;
+    }
+    if (pos + 1 < g_prefix_index->len && strncmp(g_prefix_index->ids[pos + 1], prefix, prefix_len) == 0) {
+        ERROR("Multiple IDs found with provided prefix: %s", prefix);
+        goto unlock;
+    }
+    id = util_strdup_s(g_prefix_index->ids[pos]);
+
+unlock:
+    if (pthread_rwlock_unlock(&g_prefix_index->rwlock) != 0) {
+        ERROR("unlock prefix index failed");
+    }
+    return id;
+}
+
 /* containers store add */
 bool containers_store_add(const char *id, container_t *cont)
 {
     bool ret = false;
+    memory_store_stripe *stripe = NULL;
 
-    if (pthread_rwlock_wrlock(&g_containers_store->rwlock)) {
+    if (id == NULL) {
+        return false;
+    }
+
+    stripe = &g_containers_store->stripes[stripe_of(id)];
+    if (pthread_rwlock_wrlock(&stripe->rwlock)) {
         ERROR("lock memory store failed");
         return false;
     }
-    ret = map_replace(g_containers_store->map, (void *)id, (void *)cont);
-    if (pthread_rwlock_unlock(&g_containers_store->rwlock)) {
+    ret = map_replace(stripe->map, (void *)id, (void *)cont);
+    if (pthread_rwlock_unlock(&stripe->rwlock)) {
         ERROR("unlock memory store failed");
         return false;
     }
-    return ret;
+
+    if (!ret || prefix_index_add(id)) {
+        return ret;
+    }
+
+    ERROR("Failed to add %s to prefix index", id);
+    if (pthread_rwlock_wrlock(&stripe->rwlock)) {
+        ERROR("lock memory store failed");
+        return false;
+    }
+    // the reference of caller is kept, it still owns the container when add failed
+    if (map_search(stripe->map, (void *)id) == cont) {
+        container_refinc(cont);
+        if (!map_remove(stripe->map, (void *)id)) {
+            ERROR("Failed to remove %s from memory store", id);
+        }
+    }
+    if (pthread_rwlock_unlock(&stripe->rwlock)) {
+        ERROR("unlock memory store failed");
+    }
+    return false;
 }
 
 /* containers store get */
 static container_t *containers_store_get_by_id(const char *id)
 {
     container_t *cont = NULL;
+    memory_store_stripe *stripe = NULL;
 
     if (id == NULL) {
         return NULL;
     }
-    if (pthread_rwlock_rdlock(&g_containers_store->rwlock) != 0) {
+    stripe = &g_containers_store->stripes[stripe_of(id)];
+    if (pthread_rwlock_rdlock(&stripe->rwlock) != 0) {
         ERROR("lock memory store failed");
         return cont;
     }
-    cont = map_search(g_containers_store->map, (void *)id);
+    cont = map_search(stripe->map, (void *)id);
     container_refinc(cont);
-    if (pthread_rwlock_unlock(&g_containers_store->rwlock) != 0) {
+    if (pthread_rwlock_unlock(&stripe->rwlock) != 0) {
         ERROR("unlock memory store failed");
         return cont;
     }
@@ -150,55 +398,21 @@ static container_t *containers_store_get_by_name(const char *name)
 /* containers store get container by prefix */
 container_t *containers_store_get_by_prefix(const char *prefix)
 {
-    bool ret = false;
-    char *container_id = NULL;
+    char *id = NULL;
     container_t *cont = NULL;
-    map_itor *itor = NULL;
 
     if (prefix == NULL) {
         return NULL;
     }
-    if (pthread_rwlock_rdlock(&g_containers_store->rwlock) != 0) {
-        ERROR("lock memory store failed");
-        return NULL;
-    }
 
-    itor = map_itor_new(g_containers_store->map);
-    if (itor == NULL) {
-        ERROR("Out of memory");
-        ret = false;
-        goto unlock;
-    }
-
-    for (; map_itor_valid(itor); map_itor_next(itor)) {
-        container_id = map_itor_key(itor);
-        if (container_id == NULL) {
-            ERROR("Out of memory");
-            ret = false;
-            goto unlock;
-        }
-        if (strncmp(container_id, prefix, strlen(prefix)) == 0) {
-            if (cont != NULL) {
-                ERROR("Multiple IDs found with provided prefix: %s", prefix);
-                ret = false;
-                goto unlock;
-            } else {
-                cont = map_itor_value(itor);
-            }
-        }
+    id = prefix_index_get_unique(prefix);
+    if (id == NULL) {
+        return NULL;
     }
 
-    ret = true;
-    container_refinc(cont);
+    cont = containers_store_get_by_id(id);
 
-unlock:
-    if (pthread_rwlock_unlock(&g_containers_store->rwlock) != 0) {
-        ERROR("unlock memory store failed");
-    }
-    map_itor_free(itor);
-    if (!ret) {
-        cont = NULL;
-    }
+    free(id);
     return cont;
 }
 
@@ -239,11 +453,21 @@ container_t *containers_store_get(const char *id_or_name)
     return NULL;
 }
 
+/* compare containers by id, keep the same order as the ids list */
+static int container_id_cmp(const void *a, const void *b)
+{
+    const container_t *ca = *(const container_t * const *)a;
+    const container_t *cb = *(const container_t * const *)b;
+
+    return strcmp(ca->common_config->id, cb->common_config->id);
+}
+
 /* containers store list */
 int containers_store_list(container_t ***out, size_t *size)
 {
     int ret = -1;
     size_t i;
+    size_t n = 0;
     container_t **conts = NULL;
     map_itor *itor = NULL;
 
@@ -252,12 +476,11 @@ int containers_store_list(container_t ***out, size_t *size)
         return -1;
     }
 
-    if (pthread_rwlock_rdlock(&g_containers_store->rwlock) != 0) {
-        ERROR("lock memory store failed");
+    if (memory_store_rdlock_all() != 0) {
         return -1;
     }
 
-    *size = map_size(g_containers_store->map);
+    *size = memory_store_size_locked();
     if (*size == 0) {
         ret = 0;
         goto unlock;
@@ -268,26 +491,33 @@ int containers_store_list(container_t ***out, size_t *size)
         goto unlock;
     }
 
-    itor = map_itor_new(g_containers_store->map);
-    if (itor == NULL) {
-        ERROR("Out of memory");
-        goto unlock;
-    }
+    for (i = 0; i < CONTAINERS_STORE_STRIPES; i++) {
+        itor = map_itor_new(g_containers_store->stripes[i].map);
+        if (itor == NULL) {
+            ERROR("Out of memory");
+            goto unlock;
+        }
 
-    for (i = 0; map_itor_valid(itor) && i < *size; map_itor_next(itor), i++) {
-        conts[i] = map_itor_value(itor);
-        container_refinc(conts[i]);
+        for (; map_itor_valid(itor) && n < *size; map_itor_next(itor), n++) {
+            conts[n] = map_itor_value(itor);
+            container_refinc(conts[n]);
+        }
+        map_itor_free(itor);
+        itor = NULL;
     }
     ret = 0;
 unlock:
-    if (pthread_rwlock_unlock(&g_containers_store->rwlock)) {
-        ERROR("unlock memory store failed");
-    }
+    memory_store_unlock_all();
     map_itor_free(itor);
     if (ret != 0) {
+        for (i = 0; i < n; i++) {
+            container_unref(conts[i]);
+        }
         free(conts);
         *size = 0;
         conts = NULL;
+    } else if (conts != NULL) {
+        qsort(conts, n, sizeof(container_t *), container_id_cmp);
     }
     *out = conts;
     return ret;
@@ -297,38 +527,33 @@ unlock:
 char **containers_store_list_ids(void)
 {
     bool ret = false;
+    size_t i;
     char **idsarray = NULL;
-    map_itor *itor = NULL;
 
-    if (pthread_rwlock_rdlock(&g_containers_store->rwlock) != 0) {
-        ERROR("lock memory store failed");
+    if (pthread_rwlock_rdlock(&g_prefix_index->rwlock) != 0) {
+        ERROR("lock prefix index failed");
         return NULL;
     }
 
-    if (map_size(g_containers_store->map) == 0) {
+    if (g_prefix_index->len == 0) {
         ret = true;
         goto unlock;
     }
 
-    itor = map_itor_new(g_containers_store->map);
-    if (itor == NULL) {
+    idsarray = util_smart_calloc_s(sizeof(char *), g_prefix_index->len + 1);
+    if (idsarray == NULL) {
         ERROR("Out of memory");
         goto unlock;
     }
 
-    for (; map_itor_valid(itor); map_itor_next(itor)) {
-        char *id = map_itor_key(itor);
-        if (util_array_append(&idsarray, id ? id : "-")) {
-            ERROR("Out of memory");
-            goto unlock;
-        }
+    for (i = 0; i < g_prefix_index->len; i++) {
+        idsarray[i] = util_strdup_s(g_prefix_index->ids[i]);
     }
     ret = true;
 unlock:
-    if (pthread_rwlock_unlock(&g_containers_store->rwlock)) {
-        ERROR("unlock memory store failed");
+    if (pthread_rwlock_unlock(&g_prefix_index->rwlock)) {
+        ERROR("unlock prefix index failed");
     }
-    map_itor_free(itor);
     if (!ret) {
         util_free_array(idsarray);
         idsarray = NULL;
@@ -340,16 +565,26 @@ unlock:
 bool containers_store_remove(const char *id)
 {
     bool ret = false;
+    memory_store_stripe *stripe = NULL;
 
-    if (pthread_rwlock_wrlock(&g_containers_store->rwlock) != 0) {
+    if (id == NULL) {
+        return false;
+    }
+
+    stripe = &g_containers_store->stripes[stripe_of(id)];
+    if (pthread_rwlock_wrlock(&stripe->rwlock) != 0) {
         ERROR("lock memory store failed");
         return false;
     }
-    ret = map_remove(g_containers_store->map, (void *)id);
-    if (pthread_rwlock_unlock(&g_containers_store->rwlock) != 0) {
+    ret = map_remove(stripe->map, (void *)id);
+    if (pthread_rwlock_unlock(&stripe->rwlock) != 0) {
         ERROR("unlock memory store failed");
         return false;
     }
+
+    if (ret) {
+        prefix_index_remove(id);
+    }
     return ret;
 }
 
@@ -360,25 +595,38 @@ int containers_store_init(void)
     if (g_containers_store == NULL) {
         return -1;
     }
+    g_prefix_index = prefix_index_new();
+    if (g_prefix_index == NULL) {
+        memory_store_free(g_containers_store);
+        g_containers_store = NULL;
+        return -1;
+    }
     return 0;
 }
 
 /* name index free */
 static void name_index_free(name_index *indexs)
 {
+    size_t i;
+
     if (indexs == NULL) {
         return;
     }
-    map_free(indexs->map);
-    indexs->map = NULL;
-    pthread_rwlock_destroy(&(indexs->rwlock));
+    for (i = 0; i < CONTAINERS_STORE_STRIPES; i++) {
+        if (indexs->stripes[i].map == NULL) {
+            continue;
+        }
+        map_free(indexs->stripes[i].map);
+        indexs->stripes[i].map = NULL;
+        pthread_rwlock_destroy(&(indexs->stripes[i].rwlock));
+    }
     free(indexs);
 }
 
 /* name index new */
 static name_index *name_index_new(void)
 {
-    int ret;
+    size_t i;
     name_index *indexs = NULL;
 
     indexs = util_common_calloc_s(sizeof(name_index));
@@ -386,16 +634,17 @@ static name_index *name_index_new(void)
         ERROR("Out of memory");
         return NULL;
     }
-    ret = pthread_rwlock_init(&(indexs->rwlock), NULL);
-    if (ret != 0) {
-        ERROR("Failed to init name g_indexs rwlock");
-        free(indexs);
-        return NULL;
-    }
-    indexs->map = map_new(MAP_STR_STR, MAP_DEFAULT_CMP_FUNC, MAP_DEFAULT_FREE_FUNC);
-    if (indexs->map == NULL) {
-        ERROR("Out of memory");
-        goto error_out;
+    for (i = 0; i < CONTAINERS_STORE_STRIPES; i++) {
+        if (pthread_rwlock_init(&(indexs->stripes[i].rwlock), NULL) != 0) {
+            ERROR("Failed to init name g_indexs rwlock");
+            goto error_out;
+        }
+        indexs->stripes[i].map = map_new(MAP_STR_STR, MAP_DEFAULT_CMP_FUNC, MAP_DEFAULT_FREE_FUNC);
+        if (indexs->stripes[i].map == NULL) {
+            ERROR("Out of memory");
+            pthread_rwlock_destroy(&(indexs->stripes[i].rwlock));
+            goto error_out;
+        }
     }
     return indexs;
 error_out:
@@ -407,13 +656,19 @@ error_out:
 bool container_name_index_add(const char *name, const char *id)
 {
     bool ret = false;
+    name_index_stripe *stripe = NULL;
 
-    if (pthread_rwlock_wrlock(&g_indexs->rwlock) != 0) {
+    if (name == NULL) {
+        return false;
+    }
+
+    stripe = &g_indexs->stripes[stripe_of(name)];
+    if (pthread_rwlock_wrlock(&stripe->rwlock) != 0) {
         ERROR("lock name index failed");
         return false;
     }
-    ret = map_insert(g_indexs->map, (void *)name, (void *)id);
-    if (pthread_rwlock_unlock(&g_indexs->rwlock) != 0) {
+    ret = map_insert(stripe->map, (void *)name, (void *)id);
+    if (pthread_rwlock_unlock(&stripe->rwlock) != 0) {
         ERROR("unlock name index failed");
         return false;
     }
@@ -424,20 +679,46 @@ bool container_name_index_add(const char *name, const char *id)
 bool container_name_index_rename(const char *new_name, const char *old_name, const char *id)
 {
     bool ret = false;
+    size_t new_idx;
+    size_t old_idx;
+    name_index_stripe *first = NULL;
+    name_index_stripe *second = NULL;
+
+    if (new_name == NULL || old_name == NULL) {
+        return false;
+    }
 
-    if (pthread_rwlock_wrlock(&g_indexs->rwlock) != 0) {
+    // lock the stripes in ascending order to avoid deadlock with concurrent rename
+    new_idx = stripe_of(new_name);
+    old_idx = stripe_of(old_name);
+    first = &g_indexs->stripes[new_idx < old_idx ? new_idx : old_idx];
+    if (new_idx != old_idx) {
+        second = &g_indexs->stripes[new_idx < old_idx ? old_idx : new_idx];
+    }
+
+    if (pthread_rwlock_wrlock(&first->rwlock) != 0) {
         ERROR("lock name index failed");
         return false;
     }
-    ret = map_insert(g_indexs->map, (void *)new_name, (void *)id);
+    if (second != NULL && pthread_rwlock_wrlock(&second->rwlock) != 0) {
+        ERROR("lock name index failed");
+        (void)pthread_rwlock_unlock(&first->rwlock);
+        return false;
+    }
+
+    ret = map_insert(g_indexs->stripes[new_idx].map, (void *)new_name, (void *)id);
     if (!ret) {
         goto unlock_out;
     }
 
-    ret = map_remove(g_indexs->map, (void *)old_name);
+    ret = map_remove(g_indexs->stripes[old_idx].map, (void *)old_name);
 
 unlock_out:
-    if (pthread_rwlock_unlock(&g_indexs->rwlock) != 0) {
+    if (second != NULL && pthread_rwlock_unlock(&second->rwlock) != 0) {
+        ERROR("unlock name index failed");
+        ret = false;
+    }
+    if (pthread_rwlock_unlock(&first->rwlock) != 0) {
         ERROR("unlock name index failed");
         return false;
     }
@@ -449,19 +730,21 @@ char *container_name_index_get(const char *name)
 {
     char *id = NULL;
     char *result = NULL;
+    name_index_stripe *stripe = NULL;
 
     if (name == NULL) {
         return id;
     }
-    if (pthread_rwlock_rdlock(&g_indexs->rwlock) != 0) {
+    stripe = &g_indexs->stripes[stripe_of(name)];
+    if (pthread_rwlock_rdlock(&stripe->rwlock) != 0) {
         ERROR("lock name index failed");
         return id;
     }
 
-    id = map_search(g_indexs->map, (void *)name);
+    id = map_search(stripe->map, (void *)name);
     result = util_strdup_s(id);
 
-    if (pthread_rwlock_unlock(&g_indexs->rwlock) != 0) {
+    if (pthread_rwlock_unlock(&stripe->rwlock) != 0) {
         ERROR("unlock name index failed");
     }
     return result;
@@ -471,13 +754,19 @@ char *container_name_index_get(const char *name)
 bool container_name_index_remove(const char *name)
 {
     bool ret = false;
+    name_index_stripe *stripe = NULL;
 
-    if (pthread_rwlock_wrlock(&g_indexs->rwlock) != 0) {
+    if (name == NULL) {
+        return false;
+    }
+
+    stripe = &g_indexs->stripes[stripe_of(name)];
+    if (pthread_rwlock_wrlock(&stripe->rwlock) != 0) {
         ERROR("lock name index failed");
         return false;
     }
-    ret = map_remove(g_indexs->map, (void *)name);
-    if (pthread_rwlock_unlock(&g_indexs->rwlock) != 0) {
+    ret = map_remove(stripe->map, (void *)name);
+    if (pthread_rwlock_unlock(&stripe->rwlock) != 0) {
         ERROR("unlock name index failed");
         return false;
     }
@@ -488,6 +777,7 @@ bool container_name_index_remove(const char *name)
 map_t *container_name_index_get_all(void)
 {
     bool ret = false;
+    size_t i;
     map_t *map_id_name = NULL;
     map_itor *itor = NULL;
 
@@ -497,33 +787,36 @@ map_t *container_name_index_get_all(void)
         return NULL;
     }
 
-    if (pthread_rwlock_rdlock(&g_indexs->rwlock) != 0) {
-        ERROR("lock memory store failed");
-        goto out;
-    }
+    for (i = 0; i < CONTAINERS_STORE_STRIPES; i++) {
+        name_index_stripe *stripe = &g_indexs->stripes[i];
 
-    if (map_size(g_indexs->map) == 0) {
-        ret = true;
-        goto unlock;
-    }
+        if (pthread_rwlock_rdlock(&stripe->rwlock) != 0) {
+            ERROR("lock name index failed");
+            goto out;
+        }
 
-    itor = map_itor_new(g_indexs->map);
-    if (itor == NULL) {
-        ERROR("Out of memory");
-        goto unlock;
-    }
+        itor = map_itor_new(stripe->map);
+        if (itor == NULL) {
+            ERROR("Out of memory");
+            (void)pthread_rwlock_unlock(&stripe->rwlock);
+            goto out;
+        }
 
-    for (; map_itor_valid(itor); map_itor_next(itor)) {
-        if (!map_insert(map_id_name, map_itor_value(itor), map_itor_key(itor))) {
-            ERROR("Insert failed");
-            goto unlock;
+        for (; map_itor_valid(itor); map_itor_next(itor)) {
+            if (!map_insert(map_id_name, map_itor_value(itor), map_itor_key(itor))) {
+                ERROR("Insert failed");
+                (void)pthread_rwlock_unlock(&stripe->rwlock);
+                goto out;
+            }
+        }
+        map_itor_free(itor);
+        itor = NULL;
+
+        if (pthread_rwlock_unlock(&stripe->rwlock) != 0) {
+            ERROR("unlock name index failed");
         }
     }
     ret = true;
-unlock:
-    if (pthread_rwlock_unlock(&g_indexs->rwlock)) {
-        ERROR("unlock memory store failed");
-    }
 out:
     map_itor_free(itor);
     if (!ret) {
@@ -35,6 +35,7 @@
 #include "io_wrapper.h"
 #include "utils_array.h"
 #include "utils_timestamp.h"
+#include "health_check_scheduler.h"
 
 /* container state lock */
 static void container_health_check_lock(health_check_manager_t *health)
@@ -174,7 +175,11 @@ static void close_health_check_monitor(container_t *cont)
     }
 
     set_monitor_stop_status(cont->health_check);
-    // ensure that the monitor process exits
+    if (health_check_scheduler_cancel(cont->common_config->id)) {
+        set_monitor_exist_flag(cont->health_check, false);
+        return;
+    }
+    // ensure that the running probe of the monitor finishes
     while (get_monitor_exist_flag(cont->health_check)) {
         util_usleep_nointerupt(500);
     }
@@ -763,100 +768,61 @@ out:
     return ret;
 }
 
-static int do_monitor_default(const char *container_id, int64_t probe_interval, health_check_manager_t *health_check,
-                              const types_timestamp_t *start_timestamp, types_timestamp_t *last_timestamp)
+// Run one round of the container's monitor, called by a health check worker when the probe is due.
+// There is never more than one probe running per container at a time.
+static bool health_check_monitor_probe(const char *container_id)
 {
-    int64_t time_interval = 0;
-
-    if (!valid_container_status_for_health_check(container_id)) {
-        ERROR("Invalid container status for health check");
-        return -1;
-    }
+    bool keep = false;
+    container_t *cont = NULL;
+    types_timestamp_t start_timestamp = { 0 };
 
-    if (util_get_now_time_stamp(last_timestamp) == false) {
-        ERROR("Failed to get time stamp");
-        return -1;
+    cont = containers_store_get(container_id);
+    if (cont == NULL) {
+        ERROR("Failed to get container info");
+        return false;
     }
 
-    if (util_get_time_interval(*start_timestamp, *last_timestamp, &time_interval)) {
-        ERROR("Failed to get time interval");
-        return -1;
+    // interval elapsed, the monitor goes IDLE -> INTERVAL -> probe -> IDLE as before
+    if (transfer_monitor_interval_timeout_status(cont->health_check) != 0) {
+        DEBUG("Stop healthcheck monitoring for container %s (received while idle)", cont->common_config->id);
+        goto out;
     }
 
-    if (time_interval >= probe_interval && transfer_monitor_interval_timeout_status(health_check) != 0) {
-        return -1;
+    if (do_monitor_interval(container_id, cont->health_check, &start_timestamp) != 0) {
+        goto out;
     }
-    util_usleep_nointerupt(500);
+    keep = true;
 
-    return 0;
+out:
+    container_unref(cont);
+    return keep;
 }
 
-// Run the container's monitoring thread until notified via "stop".
-// There is never more than one monitor thread running per container at a time.
-static void *health_check_monitor(void *arg)
+static void health_check_monitor_end(const char *container_id, uint64_t generation)
 {
-    char *container_id = NULL;
-    int64_t probe_interval = 0;
     container_t *cont = NULL;
-    types_timestamp_t start_timestamp = { 0 };
-    types_timestamp_t last_timestamp = { 0 };
-
-    if ((char *)arg == NULL) {
-        ERROR("Container id is empty");
-        return NULL;
-    }
-
-    container_id = (char *)arg;
-
-    prctl(PR_SET_NAME, "HealthCheck");
 
     cont = containers_store_get(container_id);
     if (cont == NULL) {
         ERROR("Failed to get container info");
-        free(container_id);
-        return NULL;
-    }
-    set_monitor_exist_flag(cont->health_check, true);
-    if (util_get_now_time_stamp(&start_timestamp) == false) {
-        ERROR("Failed to monitor start time stamp");
-        goto out;
-    }
-    probe_interval = (cont->common_config->config->healthcheck->interval == 0) ?
-                     DEFAULT_PROBE_INTERVAL :
-                     cont->common_config->config->healthcheck->interval;
-
-    while (true) {
-        switch (get_health_check_monitor_state(cont->health_check)) {
-            case MONITOR_STOP:
-                DEBUG("Stop healthcheck monitoring for container %s (received while idle)", cont->common_config->id);
-                goto out;
-            /* fall-through */
-            case MONITOR_INTERVAL:
-                if (do_monitor_interval(container_id, cont->health_check, &start_timestamp) != 0) {
-                    goto out;
-                }
-                break;
-            case MONITOR_IDLE:
-            /* fall-through */
-            default:
-                if (do_monitor_default(container_id, probe_interval, cont->health_check, &start_timestamp,
-                                       &last_timestamp) != 0) {
-                    goto out;
-                }
-                break;
-        }
+        return;
     }
 
-out:
-    free(container_id);
-    container_id = NULL;
+    container_health_check_lock(cont->health_check);
+    // a new monitor may be started after the scheduler dropped this one
+    if (cont->health_check->monitor_generation != generation) {
+        DEBUG("Ignore the end of a previous health check monitor of container %s", container_id);
+        goto unlock;
+    }
     //  unhealthy when the monitor has stopped for compatibility reasons
     set_health_status(cont, UNHEALTHY);
-    // post semaphore, indicating that the minitor process has exited
-    set_monitor_exist_flag(cont->health_check, false);
+    // indicating that the minitor has exited
+    cont->health_check->monitor_exist = false;
+
+unlock:
+    container_health_check_unlock(cont->health_check);
     container_unref(cont);
     DAEMON_CLEAR_ERRMSG();
-    return NULL;
 }
 
 // Ensure the health-check monitor is running or not, depending on the current
@@ -887,18 +853,24 @@ void container_update_health_monitor(const char *container_id)
 
     want_running = container_is_running(cont->state) && !container_is_paused(cont->state) && probe != HEALTH_NONE;
     if (want_running) {
-        pthread_t monitor_tid = { 0 };
-        char *cid = util_strdup_s(container_id);
-        // ensured that the health check monitor process is stopped
+        int64_t probe_interval = (cont->common_config->config->healthcheck->interval == 0) ?
+                                 DEFAULT_PROBE_INTERVAL :
+                                 cont->common_config->config->healthcheck->interval;
+        int64_t probe_timeout = (cont->common_config->config->healthcheck->timeout == 0) ?
+                                DEFAULT_PROBE_TIMEOUT :
+                                cont->common_config->config->healthcheck->timeout;
+        uint64_t generation = 0;
+
+        // ensured that the health check monitor is stopped
         close_health_check_monitor(cont);
         init_monitor_idle_status(cont->health_check);
-        if (pthread_create(&monitor_tid, NULL, health_check_monitor, (void *)cid)) {
-            free(cid);
-            ERROR("Failed to create thread to monitor health check...");
-            goto out;
-        }
-        if (pthread_detach(monitor_tid)) {
-            ERROR("Failed to detach the health check monitor thread");
+        container_health_check_lock(cont->health_check);
+        cont->health_check->monitor_exist = true;
+        generation = ++cont->health_check->monitor_generation;
+        container_health_check_unlock(cont->health_check);
+        if (health_check_scheduler_add(container_id, probe_interval, probe_timeout, generation) != 0) {
+            set_monitor_exist_flag(cont->health_check, false);
+            ERROR("Failed to schedule health check monitor...");
             goto out;
         }
     } else {
@@ -958,3 +930,14 @@ out:
     container_unref(cont);
     return;
 }
+
+void container_health_check_get_metrics(health_check_metrics_t *metrics)
+{
+    health_check_scheduler_get_metrics(metrics);
+}
+
+/* init health check scheduler */
+int health_check_init()
+{
+    return health_check_scheduler_init(health_check_monitor_probe, health_check_monitor_end);
+}
@@ -27,6 +27,8 @@ typedef enum { CMD, CMD_SHELL, HEALTH_NONE, HEALTH_UNKNOWN } health_probe_t;
 
 void health_check_manager_free(health_check_manager_t *health_check);
 
+int health_check_init();
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,506 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-07
+ * Description: provide health check scheduler functions
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include "health_check_scheduler.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+
+#include <isula_libutils/log.h>
+
+#include "err_msg.h"
+#include "linked_list.h"
+#include "map.h"
+#include "utils.h"
+
+typedef enum { ENTRY_IN_WHEEL = 0, ENTRY_READY, ENTRY_RUNNING } health_entry_status_t;
+
+typedef struct health_entry {
+    char *id;
+    uint64_t generation;
+    int64_t interval;
+    int64_t timeout;
+    // monotonic time when the next probe is due
+    int64_t due;
+    // monotonic time when the running probe started
+    int64_t started;
+    uint64_t rounds;
+    health_entry_status_t status;
+    bool cancelled;
+    // running probe is past its timeout, a worker is started in place of the one running it
+    bool hung;
+    // node in a wheel slot, in the ready queue or in the running list
+    struct linked_list node;
+} health_entry_t;
+
+typedef struct health_scheduler {
+    pthread_mutex_t mutex;
+    pthread_cond_t ready_cond;
+    // container id --> health_entry_t *
+    map_t *entries;
+    struct linked_list slots[HEALTH_WHEEL_SLOTS];
+    size_t cursor;
+    int64_t cursor_time;
+    struct linked_list ready;
+    struct linked_list running;
+    // workers wanted besides the ones running hung probes
+    uint64_t base_workers;
+    uint64_t hung;
+    unsigned int seed;
+    health_probe_cb_t probe_cb;
+    health_monitor_end_cb_t end_cb;
+    health_check_metrics_t metrics;
+} health_scheduler_t;
+
+static health_scheduler_t g_health_scheduler;
+
+static void health_scheduler_lock()
+{
+    if (pthread_mutex_lock(&g_health_scheduler.mutex) != 0) {
+        ERROR("Failed to lock health check scheduler");
+    }
+}
+
+static void health_scheduler_unlock()
+{
+    if (pthread_mutex_unlock(&g_health_scheduler.mutex) != 0) {
+        ERROR("Failed to unlock health check scheduler");
+    }
+}
+
+static int64_t monotonic_now()
+{
+    struct timespec ts = { 0 };
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * Time_Second + ts.tv_nsec;
+}
+
+static void health_entry_free(health_entry_t *entry)
+{
+    if (entry == NULL) {
+        return;
+    }
+    free(entry->id);
+    free(entry);
+}
+
+/* the map only indexes entries, they are freed by whoever ends the monitor */
+static void health_entry_kvfree(void *key, void *value)
+{
+    (void)value;
+    free(key);
+}
+
+static void wheel_insert_locked(health_entry_t *entry)
+{
+    int64_t delay = entry->due - g_health_scheduler.cursor_time;
+    uint64_t ticks = 1;
+    size_t slot;
+
+    if (delay > HEALTH_WHEEL_TICK) {
+        ticks = (uint64_t)((delay + HEALTH_WHEEL_TICK - 1) / HEALTH_WHEEL_TICK);
+    }
+
+    slot = (g_health_scheduler.cursor + ticks) % HEALTH_WHEEL_SLOTS;
+    entry->rounds = (ticks - 1) / HEALTH_WHEEL_SLOTS;
+    entry->status = ENTRY_IN_WHEEL;
+    linked_list_add_tail(&g_health_scheduler.slots[slot], &entry->node);
+    g_health_scheduler.metrics.scheduled++;
+}
+
+static void wheel_advance_locked(int64_t now)
+{
+    bool has_ready = false;
+
+    while (g_health_scheduler.cursor_time + HEALTH_WHEEL_TICK <= now) {
+        struct linked_list *it = NULL;
+        struct linked_list *next = NULL;
+        struct linked_list *slot = NULL;
+
+        g_health_scheduler.cursor = (g_health_scheduler.cursor + 1) % HEALTH_WHEEL_SLOTS;
+        g_health_scheduler.cursor_time += HEALTH_WHEEL_TICK;
+        slot = &g_health_scheduler.slots[g_health_scheduler.cursor];
+
+        linked_list_for_each_safe(it, slot, next) {
+            health_entry_t *entry = (health_entry_t *)it->elem;
+
+            if (entry->rounds > 0) {
+                entry->rounds--;
+                continue;
+            }
+            linked_list_del(&entry->node);
+            entry->status = ENTRY_READY;
+            linked_list_add_tail(&g_health_scheduler.ready, &entry->node);
+            g_health_scheduler.metrics.scheduled--;
+            g_health_scheduler.metrics.queued++;
+            has_ready = true;
+        }
+    }
+
+    if (has_ready) {
+        pthread_cond_broadcast(&g_health_scheduler.ready_cond);
+    }
+}
+
+static void update_probe_metrics_locked(int64_t queue_delay, int64_t latency)
+{
+    health_check_metrics_t *metrics = &g_health_scheduler.metrics;
+
+    metrics->probes_total++;
+    metrics->queue_delay_total += queue_delay;
+    if (queue_delay > metrics->queue_delay_max) {
+        metrics->queue_delay_max = queue_delay;
+    }
+    metrics->latency_total += latency;
+    if (latency > metrics->latency_max) {
+        metrics->latency_max = latency;
+    }
+}
+
+static void run_ready_entry(health_entry_t *entry)
+{
+    int64_t start = 0;
+    int64_t end = 0;
+    bool keep = false;
+
+    start = monotonic_now();
+    keep = g_health_scheduler.probe_cb(entry->id);
+    end = monotonic_now();
+
+    health_scheduler_lock();
+    linked_list_del(&entry->node);
+    if (entry->hung) {
+        g_health_scheduler.hung--;
+    }
+    g_health_scheduler.metrics.running--;
+    update_probe_metrics_locked(start > entry->due ? start - entry->due : 0, end - start);
+    if (keep && !entry->cancelled) {
+        // next probe is one interval after this one ends, same as the per-container monitor did
+        entry->due = end + entry->interval;
+        wheel_insert_locked(entry);
+        health_scheduler_unlock();
+        return;
+    }
+    if (!map_remove(g_health_scheduler.entries, entry->id)) {
+        WARN("Failed to remove health check entry of container %s", entry->id);
+    }
+    health_scheduler_unlock();
+
+    g_health_scheduler.end_cb(entry->id, entry->generation);
+    health_entry_free(entry);
+}
+
+static void *health_worker_routine(void *arg)
+{
+    int ret;
+
+    ret = pthread_detach(pthread_self());
+    if (ret != 0) {
+        CRIT("Set thread detach fail");
+        return NULL;
+    }
+
+    prctl(PR_SET_NAME, "HealthCheck");
+
+    for (;;) {
+        health_entry_t *entry = NULL;
+
+        health_scheduler_lock();
+        // a worker started in place of a hung probe is not needed once the probe returns
+        if (g_health_scheduler.metrics.workers - g_health_scheduler.hung > g_health_scheduler.base_workers) {
+            g_health_scheduler.metrics.workers--;
+            health_scheduler_unlock();
+            break;
+        }
+        while (linked_list_empty(&g_health_scheduler.ready)) {
+            pthread_cond_wait(&g_health_scheduler.ready_cond, &g_health_scheduler.mutex);
+        }
+        entry = (health_entry_t *)linked_list_first_elem(&g_health_scheduler.ready);
+        linked_list_del(&entry->node);
+        entry->status = ENTRY_RUNNING;
+        entry->started = monotonic_now();
+        linked_list_add_tail(&g_health_scheduler.running, &entry->node);
+        g_health_scheduler.metrics.queued--;
+        g_health_scheduler.metrics.running++;
+        health_scheduler_unlock();
+
+        run_ready_entry(entry);
+        DAEMON_CLEAR_ERRMSG();
+    }
+
+    return NULL;
+}
+
+static int start_health_worker()
+{
+    pthread_t a_thread;
+
+    if (pthread_create(&a_thread, NULL, health_worker_routine, NULL) != 0) {
+        CRIT("Thread creation failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* probes can not be interrupted, start workers in place of the ones running hung probes */
+static void check_hung_probes_locked(int64_t now)
+{
+    struct linked_list *it = NULL;
+
+    linked_list_for_each(it, &g_health_scheduler.running) {
+        health_entry_t *entry = (health_entry_t *)it->elem;
+
+        if (entry->hung || now - entry->started < entry->timeout + HEALTH_PROBE_HUNG_GRACE) {
+            continue;
+        }
+        WARN("Health check probe of container %s is running over its timeout", entry->id);
+        entry->hung = true;
+        g_health_scheduler.hung++;
+        g_health_scheduler.metrics.probes_timeout++;
+    }
+
+    while (g_health_scheduler.metrics.workers - g_health_scheduler.hung < g_health_scheduler.base_workers) {
+        if (g_health_scheduler.metrics.workers >= g_health_scheduler.base_workers + HEALTH_MAX_REPLACEMENT_WORKERS) {
+            WARN("Too many hung health check probes, %" PRIu64 " workers left", g_health_scheduler.metrics.workers -
+                 g_health_scheduler.hung);
+            break;
+        }
+        if (start_health_worker() != 0) {
+            break;
+        }
+        g_health_scheduler.metrics.workers++;
+    }
+}
+
+static void *health_wheel_routine(void *arg)
+{
+    int ret;
+
+    ret = pthread_detach(pthread_self());
+    if (ret != 0) {
+        CRIT("Set thread detach fail");
+        return NULL;
+    }
+
+    prctl(PR_SET_NAME, "HealthWheel");
+
+    for (;;) {
+        int64_t now = 0;
+
+        util_usleep_nointerupt((unsigned long)(HEALTH_WHEEL_TICK / Time_Micro));
+        now = monotonic_now();
+        health_scheduler_lock();
+        wheel_advance_locked(now);
+        check_hung_probes_locked(now);
+        health_scheduler_unlock();
+    }
+
+    return NULL;
+}
+
+int health_check_scheduler_add(const char *id, int64_t interval, int64_t timeout, uint64_t generation)
+{
+    int ret = 0;
+    int64_t jitter = 0;
+    health_entry_t *entry = NULL;
+
+    if (id == NULL || interval <= 0 || timeout <= 0) {
+        ERROR("Invalid input arguments");
+        return -1;
+    }
+
+    entry = util_common_calloc_s(sizeof(health_entry_t));
+    if (entry == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+    entry->id = util_strdup_s(id);
+    entry->generation = generation;
+    entry->interval = interval;
+    entry->timeout = timeout;
+    linked_list_init(&entry->node);
+    linked_list_add_elem(&entry->node, entry);
+
+    health_scheduler_lock();
+
+    if (map_search(g_health_scheduler.entries, (void *)id) != NULL) {
+        ERROR("Health check monitor of container %s is already running", id);
+        ret = -1;
+        goto unlock;
+    }
+
+    if (!map_insert(g_health_scheduler.entries, (void *)id, entry)) {
+        ERROR("Failed to add health check entry of container %s", id);
+        ret = -1;
+        goto unlock;
+    }
+
+    // up to a quarter interval earlier than the first probe was before, never later
+    jitter = (int64_t)(rand_r(&g_health_scheduler.seed) % 1000) * (interval / 4 / 1000);
+    entry->due = monotonic_now() + interval - jitter;
+    wheel_insert_locked(entry);
+    entry = NULL;
+
+unlock:
+    health_scheduler_unlock();
+    health_entry_free(entry);
+    return ret;
+}
+
+bool health_check_scheduler_cancel(const char *id)
+{
+    bool ended = true;
+    health_entry_t *entry = NULL;
+
+    if (id == NULL || g_health_scheduler.entries == NULL) {
+        return true;
+    }
+
+    health_scheduler_lock();
+    entry = map_search(g_health_scheduler.entries, (void *)id);
+    if (entry == NULL) {
+        goto unlock;
+    }
+
+    if (entry->status == ENTRY_RUNNING) {
+        // the worker ends the monitor when the probe returns
+        entry->cancelled = true;
+        entry = NULL;
+        ended = false;
+        goto unlock;
+    }
+
+    linked_list_del(&entry->node);
+    if (entry->status == ENTRY_IN_WHEEL) {
+        g_health_scheduler.metrics.scheduled--;
+    } else {
+        g_health_scheduler.metrics.queued--;
+    }
+    if (!map_remove(g_health_scheduler.entries, (void *)id)) {
+        WARN("Failed to remove health check entry of container %s", id);
+    }
+
+unlock:
+    health_scheduler_unlock();
+
+    if (entry != NULL) {
+        g_health_scheduler.end_cb(entry->id, entry->generation);
+        health_entry_free(entry);
+    }
+    return ended;
+}
+
+void health_check_scheduler_get_metrics(health_check_metrics_t *metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+
+    if (g_health_scheduler.entries == NULL) {
+        (void)memset(metrics, 0, sizeof(*metrics));
+        return;
+    }
+
+    health_scheduler_lock();
+    *metrics = g_health_scheduler.metrics;
+    health_scheduler_unlock();
+}
+
+static int start_health_workers()
+{
+    long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t workers = 0;
+    uint64_t i;
+
+    workers = nprocs > 0 ? (uint64_t)nprocs : HEALTH_MIN_PROBE_WORKERS;
+    if (workers < HEALTH_MIN_PROBE_WORKERS) {
+        workers = HEALTH_MIN_PROBE_WORKERS;
+    }
+    if (workers > HEALTH_MAX_PROBE_WORKERS) {
+        workers = HEALTH_MAX_PROBE_WORKERS;
+    }
+
+    health_scheduler_lock();
+    for (i = 0; i < workers; i++) {
+        if (start_health_worker() != 0) {
+            break;
+        }
+    }
+    g_health_scheduler.base_workers = i;
+    g_health_scheduler.metrics.workers = i;
+    health_scheduler_unlock();
+
+    return i == 0 ? -1 : 0;
+}
+
+/* init health check scheduler */
+int health_check_scheduler_init(health_probe_cb_t probe_cb, health_monitor_end_cb_t end_cb)
+{
+    pthread_t a_thread;
+    size_t i;
+
+    if (probe_cb == NULL || end_cb == NULL) {
+        ERROR("Invalid input arguments");
+        return -1;
+    }
+
+    if (pthread_mutex_init(&g_health_scheduler.mutex, NULL) != 0) {
+        CRIT("Mutex initialization failed");
+        return -1;
+    }
+
+    if (pthread_cond_init(&g_health_scheduler.ready_cond, NULL) != 0) {
+        CRIT("Cond initialization failed");
+        goto err_out;
+    }
+
+    for (i = 0; i < HEALTH_WHEEL_SLOTS; i++) {
+        linked_list_init(&g_health_scheduler.slots[i]);
+    }
+    linked_list_init(&g_health_scheduler.ready);
+    linked_list_init(&g_health_scheduler.running);
+    g_health_scheduler.cursor_time = monotonic_now();
+    g_health_scheduler.seed = (unsigned int)(g_health_scheduler.cursor_time ^ getpid());
+    g_health_scheduler.probe_cb = probe_cb;
+    g_health_scheduler.end_cb = end_cb;
+
+    g_health_scheduler.entries = map_new(MAP_STR_PTR, MAP_DEFAULT_CMP_FUNC, health_entry_kvfree);
+    if (g_health_scheduler.entries == NULL) {
+        ERROR("Out of memory");
+        goto err_out;
+    }
+
+    if (start_health_workers() != 0) {
+        goto err_out;
+    }
+
+    if (pthread_create(&a_thread, NULL, health_wheel_routine, NULL) != 0) {
+        CRIT("Thread creation failed");
+        goto err_out;
+    }
+
+    return 0;
+
+err_out:
+    // workers may have started, keep the map and locks for them
+    return -1;
+}
@@ -0,0 +1,60 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-07
+ * Description: provide health check scheduler definition
+ ******************************************************************************/
+#ifndef DAEMON_MODULES_CONTAINER_HEALTH_CHECK_HEALTH_CHECK_SCHEDULER_H
+#define DAEMON_MODULES_CONTAINER_HEALTH_CHECK_HEALTH_CHECK_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "utils_timestamp.h"
+#include "container_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// timer wheel granularity, probes are started at most one tick late
+#define HEALTH_WHEEL_TICK (100 * Time_Milli)
+#define HEALTH_WHEEL_SLOTS 1024
+#define HEALTH_MIN_PROBE_WORKERS 2
+#define HEALTH_MAX_PROBE_WORKERS 8
+// a probe running this long over its timeout is hung, its worker is replaced by a new one
+#ifndef HEALTH_PROBE_HUNG_GRACE
+#define HEALTH_PROBE_HUNG_GRACE (5 * Time_Second)
+#endif
+#define HEALTH_MAX_REPLACEMENT_WORKERS HEALTH_MAX_PROBE_WORKERS
+
+// run one probe of container id, returns false when the monitor of the container should end
+typedef bool (*health_probe_cb_t)(const char *id);
+// called once the monitor of container id has ended, either by the probe or by cancel,
+// generation is the one the monitor was added with, so that a newer monitor is not ended by mistake
+typedef void (*health_monitor_end_cb_t)(const char *id, uint64_t generation);
+
+int health_check_scheduler_init(health_probe_cb_t probe_cb, health_monitor_end_cb_t end_cb);
+
+// first probe is after interval minus a random jitter, so monitors started together spread out
+int health_check_scheduler_add(const char *id, int64_t interval, int64_t timeout, uint64_t generation);
+
+// end the monitor of container id now if it is waiting and return true,
+// return false if a probe is running, which ends the monitor when it finishes
+bool health_check_scheduler_cancel(const char *id);
+
+void health_check_scheduler_get_metrics(health_check_metrics_t *metrics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DAEMON_MODULES_CONTAINER_HEALTH_CHECK_HEALTH_CHECK_SCHEDULER_H
@@ -15,6 +15,7 @@
 #include "utils.h"
 #include "cleanup.h"
 #include "oci_rootfs_clean.h"
+#include "dir_reaper.h"
 
 static struct cleaners *create_cleaners()
 {
@@ -99,6 +100,12 @@ struct cleaners *cleaners_init()
         return clns;
     }
 
+    ret = add_clean_node(clns, trash_dir_cleaner, "clean trash dirs");
+    if (ret != 0) {
+        ERROR("Add trash_dir_cleaner error");
+        return clns;
+    }
+
 #ifdef ENABLE_OCI_IMAGE
     ret = add_clean_node(clns, oci_broken_rootfs_cleaner, "clean broken rootfs");
     if (ret != 0) {
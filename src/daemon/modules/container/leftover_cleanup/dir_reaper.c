@@ -0,0 +1,312 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ * Description: provide background directory reaper functions
+ *********************************************************************************/
+#define _GNU_SOURCE
+#include "dir_reaper.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+#include "constants.h"
+#include "isulad_config.h"
+#include "map.h"
+#include "utils.h"
+#include "utils_array.h"
+#include "utils_file.h"
+#include "utils_timestamp.h"
+
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+
+typedef struct dir_reaper {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    char *trash_dir;
+    uint64_t seq;
+    bool running;
+    // names in trash which are queued or being removed --> true
+    map_t *pending;
+    struct linked_list queue;
+} dir_reaper_t;
+
+static dir_reaper_t g_dir_reaper = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void dir_reaper_lock()
+{
+    if (pthread_mutex_lock(&g_dir_reaper.mutex) != 0) {
+        ERROR("Failed to lock dir reaper");
+    }
+}
+
+static void dir_reaper_unlock()
+{
+    if (pthread_mutex_unlock(&g_dir_reaper.mutex) != 0) {
+        ERROR("Failed to unlock dir reaper");
+    }
+}
+
+static void set_idle_io_priority()
+{
+#ifdef SYS_ioprio_set
+    // who 0 means the calling thread
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) != 0) {
+        SYSWARN("Failed to set idle io priority for dir reaper");
+    }
+#endif
+}
+
+static int dir_reaper_init_locked()
+{
+    char *root_dir = NULL;
+    char *trash_dir = NULL;
+
+    if (g_dir_reaper.trash_dir != NULL) {
+        return 0;
+    }
+
+    root_dir = conf_get_isulad_rootdir();
+    if (root_dir == NULL) {
+        ERROR("Failed to get isulad root dir");
+        return -1;
+    }
+
+    trash_dir = util_path_join(root_dir, DIR_REAPER_TRASH_NAME);
+    free(root_dir);
+    if (trash_dir == NULL) {
+        ERROR("Failed to join trash dir");
+        return -1;
+    }
+
+    if (util_mkdir_p(trash_dir, TEMP_DIRECTORY_MODE) != 0) {
+        ERROR("Failed to create trash dir %s", trash_dir);
+        free(trash_dir);
+        return -1;
+    }
+
+    g_dir_reaper.pending = map_new(MAP_STR_BOOL, MAP_DEFAULT_CMP_FUNC, MAP_DEFAULT_FREE_FUNC);
+    if (g_dir_reaper.pending == NULL) {
+        ERROR("Out of memory");
+        free(trash_dir);
+        return -1;
+    }
+    linked_list_init(&g_dir_reaper.queue);
+    g_dir_reaper.trash_dir = trash_dir;
+
+    return 0;
+}
+
+static void remove_trash(const char *name)
+{
+    char *path = NULL;
+
+    path = util_path_join(g_dir_reaper.trash_dir, name);
+    if (path == NULL) {
+        ERROR("Failed to join trash path of %s", name);
+        return;
+    }
+
+    if (util_recursive_rmdir(path, 0) != 0) {
+        ERROR("Failed to remove %s, it is retried after restart", path);
+    } else {
+        DEBUG("Removed %s in background", path);
+    }
+    free(path);
+}
+
+static void *dir_reaper_routine(void *arg)
+{
+    int ret;
+
+    ret = pthread_detach(pthread_self());
+    if (ret != 0) {
+        CRIT("Set thread detach fail");
+        return NULL;
+    }
+
+    prctl(PR_SET_NAME, "DirReaper");
+    set_idle_io_priority();
+
+    for (;;) {
+        struct linked_list *node = NULL;
+        char *name = NULL;
+
+        dir_reaper_lock();
+        if (linked_list_empty(&g_dir_reaper.queue)) {
+            g_dir_reaper.running = false;
+            dir_reaper_unlock();
+            break;
+        }
+        node = g_dir_reaper.queue.next;
+        linked_list_del(node);
+        dir_reaper_unlock();
+
+        name = (char *)node->elem;
+        remove_trash(name);
+
+        dir_reaper_lock();
+        if (!map_remove(g_dir_reaper.pending, name)) {
+            WARN("Failed to remove pending trash %s", name);
+        }
+        dir_reaper_unlock();
+
+        free(name);
+        free(node);
+    }
+
+    return NULL;
+}
+
+static int queue_trash_locked(const char *name)
+{
+    bool val = true;
+    pthread_t a_thread;
+    struct linked_list *node = NULL;
+
+    if (map_search(g_dir_reaper.pending, (void *)name) != NULL) {
+        return 0;
+    }
+
+    node = util_common_calloc_s(sizeof(struct linked_list));
+    if (node == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+
+    if (!map_insert(g_dir_reaper.pending, (void *)name, &val)) {
+        ERROR("Failed to add pending trash %s", name);
+        free(node);
+        return -1;
+    }
+    linked_list_add_elem(node, util_strdup_s(name));
+    linked_list_add_tail(&g_dir_reaper.queue, node);
+
+    if (g_dir_reaper.running) {
+        return 0;
+    }
+
+    if (pthread_create(&a_thread, NULL, dir_reaper_routine, NULL) != 0) {
+        CRIT("Thread creation failed");
+        linked_list_del(node);
+        (void)map_remove(g_dir_reaper.pending, (void *)name);
+        free(node->elem);
+        free(node);
+        return -1;
+    }
+    g_dir_reaper.running = true;
+
+    return 0;
+}
+
+int dir_reaper_remove(const char *path)
+{
+    int nret = 0;
+    char *base = NULL;
+    char *trash_path = NULL;
+    char name[PATH_MAX] = { 0 };
+
+    if (path == NULL) {
+        return -1;
+    }
+
+    dir_reaper_lock();
+    if (dir_reaper_init_locked() != 0) {
+        goto sync_out;
+    }
+
+    base = util_path_base(path);
+    if (base == NULL) {
+        ERROR("Failed to get base name of %s", path);
+        goto sync_out;
+    }
+
+    // the same directory may be created and removed again before the old one is reaped
+    nret = snprintf(name, sizeof(name), "%s-%lld-%llu", base, (long long)util_get_now_time_nanos(),
+                    (unsigned long long)++g_dir_reaper.seq);
+    if (nret < 0 || (size_t)nret >= sizeof(name)) {
+        ERROR("Failed to get trash name of %s", path);
+        goto sync_out;
+    }
+
+    trash_path = util_path_join(g_dir_reaper.trash_dir, name);
+    if (trash_path == NULL) {
+        ERROR("Failed to join trash path of %s", path);
+        goto sync_out;
+    }
+
+    if (rename(path, trash_path) != 0) {
+        if (errno != ENOENT) {
+            SYSWARN("Failed to move %s to trash, remove it directly", path);
+        }
+        goto sync_out;
+    }
+
+    if (queue_trash_locked(name) != 0) {
+        dir_reaper_unlock();
+        nret = util_recursive_rmdir(trash_path, 0);
+        goto out;
+    }
+    dir_reaper_unlock();
+    nret = 0;
+    goto out;
+
+sync_out:
+    dir_reaper_unlock();
+    nret = util_recursive_rmdir(path, 0);
+
+out:
+    free(base);
+    free(trash_path);
+    return nret;
+}
+
+int trash_dir_cleaner(struct clean_ctx *ctx)
+{
+    int ret = 0;
+    size_t i;
+    char **names = NULL;
+
+    dir_reaper_lock();
+    if (dir_reaper_init_locked() != 0) {
+        ret = -1;
+        goto out;
+    }
+
+    if (util_list_all_subdir(g_dir_reaper.trash_dir, &names) != 0) {
+        ERROR("Failed to list trash dir %s", g_dir_reaper.trash_dir);
+        ret = -1;
+        goto out;
+    }
+
+    for (i = 0; i < util_array_len((const char **)names); i++) {
+        if (queue_trash_locked(names[i]) != 0) {
+            ret = -1;
+        }
+    }
+
+out:
+    dir_reaper_unlock();
+    util_free_array(names);
+    return ret;
+}
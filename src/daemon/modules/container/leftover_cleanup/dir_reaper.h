@@ -0,0 +1,39 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ * Description: provide background directory reaper definition
+ *********************************************************************************/
+#ifndef DAEMON_MODULES_CONTAINER_LEFTOVER_CLEANUP_DIR_REAPER_H
+#define DAEMON_MODULES_CONTAINER_LEFTOVER_CLEANUP_DIR_REAPER_H
+
+#include "cleanup.h"
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+#define DIR_REAPER_TRASH_NAME "trash"
+
+/*
+ * Directories are renamed into the trash directory under isulad root and removed
+ * by one background thread with idle io priority. Whatever is left in the trash
+ * when isulad exits is removed again after the next start.
+ */
+int dir_reaper_remove(const char *path);
+
+int trash_dir_cleaner(struct clean_ctx *ctx);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif
+
+#endif
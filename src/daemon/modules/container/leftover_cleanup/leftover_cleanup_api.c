@@ -16,6 +16,7 @@
 #include "leftover_cleanup_api.h"
 #include "cleanup.h"
 #include "clean_context.h"
+#include "dir_reaper.h"
 
 struct clean_ctx *g_clean_ctx = NULL;
 struct cleaners *g_clns = NULL;
@@ -69,3 +70,7 @@ void clean_module_do_clean()
     g_clean_ctx = NULL;
 }
 
+int clean_module_remove_dir_async(const char *path)
+{
+    return dir_reaper_remove(path);
+}
@@ -22,6 +22,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "isulad_config.h"
 #include "isula_libutils/log.h"
@@ -42,6 +43,11 @@
 #include "utils_file.h"
 #include "utils_timestamp.h"
 
+// upper limit of restore workers, it is a build option until daemon configs can carry it
+#ifndef MAX_RESTORE_PARALLELISM
+#define MAX_RESTORE_PARALLELISM 16
+#endif
+
 /* restore supervisor */
 static int restore_supervisor(const container_t *cont)
 {
@@ -430,60 +436,208 @@ unlock_continue:
     return;
 }
 
-/* scan dir to add store */
-static void scan_dir_to_add_store(const char *runtime, const char *rootpath, const char *statepath,
-                                  const size_t subdir_num, const char **subdir)
+/* load a container directory and check its image and runtime state, commit into store is done by caller */
+static container_t *load_and_check_container(const char *runtime, const char *rootpath, const char *statepath,
+                                             const char *name)
 {
-    size_t i = 0;
     container_t *cont = NULL;
 
-    for (i = 0; i < subdir_num; i++) {
-        cont = NULL;
-        bool aret = false;
-        bool index_flag = false;
-        cont = container_load(runtime, rootpath, statepath, subdir[i]);
-        if (cont == NULL) {
-            ERROR("Failed to load subdir:%s", subdir[i]);
-            goto error_load;
-        }
+    cont = container_load(runtime, rootpath, statepath, name);
+    if (cont == NULL) {
+        ERROR("Failed to load subdir:%s", name);
+        goto error_load;
+    }
 
-        if (check_container_image_exist(cont) != 0) {
-            ERROR("Failed to restore container:%s due to image not exist", subdir[i]);
-            goto error_load;
-        }
+    if (check_container_image_exist(cont) != 0) {
+        ERROR("Failed to restore container:%s due to image not exist", name);
+        goto error_load;
+    }
+
+    restore_state(cont);
+
+    return cont;
+
+error_load:
+    if (remove_invalid_container(cont, runtime, rootpath, statepath, name)) {
+        ERROR("Failed to delete subdir:%s", name);
+    }
+    container_unref(cont);
+    return NULL;
+}
+
+typedef struct {
+    const char *runtime;
+    const char *rootpath;
+    const char *statepath;
+    const char **subdir;
+    size_t subdir_num;
+    // loaded containers, conts[i] is the result of subdir[i], NULL if it is invalid
+    container_t **conts;
+    pthread_mutex_t mutex;
+    // index of the next subdir to load
+    size_t next;
+} restore_jobs_t;
+
+static bool restore_jobs_claim(restore_jobs_t *jobs, size_t *index)
+{
+    bool ret = false;
+
+    if (pthread_mutex_lock(&jobs->mutex) != 0) {
+        ERROR("Failed to lock restore jobs");
+        return false;
+    }
+    if (jobs->next < jobs->subdir_num) {
+        *index = jobs->next;
+        jobs->next++;
+        ret = true;
+    }
+    (void)pthread_mutex_unlock(&jobs->mutex);
+
+    return ret;
+}
+
+static void *restore_load_worker(void *arg)
+{
+    restore_jobs_t *jobs = (restore_jobs_t *)arg;
+    size_t i = 0;
+
+    while (restore_jobs_claim(jobs, &i)) {
+        jobs->conts[i] = load_and_check_container(jobs->runtime, jobs->rootpath, jobs->statepath, jobs->subdir[i]);
+    }
 
-        restore_state(cont);
+    return NULL;
+}
+
+static size_t get_restore_parallelism(size_t subdir_num)
+{
+    long nprocs = 0;
+    size_t parallelism = 0;
+
+    nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+    parallelism = nprocs > 0 ? (size_t)nprocs : 1;
+    if (parallelism > MAX_RESTORE_PARALLELISM) {
+        parallelism = MAX_RESTORE_PARALLELISM;
+    }
 
-        index_flag = container_name_index_add(cont->common_config->name, cont->common_config->id);
-        if (!index_flag) {
-            ERROR("Failed add %s into name indexs", subdir[i]);
-            goto error_load;
+    return parallelism < subdir_num ? parallelism : subdir_num;
+}
+
+/* load containers with a bounded worker pool, fall back to load in current thread if workers can not be created */
+static void load_containers_in_parallel(restore_jobs_t *jobs)
+{
+    size_t i = 0;
+    size_t started = 0;
+    size_t parallelism = get_restore_parallelism(jobs->subdir_num);
+    pthread_t *workers = NULL;
+
+    // current thread is one of the loaders
+    if (parallelism > 1) {
+        workers = util_smart_calloc_s(sizeof(pthread_t), parallelism - 1);
+        if (workers == NULL) {
+            ERROR("Out of memory");
         }
-        aret = containers_store_add(cont->common_config->id, cont);
-        if (!aret) {
-            ERROR("Failed add container %s to store", subdir[i]);
-            goto error_load;
+    }
+
+    for (i = 0; workers != NULL && i < parallelism - 1; i++) {
+        if (pthread_create(&workers[started], NULL, restore_load_worker, jobs) != 0) {
+            ERROR("Failed to create restore worker");
+            break;
         }
+        started++;
+    }
+
+    DEBUG("Load %zu containers with %zu workers", jobs->subdir_num, started + 1);
+
+    // current thread takes part in loading, it also does all the work if no worker is started
+    (void)restore_load_worker(jobs);
+
+    for (i = 0; i < started; i++) {
+        (void)pthread_join(workers[i], NULL);
+    }
+
+    free(workers);
+}
+
+/* commit loaded containers into name index and store in directory order */
+static void commit_loaded_container(container_t *cont, const char *runtime, const char *rootpath,
+                                    const char *statepath, const char *name)
+{
+    bool aret = false;
+    bool index_flag = false;
+
+    index_flag = container_name_index_add(cont->common_config->name, cont->common_config->id);
+    if (!index_flag) {
+        ERROR("Failed add %s into name indexs", name);
+        goto error_load;
+    }
+    aret = containers_store_add(cont->common_config->id, cont);
+    if (!aret) {
+        ERROR("Failed add container %s to store", name);
+        goto error_load;
+    }
 
 #ifdef ENABLE_NATIVE_NETWORK
-        aret = network_store_container_list_add(cont);
-        if (!aret) {
-            ERROR("Failed add container %s to native_network_store", cont->common_config->id);
-        }
+    aret = network_store_container_list_add(cont);
+    if (!aret) {
+        ERROR("Failed add container %s to native_network_store", cont->common_config->id);
+    }
 #endif
 
-        continue;
+    return;
+
 error_load:
-        if (remove_invalid_container(cont, runtime, rootpath, statepath, subdir[i])) {
-            ERROR("Failed to delete subdir:%s", subdir[i]);
-        }
+    if (remove_invalid_container(cont, runtime, rootpath, statepath, name)) {
+        ERROR("Failed to delete subdir:%s", name);
+    }
+
+    if (index_flag) {
+        container_name_index_remove(cont->common_config->name);
+    }
+    container_unref(cont);
+}
+
+/* scan dir to add store */
+static void scan_dir_to_add_store(const char *runtime, const char *rootpath, const char *statepath,
+                                  const size_t subdir_num, const char **subdir)
+{
+    size_t i = 0;
+    int64_t start_time = 0;
+    int64_t load_time = 0;
+    restore_jobs_t jobs = { 0 };
+
+    jobs.conts = util_smart_calloc_s(sizeof(container_t *), subdir_num);
+    if (jobs.conts == NULL) {
+        ERROR("Out of memory");
+        return;
+    }
+    jobs.runtime = runtime;
+    jobs.rootpath = rootpath;
+    jobs.statepath = statepath;
+    jobs.subdir = subdir;
+    jobs.subdir_num = subdir_num;
+    if (pthread_mutex_init(&jobs.mutex, NULL) != 0) {
+        ERROR("Failed to init restore jobs mutex");
+        free(jobs.conts);
+        return;
+    }
 
-        if (index_flag) {
-            container_name_index_remove(cont->common_config->name);
+    start_time = util_get_now_time_nanos();
+    load_containers_in_parallel(&jobs);
+    load_time = util_get_now_time_nanos();
+
+    for (i = 0; i < subdir_num; i++) {
+        if (jobs.conts[i] == NULL) {
+            continue;
         }
-        container_unref(cont);
-        continue;
+        commit_loaded_container(jobs.conts[i], runtime, rootpath, statepath, subdir[i]);
     }
+
+    INFO("Restore %zu containers of runtime %s: load cost %lld ms, commit cost %lld ms", subdir_num, runtime,
+         (long long)((load_time - start_time) / Time_Milli),
+         (long long)((util_get_now_time_nanos() - load_time) / Time_Milli));
+
+    (void)pthread_mutex_destroy(&jobs.mutex);
+    free(jobs.conts);
 }
 
 /* restore container by runtime */
@@ -535,9 +689,14 @@ void containers_restore(void)
     int ret = 0;
     size_t subdir_num = 0;
     size_t i = 0;
+    int64_t start_time = 0;
+    int64_t handle_start = 0;
+    int64_t handle_time = 0;
     char *engines_path = NULL;
     char **subdir = NULL;
 
+    start_time = util_get_now_time_nanos();
+
     engines_path = conf_get_engine_rootpath();
     if (engines_path == NULL) {
         ERROR("Failed to get engines path");
@@ -559,8 +718,13 @@ void containers_restore(void)
         }
     }
 
+    handle_start = util_get_now_time_nanos();
     handle_restored_container();
 
+    handle_time = util_get_now_time_nanos();
+    INFO("Containers restore cost %lld ms, handle restored containers cost %lld ms",
+         (long long)((handle_time - start_time) / Time_Milli), (long long)((handle_time - handle_start) / Time_Milli));
+
 out:
     free(engines_path);
     util_free_array(subdir);
@@ -0,0 +1,847 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-07-31
+ * Description: provide container state journal functions
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include "state_journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+
+#include <isula_libutils/container_state.h>
+#include <isula_libutils/log.h>
+
+#include "buffer.h"
+#include "constants.h"
+#include "container_unix.h"
+#include "isulad_config.h"
+#include "map.h"
+#include "path.h"
+#include "utils.h"
+#include "utils_array.h"
+#include "utils_file.h"
+#include "utils_verify.h"
+
+#define JOURNAL_BUFFER_INIT_SIZE 4096
+
+struct journal_record {
+    char *rootpath;
+    char *id;
+    char *state_json;
+};
+
+struct state_journal {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    char *path;
+    int fd;
+    int64_t size;
+    // records appended but not written yet
+    Buffer *pending;
+    // records being written by the flushing caller
+    Buffer *flushing_buf;
+    bool flushing;
+    uint64_t appended_seq;
+    uint64_t flushed_seq;
+    // "<rootpath>/<id>" --> struct journal_record *, latest states written to journal since last compaction
+    map_t *latest;
+    // journal being compacted, renamed from path so that appends go to a new journal meanwhile
+    char *compacting_path;
+    // records of compacting_path not written into state files yet, NULL if no compaction is running
+    map_t *compacting;
+    pthread_cond_t compact_cond;
+    bool compact_requested;
+    bool compactor_started;
+    // journal size which triggers next compaction, raised after a failed compaction
+    int64_t compact_size;
+};
+
+static struct state_journal g_state_journal = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .fd = -1,
+    .compact_cond = PTHREAD_COND_INITIALIZER,
+    .compact_size = STATE_JOURNAL_COMPACT_SIZE,
+};
+
+static void journal_record_free(struct journal_record *record)
+{
+    if (record == NULL) {
+        return;
+    }
+
+    free(record->rootpath);
+    free(record->id);
+    free(record->state_json);
+    free(record);
+}
+
+static void journal_record_kvfree(void *key, void *value)
+{
+    free(key);
+    journal_record_free((struct journal_record *)value);
+}
+
+static map_t *new_record_map(void)
+{
+    return map_new(MAP_STR_PTR, MAP_DEFAULT_CMP_FUNC, journal_record_kvfree);
+}
+
+static int set_latest_record(map_t *latest, const char *rootpath, const char *id, const char *state_json)
+{
+    int ret = 0;
+    char *key = NULL;
+    struct journal_record *record = NULL;
+
+    key = util_path_join(rootpath, id);
+    if (key == NULL) {
+        ERROR("Failed to join path %s and %s", rootpath, id);
+        return -1;
+    }
+
+    record = util_common_calloc_s(sizeof(struct journal_record));
+    if (record == NULL) {
+        ERROR("Out of memory");
+        ret = -1;
+        goto out;
+    }
+    record->rootpath = util_strdup_s(rootpath);
+    record->id = util_strdup_s(id);
+    record->state_json = util_strdup_s(state_json);
+
+    if (!map_replace(latest, key, record)) {
+        ERROR("Failed to record journal state of container %s", id);
+        journal_record_free(record);
+        ret = -1;
+    }
+
+out:
+    free(key);
+    return ret;
+}
+
+static bool rootpath_recorded(const char **rootpaths, const char *rootpath)
+{
+    size_t i;
+
+    for (i = 0; rootpaths != NULL && rootpaths[i] != NULL; i++) {
+        if (strcmp(rootpaths[i], rootpath) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void sync_rootpaths(const char **rootpaths)
+{
+    size_t i;
+
+    for (i = 0; rootpaths != NULL && rootpaths[i] != NULL; i++) {
+        int fd = util_open(rootpaths[i], O_RDONLY | O_DIRECTORY, 0);
+        if (fd < 0) {
+            SYSWARN("Failed to open %s", rootpaths[i]);
+            continue;
+        }
+        if (syncfs(fd) != 0) {
+            SYSWARN("Failed to sync filesystem of %s", rootpaths[i]);
+        }
+        close(fd);
+    }
+}
+
+/*
+ * called with mutex held, so that the container is not removed by container_state_journal_remove()
+ * between the check and the write of its container_state.json.tmp
+ */
+static int compact_record_locked(const char *cont_dir, const struct journal_record *record, char ***rootpaths)
+{
+    if (!util_dir_exists(cont_dir)) {
+        DEBUG("Container %s has been removed, skip its journal state", record->id);
+        return 0;
+    }
+
+    if (save_container_state_config(record->id, record->rootpath, record->state_json) != 0) {
+        ERROR("Failed to compact journal state of container %s", record->id);
+        return -1;
+    }
+
+    if (!rootpath_recorded((const char **)*rootpaths, record->rootpath) &&
+        util_array_append(rootpaths, record->rootpath) != 0) {
+        ERROR("Out of memory");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* called with mutex held, write latest states in records into container_state.json of the containers */
+static int compact_records_locked(map_t *records)
+{
+    int ret = 0;
+    map_itor *itor = NULL;
+    char **rootpaths = NULL;
+
+    itor = map_itor_new(records);
+    if (itor == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+
+    for (; map_itor_valid(itor); map_itor_next(itor)) {
+        if (compact_record_locked(map_itor_key(itor), map_itor_value(itor), &rootpaths) != 0) {
+            ret = -1;
+        }
+    }
+    map_itor_free(itor);
+
+    // states must reach disk before the journal records are dropped
+    sync_rootpaths((const char **)rootpaths);
+    util_free_array(rootpaths);
+    return ret;
+}
+
+/* a running compaction writes older states, wait for it before writing newer ones into the same state files */
+static void journal_wait_compacted_locked(void)
+{
+    while (g_state_journal.compacting != NULL) {
+        pthread_cond_wait(&g_state_journal.cond, &g_state_journal.mutex);
+    }
+}
+
+/* stop journaling after a write error, states recorded so far are written into the state files */
+static void journal_break_locked(void)
+{
+    ERROR("State journal %s is broken, fallback to write state files directly", g_state_journal.path);
+
+    // records of a failed compaction are appended back into latest before it ends
+    journal_wait_compacted_locked();
+
+    if (compact_records_locked(g_state_journal.latest) != 0) {
+        ERROR("Failed to write journal states into state files");
+    } else if (util_file_exists(g_state_journal.compacting_path) &&
+               util_path_remove(g_state_journal.compacting_path) != 0) {
+        // it must not be replayed over the state files written directly from now on
+        SYSERROR("Failed to remove state journal %s", g_state_journal.compacting_path);
+    }
+
+    close(g_state_journal.fd);
+    g_state_journal.fd = -1;
+    if (util_path_remove(g_state_journal.path) != 0) {
+        SYSERROR("Failed to remove state journal %s", g_state_journal.path);
+    }
+}
+
+static void journal_flush_locked(void)
+{
+    Buffer *batch = NULL;
+    uint64_t batch_seq = 0;
+    ssize_t nwrite = 0;
+    bool failed = false;
+
+    g_state_journal.flushing = true;
+    batch = g_state_journal.pending;
+    g_state_journal.pending = g_state_journal.flushing_buf;
+    g_state_journal.flushing_buf = batch;
+    batch_seq = g_state_journal.appended_seq;
+
+    // records appended by others meanwhile are written by the next flush, in one write
+    pthread_mutex_unlock(&g_state_journal.mutex);
+    // not synced, as the state files written directly are not synced either
+    nwrite = util_write_nointr_in_total(g_state_journal.fd, batch->contents, batch->bytes_used);
+    if (nwrite < 0 || (size_t)nwrite != batch->bytes_used) {
+        SYSERROR("Failed to write state journal %s", g_state_journal.path);
+        failed = true;
+    }
+    pthread_mutex_lock(&g_state_journal.mutex);
+
+    if (failed) {
+        journal_break_locked();
+    } else {
+        g_state_journal.size += (int64_t)batch->bytes_used;
+        g_state_journal.flushed_seq = batch_seq;
+        if (g_state_journal.size >= g_state_journal.compact_size && !g_state_journal.compact_requested) {
+            g_state_journal.compact_requested = true;
+            pthread_cond_signal(&g_state_journal.compact_cond);
+        }
+    }
+    buffer_empty(batch);
+
+    g_state_journal.flushing = false;
+    pthread_cond_broadcast(&g_state_journal.cond);
+}
+
+static int journal_append_locked(const char *rootpath, const char *id, const char *state_json)
+{
+    size_t len = strlen(rootpath) + strlen(id) + strlen(state_json) + 3;
+    char *line = NULL;
+    int nret;
+    int ret = 0;
+
+    line = util_common_calloc_s(len + 1);
+    if (line == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+
+    nret = snprintf(line, len + 1, "%s\t%s\t%s\n", rootpath, id, state_json);
+    if (nret < 0 || (size_t)nret != len) {
+        ERROR("Failed to print journal record");
+        ret = -1;
+        goto out;
+    }
+
+    if (set_latest_record(g_state_journal.latest, rootpath, id, state_json) != 0) {
+        ret = -1;
+        goto out;
+    }
+
+    if (buffer_append(g_state_journal.pending, line, len) != 0) {
+        ERROR("Failed to append journal record");
+        ret = -1;
+        goto out;
+    }
+
+out:
+    free(line);
+    return ret;
+}
+
+/* wait until records appended up to seq are written, or write them if nobody is writing */
+static int journal_wait_flushed_locked(uint64_t seq)
+{
+    while (g_state_journal.flushed_seq < seq) {
+        if (g_state_journal.fd < 0) {
+            return -1;
+        }
+        if (g_state_journal.flushing) {
+            pthread_cond_wait(&g_state_journal.cond, &g_state_journal.mutex);
+            continue;
+        }
+        journal_flush_locked();
+    }
+
+    return 0;
+}
+
+/*
+ * append records again into the journal, unless newer states of the containers are recorded meanwhile,
+ * seq is set to the sequence to wait for by journal_wait_flushed_locked()
+ */
+static int journal_restore_records_locked(map_t *records, uint64_t *seq)
+{
+    int ret = 0;
+    size_t count = 0;
+    map_itor *itor = NULL;
+
+    itor = map_itor_new(records);
+    if (itor == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+
+    for (; map_itor_valid(itor); map_itor_next(itor)) {
+        struct journal_record *record = map_itor_value(itor);
+
+        if (map_search(g_state_journal.latest, map_itor_key(itor)) != NULL) {
+            continue;
+        }
+        if (journal_append_locked(record->rootpath, record->id, record->state_json) != 0) {
+            ERROR("Failed to keep journal state of container %s", record->id);
+            ret = -1;
+            continue;
+        }
+        count++;
+    }
+    map_itor_free(itor);
+
+    if (count > 0) {
+        *seq = ++g_state_journal.appended_seq;
+    }
+
+    return ret;
+}
+
+int container_state_journal_append(const char *rootpath, const char *id, const char *state_json)
+{
+    int ret = 0;
+
+    if (rootpath == NULL || id == NULL || state_json == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_state_journal.mutex);
+
+    if (g_state_journal.fd < 0) {
+        // journal is disabled or broken
+        ret = -1;
+        goto unlock;
+    }
+
+    if (journal_append_locked(rootpath, id, state_json) != 0) {
+        ret = -1;
+        goto unlock;
+    }
+
+    ret = journal_wait_flushed_locked(++g_state_journal.appended_seq);
+
+unlock:
+    pthread_mutex_unlock(&g_state_journal.mutex);
+    return ret;
+}
+
+int container_state_journal_remove(const char *rootpath, const char *id)
+{
+    int ret = 0;
+    char *key = NULL;
+    char **rootpaths = NULL;
+    struct journal_record *record = NULL;
+
+    if (rootpath == NULL || id == NULL) {
+        return -1;
+    }
+
+    key = util_path_join(rootpath, id);
+    if (key == NULL) {
+        ERROR("Failed to join path %s and %s", rootpath, id);
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_state_journal.mutex);
+
+    if (g_state_journal.latest != NULL) {
+        record = map_search(g_state_journal.latest, key);
+    }
+    if (record == NULL && g_state_journal.compacting != NULL) {
+        record = map_search(g_state_journal.compacting, key);
+    }
+    // the state file is up to date in case the removal fails
+    if (record != NULL) {
+        ret = compact_record_locked(key, record, &rootpaths);
+    }
+
+    if (g_state_journal.latest != NULL) {
+        (void)map_remove(g_state_journal.latest, key);
+    }
+    if (g_state_journal.compacting != NULL) {
+        (void)map_remove(g_state_journal.compacting, key);
+    }
+
+    pthread_mutex_unlock(&g_state_journal.mutex);
+
+    util_free_array(rootpaths);
+    free(key);
+    return ret;
+}
+
+static bool valid_state_json(const char *state_json)
+{
+    container_state *state = NULL;
+    parser_error err = NULL;
+
+    state = container_state_parse_data(state_json, NULL, &err);
+    free(err);
+    if (state == NULL) {
+        return false;
+    }
+    free_container_state(state);
+    return true;
+}
+
+/* record "<rootpath>\t<id>\t<state json>\n", a torn line at the end is not terminated by newline */
+static int parse_journal_line(char *line, size_t len, map_t *records)
+{
+    char *id = NULL;
+    char *state_json = NULL;
+
+    if (len == 0 || line[len - 1] != '\n') {
+        return -1;
+    }
+    line[len - 1] = '\0';
+
+    id = strchr(line, '\t');
+    if (id == NULL) {
+        return -1;
+    }
+    *id++ = '\0';
+
+    state_json = strchr(id, '\t');
+    if (state_json == NULL) {
+        return -1;
+    }
+    *state_json++ = '\0';
+
+    if (!util_valid_container_id(id) || !valid_state_json(state_json)) {
+        return -1;
+    }
+
+    return set_latest_record(records, line, id, state_json);
+}
+
+static int replay_journal(const char *path, map_t *records)
+{
+    FILE *fp = NULL;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len = 0;
+    size_t count = 0;
+
+    fp = util_fopen(path, "r");
+    if (fp == NULL) {
+        SYSERROR("Failed to open state journal %s", path);
+        return -1;
+    }
+
+    while ((len = getline(&line, &cap, fp)) != -1) {
+        if (parse_journal_line(line, (size_t)len, records) != 0) {
+            WARN("Skip invalid record in state journal %s", path);
+            continue;
+        }
+        count++;
+    }
+
+    free(line);
+    fclose(fp);
+    INFO("Replayed %zu records from state journal %s", count, path);
+    return 0;
+}
+
+static int journal_open(void)
+{
+    struct stat st = { 0 };
+
+    g_state_journal.fd = util_open(g_state_journal.path, O_WRONLY | O_CREAT | O_APPEND, DEFAULT_SECURE_FILE_MODE);
+    if (g_state_journal.fd < 0) {
+        SYSERROR("Failed to open state journal %s", g_state_journal.path);
+        return -1;
+    }
+
+    if (fstat(g_state_journal.fd, &st) != 0) {
+        SYSERROR("Failed to stat state journal %s", g_state_journal.path);
+        close(g_state_journal.fd);
+        g_state_journal.fd = -1;
+        return -1;
+    }
+    g_state_journal.size = (int64_t)st.st_size;
+
+    return 0;
+}
+
+/* called with mutex held and nobody writing the journal, move the journal aside and start a new one */
+static int journal_rotate_locked(void)
+{
+    int old_fd = g_state_journal.fd;
+
+    if (util_file_exists(g_state_journal.compacting_path)) {
+        ERROR("State journal %s is not compacted yet", g_state_journal.compacting_path);
+        return -1;
+    }
+
+    if (rename(g_state_journal.path, g_state_journal.compacting_path) != 0) {
+        SYSERROR("Failed to rename state journal %s", g_state_journal.path);
+        return -1;
+    }
+
+    if (journal_open() != 0) {
+        if (rename(g_state_journal.compacting_path, g_state_journal.path) != 0) {
+            SYSERROR("Failed to rename state journal %s back", g_state_journal.compacting_path);
+        }
+        g_state_journal.fd = old_fd;
+        return -1;
+    }
+    close(old_fd);
+
+    return 0;
+}
+
+static int collect_record_keys(map_t *records, char ***keys)
+{
+    map_itor *itor = NULL;
+
+    itor = map_itor_new(records);
+    if (itor == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+
+    for (; map_itor_valid(itor); map_itor_next(itor)) {
+        if (util_array_append(keys, map_itor_key(itor)) != 0) {
+            ERROR("Out of memory");
+            map_itor_free(itor);
+            return -1;
+        }
+    }
+    map_itor_free(itor);
+
+    return 0;
+}
+
+/* called with mutex held, the mutex is released between the state files so that appends go on */
+static int compact_moving_records_locked(void)
+{
+    int ret = 0;
+    size_t i;
+    char **keys = NULL;
+    char **rootpaths = NULL;
+
+    if (collect_record_keys(g_state_journal.compacting, &keys) != 0) {
+        return -1;
+    }
+
+    for (i = 0; keys != NULL && keys[i] != NULL; i++) {
+        // dropped by container_state_journal_remove() meanwhile
+        struct journal_record *record = map_search(g_state_journal.compacting, keys[i]);
+
+        if (record != NULL) {
+            // failed ones are kept in the journal
+            if (compact_record_locked(keys[i], record, &rootpaths) == 0) {
+                (void)map_remove(g_state_journal.compacting, keys[i]);
+            } else {
+                ret = -1;
+            }
+        }
+        pthread_mutex_unlock(&g_state_journal.mutex);
+        pthread_mutex_lock(&g_state_journal.mutex);
+    }
+
+    pthread_mutex_unlock(&g_state_journal.mutex);
+    sync_rootpaths((const char **)rootpaths);
+    pthread_mutex_lock(&g_state_journal.mutex);
+
+    util_free_array(rootpaths);
+    util_free_array(keys);
+    return ret;
+}
+
+/* called with mutex held, the mutex is released while writing state files */
+static void journal_compact_locked(void)
+{
+    map_t *records = NULL;
+    map_t *empty = NULL;
+    uint64_t seq = 0;
+    bool kept = false;
+    int ret;
+
+    empty = new_record_map();
+    if (empty == NULL) {
+        ERROR("Out of memory");
+        goto backoff;
+    }
+
+    if (journal_rotate_locked() != 0) {
+        map_free(empty);
+        goto backoff;
+    }
+    g_state_journal.compacting = g_state_journal.latest;
+    g_state_journal.latest = empty;
+
+    ret = compact_moving_records_locked();
+
+    records = g_state_journal.compacting;
+    g_state_journal.compacting = NULL;
+    if (ret != 0) {
+        WARN("Failed to compact state journal, keep its records");
+        kept = journal_restore_records_locked(records, &seq) == 0;
+    }
+    map_free(records);
+    pthread_cond_broadcast(&g_state_journal.cond);
+    // a broken journal meanwhile writes the kept records into state files and removes compacting_path
+    if (kept && journal_wait_flushed_locked(seq) != 0) {
+        kept = false;
+    }
+
+    // records are in the state files or in the new journal now, otherwise replayed at next startup
+    if ((ret == 0 || kept) && util_path_remove(g_state_journal.compacting_path) != 0) {
+        SYSERROR("Failed to remove state journal %s", g_state_journal.compacting_path);
+    }
+    if (ret == 0) {
+        DEBUG("State journal compacted");
+        g_state_journal.compact_size = STATE_JOURNAL_COMPACT_SIZE;
+        return;
+    }
+
+backoff:
+    // do not retry on every flush, wait for the journal to grow again
+    g_state_journal.compact_size = g_state_journal.size + STATE_JOURNAL_COMPACT_SIZE;
+}
+
+static void *state_journal_compactor(void *arg)
+{
+    int ret;
+
+    ret = pthread_detach(pthread_self());
+    if (ret != 0) {
+        CRIT("Set thread detach fail");
+        return NULL;
+    }
+
+    prctl(PR_SET_NAME, "StateJournal");
+
+    pthread_mutex_lock(&g_state_journal.mutex);
+    for (;;) {
+        while (!g_state_journal.compact_requested) {
+            pthread_cond_wait(&g_state_journal.compact_cond, &g_state_journal.mutex);
+        }
+        // the journal must not be written while it is moved aside
+        while (g_state_journal.flushing) {
+            pthread_cond_wait(&g_state_journal.cond, &g_state_journal.mutex);
+        }
+
+        // flushes meanwhile do not request another compaction, check the new journal here
+        if (g_state_journal.fd >= 0) {
+            journal_compact_locked();
+        }
+        g_state_journal.compact_requested = g_state_journal.fd >= 0 &&
+                                            g_state_journal.size >= g_state_journal.compact_size;
+    }
+    pthread_mutex_unlock(&g_state_journal.mutex);
+
+    return NULL;
+}
+
+/* drop the journal state of a previous init */
+static void journal_reset_locked(void)
+{
+    if (g_state_journal.fd >= 0) {
+        close(g_state_journal.fd);
+        g_state_journal.fd = -1;
+    }
+    free(g_state_journal.path);
+    g_state_journal.path = NULL;
+    free(g_state_journal.compacting_path);
+    g_state_journal.compacting_path = NULL;
+    map_free(g_state_journal.latest);
+    g_state_journal.latest = NULL;
+    buffer_free(g_state_journal.pending);
+    g_state_journal.pending = NULL;
+    buffer_free(g_state_journal.flushing_buf);
+    g_state_journal.flushing_buf = NULL;
+    g_state_journal.size = 0;
+    g_state_journal.appended_seq = 0;
+    g_state_journal.flushed_seq = 0;
+    g_state_journal.compact_requested = false;
+    g_state_journal.compact_size = STATE_JOURNAL_COMPACT_SIZE;
+}
+
+static int journal_replay_files(map_t *records)
+{
+    // a journal left by an interrupted compaction holds older records
+    if (util_file_exists(g_state_journal.compacting_path) &&
+        replay_journal(g_state_journal.compacting_path, records) != 0) {
+        return -1;
+    }
+
+    if (util_file_exists(g_state_journal.path) && replay_journal(g_state_journal.path, records) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int container_state_journal_init(void)
+{
+    int ret = 0;
+    char *rootdir = NULL;
+    map_t *records = NULL;
+    uint64_t seq = 0;
+    pthread_t thread_id;
+
+    rootdir = conf_get_isulad_rootdir();
+    if (rootdir == NULL) {
+        ERROR("Failed to get isulad root dir");
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_state_journal.mutex);
+
+    journal_wait_compacted_locked();
+    journal_reset_locked();
+
+    g_state_journal.path = util_path_join(rootdir, STATE_JOURNAL_FILE);
+    g_state_journal.compacting_path = util_path_join(rootdir, STATE_JOURNAL_COMPACTING_FILE);
+    if (g_state_journal.path == NULL || g_state_journal.compacting_path == NULL) {
+        ERROR("Failed to join state journal path");
+        ret = -1;
+        goto unlock;
+    }
+
+    records = new_record_map();
+    g_state_journal.latest = new_record_map();
+    g_state_journal.pending = buffer_alloc(JOURNAL_BUFFER_INIT_SIZE);
+    g_state_journal.flushing_buf = buffer_alloc(JOURNAL_BUFFER_INIT_SIZE);
+    if (records == NULL || g_state_journal.latest == NULL || g_state_journal.pending == NULL ||
+        g_state_journal.flushing_buf == NULL) {
+        ERROR("Out of memory");
+        ret = -1;
+        goto unlock;
+    }
+
+    // replay on top of the state files, so that containers are restored from up to date state files
+    if (journal_replay_files(records) != 0) {
+        ret = -1;
+        goto unlock;
+    }
+
+    if (journal_open() != 0) {
+        ret = -1;
+        goto unlock;
+    }
+
+    if (compact_records_locked(records) == 0) {
+        if (ftruncate(g_state_journal.fd, 0) != 0) {
+            SYSWARN("Failed to truncate state journal %s", g_state_journal.path);
+        } else {
+            g_state_journal.size = 0;
+        }
+    } else {
+        ERROR("Failed to replay state journal %s, some container states may be out of date",
+              g_state_journal.path);
+        // keep the records for next compaction
+        if (journal_restore_records_locked(records, &seq) != 0 || journal_wait_flushed_locked(seq) != 0) {
+            ret = -1;
+            goto unlock;
+        }
+    }
+
+    if (util_file_exists(g_state_journal.compacting_path) &&
+        util_path_remove(g_state_journal.compacting_path) != 0) {
+        SYSWARN("Failed to remove state journal %s", g_state_journal.compacting_path);
+    }
+
+    if (!g_state_journal.compactor_started) {
+        if (pthread_create(&thread_id, NULL, state_journal_compactor, NULL) != 0) {
+            ERROR("Failed to create state journal compactor thread");
+            ret = -1;
+            goto unlock;
+        }
+        g_state_journal.compactor_started = true;
+    }
+
+unlock:
+    if (ret != 0 && g_state_journal.fd >= 0) {
+        close(g_state_journal.fd);
+        g_state_journal.fd = -1;
+    }
+    pthread_mutex_unlock(&g_state_journal.mutex);
+    map_free(records);
+    free(rootdir);
+    return ret;
+}
@@ -0,0 +1,52 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-07-31
+ * Description: provide container state journal definition
+ ******************************************************************************/
+#ifndef DAEMON_MODULES_CONTAINER_STATE_JOURNAL_STATE_JOURNAL_H
+#define DAEMON_MODULES_CONTAINER_STATE_JOURNAL_STATE_JOURNAL_H
+
+#include <stdbool.h>
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+#define STATE_JOURNAL_FILE "container_state.journal"
+#define STATE_JOURNAL_COMPACTING_FILE "container_state.journal.compacting"
+// journal is compacted into container_state.json files when it grows over this size
+#ifndef STATE_JOURNAL_COMPACT_SIZE
+#define STATE_JOURNAL_COMPACT_SIZE (4 * 1024 * 1024)
+#endif
+
+/*
+ * Container state changes are appended to a per-daemon journal instead of rewriting the
+ * container_state.json of the container. Each record is one line "<rootpath>\t<id>\t<state json>\n".
+ * Concurrent appends are written together by whichever caller comes first (group commit).
+ * The journal is compacted into the container_state.json files by a background thread when it
+ * grows large, and replayed into them at startup, before containers are restored.
+ */
+int container_state_journal_init(void);
+
+int container_state_journal_append(const char *rootpath, const char *id, const char *state_json);
+
+/*
+ * Write the journal state of the container into its state file and forget it, called before the
+ * container directory is removed, so that compaction does not write into the directory being removed.
+ */
+int container_state_journal_remove(const char *rootpath, const char *id);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif
+
+#endif // DAEMON_MODULES_CONTAINER_STATE_JOURNAL_STATE_JOURNAL_H
@@ -0,0 +1,700 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-07-10
+ * Description: provide container resources stats collector functions
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include "stats_collector.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+
+#include <isula_libutils/log.h>
+
+#include "cgroup.h"
+#include "container_api.h"
+#include "utils.h"
+#include "utils_convert.h"
+#include "utils_file.h"
+#include "utils_string.h"
+#include "utils_timestamp.h"
+
+#define STATS_READ_BUF_SIZE 8192
+
+typedef enum {
+    STATS_CTRL_CPUACCT = 0,
+    STATS_CTRL_MEMORY,
+    STATS_CTRL_PIDS,
+    STATS_CTRL_BLKIO,
+    STATS_CTRL_MAX
+} stats_controller_t;
+
+struct stats_file_desc {
+    stats_controller_t controller;
+    const char *v1_name;
+    const char *v2_name;
+};
+
+static const struct stats_file_desc g_stats_files[STATS_FILE_MAX] = {
+    [STATS_FILE_CPU_USAGE] = { STATS_CTRL_CPUACCT, "cpuacct.usage", "cpu.stat" },
+    [STATS_FILE_CPU_STAT] = { STATS_CTRL_CPUACCT, "cpuacct.stat", NULL },
+    [STATS_FILE_MEM_USAGE] = { STATS_CTRL_MEMORY, "memory.usage_in_bytes", "memory.current" },
+    [STATS_FILE_MEM_LIMIT] = { STATS_CTRL_MEMORY, "memory.limit_in_bytes", "memory.max" },
+    [STATS_FILE_MEM_STAT] = { STATS_CTRL_MEMORY, "memory.stat", "memory.stat" },
+    [STATS_FILE_KMEM_USAGE] = { STATS_CTRL_MEMORY, "memory.kmem.usage_in_bytes", NULL },
+    [STATS_FILE_KMEM_LIMIT] = { STATS_CTRL_MEMORY, "memory.kmem.limit_in_bytes", NULL },
+    [STATS_FILE_PIDS_CURRENT] = { STATS_CTRL_PIDS, "pids.current", "pids.current" },
+    [STATS_FILE_BLKIO] = { STATS_CTRL_BLKIO, "blkio.throttle.io_service_bytes", "io.stat" },
+};
+
+static const char *g_stats_controllers[STATS_CTRL_MAX] = {
+    [STATS_CTRL_CPUACCT] = "cpuacct",
+    [STATS_CTRL_MEMORY] = "memory",
+    [STATS_CTRL_PIDS] = "pids",
+    [STATS_CTRL_BLKIO] = "blkio",
+};
+
+static stats_collector_t g_stats_collector;
+// mountpoint and root of each cgroup v1 controller, resolved once at init
+static char *g_v1_mountpoints[STATS_CTRL_MAX];
+static char *g_v1_roots[STATS_CTRL_MAX];
+
+static void stats_collector_lock()
+{
+    if (pthread_mutex_lock(&(g_stats_collector.mutex)) != 0) {
+        ERROR("Failed to lock stats collector");
+    }
+}
+
+static void stats_collector_unlock()
+{
+    if (pthread_mutex_unlock(&(g_stats_collector.mutex)) != 0) {
+        ERROR("Failed to unlock stats collector");
+    }
+}
+
+static void stats_entry_free(stats_entry_t *entry)
+{
+    int i;
+
+    if (entry == NULL) {
+        return;
+    }
+
+    for (i = 0; i < STATS_FILE_MAX; i++) {
+        if (entry->fds[i] >= 0) {
+            close(entry->fds[i]);
+        }
+    }
+    free(entry->id);
+    free(entry);
+}
+
+static void stats_entry_kvfree(void *key, void *value)
+{
+    free(key);
+    stats_entry_free((stats_entry_t *)value);
+}
+
+/* find the cgroup path of controller in /proc/<pid>/cgroup, controller NULL means the unified hierarchy */
+static char *get_pid_cgroup_path(pid_t pid, const char *controller)
+{
+    char proc_path[PATH_MAX] = { 0 };
+    FILE *fp = NULL;
+    char *pline = NULL;
+    size_t length = 0;
+    char *result = NULL;
+    int nret;
+
+    nret = snprintf(proc_path, sizeof(proc_path), "/proc/%d/cgroup", pid);
+    if (nret < 0 || (size_t)nret >= sizeof(proc_path)) {
+        ERROR("Failed to sprintf cgroup path of pid %d", pid);
+        return NULL;
+    }
+
+    fp = util_fopen(proc_path, "r");
+    if (fp == NULL) {
+        WARN("Failed to open %s", proc_path);
+        return NULL;
+    }
+
+    while (getline(&pline, &length, fp) != -1) {
+        char *controllers = NULL;
+        char *path = NULL;
+        char *tok = NULL;
+        char *psave = NULL;
+
+        util_trim_newline(pline);
+        controllers = strchr(pline, ':');
+        if (controllers == NULL) {
+            continue;
+        }
+        controllers++;
+        path = strchr(controllers, ':');
+        if (path == NULL) {
+            continue;
+        }
+        *path = '\0';
+        path++;
+
+        if (controller == NULL) {
+            if (strlen(controllers) == 0) {
+                result = util_strdup_s(path);
+                break;
+            }
+            continue;
+        }
+
+        for (tok = strtok_r(controllers, ",", &psave); tok != NULL; tok = strtok_r(NULL, ",", &psave)) {
+            if (strcmp(tok, controller) == 0) {
+                result = util_strdup_s(path);
+                goto out;
+            }
+        }
+    }
+
+out:
+    free(pline);
+    fclose(fp);
+    return result;
+}
+
+static char *join_cgroup_dir(const char *mountpoint, const char *root, const char *path)
+{
+    const char *rel = path;
+
+    // the mount root of a cgroup namespace or a bind mount is not part of the path under the mountpoint
+    if (root != NULL && strcmp(root, "/") != 0 && util_has_prefix(path, root)) {
+        rel = path + strlen(root);
+    }
+
+    return util_path_join(mountpoint, rel);
+}
+
+static int open_stats_file(const char *dir, const char *name)
+{
+    char *fpath = NULL;
+    int fd;
+
+    if (dir == NULL || name == NULL) {
+        return -1;
+    }
+
+    fpath = util_path_join(dir, name);
+    if (fpath == NULL) {
+        return -1;
+    }
+
+    fd = util_open(fpath, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        DEBUG("Failed to open stats file %s: %s", fpath, strerror(errno));
+    }
+    free(fpath);
+    return fd;
+}
+
+static int stats_entry_open_files(stats_entry_t *entry)
+{
+    char *dirs[STATS_CTRL_MAX] = { 0 };
+    char *path = NULL;
+    int i;
+    int ret = 0;
+    bool opened = false;
+
+    if (g_stats_collector.cgroup_version == CGROUP_VERSION_2) {
+        path = get_pid_cgroup_path(entry->pid, NULL);
+        if (path == NULL) {
+            return -1;
+        }
+        dirs[0] = util_path_join(CGROUP_MOUNTPOINT, path);
+        for (i = 1; i < STATS_CTRL_MAX; i++) {
+            dirs[i] = util_strdup_s(dirs[0]);
+        }
+        free(path);
+    } else {
+        for (i = 0; i < STATS_CTRL_MAX; i++) {
+            if (g_v1_mountpoints[i] == NULL) {
+                continue;
+            }
+            path = get_pid_cgroup_path(entry->pid, g_stats_controllers[i]);
+            if (path == NULL) {
+                continue;
+            }
+            dirs[i] = join_cgroup_dir(g_v1_mountpoints[i], g_v1_roots[i], path);
+            free(path);
+        }
+    }
+
+    for (i = 0; i < STATS_FILE_MAX; i++) {
+        const char *name = g_stats_collector.cgroup_version == CGROUP_VERSION_2 ? g_stats_files[i].v2_name :
+                           g_stats_files[i].v1_name;
+
+        entry->fds[i] = open_stats_file(dirs[g_stats_files[i].controller], name);
+        if (entry->fds[i] >= 0) {
+            opened = true;
+        }
+    }
+
+    if (!opened) {
+        WARN("No cgroup stats file found for container %s", entry->id);
+        ret = -1;
+    }
+
+    for (i = 0; i < STATS_CTRL_MAX; i++) {
+        free(dirs[i]);
+    }
+    return ret;
+}
+
+static stats_entry_t *stats_entry_new(const char *id, pid_t pid)
+{
+    stats_entry_t *entry = NULL;
+    int i;
+
+    entry = util_common_calloc_s(sizeof(stats_entry_t));
+    if (entry == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+
+    for (i = 0; i < STATS_FILE_MAX; i++) {
+        entry->fds[i] = -1;
+    }
+    entry->id = util_strdup_s(id);
+    entry->pid = pid;
+
+    if (stats_entry_open_files(entry) != 0) {
+        stats_entry_free(entry);
+        return NULL;
+    }
+
+    return entry;
+}
+
+/* read the whole content of stats file from the beginning, return the length or -1 on failure */
+static ssize_t read_stats_file(int fd, char *buf, size_t size)
+{
+    ssize_t len;
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    do {
+        len = pread(fd, buf, size - 1, 0);
+    } while (len < 0 && errno == EINTR);
+
+    if (len < 0) {
+        return -1;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static int read_stats_uint64(int fd, char *buf, size_t size, uint64_t *value)
+{
+    if (read_stats_file(fd, buf, size) < 0) {
+        return -1;
+    }
+
+    util_trim_newline(buf);
+    // cgroup v2 uses "max" for unlimited values
+    if (strcmp(buf, "max") == 0) {
+        *value = UINT64_MAX;
+        return 0;
+    }
+
+    return util_safe_uint64(buf, value);
+}
+
+typedef void (*stats_kv_cb_t)(const char *key, uint64_t value, struct runtime_container_resources_stats_info *info);
+
+/* parse flat keyed file such as memory.stat and cpu.stat, each line is "key value" */
+static int read_stats_flat_keyed(int fd, char *buf, size_t size, stats_kv_cb_t cb,
+                                 struct runtime_container_resources_stats_info *info)
+{
+    char *line = NULL;
+    char *psave = NULL;
+
+    if (read_stats_file(fd, buf, size) < 0) {
+        return -1;
+    }
+
+    for (line = strtok_r(buf, "\n", &psave); line != NULL; line = strtok_r(NULL, "\n", &psave)) {
+        char *value = NULL;
+        uint64_t num = 0;
+
+        value = strchr(line, ' ');
+        if (value == NULL) {
+            continue;
+        }
+        *value = '\0';
+        value++;
+        if (util_safe_uint64(value, &num) != 0) {
+            continue;
+        }
+        cb(line, num, info);
+    }
+
+    return 0;
+}
+
+static void parse_v1_cpuacct_stat(const char *key, uint64_t value, struct runtime_container_resources_stats_info *info)
+{
+    static long clk_tck = 0;
+
+    if (strcmp(key, "system") != 0) {
+        return;
+    }
+
+    if (clk_tck <= 0) {
+        clk_tck = sysconf(_SC_CLK_TCK);
+    }
+    if (clk_tck > 0) {
+        info->cpu_system_use = value * (uint64_t)(Time_Second / clk_tck);
+    }
+}
+
+static void parse_v2_cpu_stat(const char *key, uint64_t value, struct runtime_container_resources_stats_info *info)
+{
+    if (strcmp(key, "usage_usec") == 0) {
+        info->cpu_use_nanos = value * Time_Micro;
+    } else if (strcmp(key, "system_usec") == 0) {
+        info->cpu_system_use = value * Time_Micro;
+    }
+}
+
+static void parse_v1_memory_stat(const char *key, uint64_t value, struct runtime_container_resources_stats_info *info)
+{
+    if (strcmp(key, "total_inactive_file") == 0) {
+        info->inactive_file_total = value;
+    } else if (strcmp(key, "total_rss") == 0) {
+        info->rss_bytes = value;
+    } else if (strcmp(key, "cache") == 0) {
+        info->cache = value;
+    } else if (strcmp(key, "total_cache") == 0) {
+        info->cache_total = value;
+    } else if (strcmp(key, "total_pgfault") == 0) {
+        info->page_faults = value;
+    } else if (strcmp(key, "total_pgmajfault") == 0) {
+        info->major_page_faults = value;
+    }
+}
+
+static void parse_v2_memory_stat(const char *key, uint64_t value, struct runtime_container_resources_stats_info *info)
+{
+    if (strcmp(key, "inactive_file") == 0) {
+        info->inactive_file_total = value;
+    } else if (strcmp(key, "anon") == 0) {
+        info->rss_bytes = value;
+    } else if (strcmp(key, "file") == 0) {
+        info->cache = value;
+        info->cache_total = value;
+    } else if (strcmp(key, "pgfault") == 0) {
+        info->page_faults = value;
+    } else if (strcmp(key, "pgmajfault") == 0) {
+        info->major_page_faults = value;
+    } else if (strcmp(key, "kernel") == 0) {
+        info->kmem_used = value;
+    }
+}
+
+/*
+ * v1 blkio.throttle.io_service_bytes: "8:0 Read 1024"
+ * v2 io.stat: "8:0 rbytes=1024 wbytes=0 rios=1 wios=0 dbytes=0 dios=0"
+ */
+static int read_stats_blkio(int fd, char *buf, size_t size, int version,
+                            struct runtime_container_resources_stats_info *info)
+{
+    char *line = NULL;
+    char *psave = NULL;
+
+    if (read_stats_file(fd, buf, size) < 0) {
+        return -1;
+    }
+
+    for (line = strtok_r(buf, "\n", &psave); line != NULL; line = strtok_r(NULL, "\n", &psave)) {
+        char **fields = NULL;
+        size_t fields_len;
+        size_t i;
+        uint64_t num = 0;
+
+        fields = util_string_split_multi(line, ' ');
+        fields_len = util_array_len((const char **)fields);
+        if (version == CGROUP_VERSION_2) {
+            for (i = 1; i < fields_len; i++) {
+                if (util_has_prefix(fields[i], "rbytes=") &&
+                    util_safe_uint64(fields[i] + strlen("rbytes="), &num) == 0) {
+                    info->blkio_read += num;
+                } else if (util_has_prefix(fields[i], "wbytes=") &&
+                           util_safe_uint64(fields[i] + strlen("wbytes="), &num) == 0) {
+                    info->blkio_write += num;
+                }
+            }
+        } else if (fields_len == 3 && util_safe_uint64(fields[2], &num) == 0) {
+            if (strcmp(fields[1], "Read") == 0) {
+                info->blkio_read += num;
+            } else if (strcmp(fields[1], "Write") == 0) {
+                info->blkio_write += num;
+            }
+        }
+        util_free_array(fields);
+    }
+
+    return 0;
+}
+
+/* sample all stats files of entry, fail only if the cgroup is gone */
+static int stats_entry_sample(stats_entry_t *entry)
+{
+    char buf[STATS_READ_BUF_SIZE] = { 0 };
+    stats_sample_t *sample = NULL;
+    struct runtime_container_resources_stats_info *info = NULL;
+    int version = g_stats_collector.cgroup_version;
+    int nret;
+
+    sample = &entry->ring[entry->head];
+    (void)memset(sample, 0, sizeof(stats_sample_t));
+    info = &sample->info;
+
+    if (version == CGROUP_VERSION_2) {
+        nret = read_stats_flat_keyed(entry->fds[STATS_FILE_CPU_USAGE], buf, sizeof(buf), parse_v2_cpu_stat, info);
+    } else {
+        nret = read_stats_uint64(entry->fds[STATS_FILE_CPU_USAGE], buf, sizeof(buf), &info->cpu_use_nanos);
+        (void)read_stats_flat_keyed(entry->fds[STATS_FILE_CPU_STAT], buf, sizeof(buf), parse_v1_cpuacct_stat, info);
+    }
+    // the cgroup dir is removed after container exited, all the opened files return ENODEV then
+    if (nret != 0 && entry->fds[STATS_FILE_CPU_USAGE] >= 0) {
+        return -1;
+    }
+
+    (void)read_stats_uint64(entry->fds[STATS_FILE_MEM_USAGE], buf, sizeof(buf), &info->mem_used);
+    (void)read_stats_uint64(entry->fds[STATS_FILE_MEM_LIMIT], buf, sizeof(buf), &info->mem_limit);
+    (void)read_stats_flat_keyed(entry->fds[STATS_FILE_MEM_STAT], buf, sizeof(buf),
+                                version == CGROUP_VERSION_2 ? parse_v2_memory_stat : parse_v1_memory_stat, info);
+    (void)read_stats_uint64(entry->fds[STATS_FILE_KMEM_USAGE], buf, sizeof(buf), &info->kmem_used);
+    (void)read_stats_uint64(entry->fds[STATS_FILE_KMEM_LIMIT], buf, sizeof(buf), &info->kmem_limit);
+    (void)read_stats_uint64(entry->fds[STATS_FILE_PIDS_CURRENT], buf, sizeof(buf), &info->pids_current);
+    (void)read_stats_blkio(entry->fds[STATS_FILE_BLKIO], buf, sizeof(buf), version, info);
+
+    info->usage_bytes = info->mem_used;
+    if (info->mem_limit > info->mem_used) {
+        info->avaliable_bytes = info->mem_limit - info->mem_used;
+    }
+
+    sample->timestamp = util_get_now_time_nanos();
+    entry->head = (entry->head + 1) % STATS_RING_SIZE;
+    if (entry->count < STATS_RING_SIZE) {
+        entry->count++;
+    }
+
+    return 0;
+}
+
+static const stats_sample_t *stats_entry_latest(const stats_entry_t *entry)
+{
+    if (entry->count == 0) {
+        return NULL;
+    }
+
+    return &entry->ring[(entry->head + STATS_RING_SIZE - 1) % STATS_RING_SIZE];
+}
+
+static void stats_collector_sample_all()
+{
+    map_itor *itor = NULL;
+    char **stale_ids = NULL;
+    size_t i;
+
+    stats_collector_lock();
+
+    itor = map_itor_new(g_stats_collector.entries);
+    if (itor == NULL) {
+        ERROR("Out of memory");
+        goto unlock;
+    }
+
+    for (; map_itor_valid(itor); map_itor_next(itor)) {
+        stats_entry_t *entry = map_itor_value(itor);
+
+        if (stats_entry_sample(entry) != 0 && util_array_append(&stale_ids, entry->id) != 0) {
+            ERROR("Out of memory");
+            break;
+        }
+    }
+    map_itor_free(itor);
+
+    for (i = 0; stale_ids != NULL && stale_ids[i] != NULL; i++) {
+        DEBUG("Cgroup of container %s is gone, stop collecting stats", stale_ids[i]);
+        if (!map_remove(g_stats_collector.entries, stale_ids[i])) {
+            WARN("Failed to remove stats entry of container %s", stale_ids[i]);
+        }
+    }
+
+unlock:
+    stats_collector_unlock();
+    util_free_array(stale_ids);
+}
+
+static void *stats_collector_routine(void *arg)
+{
+    int ret;
+
+    ret = pthread_detach(pthread_self());
+    if (ret != 0) {
+        CRIT("Set thread detach fail");
+        return NULL;
+    }
+
+    prctl(PR_SET_NAME, "Stats_collector");
+
+    for (;;) {
+        util_usleep_nointerupt((unsigned long)(g_stats_collector.interval / Time_Micro));
+        stats_collector_sample_all();
+    }
+
+    return NULL;
+}
+
+/* get cached stats of container, the container is registered to the collector at the first query */
+int container_stats_collector_get(const char *id, int pid, struct runtime_container_resources_stats_info *info)
+{
+    stats_entry_t *entry = NULL;
+    const stats_sample_t *latest = NULL;
+    int ret = 0;
+
+    if (id == NULL || pid <= 0 || info == NULL) {
+        return -1;
+    }
+
+    if (g_stats_collector.entries == NULL) {
+        return -1;
+    }
+
+    stats_collector_lock();
+
+    entry = map_search(g_stats_collector.entries, (void *)id);
+    if (entry != NULL && entry->pid != pid) {
+        // container has been restarted, its cgroup and the opened files are stale
+        if (!map_remove(g_stats_collector.entries, (void *)id)) {
+            ERROR("Failed to remove stale stats entry of container %s", id);
+            ret = -1;
+            goto unlock;
+        }
+        entry = NULL;
+    }
+
+    if (entry == NULL) {
+        entry = stats_entry_new(id, pid);
+        if (entry == NULL) {
+            ret = -1;
+            goto unlock;
+        }
+        if (stats_entry_sample(entry) != 0 || !map_insert(g_stats_collector.entries, (void *)id, entry)) {
+            ERROR("Failed to add stats entry of container %s", id);
+            stats_entry_free(entry);
+            ret = -1;
+            goto unlock;
+        }
+    }
+
+    latest = stats_entry_latest(entry);
+    if (latest == NULL) {
+        ret = -1;
+        goto unlock;
+    }
+    (void)memcpy(info, &latest->info, sizeof(struct runtime_container_resources_stats_info));
+
+unlock:
+    stats_collector_unlock();
+    return ret;
+}
+
+void container_stats_collector_remove(const char *id)
+{
+    if (id == NULL || g_stats_collector.entries == NULL) {
+        return;
+    }
+
+    stats_collector_lock();
+    if (map_search(g_stats_collector.entries, (void *)id) != NULL &&
+        !map_remove(g_stats_collector.entries, (void *)id)) {
+        WARN("Failed to remove stats entry of container %s", id);
+    }
+    stats_collector_unlock();
+}
+
+static void init_v1_mountpoints()
+{
+    int i;
+
+    for (i = 0; i < STATS_CTRL_MAX; i++) {
+        if (find_cgroup_mountpoint_and_root(g_stats_controllers[i], &g_v1_mountpoints[i], &g_v1_roots[i]) != 0 ||
+            g_v1_mountpoints[i] == NULL) {
+            WARN("Unable to find %s cgroup in mounts, related stats are not collected", g_stats_controllers[i]);
+        }
+    }
+}
+
+/* new stats collector */
+int new_stats_collector(void)
+{
+    if (pthread_mutex_init(&(g_stats_collector.mutex), NULL) != 0) {
+        CRIT("Mutex initialization failed");
+        return -1;
+    }
+
+    g_stats_collector.cgroup_version = get_cgroup_version();
+    if (g_stats_collector.cgroup_version < 0) {
+        ERROR("Failed to get cgroup version");
+        goto err_out;
+    }
+
+    if (g_stats_collector.cgroup_version == CGROUP_VERSION_1) {
+        init_v1_mountpoints();
+    }
+
+    g_stats_collector.interval = (int64_t)DEFAULT_STATS_COLLECT_INTERVAL * Time_Second;
+
+    g_stats_collector.entries = map_new(MAP_STR_PTR, MAP_DEFAULT_CMP_FUNC, stats_entry_kvfree);
+    if (g_stats_collector.entries == NULL) {
+        ERROR("Out of memory");
+        goto err_out;
+    }
+
+    return 0;
+
+err_out:
+    pthread_mutex_destroy(&(g_stats_collector.mutex));
+    return -1;
+}
+
+/* start stats collector */
+int start_stats_collector(void)
+{
+    pthread_t a_thread;
+
+    INFO("Starting stats collector...");
+
+    if (pthread_create(&a_thread, NULL, stats_collector_routine, NULL) != 0) {
+        CRIT("Thread creation failed");
+        return -1;
+    }
+
+    return 0;
+}
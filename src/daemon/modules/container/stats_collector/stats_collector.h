@@ -0,0 +1,82 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-07-10
+ * Description: provide container resources stats collector definition
+ ******************************************************************************/
+#ifndef DAEMON_MODULES_CONTAINER_STATS_COLLECTOR_STATS_COLLECTOR_H
+#define DAEMON_MODULES_CONTAINER_STATS_COLLECTOR_STATS_COLLECTOR_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "map.h"
+#include "runtime_api.h"
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+// in seconds, it is a build option until daemon configs can carry it
+#ifndef DEFAULT_STATS_COLLECT_INTERVAL
+#define DEFAULT_STATS_COLLECT_INTERVAL 2
+#endif
+#define STATS_RING_SIZE 8
+
+typedef enum {
+    STATS_FILE_CPU_USAGE = 0,
+    STATS_FILE_CPU_STAT,
+    STATS_FILE_MEM_USAGE,
+    STATS_FILE_MEM_LIMIT,
+    STATS_FILE_MEM_STAT,
+    STATS_FILE_KMEM_USAGE,
+    STATS_FILE_KMEM_LIMIT,
+    STATS_FILE_PIDS_CURRENT,
+    STATS_FILE_BLKIO,
+    STATS_FILE_MAX
+} stats_file_t;
+
+typedef struct {
+    int64_t timestamp;
+    struct runtime_container_resources_stats_info info;
+} stats_sample_t;
+
+typedef struct {
+    char *id;
+    // pid of container init process, the cgroup dirs are resolved from it
+    pid_t pid;
+    int fds[STATS_FILE_MAX];
+    // ring buffer of the latest samples, head is the next slot to write
+    stats_sample_t ring[STATS_RING_SIZE];
+    size_t head;
+    size_t count;
+} stats_entry_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    // container id --> stats_entry_t *
+    map_t *entries;
+    int cgroup_version;
+    // interval of background sampling, in nanoseconds
+    int64_t interval;
+} stats_collector_t;
+
+int new_stats_collector(void);
+
+int start_stats_collector(void);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif
+
+#endif // DAEMON_MODULES_CONTAINER_STATS_COLLECTOR_STATS_COLLECTOR_H
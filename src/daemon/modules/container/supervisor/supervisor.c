@@ -27,6 +27,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <time.h>
 
 #include "isula_libutils/log.h"
 #include "utils.h"
@@ -39,17 +41,49 @@
 #include "event_type.h"
 #include "utils_file.h"
 
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+// number of workers to clean resources of exited containers
+#define SUPERVISOR_CLEAN_WORKERS 4
+// interval and times to check again whether the killed init process of an exited container is gone
+#define CLEAN_RETRY_INTERVAL_MS 100
+#define CLEAN_MAX_RETRY 10
+
 pthread_mutex_t g_supervisor_lock = PTHREAD_MUTEX_INITIALIZER;
 struct epoll_descr g_supervisor_descr;
+// whether the kernel supports pidfd_open, probed when the supervisor starts
+static bool g_pidfd_supported = false;
 
 struct supervisor_handler_data {
+    // exit fifo, the monitor of container writes exit code into it
     int fd;
+    // pidfd of container init process, it only wakes up the supervisor to watch the exit fifo
+    int pidfd;
     int exit_code;
     char *name;
     char *runtime;
     pid_ppid_info_t pid_info;
+    int retry_count;
+    // monotonic time in milliseconds when the data is retried
+    uint64_t retry_at;
+    struct supervisor_handler_data *next;
+};
+
+struct clean_list {
+    struct supervisor_handler_data *head;
+    struct supervisor_handler_data *tail;
 };
 
+// exited containers waiting to be cleaned, and the ones whose init process is killed and checked later
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    struct clean_list ready;
+    struct clean_list retry;
+} g_clean_queue = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, { NULL, NULL }, { NULL, NULL } };
+
 /* supervisor handler lock */
 static void supervisor_handler_lock()
 {
@@ -152,29 +186,72 @@ static void supervisor_handler_data_free(struct supervisor_handler_data *data)
     if (data->fd >= 0) {
         close(data->fd);
     }
+    if (data->pidfd >= 0) {
+        close(data->pidfd);
+    }
     free(data);
 }
 
-/* clean resources thread */
-static void *clean_resources_thread(void *arg)
+static int supervisor_pidfd_open(pid_t pid)
+{
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+}
+
+static void probe_pidfd_support()
+{
+    int fd = supervisor_pidfd_open(getpid());
+
+    if (fd < 0) {
+        WARN("Pidfd is not supported: %s, watch container exit by exit fifo", strerror(errno));
+        return;
+    }
+    close(fd);
+    g_pidfd_supported = true;
+}
+
+static int open_init_pidfd(const pid_ppid_info_t *pid_info)
+{
+    int pidfd = -1;
+
+    if (!g_pidfd_supported || pid_info->pid <= 0) {
+        return -1;
+    }
+
+    pidfd = supervisor_pidfd_open(pid_info->pid);
+    if (pidfd < 0) {
+        return -1;
+    }
+    // the pidfd pins the process, so a pid reused by another process is found by checking it after open
+    if (!util_process_alive(pid_info->pid, pid_info->start_time)) {
+        close(pidfd);
+        return -1;
+    }
+
+    return pidfd;
+}
+
+static uint64_t monotonic_ms()
+{
+    struct timespec ts = { 0 };
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* clean resources of exited container, returns false if its init process is killed and must be checked later */
+static bool clean_resources(struct supervisor_handler_data *data)
 {
     int ret = 0;
-    struct supervisor_handler_data *data = arg;
     char *name = data->name;
     char *runtime = data->runtime;
     unsigned long long start_time = data->pid_info.start_time;
     pid_t pid = data->pid_info.pid;
-    int retry_count = 0;
-    int max_retry = 10;
 
-    ret = pthread_detach(pthread_self());
-    if (ret != 0) {
-        CRIT("Set thread detach fail");
+    if (data->retry_count == 0) {
+        // the cgroup of exited container will be removed, stop collecting its stats
+        container_stats_collector_remove(name);
     }
 
-    prctl(PR_SET_NAME, "Clean resource");
-
-retry:
     if (false == util_process_alive(pid, start_time)) {
         ret = clean_container_resource(name, runtime, pid);
         // clean_container_resource failed, do not log error message,
@@ -188,10 +265,10 @@ retry:
             ERROR("Can not kill process (pid=%d) with SIGKILL for container %s", pid, name);
         }
 
-        if (retry_count < max_retry) {
-            util_usleep_nointerupt(100 * 1000); /* 100 millisecond */
-            retry_count++;
-            goto retry;
+        // check it again later in the queue, never wait here so other exits are not stalled
+        if (data->retry_count < CLEAN_MAX_RETRY) {
+            data->retry_count++;
+            return false;
         }
 
         ret = gc_add_container(name, runtime, &data->pid_info);
@@ -203,24 +280,147 @@ retry:
     (void)isulad_monitor_send_container_event(name, STOPPED, (int)pid, data->exit_code, NULL, NULL);
 
     supervisor_handler_data_free(data);
+    return true;
+}
 
-    DAEMON_CLEAR_ERRMSG();
-    return NULL;
+static void clean_list_push(struct clean_list *list, struct supervisor_handler_data *data)
+{
+    data->next = NULL;
+    if (list->tail == NULL) {
+        list->head = data;
+    } else {
+        list->tail->next = data;
+    }
+    list->tail = data;
+}
+
+static struct supervisor_handler_data *clean_list_pop(struct clean_list *list)
+{
+    struct supervisor_handler_data *data = list->head;
+
+    if (data != NULL) {
+        list->head = data->next;
+        if (list->head == NULL) {
+            list->tail = NULL;
+        }
+        data->next = NULL;
+    }
+    return data;
+}
+
+static void wait_retry_due(uint64_t retry_at)
+{
+    struct timespec ts = { 0 };
+    uint64_t now = monotonic_ms();
+    uint64_t wait_ms = retry_at > now ? retry_at - now : 0;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += (time_t)(wait_ms / 1000);
+    ts.tv_nsec += (long)(wait_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    (void)pthread_cond_timedwait(&g_clean_queue.cond, &g_clean_queue.mutex, &ts);
+}
+
+/* get the next container to clean, retries are all delayed by the same interval so they are due in order */
+static struct supervisor_handler_data *get_clean_data()
+{
+    struct supervisor_handler_data *data = NULL;
+
+    for (;;) {
+        while (g_clean_queue.retry.head != NULL && g_clean_queue.retry.head->retry_at <= monotonic_ms()) {
+            clean_list_push(&g_clean_queue.ready, clean_list_pop(&g_clean_queue.retry));
+        }
+        data = clean_list_pop(&g_clean_queue.ready);
+        if (data != NULL) {
+            return data;
+        }
+        if (g_clean_queue.retry.head != NULL) {
+            wait_retry_due(g_clean_queue.retry.head->retry_at);
+        } else {
+            (void)pthread_cond_wait(&g_clean_queue.cond, &g_clean_queue.mutex);
+        }
+    }
 }
 
-/* new clean resources thread */
-int new_clean_resources_thread(struct supervisor_handler_data *data)
+/* clean resources worker */
+static void *clean_resources_worker(void *arg)
 {
     int ret = 0;
-    pthread_t clean_thread;
+    struct supervisor_handler_data *data = NULL;
+
+    ret = pthread_detach(pthread_self());
+    if (ret != 0) {
+        CRIT("Set thread detach fail");
+    }
+
+    prctl(PR_SET_NAME, "Clean resource");
 
-    if (pthread_create(&clean_thread, NULL, clean_resources_thread, data)) {
-        ERROR("Create clean resource thread failed");
+    for (;;) {
+        if (pthread_mutex_lock(&g_clean_queue.mutex) != 0) {
+            ERROR("Failed to lock clean queue");
+            break;
+        }
+        data = get_clean_data();
+        (void)pthread_mutex_unlock(&g_clean_queue.mutex);
+
+        if (!clean_resources(data)) {
+            if (pthread_mutex_lock(&g_clean_queue.mutex) != 0) {
+                ERROR("Failed to lock clean queue");
+                supervisor_handler_data_free(data);
+                continue;
+            }
+            data->retry_at = monotonic_ms() + CLEAN_RETRY_INTERVAL_MS;
+            clean_list_push(&g_clean_queue.retry, data);
+            (void)pthread_cond_signal(&g_clean_queue.cond);
+            (void)pthread_mutex_unlock(&g_clean_queue.mutex);
+        }
+        DAEMON_CLEAR_ERRMSG();
+    }
+
+    return NULL;
+}
+
+/* queue exited container to clean resources workers */
+static int queue_clean_resources(struct supervisor_handler_data *data)
+{
+    if (pthread_mutex_lock(&g_clean_queue.mutex) != 0) {
+        ERROR("Failed to lock clean queue");
         supervisor_handler_data_free(data);
-        ret = -1;
+        return -1;
     }
+    clean_list_push(&g_clean_queue.ready, data);
+    (void)pthread_cond_signal(&g_clean_queue.cond);
+    (void)pthread_mutex_unlock(&g_clean_queue.mutex);
 
-    return ret;
+    return 0;
+}
+
+static int start_clean_resources_workers()
+{
+    size_t i = 0;
+    pthread_t worker;
+    pthread_condattr_t attr;
+
+    // retries are timed by the monotonic clock
+    if (pthread_condattr_init(&attr) != 0 || pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) != 0 ||
+        pthread_cond_init(&g_clean_queue.cond, &attr) != 0) {
+        ERROR("Failed to init clean queue cond");
+        return -1;
+    }
+    (void)pthread_condattr_destroy(&attr);
+
+    for (i = 0; i < SUPERVISOR_CLEAN_WORKERS; i++) {
+        if (pthread_create(&worker, NULL, clean_resources_worker, NULL) != 0) {
+            ERROR("Create clean resource worker failed");
+            // workers started already can still serve the queue
+            return i > 0 ? 0 : -1;
+        }
+    }
+
+    return 0;
 }
 
 /* supervisor exit cb */
@@ -243,7 +443,29 @@ static int supervisor_exit_cb(int fd, uint32_t events, void *cbdata, struct epol
     epoll_loop_del_handler(&g_supervisor_descr, fd);
     supervisor_handler_unlock();
 
-    (void)new_clean_resources_thread(data);
+    (void)queue_clean_resources(data);
+
+    return EPOLL_LOOP_HANDLE_CONTINUE;
+}
+
+/* supervisor pidfd cb, the init process exited and the exit code is read from exit fifo as usual */
+static int supervisor_pidfd_cb(int fd, uint32_t events, void *cbdata, struct epoll_descr *descr)
+{
+    int ret = 0;
+    struct supervisor_handler_data *data = cbdata;
+
+    INFO("The container %s 's init process %d has exited", data->name, data->pid_info.pid);
+    supervisor_handler_lock();
+    epoll_loop_del_handler(&g_supervisor_descr, fd);
+    close(data->pidfd);
+    data->pidfd = -1;
+    ret = epoll_loop_add_handler(&g_supervisor_descr, data->fd, supervisor_exit_cb, data);
+    supervisor_handler_unlock();
+
+    if (ret != 0) {
+        ERROR("Failed to add handler for exit fifo of container %s", data->name);
+        (void)supervisor_exit_cb(data->fd, events, data, descr);
+    }
 
     return EPOLL_LOOP_HANDLE_CONTINUE;
 }
@@ -274,6 +496,7 @@ int container_supervisor_add_exit_monitor(int fd, const pid_ppid_info_t *pid_inf
     }
 
     data->fd = fd;
+    data->pidfd = -1;
     data->name = util_strdup_s(name);
     data->runtime = util_strdup_s(runtime);
     data->pid_info.pid = pid_info->pid;
@@ -281,8 +504,15 @@ int container_supervisor_add_exit_monitor(int fd, const pid_ppid_info_t *pid_inf
     data->pid_info.ppid = pid_info->ppid;
     data->pid_info.pstart_time = pid_info->pstart_time;
 
+    // exit fifo is watched after the pidfd wakes up, or from the start without pidfd
+    data->pidfd = open_init_pidfd(pid_info);
+
     supervisor_handler_lock();
-    ret = epoll_loop_add_handler(&g_supervisor_descr, fd, supervisor_exit_cb, data);
+    if (data->pidfd >= 0) {
+        ret = epoll_loop_add_handler(&g_supervisor_descr, data->pidfd, supervisor_pidfd_cb, data);
+    } else {
+        ret = epoll_loop_add_handler(&g_supervisor_descr, fd, supervisor_exit_cb, data);
+    }
     if (ret != 0) {
         ERROR("Failed to add handler for exit fifo");
         goto err;
@@ -332,6 +562,8 @@ int new_supervisor()
 
     INFO("Starting supervisor...");
 
+    probe_pidfd_support();
+
     ret = epoll_loop_open(&g_supervisor_descr);
     if (ret != 0) {
         ERROR("Failed to create epoll_loop");
@@ -339,6 +571,11 @@ int new_supervisor()
         goto out;
     }
 
+    if (start_clean_resources_workers() != 0) {
+        ret = -1;
+        goto out;
+    }
+
     if (pthread_create(&supervisor_thread, NULL, supervisor, NULL) != 0) {
         ERROR("Create supervisor thread failed");
         ret = -1;
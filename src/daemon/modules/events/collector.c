@@ -18,12 +18,11 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
-#include <sys/prctl.h>
-#include <regex.h>
 #include <isula_libutils/container_config.h>
 #include <isula_libutils/container_config_v2.h>
 #include <isula_libutils/json_common.h>
 #include <pthread.h>
+#include <regex.h>
 #include <semaphore.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -38,29 +37,48 @@
 #include "container_events_handler.h"
 #include "constants.h"
 #include "events_format.h"
-#include "linked_list.h"
 #include "stream_wrapper.h"
 #include "utils.h"
+#include "util_atomic.h"
 #include "utils_array.h"
 #include "utils_timestamp.h"
 
-static struct context_lists g_context_lists;
-
-struct events_lists {
-    unsigned int size;
-    pthread_mutex_t event_mutex;
-    struct linked_list event_list;
+// must be a power of two, it bounds both the events kept for replay and how far a client may lag
+#define EVENTS_RING_SIZE 256
+// events a client takes from the ring at a time before writing them out of the lock
+#define EVENTS_CLIENT_BATCH 16
+// how often an idle client checks whether it is cancelled or its until time has passed
+#define EVENTS_CLIENT_CHECK_SECOND 1
+
+// published events are immutable and shared by the ring and the clients writing them
+struct shared_event {
+    struct isulad_events_format *event;
+    // "^id$" compiled once for the name filters of all clients
+    regex_t id_reg;
+    bool has_id_reg;
+    volatile uint64_t refcnt;
 };
-static struct events_lists g_events_buffer;
 
-#define EVENTSLIMIT 64
+struct events_ring {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    // sequence of the next event, event seq is kept in slots[seq % EVENTS_RING_SIZE]
+    uint64_t next_seq;
+    struct shared_event *slots[EVENTS_RING_SIZE];
+    uint64_t clients;
+    uint64_t dropped_total;
+};
+static struct events_ring g_events_ring;
 
-struct context_elem {
-    stream_func_wrapper stream;
-    char *name;
-    sem_t context_sem;
+struct events_client {
+    // the filter is resolved once when the client subscribes
+    const char *id;
     const types_timestamp_t *since;
     const types_timestamp_t *until;
+    const stream_func_wrapper *stream;
+    uint64_t cursor;
+    uint64_t delivered;
+    uint64_t dropped;
 };
 
 /* get idreg */
@@ -510,62 +528,116 @@ out:
     return ret;
 }
 
-/* events append */
-static void events_append(const struct isulad_events_format *event)
+static struct shared_event *shared_event_new(struct isulad_events_format *event)
 {
-    struct isulad_events_format *tmpevent = NULL;
-    struct linked_list *newnode = NULL;
-    struct linked_list *firstnode = NULL;
+    struct shared_event *shared = NULL;
 
-    if (pthread_mutex_lock(&g_events_buffer.event_mutex)) {
-        WARN("Failed to lock");
-        return;
+    shared = util_common_calloc_s(sizeof(struct shared_event));
+    if (shared == NULL) {
+        ERROR("Out of memory");
+        return NULL;
     }
+    shared->event = event;
+    shared->has_id_reg = get_idreg(&shared->id_reg, event->id);
+    shared->refcnt = 1;
 
-    if (g_events_buffer.size < EVENTSLIMIT) {
-        newnode = util_common_calloc_s(sizeof(struct linked_list));
-        if (newnode == NULL) {
-            CRIT("Memory allocation error.");
-            goto unlock;
-        }
+    return shared;
+}
 
-        tmpevent = util_common_calloc_s(sizeof(struct isulad_events_format));
-        if (tmpevent == NULL) {
-            CRIT("Memory allocation error.");
-            free(newnode);
-            goto unlock;
-        }
+static struct shared_event *shared_event_ref(struct shared_event *shared)
+{
+    if (shared != NULL) {
+        atomic_int_inc(&shared->refcnt);
+    }
+    return shared;
+}
 
-        if (event_copy(event, tmpevent) != 0) {
-            CRIT("Failed to copy event.");
-            isulad_events_format_free(tmpevent);
-            free(newnode);
-            goto unlock;
-        }
+static void shared_event_unref(struct shared_event *shared)
+{
+    if (shared == NULL) {
+        return;
+    }
 
-        linked_list_add_elem(newnode, tmpevent);
-        linked_list_add_tail(&g_events_buffer.event_list, newnode);
-        g_events_buffer.size++;
-    } else {
-        firstnode = linked_list_first_node(&g_events_buffer.event_list);
-        if (firstnode != NULL) {
-            linked_list_del(firstnode);
-
-            tmpevent = (struct isulad_events_format *)firstnode->elem;
-            if (event_copy(event, tmpevent) != 0) {
-                CRIT("Failed to copy event.");
-                goto unlock;
-            }
+    if (!atomic_int_dec_test(&shared->refcnt)) {
+        return;
+    }
 
-            linked_list_add_tail(&g_events_buffer.event_list, firstnode);
-        }
+    if (shared->has_id_reg) {
+        regfree(&shared->id_reg);
     }
+    isulad_events_format_free(shared->event);
+    free(shared);
+}
 
-unlock:
-    if (pthread_mutex_unlock(&g_events_buffer.event_mutex)) {
-        WARN("Failed to unlock");
+static void events_ring_lock()
+{
+    if (pthread_mutex_lock(&g_events_ring.mutex) != 0) {
+        ERROR("Failed to lock events ring");
+    }
+}
+
+static void events_ring_unlock()
+{
+    if (pthread_mutex_unlock(&g_events_ring.mutex) != 0) {
+        ERROR("Failed to unlock events ring");
+    }
+}
+
+/* oldest sequence still kept in the ring, must be called with the ring locked */
+static uint64_t events_ring_first_seq()
+{
+    return g_events_ring.next_seq > EVENTS_RING_SIZE ? g_events_ring.next_seq - EVENTS_RING_SIZE : 0;
+}
+
+/* publish takes the ownership of event, the cost is the same whatever the number of clients */
+static void events_publish(struct isulad_events_format *event)
+{
+    struct shared_event *shared = NULL;
+    struct shared_event *evicted = NULL;
+    size_t slot;
+
+    shared = shared_event_new(event);
+    if (shared == NULL) {
+        isulad_events_format_free(event);
         return;
     }
+
+    events_ring_lock();
+    slot = g_events_ring.next_seq & (EVENTS_RING_SIZE - 1);
+    evicted = g_events_ring.slots[slot];
+    g_events_ring.slots[slot] = shared;
+    g_events_ring.next_seq++;
+    if (g_events_ring.clients > 0) {
+        (void)pthread_cond_broadcast(&g_events_ring.cond);
+    }
+    events_ring_unlock();
+
+    // clients still writing the evicted event hold their own reference
+    shared_event_unref(evicted);
+}
+
+/*
+ * take up to max events after the client's cursor, must be called with the ring locked.
+ * a client lagging more than the ring size skips the overwritten events and accounts them as dropped
+ */
+static size_t events_client_take(struct events_client *client, struct shared_event **batch, size_t max)
+{
+    uint64_t first = events_ring_first_seq();
+    size_t n = 0;
+
+    if (client->cursor < first) {
+        client->dropped += first - client->cursor;
+        g_events_ring.dropped_total += first - client->cursor;
+        WARN("Events client lagged behind, %lu events dropped", (unsigned long)(first - client->cursor));
+        client->cursor = first;
+    }
+
+    while (n < max && client->cursor < g_events_ring.next_seq) {
+        batch[n++] = shared_event_ref(g_events_ring.slots[client->cursor & (EVENTS_RING_SIZE - 1)]);
+        client->cursor++;
+    }
+
+    return n;
 }
 
 static int do_write_events(const stream_func_wrapper *stream, struct isulad_events_format *event)
@@ -606,54 +678,57 @@ static int check_util_time(const types_timestamp_t *until, const struct isulad_e
     return 0;
 }
 
-static int do_subscribe(const char *name, const types_timestamp_t *since, const types_timestamp_t *until,
-                        const stream_func_wrapper *stream)
+static bool events_client_match(const struct events_client *client, const struct shared_event *shared)
 {
-    bool regflag = false;
-    int ret = 0;
-    regex_t preg;
-    struct linked_list *it = NULL;
-    struct linked_list *next = NULL;
-    struct isulad_events_format *c_event = NULL;
-
-    if (pthread_mutex_lock(&g_events_buffer.event_mutex)) {
-        WARN("Failed to lock");
-        return -1;
+    if (check_since_time(client->since, shared->event) != 0) {
+        return false;
     }
 
-    linked_list_for_each_safe(it, &g_events_buffer.event_list, next) {
-        c_event = (struct isulad_events_format *)it->elem;
+    // the id of the event is the pattern, matched against the name of the client
+    if (client->id != NULL && shared->has_id_reg && regexec(&shared->id_reg, client->id, 0, NULL, 0) != 0) {
+        return false;
+    }
 
-        if (check_since_time(since, c_event) != 0) {
-            continue;
-        }
+    return true;
+}
 
-        if (check_util_time(until, c_event) != 0) {
+static int do_subscribe(const char *name, const types_timestamp_t *since, const types_timestamp_t *until,
+                        const stream_func_wrapper *stream)
+{
+    int ret = 0;
+    size_t i;
+    size_t n = 0;
+    struct shared_event *batch[EVENTS_RING_SIZE] = { 0 };
+    struct events_client client = { 0 };
+
+    client.id = name;
+    client.since = since;
+    client.until = until;
+    client.stream = stream;
+
+    // replay from a snapshot of the ring, so the producer is never blocked by the writes
+    events_ring_lock();
+    client.cursor = events_ring_first_seq();
+    n = events_client_take(&client, batch, EVENTS_RING_SIZE);
+    events_ring_unlock();
+
+    for (i = 0; i < n; i++) {
+        if (check_util_time(until, batch[i]->event) != 0) {
             break;
         }
 
-        if (regflag) {
-            regfree(&preg);
-        }
-        regflag = get_idreg(&preg, c_event->id);
-
-        if (name != NULL && regflag) {
-            if (regexec(&preg, name, 0, NULL, 0)) {
-                continue;
-            }
+        if (!events_client_match(&client, batch[i])) {
+            continue;
         }
 
-        ret = do_write_events(stream, c_event);
+        ret = do_write_events(stream, batch[i]->event);
         if (ret != 0) {
             break;
         }
     }
 
-    if (pthread_mutex_unlock(&g_events_buffer.event_mutex)) {
-        WARN("Failed to unlock");
-    }
-    if (regflag) {
-        regfree(&preg);
+    for (i = 0; i < n; i++) {
+        shared_event_unref(batch[i]);
     }
 
     return ret;
@@ -683,134 +758,92 @@ int events_subscribe(const char *name, const types_timestamp_t *since, const typ
     return do_subscribe(name, since, until, stream);
 }
 
-/* events forward */
-static void events_forward(struct isulad_events_format *r)
+static bool events_client_should_exit(const struct events_client *client)
 {
-    struct linked_list *it = NULL;
-    struct linked_list *next = NULL;
-    struct context_elem *context_info = NULL;
-    char *name = NULL;
-    regex_t preg;
-    bool regflag = false;
-
-    events_append(r);
-    regflag = get_idreg(&preg, r->id);
-
-    if (pthread_mutex_lock(&g_context_lists.context_mutex)) {
-        WARN("Failed to lock");
-        return;
-    }
-
-    linked_list_for_each_safe(it, &g_context_lists.context_list, next) {
-        context_info = (struct context_elem *)it->elem;
-        name = context_info->name;
-
-        if (context_info->since != NULL) {
-            if (util_types_timestamp_cmp(&r->timestamp, context_info->since) < 0) {
-                continue;
-            }
-        }
-
-        if (name != NULL && regflag) {
-            if (regexec(&preg, name, 0, NULL, 0)) {
-                continue;
-            }
-        }
-
-        if (context_info->stream.write_func == NULL || context_info->stream.writer == NULL) {
-            INFO("Unimplemented write function");
-            goto delete_and_continue;
-        }
-        if (!context_info->stream.write_func(context_info->stream.writer, r)) {
-            INFO("Failed to send exit event for 'events' client");
-            goto delete_and_continue;
-        }
-
-        continue;
+    struct timespec ts_now = { 0 };
+    types_timestamp_t t_now = { 0 };
 
-delete_and_continue:
-        linked_list_del(it);
-        sem_post(&context_info->context_sem);
-        continue;
+    if (client->stream->is_cancelled(client->stream->context)) {
+        DEBUG("Client has exited, stop sending events");
+        return true;
     }
 
-    if (pthread_mutex_unlock(&g_context_lists.context_mutex)) {
-        WARN("Failed to unlock");
+    if (client->until == NULL || (client->until->has_seconds == 0 && client->until->has_nanos == 0)) {
+        return false;
     }
 
-    if (regflag) {
-        regfree(&preg);
+    if (clock_gettime(CLOCK_REALTIME, &ts_now) != 0) {
+        ERROR("Failed to get time");
+        return false;
     }
-}
 
-/* event should exit */
-static void *event_should_exit(void *arg)
-{
-    int res = 0;
-    int err = 0;
+    t_now.has_seconds = true;
+    t_now.seconds = ts_now.tv_sec;
+    t_now.has_nanos = true;
+    t_now.nanos = (int32_t)ts_now.tv_nsec;
 
-    res = pthread_detach(pthread_self());
-    if (res != 0) {
-        CRIT("Set thread detach fail");
-        goto error;
+    if (util_types_timestamp_cmp(&t_now, client->until) > 0) {
+        INFO("Finish response for RPC, client should exit");
+        return true;
     }
 
-    prctl(PR_SET_NAME, "Clients_checker");
+    return false;
+}
 
-    struct linked_list *it = NULL;
-    struct linked_list *next = NULL;
-    struct context_elem *context_info = NULL;
-    struct timespec ts_now = { 0 };
-    types_timestamp_t t_now = { 0 };
+/* wait for events after the client's cursor, returns 0 when the client should exit */
+static size_t events_client_wait(struct events_client *client, struct shared_event **batch, size_t max)
+{
+    size_t n = 0;
+    struct timespec ts = { 0 };
 
-    for (;;) {
-        if (pthread_mutex_lock(&g_context_lists.context_mutex)) {
-            WARN("Failed to lock");
-            continue;
+    events_ring_lock();
+    while (client->cursor == g_events_ring.next_seq) {
+        if (events_client_should_exit(client)) {
+            goto unlock;
         }
+        ts.tv_sec = time(NULL) + EVENTS_CLIENT_CHECK_SECOND;
+        (void)pthread_cond_timedwait(&g_events_ring.cond, &g_events_ring.mutex, &ts);
+    }
+    n = events_client_take(client, batch, max);
 
-        linked_list_for_each_safe(it, &g_context_lists.context_list, next) {
-            context_info = (struct context_elem *)it->elem;
+unlock:
+    events_ring_unlock();
+    return n;
+}
 
-            if (context_info->stream.is_cancelled(context_info->stream.context)) {
-                DEBUG("Client has exited, stop sending events");
-                linked_list_del(it);
-                sem_post(&context_info->context_sem);
-                continue;
-            }
+/* the thread of each client writes its own events, a slow client only delays itself */
+static void events_client_loop(struct events_client *client)
+{
+    size_t i;
+    size_t n;
+    bool stop = false;
+    struct shared_event *batch[EVENTS_CLIENT_BATCH] = { 0 };
 
-            if (context_info->until == NULL ||
-                (context_info->until->has_seconds == 0 && context_info->until->has_nanos == 0)) {
-                continue;
-            }
+    while (!stop) {
+        n = events_client_wait(client, batch, EVENTS_CLIENT_BATCH);
+        if (n == 0) {
+            break;
+        }
 
-            err = clock_gettime(CLOCK_REALTIME, &ts_now);
-            if (err != 0) {
-                ERROR("Failed to get time");
+        for (i = 0; i < n; i++) {
+            if (stop || !events_client_match(client, batch[i])) {
+                shared_event_unref(batch[i]);
                 continue;
             }
 
-            t_now.has_seconds = true;
-            t_now.seconds = ts_now.tv_sec;
-            t_now.has_nanos = true;
-            t_now.nanos = (int32_t)ts_now.tv_nsec;
-
-            if (util_types_timestamp_cmp(&t_now, context_info->until) > 0) {
-                INFO("Finish response for RPC, client should exit");
-                linked_list_del(it);
-                sem_post(&context_info->context_sem);
-                continue;
+            if (do_write_events(client->stream, batch[i]->event) != 0) {
+                INFO("Failed to send event for 'events' client");
+                stop = true;
+            } else {
+                client->delivered++;
             }
+            shared_event_unref(batch[i]);
         }
 
-        if (pthread_mutex_unlock(&g_context_lists.context_mutex)) {
-            WARN("Failed to unlock");
+        if (!stop) {
+            stop = events_client_should_exit(client);
         }
-
-        sleep(1);
     }
-error:
-    return NULL;
 }
 
 /* post event to events hander */
@@ -864,114 +897,76 @@ void events_handler(struct monitord_msg *msg)
         goto out;
     }
 
-    /* forward events to grpc clients */
-    events_forward(events);
-
     /* log event into isulad.log */
     (void)write_events_log(events);
 
+    /* forward events to grpc clients, the ring owns the event from now on */
+    events_publish(events);
+    events = NULL;
+
 out:
     isulad_events_format_free(events);
 }
 
-/* add monitor client */
+/* add monitor client, the caller's thread serves the client until it exits */
 int add_monitor_client(char *name, const types_timestamp_t *since, const types_timestamp_t *until,
                        const stream_func_wrapper *stream)
 {
-    int ret = 0;
-    struct linked_list *newnode = NULL;
-    struct context_elem *context_info = NULL;
+    struct events_client client = { 0 };
 
     if (stream == NULL) {
         CRIT("Should provide stream functions");
         return -1;
     }
 
-    newnode = util_common_calloc_s(sizeof(struct linked_list));
-    if (newnode == NULL) {
-        CRIT("Memory allocation error.");
+    if (stream->is_cancelled == NULL || stream->write_func == NULL || stream->writer == NULL) {
+        ERROR("Unimplemented stream function");
         return -1;
     }
 
-    context_info = util_common_calloc_s(sizeof(struct context_elem));
-    if (context_info == NULL) {
-        CRIT("Memory allocation error.");
-        ret = -1;
-        goto free_out;
-    }
-
-    if (sem_init(&context_info->context_sem, 0, 0)) {
-        ERROR("Semaphore initialization failed");
-        ret = -1;
-        goto free_out;
-    }
+    client.id = name;
+    client.since = since;
+    client.until = until;
+    client.stream = stream;
 
-    context_info->name = name;
-    context_info->since = since;
-    context_info->until = until;
-    context_info->stream.is_cancelled = stream->is_cancelled;
-    context_info->stream.context = stream->context;
-    context_info->stream.write_func = stream->write_func;
-    context_info->stream.writer = stream->writer;
+    events_ring_lock();
+    client.cursor = g_events_ring.next_seq;
+    g_events_ring.clients++;
+    events_ring_unlock();
 
-    if (pthread_mutex_lock(&g_context_lists.context_mutex)) {
-        ERROR("Failed to lock");
-        ret = -1;
-        goto sem_free;
-    }
+    events_client_loop(&client);
 
-    linked_list_add_elem(newnode, context_info);
-    linked_list_add_tail(&g_context_lists.context_list, newnode);
+    events_ring_lock();
+    g_events_ring.clients--;
+    events_ring_unlock();
 
-    if (pthread_mutex_unlock(&g_context_lists.context_mutex)) {
-        WARN("Failed to unlock");
-        ret = -1;
-        goto sem_free;
+    if (client.dropped > 0) {
+        WARN("Events client exited, %lu events delivered, %lu events dropped", (unsigned long)client.delivered,
+             (unsigned long)client.dropped);
     }
 
-    sem_wait(&context_info->context_sem);
-
-sem_free:
-    sem_destroy(&context_info->context_sem);
-
-free_out:
-    free(context_info);
-    free(newnode);
-    return ret;
+    return 0;
 }
 
 /* newcollector */
 static int newcollector()
 {
     int ret = -1;
-    pthread_t exit_thread;
 
-    linked_list_init(&(g_context_lists.context_list));
-    linked_list_init(&(g_events_buffer.event_list));
-    g_events_buffer.size = 0;
-
-    ret = pthread_mutex_init(&(g_context_lists.context_mutex), NULL);
+    ret = pthread_mutex_init(&(g_events_ring.mutex), NULL);
     if (ret != 0) {
         CRIT("Mutex initialization failed");
         goto out;
     }
 
-    ret = pthread_mutex_init(&(g_events_buffer.event_mutex), NULL);
+    ret = pthread_cond_init(&(g_events_ring.cond), NULL);
     if (ret != 0) {
-        CRIT("Mutex initialization failed");
-        pthread_mutex_destroy(&(g_context_lists.context_mutex));
+        CRIT("Cond initialization failed");
+        pthread_mutex_destroy(&(g_events_ring.mutex));
         goto out;
     }
 
     INFO("Starting collector...");
-    ret = pthread_create(&exit_thread, NULL, event_should_exit, NULL);
-    if (ret != 0) {
-        CRIT("Thread creation failed");
-        pthread_mutex_destroy(&(g_context_lists.context_mutex));
-        pthread_mutex_destroy(&(g_events_buffer.event_mutex));
-        goto out;
-    }
-
     ret = 0;
 out:
     return ret;
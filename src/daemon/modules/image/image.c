@@ -2041,6 +2041,19 @@ struct graphdriver_status *im_graphdriver_get_status(void)
 #endif
 }
 
+void im_get_pull_metrics(im_pull_metrics *metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+
+#ifdef ENABLE_OCI_IMAGE
+    oci_get_pull_metrics(metrics);
+#else
+    (void)memset(metrics, 0, sizeof(*metrics));
+#endif
+}
+
 bool im_oci_image_exist(const char *name)
 {
     if (name == NULL) {
@@ -0,0 +1,553 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-16
+ * Description: provide content addressable blob cache functions
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include "blob_cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "isula_libutils/log.h"
+#include "linked_list.h"
+#include "map.h"
+#include "sha256.h"
+#include "utils.h"
+#include "utils_file.h"
+#include "utils_verify.h"
+
+#define BLOB_CACHE_DIR "blob-cache"
+#define BLOB_CACHE_DIR_MODE 0700
+// cached blobs are never modified in place
+#define BLOB_CACHE_FILE_MODE 0440
+#define BLOB_FILE_MODE 0640
+#define BLOB_CACHE_DIGEST_PREFIX "sha256:"
+#define BLOB_CACHE_TMP_SUFFIX ".tmp"
+
+typedef struct {
+    char *digest;
+    int64_t size;
+    struct timespec mtime;
+    // content is checked on the first get after it is put or found at startup
+    bool verified;
+    struct linked_list node;
+} blob_cache_entry;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    char *dir;
+    int64_t max_size;
+    int64_t total_size;
+    uint64_t tmp_seq;
+    map_t *entries;
+    // least recently used first
+    struct linked_list lru;
+} blob_cache_t;
+
+static blob_cache_t *g_blob_cache;
+
+static void free_blob_cache_entry(blob_cache_entry *entry)
+{
+    if (entry == NULL) {
+        return;
+    }
+    free(entry->digest);
+    entry->digest = NULL;
+    free(entry);
+}
+
+static void blob_cache_kvfree(void *key, void *value)
+{
+    free(key);
+    free_blob_cache_entry((blob_cache_entry *)value);
+}
+
+static char *blob_path(const char *digest)
+{
+    if (digest == NULL || !util_valid_digest(digest)) {
+        return NULL;
+    }
+
+    return util_path_join(g_blob_cache->dir, digest + strlen(BLOB_CACHE_DIGEST_PREFIX));
+}
+
+static int add_entry(const char *digest, int64_t size, const struct timespec *mtime)
+{
+    blob_cache_entry *entry = NULL;
+
+    entry = util_common_calloc_s(sizeof(blob_cache_entry));
+    if (entry == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+    entry->digest = util_strdup_s(digest);
+    entry->size = size;
+    entry->mtime = *mtime;
+    linked_list_add_elem(&entry->node, entry);
+
+    if (!map_insert(g_blob_cache->entries, (void *)digest, entry)) {
+        ERROR("Failed to insert blob %s to cache", digest);
+        free_blob_cache_entry(entry);
+        return -1;
+    }
+    linked_list_add_tail(&g_blob_cache->lru, &entry->node);
+    g_blob_cache->total_size += size;
+
+    return 0;
+}
+
+static void remove_entry(blob_cache_entry *entry)
+{
+    char *path = NULL;
+    char *digest = NULL;
+
+    path = blob_path(entry->digest);
+    if (path != NULL && unlink(path) != 0 && errno != ENOENT) {
+        WARN("Failed to remove cached blob %s: %s", path, strerror(errno));
+    }
+    free(path);
+
+    linked_list_del(&entry->node);
+    g_blob_cache->total_size -= entry->size;
+    // entry is freed by map, including its digest
+    digest = util_strdup_s(entry->digest);
+    (void)map_remove(g_blob_cache->entries, digest);
+    free(digest);
+}
+
+static void touch_entry(blob_cache_entry *entry, const char *path)
+{
+    linked_list_del(&entry->node);
+    linked_list_add_tail(&g_blob_cache->lru, &entry->node);
+    // mtime keeps the lru order across restarts
+    if (utimensat(AT_FDCWD, path, NULL, 0) != 0) {
+        DEBUG("Failed to update time of %s: %s", path, strerror(errno));
+    }
+}
+
+static void evict_entries(int64_t need)
+{
+    blob_cache_entry *entry = NULL;
+
+    while (g_blob_cache->total_size + need > g_blob_cache->max_size && !linked_list_empty(&g_blob_cache->lru)) {
+        entry = (blob_cache_entry *)linked_list_first_elem(&g_blob_cache->lru);
+        DEBUG("Evict blob %s from cache", entry->digest);
+        remove_entry(entry);
+    }
+}
+
+static bool is_tmp_blob(const char *name)
+{
+    size_t len = strlen(name);
+
+    return len > strlen(BLOB_CACHE_TMP_SUFFIX) &&
+           strcmp(name + len - strlen(BLOB_CACHE_TMP_SUFFIX), BLOB_CACHE_TMP_SUFFIX) == 0;
+}
+
+static int compare_entry_mtime(const void *a, const void *b)
+{
+    const blob_cache_entry *ea = *(const blob_cache_entry * const *)a;
+    const blob_cache_entry *eb = *(const blob_cache_entry * const *)b;
+
+    if (ea->mtime.tv_sec != eb->mtime.tv_sec) {
+        return ea->mtime.tv_sec < eb->mtime.tv_sec ? -1 : 1;
+    }
+    if (ea->mtime.tv_nsec != eb->mtime.tv_nsec) {
+        return ea->mtime.tv_nsec < eb->mtime.tv_nsec ? -1 : 1;
+    }
+    return 0;
+}
+
+static int append_scanned_entry(const char *name, blob_cache_entry ***scanned, size_t *len, size_t *cap)
+{
+    char *path = NULL;
+    char digest[PATH_MAX] = { 0 };
+    struct stat st = { 0 };
+    blob_cache_entry *entry = NULL;
+    blob_cache_entry **tmp = NULL;
+    int nret = 0;
+
+    nret = snprintf(digest, sizeof(digest), "%s%s", BLOB_CACHE_DIGEST_PREFIX, name);
+    if (nret < 0 || (size_t)nret >= sizeof(digest) || !util_valid_digest(digest)) {
+        return 0;
+    }
+
+    path = util_path_join(g_blob_cache->dir, name);
+    if (path == NULL || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        free(path);
+        return 0;
+    }
+    free(path);
+
+    if (*len == *cap) {
+        *cap = *cap == 0 ? 16 : *cap * 2;
+        tmp = util_smart_calloc_s(sizeof(blob_cache_entry *), *cap);
+        if (tmp == NULL) {
+            ERROR("Out of memory");
+            return -1;
+        }
+        if (*scanned != NULL) {
+            (void)memcpy(tmp, *scanned, sizeof(blob_cache_entry *) * (*len));
+        }
+        free(*scanned);
+        *scanned = tmp;
+    }
+
+    entry = util_common_calloc_s(sizeof(blob_cache_entry));
+    if (entry == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+    entry->digest = util_strdup_s(digest);
+    entry->size = (int64_t)st.st_size;
+    entry->mtime = st.st_mtim;
+    (*scanned)[(*len)++] = entry;
+
+    return 0;
+}
+
+static int scan_blob_cache_dir(void)
+{
+    DIR *dir = NULL;
+    struct dirent *dent = NULL;
+    blob_cache_entry **scanned = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    size_t i;
+    int ret = 0;
+
+    dir = opendir(g_blob_cache->dir);
+    if (dir == NULL) {
+        ERROR("Failed to open %s: %s", g_blob_cache->dir, strerror(errno));
+        return -1;
+    }
+
+    while ((dent = readdir(dir)) != NULL) {
+        if (strcmp(dent->d_name, ".") == 0 || strcmp(dent->d_name, "..") == 0) {
+            continue;
+        }
+        // left by an interrupted put
+        if (is_tmp_blob(dent->d_name)) {
+            (void)unlinkat(dirfd(dir), dent->d_name, 0);
+            continue;
+        }
+        if (append_scanned_entry(dent->d_name, &scanned, &len, &cap) != 0) {
+            ret = -1;
+            goto out;
+        }
+    }
+
+    qsort(scanned, len, sizeof(blob_cache_entry *), compare_entry_mtime);
+    for (i = 0; i < len; i++) {
+        if (add_entry(scanned[i]->digest, scanned[i]->size, &scanned[i]->mtime) != 0) {
+            ret = -1;
+            goto out;
+        }
+    }
+    evict_entries(0);
+
+out:
+    for (i = 0; i < len; i++) {
+        free_blob_cache_entry(scanned[i]);
+    }
+    free(scanned);
+    closedir(dir);
+    return ret;
+}
+
+int blob_cache_init(const char *root_dir, int64_t max_size)
+{
+    int ret = 0;
+
+    if (root_dir == NULL || max_size <= 0) {
+        INFO("Blob cache is disabled");
+        return 0;
+    }
+
+    g_blob_cache = util_common_calloc_s(sizeof(blob_cache_t));
+    if (g_blob_cache == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+
+    ret = pthread_mutex_init(&g_blob_cache->mutex, NULL);
+    if (ret != 0) {
+        ERROR("Failed to init blob cache mutex");
+        free(g_blob_cache);
+        g_blob_cache = NULL;
+        return -1;
+    }
+
+    g_blob_cache->max_size = max_size;
+    linked_list_init(&g_blob_cache->lru);
+    g_blob_cache->entries = map_new(MAP_STR_PTR, MAP_DEFAULT_CMP_FUNC, blob_cache_kvfree);
+    if (g_blob_cache->entries == NULL) {
+        ERROR("Out of memory");
+        ret = -1;
+        goto out;
+    }
+
+    g_blob_cache->dir = util_path_join(root_dir, BLOB_CACHE_DIR);
+    if (g_blob_cache->dir == NULL) {
+        ERROR("Failed to get blob cache dir");
+        ret = -1;
+        goto out;
+    }
+
+    if (util_mkdir_p(g_blob_cache->dir, BLOB_CACHE_DIR_MODE) != 0) {
+        ERROR("Failed to create blob cache dir %s", g_blob_cache->dir);
+        ret = -1;
+        goto out;
+    }
+
+    ret = scan_blob_cache_dir();
+    if (ret != 0) {
+        goto out;
+    }
+
+    INFO("Blob cache %s holds %zu blobs of %lld bytes, limit %lld bytes", g_blob_cache->dir,
+         map_size(g_blob_cache->entries), (long long)g_blob_cache->total_size, (long long)max_size);
+
+out:
+    if (ret != 0) {
+        blob_cache_exit();
+    }
+    return ret;
+}
+
+static int verify_blob(const char *digest, const char *file)
+{
+    char *real_digest = NULL;
+    int ret = 0;
+
+    real_digest = sha256_full_file_digest(file);
+    if (real_digest == NULL || strcmp(real_digest, digest) != 0) {
+        ERROR("File %s digest %s not match %s", file, real_digest, digest);
+        ret = -1;
+    }
+
+    free(real_digest);
+    return ret;
+}
+
+int blob_cache_get(const char *digest, const char *file)
+{
+    int ret = -1;
+    int nret = 0;
+    char *path = NULL;
+    struct stat st = { 0 };
+    blob_cache_entry *entry = NULL;
+
+    if (g_blob_cache == NULL || digest == NULL || file == NULL) {
+        return -1;
+    }
+
+    path = blob_path(digest);
+    if (path == NULL) {
+        return -1;
+    }
+
+    if (pthread_mutex_lock(&g_blob_cache->mutex) != 0) {
+        ERROR("Failed to lock blob cache");
+        free(path);
+        return -1;
+    }
+
+    entry = map_search(g_blob_cache->entries, (void *)digest);
+    if (entry == NULL) {
+        goto unlock;
+    }
+
+    if (stat(path, &st) != 0 || (int64_t)st.st_size != entry->size) {
+        WARN("Cached blob %s is damaged, drop it", digest);
+        remove_entry(entry);
+        goto unlock;
+    }
+
+    if (!entry->verified) {
+        // hash without the lock, the entry is searched again after it
+        (void)pthread_mutex_unlock(&g_blob_cache->mutex);
+        nret = verify_blob(digest, path);
+        if (pthread_mutex_lock(&g_blob_cache->mutex) != 0) {
+            ERROR("Failed to lock blob cache");
+            free(path);
+            return -1;
+        }
+        entry = map_search(g_blob_cache->entries, (void *)digest);
+        if (entry == NULL) {
+            goto unlock;
+        }
+        if (!entry->verified && nret != 0) {
+            WARN("Cached blob %s is damaged, drop it", digest);
+            remove_entry(entry);
+            goto unlock;
+        }
+        entry->verified = true;
+    }
+
+    if (unlink(file) != 0 && errno != ENOENT) {
+        ERROR("Failed to remove %s: %s", file, strerror(errno));
+        goto unlock;
+    }
+    // copy under the lock, so the blob can not be evicted while copying. Never link it,
+    // file is written by its caller and the cached blob must not change with it
+    if (util_copy_file(path, file, BLOB_FILE_MODE) != 0) {
+        ERROR("Failed to get cached blob %s to %s", digest, file);
+        goto unlock;
+    }
+
+    touch_entry(entry, path);
+    DEBUG("Get blob %s from cache", digest);
+    ret = 0;
+
+unlock:
+    (void)pthread_mutex_unlock(&g_blob_cache->mutex);
+    free(path);
+    return ret;
+}
+
+static bool blob_cached(const char *digest, const char *path)
+{
+    blob_cache_entry *entry = NULL;
+
+    entry = map_search(g_blob_cache->entries, (void *)digest);
+    if (entry != NULL) {
+        touch_entry(entry, path);
+    }
+
+    return entry != NULL;
+}
+
+int blob_cache_put(const char *digest, const char *file, bool verified)
+{
+    int ret = 0;
+    int nret = 0;
+    char *path = NULL;
+    char tmp_path[PATH_MAX] = { 0 };
+    struct stat st = { 0 };
+    bool cached = false;
+    uint64_t seq = 0;
+
+    if (g_blob_cache == NULL) {
+        return 0;
+    }
+
+    if (digest == NULL || file == NULL) {
+        return -1;
+    }
+
+    path = blob_path(digest);
+    if (path == NULL) {
+        ERROR("Invalid blob digest %s", digest);
+        return -1;
+    }
+
+    if (stat(file, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ERROR("Invalid blob file %s", file);
+        ret = -1;
+        goto out;
+    }
+
+    if ((int64_t)st.st_size > g_blob_cache->max_size) {
+        DEBUG("Blob %s is larger than the cache, not cached", digest);
+        goto out;
+    }
+
+    if (pthread_mutex_lock(&g_blob_cache->mutex) != 0) {
+        ERROR("Failed to lock blob cache");
+        ret = -1;
+        goto out;
+    }
+    cached = blob_cached(digest, path);
+    seq = g_blob_cache->tmp_seq++;
+    (void)pthread_mutex_unlock(&g_blob_cache->mutex);
+    if (cached) {
+        goto out;
+    }
+
+    if (!verified && verify_blob(digest, file) != 0) {
+        ret = -1;
+        goto out;
+    }
+
+    nret = snprintf(tmp_path, sizeof(tmp_path), "%s.%llu%s", path, (unsigned long long)seq, BLOB_CACHE_TMP_SUFFIX);
+    if (nret < 0 || (size_t)nret >= sizeof(tmp_path)) {
+        ERROR("Failed to print tmp path of %s", path);
+        ret = -1;
+        goto out;
+    }
+
+    if (util_copy_file(file, tmp_path, BLOB_CACHE_FILE_MODE) != 0) {
+        ERROR("Failed to add %s to blob cache", file);
+        (void)unlink(tmp_path);
+        ret = -1;
+        goto out;
+    }
+
+    if (pthread_mutex_lock(&g_blob_cache->mutex) != 0) {
+        ERROR("Failed to lock blob cache");
+        (void)unlink(tmp_path);
+        ret = -1;
+        goto out;
+    }
+
+    // put by another pull meanwhile
+    if (blob_cached(digest, path)) {
+        (void)unlink(tmp_path);
+        goto unlock;
+    }
+
+    evict_entries((int64_t)st.st_size);
+    if (rename(tmp_path, path) != 0) {
+        ERROR("Failed to rename %s to %s: %s", tmp_path, path, strerror(errno));
+        (void)unlink(tmp_path);
+        ret = -1;
+        goto unlock;
+    }
+    (void)utimensat(AT_FDCWD, path, NULL, 0);
+
+    ret = add_entry(digest, (int64_t)st.st_size, &st.st_mtim);
+    if (ret != 0) {
+        (void)unlink(path);
+        goto unlock;
+    }
+    DEBUG("Put blob %s to cache", digest);
+
+unlock:
+    (void)pthread_mutex_unlock(&g_blob_cache->mutex);
+out:
+    free(path);
+    return ret;
+}
+
+void blob_cache_exit(void)
+{
+    if (g_blob_cache == NULL) {
+        return;
+    }
+
+    map_free(g_blob_cache->entries);
+    g_blob_cache->entries = NULL;
+    free(g_blob_cache->dir);
+    g_blob_cache->dir = NULL;
+    (void)pthread_mutex_destroy(&g_blob_cache->mutex);
+    free(g_blob_cache);
+    g_blob_cache = NULL;
+}
@@ -0,0 +1,53 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-16
+ * Description: provide content addressable blob cache definition
+ ******************************************************************************/
+#ifndef DAEMON_MODULES_IMAGE_OCI_BLOB_CACHE_H
+#define DAEMON_MODULES_IMAGE_OCI_BLOB_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Compressed layers, configs and manifests are kept on disk by digest after a pull or load,
+ * so they need not be downloaded again once the image is removed. Total size is bounded by
+ * evicting the least recently used blobs, the last use time is kept as mtime of the blob.
+ */
+
+// default size of the cache in bytes, overridden by env ISULAD_BLOB_CACHE_SIZE, "0" disables it
+#ifndef BLOB_CACHE_SIZE
+#define BLOB_CACHE_SIZE (2LL * 1024 * 1024 * 1024)
+#endif
+#define BLOB_CACHE_SIZE_ENV "ISULAD_BLOB_CACHE_SIZE"
+
+// max_size 0 disables the cache, all other functions become no-op
+int blob_cache_init(const char *root_dir, int64_t max_size);
+
+// copy the blob of digest to file, returns -1 if it is not cached.
+// The digest of a blob is checked on its first get after it is put or found at startup
+int blob_cache_get(const char *digest, const char *file);
+
+// add a copy of file as the blob of digest, the digest of file is calculated if not verified by caller
+int blob_cache_put(const char *digest, const char *file, bool verified);
+
+void blob_cache_exit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DAEMON_MODULES_IMAGE_OCI_BLOB_CACHE_H
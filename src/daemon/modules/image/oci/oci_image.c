@@ -30,6 +30,8 @@
 #include "oci_load.h"
 #include "oci_import.h"
 #include "oci_export.h"
+#include "blob_cache.h"
+#include "pull_scheduler.h"
 #include "err_msg.h"
 #include "oci_common_operators.h"
 #include "utils_array.h"
@@ -311,6 +313,24 @@ out:
     return ret;
 }
 
+static int64_t get_blob_cache_size()
+{
+    const char *env = NULL;
+    int64_t size = 0;
+
+    env = getenv(BLOB_CACHE_SIZE_ENV);
+    if (env == NULL || strlen(env) == 0) {
+        return BLOB_CACHE_SIZE;
+    }
+
+    if (util_parse_byte_size_string(env, &size) != 0 || size < 0) {
+        WARN("Invalid %s %s, use default size of blob cache", BLOB_CACHE_SIZE_ENV, env);
+        return BLOB_CACHE_SIZE;
+    }
+
+    return size;
+}
+
 int oci_init(const isulad_daemon_configs *args)
 {
     int ret = 0;
@@ -337,6 +357,11 @@ int oci_init(const isulad_daemon_configs *args)
         goto out;
     }
 
+    if (blob_cache_init(g_oci_image_module_data.root_dir, get_blob_cache_size()) != 0) {
+        ret = -1;
+        goto out;
+    }
+
 #ifdef ENABLE_REMOTE_LAYER_STORE
     g_enable_remote = args->storage_enable_remote_layer;
 #endif
@@ -353,6 +378,7 @@ out:
 
 void oci_exit()
 {
+    blob_cache_exit();
     storage_module_exit();
     free_oci_image_data();
 }
@@ -390,6 +416,11 @@ int oci_pull_rf(const im_pull_request *request, im_pull_response *response)
     return ret;
 }
 
+void oci_get_pull_metrics(im_pull_metrics *metrics)
+{
+    pull_scheduler_get_metrics(metrics);
+}
+
 int oci_prepare_rf(const im_prepare_request *request, char **real_rootfs)
 {
     int ret = 0;
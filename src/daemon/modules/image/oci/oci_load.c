@@ -33,6 +33,7 @@
 #include "util_archive.h"
 #include "storage.h"
 #include "sha256.h"
+#include "blob_cache.h"
 #include "mediatype.h"
 #include "utils_images.h"
 #include "err_msg.h"
@@ -675,6 +676,11 @@ static int check_and_set_digest_from_tarball(load_layer_blob_t *layer, const cha
         goto out;
     }
 
+    // only compressed blobs can be shared with pulls, digest is calculated above
+    if (gzip) {
+        (void)blob_cache_put(layer->compressed_digest, layer->fpath, true);
+    }
+
 out:
     return ret;
 }
@@ -1089,6 +1095,7 @@ int oci_do_load(const im_load_request *request)
     }
 
     options.whiteout_format = NONE_WHITEOUT_FORMATE;
+    options.parallel_decompress = DEFAULT_PARALLEL_DECOMPRESS;
     if (archive_unpack(&reader, dstdir, &options, &err) != 0) {
         ERROR("Failed to unpack to %s: %s", dstdir, err);
         isulad_try_set_error_message("Failed to unpack to %s: %s", dstdir, err);
@@ -113,6 +113,8 @@ static int pull_image(const im_pull_request *request, char **name)
         options->auth.password = util_strdup_s(request->password);
     }
 
+    options->high_priority = request->high_priority;
+
     oci_image_data = get_oci_image_data();
     options->skip_tls_verify = oci_image_data->insecure_skip_verify_enforce;
     insecure_registries = oci_image_data->insecure_registries;
@@ -508,6 +508,8 @@ static int http_request_buf_options(pull_descriptor *desc, struct http_get_optio
     options->outputtype = HTTP_REQUEST_STRBUF;
     options->output = output_buffer;
     options->timeout = true;
+    // response headers are parsed by http_parser, which only knows http/1.x status lines
+    options->http2 = options->with_head == 0;
     ret = http_request(url, options, NULL, 0);
     if (ret) {
         ERROR("Failed to get http request: %s", options->errmsg);
@@ -701,8 +703,23 @@ static int xfer(void *p, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultota
     return 0;
 }
 
+static void setup_file_options(pull_descriptor *desc, struct http_get_options *options, char *file)
+{
+    // response headers are parsed by http_parser, which only knows http/1.x status lines
+    options->http2 = options->with_head == 0;
+    options->with_body = 1;
+    options->outputtype = HTTP_REQUEST_FILE;
+    options->output = file;
+    options->show_progress = 1;
+    options->progressinfo = &desc->cancel;
+    options->progress_info_op = progress;
+    options->xferinfo = &desc->cancel;
+    options->xferinfo_op = xfer;
+    options->timeout = true;
+}
+
 int http_request_file(pull_descriptor *desc, const char *url, const char **custom_headers, char *file,
-                      resp_data_type type, CURLcode *errcode)
+                      resp_data_type type, layer_stream *stream, CURLcode *errcode)
 {
     int ret = 0;
     struct http_get_options *options = NULL;
@@ -722,18 +739,14 @@ int http_request_file(pull_descriptor *desc, const char *url, const char **custo
     if (type == HEAD_BODY) {
         options->with_head = 1;
     }
-    options->with_body = 1;
     if (type == RESUME_BODY) {
         options->resume = true;
     }
-    options->outputtype = HTTP_REQUEST_FILE;
-    options->output = file;
-    options->show_progress = 1;
-    options->progressinfo = &desc->cancel;
-    options->progress_info_op = progress;
-    options->xferinfo = &desc->cancel;
-    options->xferinfo_op = xfer;
-    options->timeout = true;
+    setup_file_options(desc, options, file);
+    if (stream != NULL) {
+        options->write_hook = stream;
+        options->write_hook_op = layer_stream_write;
+    }
 
     ret = setup_common_options(desc, options, url, custom_headers);
     if (ret != 0) {
@@ -757,3 +770,45 @@ out:
 
     return ret;
 }
+
+int http_request_file_ranges(pull_descriptor *desc, const char *url, const char **custom_headers, char *file,
+                             size_t size, size_t parts_num, CURLcode *errcode)
+{
+    int ret = 0;
+    struct http_get_options *options = NULL;
+
+    if (desc == NULL || url == NULL || file == NULL || errcode == NULL) {
+        ERROR("Invalid NULL pointer");
+        return -1;
+    }
+
+    options = util_common_calloc_s(sizeof(struct http_get_options));
+    if (options == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+
+    setup_file_options(desc, options, file);
+
+    ret = setup_common_options(desc, options, url, custom_headers);
+    if (ret != 0) {
+        ERROR("Failed setup common options");
+        ret = -1;
+        goto out;
+    }
+
+    // caller falls back to a single request, so do not set the error message here
+    ret = http_request_ranges(url, options, size, parts_num);
+    if (ret != 0) {
+        WARN("Failed to get %s by %zu ranges: %s", url, parts_num, options->errmsg);
+        ret = -1;
+        goto out;
+    }
+
+out:
+    *errcode = options->errcode;
+    free_http_get_options(options);
+    options = NULL;
+
+    return ret;
+}
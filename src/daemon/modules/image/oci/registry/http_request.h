@@ -17,6 +17,7 @@
 
 #include <curl/curl.h>
 #include "registry_type.h"
+#include "layer_stream.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -31,8 +32,13 @@ typedef enum {
 
 int http_request_buf(pull_descriptor *desc, const char *url, const char **custom_headers, char **output,
                      resp_data_type type);
+// stream can be NULL, if not NULL, data written to file is also written to stream
 int http_request_file(pull_descriptor *desc, const char *url, const char **custom_headers, char *file,
-                      resp_data_type type, CURLcode *errcode);
+                      resp_data_type type, layer_stream *stream, CURLcode *errcode);
+// download the body of size bytes into file by parts_num parallel range requests,
+// errcode is CURLE_RANGE_ERROR if the server does not support range requests
+int http_request_file_ranges(pull_descriptor *desc, const char *url, const char **custom_headers, char *file,
+                             size_t size, size_t parts_num, CURLcode *errcode);
 
 #ifdef __cplusplus
 }
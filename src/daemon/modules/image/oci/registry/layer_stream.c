@@ -0,0 +1,425 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-07-15
+ * Description: provide digest and diffid calculation of layer data while downloading
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include "layer_stream.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <zlib.h>
+
+#include "isula_libutils/log.h"
+#include "sha256.h"
+#include "utils.h"
+#include "utils_file.h"
+
+#define LAYER_STREAM_RING_SIZE (4 * 1024 * 1024)
+#define LAYER_STREAM_INFLATE_SIZE (128 * 1024)
+
+struct layer_stream {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool calc_diffid;
+
+    // bytes in ring are [consumed, written), positions are taken modulo ring size
+    char *ring;
+    uint64_t written;
+    uint64_t consumed;
+    bool eof;
+    bool failed;
+    bool running;
+    pthread_t tid;
+
+    sha256_context *digest_ctx;
+    sha256_context *diffid_ctx;
+    z_stream zs;
+    bool zs_inited;
+    // first bytes are kept to check whether data is gzip compressed
+    unsigned char magic[2];
+    size_t magic_len;
+    bool gzip;
+    // a gzip member is ended, data after it is a new member or trailing garbage
+    bool member_end;
+    size_t members;
+    bool trailing;
+    unsigned char *inflate_buf;
+
+    bool complete;
+    char *digest;
+    char *diffid;
+};
+
+layer_stream *layer_stream_new(bool calc_diffid)
+{
+    layer_stream *stream = NULL;
+
+    stream = util_common_calloc_s(sizeof(layer_stream));
+    if (stream == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+
+    stream->ring = util_common_calloc_s(LAYER_STREAM_RING_SIZE);
+    if (stream->ring == NULL) {
+        ERROR("Out of memory");
+        free(stream);
+        return NULL;
+    }
+
+    if (calc_diffid) {
+        stream->inflate_buf = util_common_calloc_s(LAYER_STREAM_INFLATE_SIZE);
+        if (stream->inflate_buf == NULL) {
+            ERROR("Out of memory");
+            free(stream->ring);
+            free(stream);
+            return NULL;
+        }
+    }
+
+    (void)pthread_mutex_init(&stream->mutex, NULL);
+    (void)pthread_cond_init(&stream->cond, NULL);
+    stream->calc_diffid = calc_diffid;
+
+    return stream;
+}
+
+static int inflate_data(layer_stream *stream, const unsigned char *data, size_t len)
+{
+    int nret = 0;
+
+    stream->zs.next_in = (unsigned char *)data;
+    stream->zs.avail_in = (uInt)len;
+    while (stream->zs.avail_in > 0 && !stream->trailing) {
+        if (stream->member_end) {
+            (void)inflateReset(&stream->zs);
+            stream->member_end = false;
+        }
+
+        stream->zs.next_out = stream->inflate_buf;
+        stream->zs.avail_out = LAYER_STREAM_INFLATE_SIZE;
+        nret = inflate(&stream->zs, Z_NO_FLUSH);
+        if (nret == Z_BUF_ERROR) {
+            // need more input
+            break;
+        }
+        if (nret != Z_OK && nret != Z_STREAM_END) {
+            // same as gzread, ignore garbage after a complete gzip member
+            if (stream->members > 0 && nret == Z_DATA_ERROR) {
+                stream->trailing = true;
+                break;
+            }
+            ERROR("Inflate layer data failed: %d", nret);
+            return -1;
+        }
+        if (sha256_context_update(stream->diffid_ctx, stream->inflate_buf,
+                                  LAYER_STREAM_INFLATE_SIZE - stream->zs.avail_out) != 0) {
+            return -1;
+        }
+        if (nret == Z_STREAM_END) {
+            stream->member_end = true;
+            stream->members++;
+        }
+    }
+
+    return 0;
+}
+
+static int diffid_update(layer_stream *stream, const unsigned char *data, size_t len)
+{
+    size_t n = 0;
+
+    if (stream->magic_len < sizeof(stream->magic)) {
+        n = sizeof(stream->magic) - stream->magic_len;
+        n = n < len ? n : len;
+        (void)memcpy(stream->magic + stream->magic_len, data, n);
+        stream->magic_len += n;
+        data += n;
+        len -= n;
+        if (stream->magic_len < sizeof(stream->magic)) {
+            return 0;
+        }
+
+        stream->gzip = stream->magic[0] == 0x1f && stream->magic[1] == 0x8b;
+        if (stream->gzip) {
+            if (inflateInit2(&stream->zs, 16 + MAX_WBITS) != Z_OK) {
+                ERROR("Init inflate failed");
+                return -1;
+            }
+            stream->zs_inited = true;
+            if (inflate_data(stream, stream->magic, sizeof(stream->magic)) != 0) {
+                return -1;
+            }
+        } else if (sha256_context_update(stream->diffid_ctx, stream->magic, sizeof(stream->magic)) != 0) {
+            return -1;
+        }
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    if (stream->gzip) {
+        return inflate_data(stream, data, len);
+    }
+    return sha256_context_update(stream->diffid_ctx, data, len);
+}
+
+static int consume_data(layer_stream *stream, const unsigned char *data, size_t len)
+{
+    if (sha256_context_update(stream->digest_ctx, data, len) != 0) {
+        return -1;
+    }
+
+    if (stream->diffid_ctx != NULL) {
+        return diffid_update(stream, data, len);
+    }
+
+    return 0;
+}
+
+static void *layer_stream_worker(void *arg)
+{
+    layer_stream *stream = (layer_stream *)arg;
+    uint64_t pos = 0;
+    size_t n = 0;
+    int ret = 0;
+
+    prctl(PR_SET_NAME, "layer_stream");
+
+    for (;;) {
+        pthread_mutex_lock(&stream->mutex);
+        while (stream->written == stream->consumed && !stream->eof && !stream->failed) {
+            pthread_cond_wait(&stream->cond, &stream->mutex);
+        }
+        if (stream->failed || stream->written == stream->consumed) {
+            pthread_mutex_unlock(&stream->mutex);
+            break;
+        }
+        pos = stream->consumed % LAYER_STREAM_RING_SIZE;
+        n = (size_t)(stream->written - stream->consumed);
+        if (n > LAYER_STREAM_RING_SIZE - pos) {
+            n = LAYER_STREAM_RING_SIZE - pos;
+        }
+        pthread_mutex_unlock(&stream->mutex);
+
+        // the writer never touches data not consumed, no need to hold the lock
+        ret = consume_data(stream, (const unsigned char *)stream->ring + pos, n);
+
+        pthread_mutex_lock(&stream->mutex);
+        stream->consumed += n;
+        if (ret != 0) {
+            stream->failed = true;
+        }
+        pthread_cond_broadcast(&stream->cond);
+        pthread_mutex_unlock(&stream->mutex);
+    }
+
+    return NULL;
+}
+
+static void reset_stream(layer_stream *stream)
+{
+    sha256_context_free(stream->digest_ctx);
+    stream->digest_ctx = NULL;
+    sha256_context_free(stream->diffid_ctx);
+    stream->diffid_ctx = NULL;
+    if (stream->zs_inited) {
+        (void)inflateEnd(&stream->zs);
+        stream->zs_inited = false;
+    }
+    (void)memset(&stream->zs, 0, sizeof(stream->zs));
+    stream->magic_len = 0;
+    stream->gzip = false;
+    stream->member_end = false;
+    stream->members = 0;
+    stream->trailing = false;
+    stream->written = 0;
+    stream->consumed = 0;
+    stream->eof = false;
+    stream->failed = false;
+    stream->complete = false;
+    free(stream->digest);
+    stream->digest = NULL;
+    free(stream->diffid);
+    stream->diffid = NULL;
+}
+
+int layer_stream_start(layer_stream *stream)
+{
+    if (stream == NULL) {
+        ERROR("Invalid NULL param");
+        return -1;
+    }
+
+    if (stream->running) {
+        (void)layer_stream_finish(stream);
+    }
+    reset_stream(stream);
+
+    stream->digest_ctx = sha256_context_new();
+    if (stream->digest_ctx == NULL) {
+        goto err_out;
+    }
+    if (stream->calc_diffid) {
+        stream->diffid_ctx = sha256_context_new();
+        if (stream->diffid_ctx == NULL) {
+            goto err_out;
+        }
+    }
+
+    if (pthread_create(&stream->tid, NULL, layer_stream_worker, stream) != 0) {
+        ERROR("Failed to start layer stream thread");
+        goto err_out;
+    }
+    stream->running = true;
+
+    return 0;
+
+err_out:
+    reset_stream(stream);
+    return -1;
+}
+
+int layer_stream_write(void *data_stream, const void *data, size_t len)
+{
+    layer_stream *stream = (layer_stream *)data_stream;
+    const char *src = (const char *)data;
+    uint64_t pos = 0;
+    size_t n = 0;
+
+    if (stream == NULL || !stream->running) {
+        return -1;
+    }
+
+    while (len > 0) {
+        pthread_mutex_lock(&stream->mutex);
+        while (!stream->failed && stream->written - stream->consumed == LAYER_STREAM_RING_SIZE) {
+            pthread_cond_wait(&stream->cond, &stream->mutex);
+        }
+        if (stream->failed) {
+            pthread_mutex_unlock(&stream->mutex);
+            return -1;
+        }
+        pos = stream->written % LAYER_STREAM_RING_SIZE;
+        n = LAYER_STREAM_RING_SIZE - (size_t)(stream->written - stream->consumed);
+        if (n > LAYER_STREAM_RING_SIZE - pos) {
+            n = LAYER_STREAM_RING_SIZE - pos;
+        }
+        if (n > len) {
+            n = len;
+        }
+        pthread_mutex_unlock(&stream->mutex);
+
+        (void)memcpy(stream->ring + pos, src, n);
+
+        pthread_mutex_lock(&stream->mutex);
+        stream->written += n;
+        pthread_cond_broadcast(&stream->cond);
+        pthread_mutex_unlock(&stream->mutex);
+
+        src += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+int layer_stream_finish(layer_stream *stream)
+{
+    if (stream == NULL || !stream->running) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&stream->mutex);
+    stream->eof = true;
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->mutex);
+
+    (void)pthread_join(stream->tid, NULL);
+    stream->running = false;
+
+    if (stream->failed) {
+        return -1;
+    }
+
+    stream->digest = sha256_context_full_digest(stream->digest_ctx);
+    if (stream->digest == NULL) {
+        return -1;
+    }
+
+    if (stream->diffid_ctx != NULL) {
+        // too short to check, let it be checked when reading the file
+        if (stream->magic_len < sizeof(stream->magic)) {
+            stream->complete = true;
+            return 0;
+        }
+        // truncated gzip data
+        if (stream->gzip && !stream->member_end && !stream->trailing) {
+            stream->complete = true;
+            return 0;
+        }
+        stream->diffid = sha256_context_full_digest(stream->diffid_ctx);
+    }
+
+    stream->complete = true;
+    return 0;
+}
+
+bool layer_stream_complete(const layer_stream *stream, const char *file)
+{
+    int64_t size = 0;
+
+    if (stream == NULL || !stream->complete || file == NULL) {
+        return false;
+    }
+
+    // data may be written to file not through the stream, such as resumed download
+    size = util_file_size(file);
+    return size >= 0 && (uint64_t)size == stream->written;
+}
+
+const char *layer_stream_digest(const layer_stream *stream)
+{
+    return stream != NULL ? stream->digest : NULL;
+}
+
+const char *layer_stream_diffid(const layer_stream *stream)
+{
+    return stream != NULL ? stream->diffid : NULL;
+}
+
+void layer_stream_free(layer_stream *stream)
+{
+    if (stream == NULL) {
+        return;
+    }
+
+    if (stream->running) {
+        pthread_mutex_lock(&stream->mutex);
+        stream->failed = true;
+        pthread_cond_broadcast(&stream->cond);
+        pthread_mutex_unlock(&stream->mutex);
+        (void)pthread_join(stream->tid, NULL);
+        stream->running = false;
+    }
+    reset_stream(stream);
+    (void)pthread_mutex_destroy(&stream->mutex);
+    (void)pthread_cond_destroy(&stream->cond);
+    free(stream->inflate_buf);
+    free(stream->ring);
+    free(stream);
+}
@@ -0,0 +1,58 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-07-15
+ * Description: provide digest and diffid calculation of layer data while downloading
+ ******************************************************************************/
+#ifndef DAEMON_MODULES_IMAGE_OCI_REGISTRY_LAYER_STREAM_H
+#define DAEMON_MODULES_IMAGE_OCI_REGISTRY_LAYER_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Data written to a layer stream is copied into a ring buffer and consumed by a
+ * worker thread, which calculates the digest of the data and, if required, the
+ * digest of the uncompressed data (diffid). So the downloaded file need not to be
+ * read again to verify it.
+ */
+typedef struct layer_stream layer_stream;
+
+layer_stream *layer_stream_new(bool calc_diffid);
+
+// start a new round of calculation, results of last round are dropped
+int layer_stream_start(layer_stream *stream);
+
+// compatible with write_hook_func of http_get_options
+int layer_stream_write(void *stream, const void *data, size_t len);
+
+// wait all data written consumed and stop the worker thread
+int layer_stream_finish(layer_stream *stream);
+
+// true if the stream finished successfully and have seen all data of file
+bool layer_stream_complete(const layer_stream *stream, const char *file);
+
+const char *layer_stream_digest(const layer_stream *stream);
+
+// NULL if not calculated or data is not a complete gzip stream
+const char *layer_stream_diffid(const layer_stream *stream);
+
+void layer_stream_free(layer_stream *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,389 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-17
+ * Description: provide registry pull scheduler functions
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include "pull_scheduler.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/prctl.h>
+
+#include <isula_libutils/log.h>
+
+#include "err_msg.h"
+#include "linked_list.h"
+#include "map.h"
+#include "utils.h"
+#include "utils_timestamp.h"
+
+typedef struct pull_host {
+    size_t limit;
+    size_t running;
+    // jobs of the host, the host is removed with its last job
+    size_t jobs;
+} pull_host_t;
+
+struct pull_job {
+    char *host_name;
+    pull_host_t *host;
+    pull_priority_t priority;
+    size_t limit;
+    size_t running;
+    // value of the dispatch counter when the job last got a worker
+    uint64_t served;
+    bool released;
+    struct linked_list tasks;
+    struct linked_list node;
+};
+
+typedef struct pull_task {
+    pull_job_t *job;
+    pull_task_cb_t cb;
+    void *arg;
+    int64_t submit_time;
+    struct linked_list node;
+} pull_task_t;
+
+typedef struct pull_scheduler {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool inited;
+    // host name --> pull_host_t *
+    map_t *hosts;
+    struct linked_list jobs;
+    uint64_t dispatched;
+    im_pull_metrics metrics;
+} pull_scheduler_t;
+
+static pull_scheduler_t g_pull_scheduler = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void pull_scheduler_lock()
+{
+    if (pthread_mutex_lock(&g_pull_scheduler.mutex) != 0) {
+        ERROR("Failed to lock pull scheduler");
+    }
+}
+
+static void pull_scheduler_unlock()
+{
+    if (pthread_mutex_unlock(&g_pull_scheduler.mutex) != 0) {
+        ERROR("Failed to unlock pull scheduler");
+    }
+}
+
+static int64_t monotonic_now()
+{
+    struct timespec ts = { 0 };
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * Time_Second + ts.tv_nsec;
+}
+
+static void pull_hosts_kvfree(void *key, void *value)
+{
+    free(key);
+    free(value);
+}
+
+static bool job_before(const pull_job_t *a, const pull_job_t *b)
+{
+    if (a->priority != b->priority) {
+        return a->priority > b->priority;
+    }
+    if (a->running != b->running) {
+        return a->running < b->running;
+    }
+    return a->served < b->served;
+}
+
+static pull_job_t *pick_job_locked()
+{
+    struct linked_list *it = NULL;
+    pull_job_t *best = NULL;
+
+    linked_list_for_each(it, &g_pull_scheduler.jobs) {
+        pull_job_t *job = (pull_job_t *)it->elem;
+
+        if (linked_list_empty(&job->tasks)) {
+            continue;
+        }
+        if (job->limit > 0 && job->running >= job->limit) {
+            continue;
+        }
+        if (job->host->limit > 0 && job->host->running >= job->host->limit) {
+            continue;
+        }
+        if (best == NULL || job_before(job, best)) {
+            best = job;
+        }
+    }
+
+    return best;
+}
+
+static void job_free_locked(pull_job_t *job)
+{
+    linked_list_del(&job->node);
+    g_pull_scheduler.metrics.pulls--;
+
+    job->host->jobs--;
+    if (job->host->jobs == 0 && !map_remove(g_pull_scheduler.hosts, job->host_name)) {
+        WARN("Failed to remove pull host %s", job->host_name);
+    }
+
+    free(job->host_name);
+    free(job);
+}
+
+static void update_task_metrics_locked(int64_t queue_delay, int64_t fetch_time, int ret)
+{
+    im_pull_metrics *metrics = &g_pull_scheduler.metrics;
+
+    metrics->tasks_total++;
+    if (ret != 0) {
+        metrics->tasks_failed++;
+    }
+    metrics->queue_delay_total += queue_delay;
+    if (queue_delay > metrics->queue_delay_max) {
+        metrics->queue_delay_max = queue_delay;
+    }
+    metrics->fetch_time_total += fetch_time;
+    if (fetch_time > metrics->fetch_time_max) {
+        metrics->fetch_time_max = fetch_time;
+    }
+}
+
+static void run_task(pull_task_t *task)
+{
+    pull_job_t *job = task->job;
+    int64_t start = 0;
+    int64_t end = 0;
+    int ret = 0;
+
+    start = monotonic_now();
+    ret = task->cb(task->arg);
+    end = monotonic_now();
+
+    pull_scheduler_lock();
+    g_pull_scheduler.metrics.running--;
+    update_task_metrics_locked(start - task->submit_time, end - start, ret);
+    job->running--;
+    job->host->running--;
+    if (job->released && job->running == 0 && linked_list_empty(&job->tasks)) {
+        job_free_locked(job);
+    }
+    pull_scheduler_unlock();
+
+    free(task);
+}
+
+static void *pull_worker_routine(void *arg)
+{
+    int ret;
+
+    ret = pthread_detach(pthread_self());
+    if (ret != 0) {
+        CRIT("Set thread detach fail");
+        return NULL;
+    }
+
+    prctl(PR_SET_NAME, "pull_worker");
+
+    for (;;) {
+        pull_job_t *job = NULL;
+        pull_task_t *task = NULL;
+
+        pull_scheduler_lock();
+        while ((job = pick_job_locked()) == NULL) {
+            pthread_cond_wait(&g_pull_scheduler.cond, &g_pull_scheduler.mutex);
+        }
+        task = (pull_task_t *)linked_list_first_elem(&job->tasks);
+        linked_list_del(&task->node);
+        job->running++;
+        job->host->running++;
+        job->served = ++g_pull_scheduler.dispatched;
+        g_pull_scheduler.metrics.queued--;
+        g_pull_scheduler.metrics.running++;
+        pull_scheduler_unlock();
+
+        run_task(task);
+        DAEMON_CLEAR_ERRMSG();
+    }
+
+    return NULL;
+}
+
+pull_job_t *pull_scheduler_job_new(const char *host, size_t job_limit, size_t host_limit, pull_priority_t priority)
+{
+    const char *host_name = host != NULL ? host : "";
+    pull_job_t *job = NULL;
+    pull_host_t *phost = NULL;
+
+    job = util_common_calloc_s(sizeof(pull_job_t));
+    if (job == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+    job->host_name = util_strdup_s(host_name);
+    job->priority = priority;
+    job->limit = job_limit;
+    linked_list_init(&job->tasks);
+    linked_list_init(&job->node);
+    linked_list_add_elem(&job->node, job);
+
+    pull_scheduler_lock();
+    if (!g_pull_scheduler.inited) {
+        ERROR("Pull scheduler is not initialized");
+        goto err_out;
+    }
+
+    phost = map_search(g_pull_scheduler.hosts, (void *)host_name);
+    if (phost == NULL) {
+        phost = util_common_calloc_s(sizeof(pull_host_t));
+        if (phost == NULL) {
+            ERROR("Out of memory");
+            goto err_out;
+        }
+        if (!map_insert(g_pull_scheduler.hosts, (void *)host_name, phost)) {
+            ERROR("Failed to add pull host %s", host_name);
+            free(phost);
+            goto err_out;
+        }
+    }
+    // the latest configured limit wins, running tasks above a lowered limit just finish
+    phost->limit = host_limit;
+    phost->jobs++;
+    job->host = phost;
+
+    linked_list_add_tail(&g_pull_scheduler.jobs, &job->node);
+    g_pull_scheduler.metrics.pulls++;
+    pull_scheduler_unlock();
+
+    return job;
+
+err_out:
+    pull_scheduler_unlock();
+    free(job->host_name);
+    free(job);
+    return NULL;
+}
+
+int pull_scheduler_submit(pull_job_t *job, pull_task_cb_t cb, void *arg)
+{
+    pull_task_t *task = NULL;
+
+    if (job == NULL || cb == NULL) {
+        ERROR("Invalid input arguments");
+        return -1;
+    }
+
+    task = util_common_calloc_s(sizeof(pull_task_t));
+    if (task == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+    task->job = job;
+    task->cb = cb;
+    task->arg = arg;
+    task->submit_time = monotonic_now();
+    linked_list_init(&task->node);
+    linked_list_add_elem(&task->node, task);
+
+    pull_scheduler_lock();
+    linked_list_add_tail(&job->tasks, &task->node);
+    g_pull_scheduler.metrics.queued++;
+    pthread_cond_signal(&g_pull_scheduler.cond);
+    pull_scheduler_unlock();
+
+    return 0;
+}
+
+void pull_scheduler_job_release(pull_job_t *job)
+{
+    if (job == NULL) {
+        return;
+    }
+
+    pull_scheduler_lock();
+    job->released = true;
+    if (job->running == 0 && linked_list_empty(&job->tasks)) {
+        job_free_locked(job);
+    }
+    pull_scheduler_unlock();
+}
+
+void pull_scheduler_get_metrics(im_pull_metrics *metrics)
+{
+    if (metrics == NULL) {
+        return;
+    }
+
+    pull_scheduler_lock();
+    *metrics = g_pull_scheduler.metrics;
+    pull_scheduler_unlock();
+}
+
+int pull_scheduler_init(size_t workers)
+{
+    int ret = 0;
+    size_t i;
+
+    pull_scheduler_lock();
+    if (g_pull_scheduler.inited) {
+        goto out;
+    }
+
+    if (workers == 0) {
+        workers = PULL_SCHEDULER_DEFAULT_WORKERS;
+    }
+    if (workers > PULL_SCHEDULER_MAX_WORKERS) {
+        workers = PULL_SCHEDULER_MAX_WORKERS;
+    }
+
+    g_pull_scheduler.hosts = map_new(MAP_STR_PTR, MAP_DEFAULT_CMP_FUNC, pull_hosts_kvfree);
+    if (g_pull_scheduler.hosts == NULL) {
+        ERROR("Out of memory");
+        ret = -1;
+        goto out;
+    }
+    linked_list_init(&g_pull_scheduler.jobs);
+
+    for (i = 0; i < workers; i++) {
+        pthread_t a_thread;
+
+        if (pthread_create(&a_thread, NULL, pull_worker_routine, NULL) != 0) {
+            CRIT("Thread creation failed");
+            break;
+        }
+    }
+
+    if (i == 0) {
+        map_free(g_pull_scheduler.hosts);
+        g_pull_scheduler.hosts = NULL;
+        ret = -1;
+        goto out;
+    }
+    g_pull_scheduler.metrics.workers = i;
+    g_pull_scheduler.inited = true;
+
+out:
+    pull_scheduler_unlock();
+    return ret;
+}
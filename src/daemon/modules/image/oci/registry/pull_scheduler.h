@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-17
+ * Description: provide registry pull scheduler definition
+ ******************************************************************************/
+#ifndef DAEMON_MODULES_IMAGE_OCI_REGISTRY_PULL_SCHEDULER_H
+#define DAEMON_MODULES_IMAGE_OCI_REGISTRY_PULL_SCHEDULER_H
+
+#include <stddef.h>
+
+#include "image_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// these are build options until daemon configs can carry them
+#ifndef PULL_SCHEDULER_DEFAULT_WORKERS
+#define PULL_SCHEDULER_DEFAULT_WORKERS 10
+#endif
+#define PULL_SCHEDULER_MAX_WORKERS 64
+
+typedef enum { PULL_PRIORITY_NORMAL = 0, PULL_PRIORITY_HIGH } pull_priority_t;
+
+// run one task on a pull worker, the result is only counted in metrics
+typedef int (*pull_task_cb_t)(void *arg);
+
+/*
+ * Blobs of all pulls are fetched by one daemon-wide pool of workers. Each pull is a job,
+ * jobs of a higher priority are served first, and jobs of the same priority get workers
+ * in turn, the job with the fewest running tasks first. A job never runs more tasks than
+ * its own limit at the same time, and jobs from the same registry host together never run
+ * more than the limit of the host.
+ */
+typedef struct pull_job pull_job_t;
+
+// calling it again is a no-op
+int pull_scheduler_init(size_t workers);
+
+// a limit of 0 means no limit other than the number of workers
+pull_job_t *pull_scheduler_job_new(const char *host, size_t job_limit, size_t host_limit, pull_priority_t priority);
+
+// tasks of one job are started in the order they are submitted
+int pull_scheduler_submit(pull_job_t *job, pull_task_cb_t cb, void *arg);
+
+// the job is freed once its queued and running tasks have ended
+void pull_scheduler_job_release(pull_job_t *job);
+
+void pull_scheduler_get_metrics(im_pull_metrics *metrics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DAEMON_MODULES_IMAGE_OCI_REGISTRY_PULL_SCHEDULER_H
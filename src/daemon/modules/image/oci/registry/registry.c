@@ -56,9 +56,17 @@
 #include "utils_timestamp.h"
 #include "utils_verify.h"
 #include "oci_image.h"
+#include "pull_scheduler.h"
 
 #define MANIFEST_BIG_DATA_KEY "manifest"
+// limit of blobs downloaded by one pull at the same time
+#ifndef MAX_CONCURRENT_DOWNLOAD_NUM
 #define MAX_CONCURRENT_DOWNLOAD_NUM 5
+#endif
+// limit of blobs downloaded from one registry host by all pulls at the same time
+#ifndef MAX_CONCURRENT_HOST_DOWNLOAD_NUM
+#define MAX_CONCURRENT_HOST_DOWNLOAD_NUM 8
+#endif
 #define DEFAULT_WAIT_TIMEOUT 15
 #ifdef ENABLE_IMAGE_SEARCH
 #define INDEX_PREFIX "index."
@@ -91,8 +99,6 @@ typedef struct {
 typedef struct {
     pthread_mutex_t mutex;
     bool mutex_inited;
-    pthread_cond_t cond;
-    bool cond_inited;
     map_t *cached_layers;
     pthread_mutex_t image_mutex;
     bool image_mutex_inited;
@@ -1166,6 +1172,15 @@ static void register_layer_notify(pull_descriptor *desc)
     mutex_unlock(&desc->mutex);
 }
 
+// desc->mutex must be held
+static void set_pull_failed_locked(pull_descriptor *desc)
+{
+    desc->cancel = true;
+    if (desc->errmsg == NULL && g_isulad_errmsg != NULL) {
+        desc->errmsg = util_strdup_s(g_isulad_errmsg);
+    }
+}
+
 static void notify_cached_descs(char *blob_digest)
 {
     cached_layer *cache = NULL;
@@ -1179,31 +1194,47 @@ static void notify_cached_descs(char *blob_digest)
         return;
     }
 
-    // notify all related register threads to do register
+    // notify all related pulls to do register, the pull may end once its info is notified
     linked_list_for_each_safe(item, &cache->file_list, next) {
         info = ((file_elem *)item->elem)->info;
+        mutex_lock(&info->desc->mutex);
         info->notified = true;
-        register_layer_notify(info->desc);
+        if (pthread_cond_broadcast(&info->desc->cond)) {
+            ERROR("Failed to broadcast");
+        }
+        mutex_unlock(&info->desc->mutex);
+    }
+}
+
+// a layer queued by a failed pull need not be fetched, unless other pulls wait for it too
+static bool fetch_layer_needed(thread_fetch_info *info)
+{
+    cached_layer *cache = NULL;
+    bool needed = true;
+
+    if (!info->desc->cancel) {
+        return true;
+    }
+
+    mutex_lock(&g_shared->mutex);
+    cache = get_cached_layer(info->blob_digest);
+    if (cache == NULL || cache->file_list_len <= 1) {
+        needed = false;
     }
+    mutex_unlock(&g_shared->mutex);
+
+    return needed;
 }
 
-static void *fetch_layer_in_thread(void *arg)
+static int fetch_layer_task(void *arg)
 {
     thread_fetch_info *info = (thread_fetch_info *)arg;
     pull_descriptor *desc = info->desc;
     int ret = 0;
     char *diffid = NULL;
+    bool need_diffid = false;
 
-    ret = pthread_detach(pthread_self());
-    if (ret != 0) {
-        ERROR("Set thread detach fail");
-        goto out;
-    }
-
-    prctl(PR_SET_NAME, "fetch_layer");
-
-    if (fetch_layer(desc, info->index) != 0) {
-        ERROR("fetch layer %zu failed", info->index);
+    if (!fetch_layer_needed(info)) {
         ret = -1;
         goto out;
     }
@@ -1212,7 +1243,15 @@ static void *fetch_layer_in_thread(void *arg)
     // no diff id so we need to calc it. schema v2 have
     // diff id in config and we do not want to calc it again
     // as it cost too much time.
-    if (is_manifest_schemav1(desc->manifest.media_type)) {
+    need_diffid = is_manifest_schemav1(desc->manifest.media_type);
+    if (fetch_layer(desc, info->index, need_diffid ? &diffid : NULL) != 0) {
+        ERROR("fetch layer %zu failed", info->index);
+        ret = -1;
+        goto out;
+    }
+
+    // diffid is calculated while downloading normally, read the file if not
+    if (need_diffid && diffid == NULL) {
         diffid = oci_calc_diffid(info->file);
         if (diffid == NULL) {
             ERROR("calc diffid for layer %zu failed", info->index);
@@ -1222,71 +1261,47 @@ static void *fetch_layer_in_thread(void *arg)
     }
 
 out:
-    // notify to continue downloading
-    mutex_lock(&g_shared->mutex);
     if (ret != 0) {
-        desc->cancel = true;
-        if (desc->errmsg == NULL && g_isulad_errmsg != NULL) {
-            desc->errmsg = util_strdup_s(g_isulad_errmsg);
-        }
+        mutex_lock(&desc->mutex);
+        set_pull_failed_locked(desc);
+        mutex_unlock(&desc->mutex);
     }
     DAEMON_CLEAR_ERRMSG();
-    desc->pulling_number--;
+    mutex_lock(&g_shared->mutex);
     set_cached_layers_info(info->blob_digest, diffid, ret, info->file);
     notify_cached_descs(info->blob_digest);
-    // notify to continue pull
-    if (pthread_cond_broadcast(&g_shared->cond)) {
-        ERROR("Failed to broadcast");
-    }
     mutex_unlock(&g_shared->mutex);
 
     free(diffid);
     diffid = NULL;
 
-    return NULL;
+    return ret;
 }
 
-static int add_fetch_task(thread_fetch_info *info)
+static int add_fetch_task(pull_job_t *job, thread_fetch_info *info)
 {
     int ret = 0;
-    int cond_ret = 0;
-    pthread_t tid = 0;
-    bool cached_layers_added = true;
+    bool cached_layers_added = false;
     cached_layer *cache = NULL;
-    struct timespec ts = { 0 };
 
     mutex_lock(&g_shared->mutex);
     cache = get_cached_layer(info->blob_digest);
-    if (cache == NULL) {
-        // If there are too many download threads, wait until anyone completed.
-        while (info->desc->pulling_number >= MAX_CONCURRENT_DOWNLOAD_NUM) {
-            ts.tv_sec = time(NULL) + DEFAULT_WAIT_TIMEOUT; // avoid wait forever
-            cond_ret = pthread_cond_timedwait(&g_shared->cond, &g_shared->mutex, &ts);
-            if (cond_ret != 0 && cond_ret != ETIMEDOUT) {
-                ERROR("condition wait failed, ret %d", cond_ret);
-                ret = -1;
-                goto out;
-            }
-        }
-        // retry get cached layer after some time of unlock
-        cache = get_cached_layer(info->blob_digest);
-    }
 
     ret = add_cached_layer(info->blob_digest, info->file, info);
     if (ret != 0) {
-        ERROR("add fetch info failed, ret %d", cond_ret);
+        ERROR("add fetch info failed, ret %d", ret);
         ret = -1;
         goto out;
     }
     cached_layers_added = true;
 
+    // otherwise the layer is fetched or being fetched by another pull
     if (cache == NULL) {
-        ret = pthread_create(&tid, NULL, fetch_layer_in_thread, info);
+        ret = pull_scheduler_submit(job, fetch_layer_task, info);
         if (ret != 0) {
-            ERROR("failed to start thread fetch layer %zu", info->index);
+            ERROR("failed to add task to fetch layer %zu", info->index);
             goto out;
         }
-        info->desc->pulling_number++;
     }
 
 out:
@@ -1312,6 +1327,7 @@ static void free_thread_fetch_info(thread_fetch_info *info)
     return;
 }
 
+// desc->mutex must be held
 static bool all_fetch_complete(pull_descriptor *desc, thread_fetch_info *infos, int *result)
 {
     int i = 0;
@@ -1326,11 +1342,7 @@ static bool all_fetch_complete(pull_descriptor *desc, thread_fetch_info *infos,
         *result = desc->config.result;
     }
 
-    if (!desc->register_layers_complete) {
-        return false;
-    }
-
-    // wait all fetch threads completed
+    // wait all fetch tasks completed
     for (i = 0; i < desc->layers_len; i++) {
         if (infos[i].use && !infos[i].notified) {
             return false;
@@ -1344,44 +1356,30 @@ static bool all_fetch_complete(pull_descriptor *desc, thread_fetch_info *infos,
     return true;
 }
 
-static void *fetch_config_in_thread(void *arg)
+static int fetch_config_task(void *arg)
 {
     pull_descriptor *desc = (pull_descriptor *)arg;
     int ret = 0;
 
-    ret = pthread_detach(pthread_self());
-    if (ret != 0) {
-        ERROR("Set thread detach fail");
-        goto out;
-    }
-
-    prctl(PR_SET_NAME, "fetch_config");
-
     ret = fetch_and_parse_config(desc);
     if (ret != 0) {
         ERROR("fetch and parse config failed for image %s", desc->image_name);
         isulad_try_set_error_message("fetch and parse config failed");
-        goto out;
     }
 
-out:
-    mutex_lock(&g_shared->mutex);
+    mutex_lock(&desc->mutex);
     if (ret != 0) {
-        desc->cancel = true;
-        if (desc->errmsg == NULL && g_isulad_errmsg != NULL) {
-            desc->errmsg = util_strdup_s(g_isulad_errmsg);
-        }
+        set_pull_failed_locked(desc);
     }
-    DAEMON_CLEAR_ERRMSG();
     desc->config.complete = true;
     desc->config.result = ret;
-    register_layer_notify(desc);
-    if (pthread_cond_broadcast(&g_shared->cond)) {
+    if (pthread_cond_broadcast(&desc->cond)) {
         ERROR("Failed to broadcast");
     }
-    mutex_unlock(&g_shared->mutex);
+    mutex_unlock(&desc->mutex);
+    DAEMON_CLEAR_ERRMSG();
 
-    return NULL;
+    return ret;
 }
 
 static bool wait_fetch_complete(thread_fetch_info *info)
@@ -1403,30 +1401,22 @@ static bool wait_fetch_complete(thread_fetch_info *info)
     return true;
 }
 
-static void *register_layers_in_thread(void *arg)
+// register layers in order as soon as each of them is fetched
+static int register_layers(thread_fetch_info *infos)
 {
-    thread_fetch_info *infos = (thread_fetch_info *)arg;
     pull_descriptor *desc = infos[0].desc;
     int ret = 0;
     int cond_ret = 0;
     size_t i = 0;
     struct timespec ts = { 0 };
 
-    ret = pthread_detach(pthread_self());
-    if (ret != 0) {
-        ERROR("Set thread detach fail");
-        goto out;
-    }
-
-    prctl(PR_SET_NAME, "register_layer");
-
     for (i = 0; i < desc->layers_len; i++) {
         mutex_lock(&desc->mutex);
         while (wait_fetch_complete(&infos[i])) {
             ts.tv_sec = time(NULL) + DEFAULT_WAIT_TIMEOUT; // avoid wait forever
             cond_ret = pthread_cond_timedwait(&desc->cond, &desc->mutex, &ts);
             if (cond_ret != 0 && cond_ret != ETIMEDOUT) {
-                // here we can't just break and cleanup resources because threads are running.
+                // here we can't just break and cleanup resources because tasks are running.
                 // desc is freed if we break and then isulad crash. sleep some time
                 // instead to avoid cpu full running and then retry.
                 ERROR("condition wait for layer %zu to complete failed, ret %d, error: %s", i, cond_ret,
@@ -1458,27 +1448,17 @@ static void *register_layers_in_thread(void *arg)
     }
 
 out:
-    mutex_lock(&g_shared->mutex);
     if (ret != 0) {
-        desc->cancel = true;
-        if (desc->errmsg == NULL && g_isulad_errmsg != NULL) {
-            desc->errmsg = util_strdup_s(g_isulad_errmsg);
-        }
-    }
-    DAEMON_CLEAR_ERRMSG();
-    desc->register_layers_complete = true;
-    if (pthread_cond_broadcast(&g_shared->cond)) {
-        ERROR("Failed to broadcast");
+        mutex_lock(&desc->mutex);
+        set_pull_failed_locked(desc);
+        mutex_unlock(&desc->mutex);
     }
-    mutex_unlock(&g_shared->mutex);
 
-    return NULL;
+    return ret;
 }
 
-static int add_fetch_config_task(pull_descriptor *desc)
+static int add_fetch_config_task(pull_job_t *job, pull_descriptor *desc)
 {
-    pthread_t tid = 0;
-
     // manifest schema1 cann't pull config, the config is composited by
     // the history[0].v1Compatibility in manifest and rootfs's diffID
     if (is_manifest_schemav1(desc->manifest.media_type)) {
@@ -1487,14 +1467,21 @@ static int add_fetch_config_task(pull_descriptor *desc)
         return 0;
     }
 
-    if (pthread_create(&tid, NULL, fetch_config_in_thread, desc)) {
-        ERROR("failed to start thread to fetch config");
+    // submitted first so it is fetched before the layers of the pull
+    if (pull_scheduler_submit(job, fetch_config_task, desc) != 0) {
+        ERROR("failed to add task to fetch config");
         return -1;
     }
 
     return 0;
 }
 
+static pull_job_t *new_pull_job(pull_descriptor *desc)
+{
+    return pull_scheduler_job_new(desc->host, MAX_CONCURRENT_DOWNLOAD_NUM, MAX_CONCURRENT_HOST_DOWNLOAD_NUM,
+                                  desc->high_priority ? PULL_PRIORITY_HIGH : PULL_PRIORITY_NORMAL);
+}
+
 static int fetch_all(pull_descriptor *desc)
 {
     size_t i = 0;
@@ -1507,7 +1494,7 @@ static int fetch_all(pull_descriptor *desc)
     int result = 0;
     char *parent_chain_id = NULL;
     struct layer_list *list = NULL;
-    pthread_t tid = 0;
+    pull_job_t *job = NULL;
     struct timespec ts = { 0 };
 
     if (desc == NULL) {
@@ -1521,10 +1508,18 @@ static int fetch_all(pull_descriptor *desc)
         return -1;
     }
 
-    // fetch config in thread
-    ret = add_fetch_config_task(desc);
+    job = new_pull_job(desc);
+    if (job == NULL) {
+        ERROR("create pull job failed");
+        free(infos);
+        return -1;
+    }
+
+    // fetch config in pull worker
+    ret = add_fetch_config_task(job, desc);
     if (ret != 0) {
         ERROR("add fetch config task failed");
+        pull_scheduler_job_release(job);
         free(infos);
         return -1;
     }
@@ -1588,31 +1583,28 @@ static int fetch_all(pull_descriptor *desc)
         infos[i].file = util_strdup_s(file);
         infos[i].blob_digest = util_strdup_s(desc->layers[i].digest);
 
-        ret = add_fetch_task(&infos[i]);
+        ret = add_fetch_task(job, &infos[i]);
         if (ret != 0) {
             infos[i].use = false;
             break;
         }
     }
     if (ret != 0) {
-        desc->cancel = true;
-        desc->register_layers_complete = true;
+        mutex_lock(&desc->mutex);
+        set_pull_failed_locked(desc);
+        mutex_unlock(&desc->mutex);
     } else {
-        // create layers unpack thread
-        if (pthread_create(&tid, NULL, register_layers_in_thread, infos)) {
-            ERROR("failed to start thread to unpack layers");
-            ret = -1;
-            desc->register_layers_complete = true;
-        }
+        // register layers in this thread while the workers fetch them
+        ret = register_layers(infos);
     }
 
     // wait until all pulled or cancelled
-    mutex_lock(&g_shared->mutex);
+    mutex_lock(&desc->mutex);
     while (!all_fetch_complete(desc, infos, &result)) {
         ts.tv_sec = time(NULL) + DEFAULT_WAIT_TIMEOUT; // avoid wait forever
-        cond_ret = pthread_cond_timedwait(&g_shared->cond, &g_shared->mutex, &ts);
+        cond_ret = pthread_cond_timedwait(&desc->cond, &desc->mutex, &ts);
         if (cond_ret != 0 && cond_ret != ETIMEDOUT) {
-            // here we can't just break and cleanup resources because threads are running.
+            // here we can't just break and cleanup resources because tasks are running.
             // desc is freed if we break and then isulad crash. sleep some time
             // instead to avoid cpu full running and then retry.
             ERROR("condition wait for all layers to complete failed, ret %d, error: %s", cond_ret, strerror(errno));
@@ -1630,18 +1622,22 @@ static int fetch_all(pull_descriptor *desc)
         isulad_try_set_error_message(desc->errmsg);
     }
 
-    mutex_unlock(&g_shared->mutex);
+    mutex_unlock(&desc->mutex);
 
+    mutex_lock(&g_shared->mutex);
     for (i = 0; i < desc->layers_len; i++) {
         if (infos[i].use) {
-            mutex_lock(&g_shared->mutex);
             del_cached_layer(infos[i].blob_digest, infos[i].file);
-            mutex_unlock(&g_shared->mutex);
         }
+    }
+    mutex_unlock(&g_shared->mutex);
+
+    for (i = 0; i < desc->layers_len; i++) {
         free_thread_fetch_info(&infos[i]);
     }
     free(infos);
     infos = NULL;
+    pull_scheduler_job_release(job);
 
     return ret;
 }
@@ -1949,6 +1945,7 @@ static int prepare_pull_desc(pull_descriptor *desc, registry_pull_options *optio
     desc->use_decrypted_key = oci_image_data->use_decrypted_key;
     desc->skip_tls_verify = options->skip_tls_verify;
     desc->insecure_registry = options->insecure_registry;
+    desc->high_priority = options->high_priority;
     desc->cancel = false;
     desc->parent_chain_id = "";
     desc->rollback_layers_on_failure = true;
@@ -2127,13 +2124,6 @@ int registry_init(char *auths_dir, char *certs_dir)
     }
     g_shared->image_mutex_inited = true;
 
-    ret = pthread_cond_init(&g_shared->cond, NULL);
-    if (ret != 0) {
-        ERROR("Failed to init cond for download info");
-        goto out;
-    }
-    g_shared->cond_inited = true;
-
     g_shared->cached_layers = map_new(MAP_STR_PTR, MAP_DEFAULT_CMP_FUNC, cached_layers_kvfree);
     if (g_shared->cached_layers == NULL) {
         ERROR("out of memory");
@@ -2141,12 +2131,15 @@ int registry_init(char *auths_dir, char *certs_dir)
         goto out;
     }
 
+    ret = pull_scheduler_init(PULL_SCHEDULER_DEFAULT_WORKERS);
+    if (ret != 0) {
+        ERROR("Failed to init pull scheduler");
+        goto out;
+    }
+
 out:
 
     if (ret != 0) {
-        if (g_shared->cond_inited) {
-            pthread_cond_destroy(&g_shared->cond);
-        }
         if (g_shared->mutex_inited) {
             pthread_mutex_destroy(&g_shared->mutex);
         }
@@ -36,6 +36,7 @@ typedef struct {
     registry_auth auth;
     bool skip_tls_verify;
     bool insecure_registry;
+    bool high_priority;
 } registry_pull_options;
 
 typedef struct {
@@ -23,11 +23,14 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <strings.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include "registry_type.h"
 #include "isula_libutils/log.h"
 #include "http.h"
 #include "http_request.h"
+#include "layer_stream.h"
 #include "utils.h"
 #include "parser.h"
 #include "mediatype.h"
@@ -40,11 +43,18 @@
 #include "utils_file.h"
 #include "utils_string.h"
 #include "utils_verify.h"
+#include "blob_cache.h"
 
 #define DOCKER_API_VERSION_HEADER "Docker-Distribution-Api-Version: registry/2.0"
 #define MAX_ACCEPT_LEN 128
 // retry 5 times
 #define RETRY_TIMES 5
+// number of parallel range requests per blob, it is a build option until daemon configs can carry it
+#ifndef RANGE_CONCURRENCY
+#define RANGE_CONCURRENCY 4
+#endif
+// blobs are split into ranges no smaller than this
+#define MIN_RANGE_SIZE (16 * SIZE_MB)
 #define BODY_DELIMITER "\r\n\r\n"
 
 static void set_body_null_if_exist(char *message)
@@ -408,42 +418,46 @@ out:
     return ret;
 }
 
-static int registry_request(pull_descriptor *desc, char *path, char **custom_headers, char *file, char **output_buffer,
-                            resp_data_type type, CURLcode *errcode)
+static int prepare_registry_request(pull_descriptor *desc, const char *path, char **custom_headers, char *url,
+                                    size_t url_len, char ***headers)
 {
-    int ret = 0;
     int sret = 0;
-    char url[PATH_MAX] = { 0 };
-    char **headers = NULL;
 
-    if (desc == NULL || path == NULL || (file == NULL && output_buffer == NULL)) {
-        ERROR("Invalid NULL param");
+    if (registry_ping(desc) != 0) {
+        ERROR("ping failed");
         return -1;
     }
 
-    ret = registry_ping(desc);
-    if (ret != 0) {
-        ERROR("ping failed");
+    sret = snprintf(url, url_len, "%s://%s%s", desc->protocol, desc->host, path);
+    if (sret < 0 || (size_t)sret >= url_len) {
+        ERROR("Failed to sprintf url, path is %s", path);
         return -1;
     }
 
-    sret = snprintf(url, sizeof(url), "%s://%s%s", desc->protocol, desc->host, path);
-    if (sret < 0 || (size_t)sret >= sizeof(url)) {
-        ERROR("Failed to sprintf url, path is %s", path);
-        ret = -1;
-        goto out;
+    *headers = util_str_array_dup((const char **)custom_headers, util_array_len((const char **)custom_headers));
+
+    if (util_array_append(headers, DOCKER_API_VERSION_HEADER) != 0) {
+        ERROR("Append api version to header failed");
+        return -1;
     }
 
-    headers = util_str_array_dup((const char **)custom_headers, util_array_len((const char **)custom_headers));
-    if (ret != 0) {
-        ERROR("duplicate custom headers failed");
-        ret = -1;
-        goto out;
+    return 0;
+}
+
+static int registry_request(pull_descriptor *desc, char *path, char **custom_headers, char *file, char **output_buffer,
+                            resp_data_type type, layer_stream *stream, CURLcode *errcode)
+{
+    int ret = 0;
+    char url[PATH_MAX] = { 0 };
+    char **headers = NULL;
+
+    if (desc == NULL || path == NULL || (file == NULL && output_buffer == NULL)) {
+        ERROR("Invalid NULL param");
+        return -1;
     }
 
-    ret = util_array_append(&headers, DOCKER_API_VERSION_HEADER);
+    ret = prepare_registry_request(desc, path, custom_headers, url, sizeof(url), &headers);
     if (ret != 0) {
-        ERROR("Append api version to header failed");
         ret = -1;
         goto out;
     }
@@ -457,7 +471,7 @@ static int registry_request(pull_descriptor *desc, char *path, char **custom_hea
         }
         DEBUG("resp=%s", *output_buffer);
     } else {
-        ret = http_request_file(desc, url, (const char **)headers, file, type, errcode);
+        ret = http_request_file(desc, url, (const char **)headers, file, type, stream, errcode);
         if (ret != 0) {
             ERROR("http request file failed, url: %s", url);
             goto out;
@@ -471,6 +485,29 @@ out:
     return ret;
 }
 
+static int registry_request_ranges(pull_descriptor *desc, char *path, char **custom_headers, char *file, size_t size,
+                                   size_t parts_num, CURLcode *errcode)
+{
+    int ret = 0;
+    char url[PATH_MAX] = { 0 };
+    char **headers = NULL;
+
+    ret = prepare_registry_request(desc, path, custom_headers, url, sizeof(url), &headers);
+    if (ret != 0) {
+        ret = -1;
+        goto out;
+    }
+
+    DEBUG("sending url: %s by %zu ranges", url, parts_num);
+    ret = http_request_file_ranges(desc, url, (const char **)headers, file, size, parts_num, errcode);
+
+out:
+    util_free_array(headers);
+    headers = NULL;
+
+    return ret;
+}
+
 static int check_content_type(const char *content_type)
 {
     if (content_type == NULL) {
@@ -679,7 +716,7 @@ static int fetch_manifest_list(pull_descriptor *desc, char *file, char **content
 
     while (retry_times > 0) {
         retry_times--;
-        ret = registry_request(desc, path, custom_headers, file, NULL, HEAD_BODY, &errcode);
+        ret = registry_request(desc, path, custom_headers, file, NULL, HEAD_BODY, NULL, &errcode);
         if (ret != 0) {
             if (retry_times > 0 && !desc->cancel) {
                 continue;
@@ -730,7 +767,26 @@ static void try_log_resp_body(char *path, char *file)
     return;
 }
 
-static int fetch_data(pull_descriptor *desc, char *path, char *file, char *content_type, char *digest)
+static bool valid_fetched_digest(const char *file, const char *digest, const layer_stream *stream)
+{
+    const char *stream_digest = NULL;
+
+    // digest is calculated while downloading, no need to read the file again
+    if (layer_stream_complete(stream, file)) {
+        stream_digest = layer_stream_digest(stream);
+        if (stream_digest == NULL || strcmp(stream_digest, digest) != 0) {
+            ERROR("file %s digest %s not match %s", file, stream_digest, digest);
+            return false;
+        }
+        return true;
+    }
+
+    return sha256_valid_digest_file(file, digest);
+}
+
+// stream can be NULL, if not NULL, the data is also written to stream while downloading
+static int fetch_data(pull_descriptor *desc, char *path, char *file, char *content_type, char *digest,
+                      layer_stream *stream)
 {
     int ret = 0;
     int sret = 0;
@@ -739,6 +795,8 @@ static int fetch_data(pull_descriptor *desc, char *path, char *file, char *conte
     int retry_times = RETRY_TIMES;
     resp_data_type type = BODY_ONLY;
     bool forbid_resume = false;
+    bool use_stream = false;
+    bool verify_digest = false;
     CURLcode errcode = CURLE_OK;
 
     // digest can be NULL
@@ -747,6 +805,12 @@ static int fetch_data(pull_descriptor *desc, char *path, char *file, char *conte
         return -1;
     }
 
+    // If content is signatured, digest is for payload but not fetched data
+    verify_digest = strcmp(content_type, DOCKER_MANIFEST_SCHEMA1_PRETTYJWS) && digest != NULL;
+    if (verify_digest && blob_cache_get(digest, file) == 0) {
+        return 0;
+    }
+
     sret = snprintf(accept, MAX_ACCEPT_LEN, "Accept: %s", content_type);
     if (sret < 0 || (size_t)sret >= MAX_ACCEPT_LEN) {
         ERROR("Failed to sprintf accept media type %s", content_type);
@@ -762,7 +826,12 @@ static int fetch_data(pull_descriptor *desc, char *path, char *file, char *conte
 
     while (retry_times > 0) {
         retry_times--;
-        ret = registry_request(desc, path, custom_headers, file, NULL, type, &errcode);
+        // only the whole body fetched by one request can be streamed, resumed one is checked by reading file
+        use_stream = stream != NULL && type == BODY_ONLY && layer_stream_start(stream) == 0;
+        ret = registry_request(desc, path, custom_headers, file, NULL, type, use_stream ? stream : NULL, &errcode);
+        if (use_stream && layer_stream_finish(stream) != 0) {
+            WARN("Calculate digest of %s while downloading failed, check it by reading file", path);
+        }
         if (ret != 0) {
             if (errcode == CURLE_RANGE_ERROR) {
                 forbid_resume = true;
@@ -780,9 +849,8 @@ static int fetch_data(pull_descriptor *desc, char *path, char *file, char *conte
             goto out;
         }
 
-        // If content is signatured, digest is for payload but not fetched data
-        if (strcmp(content_type, DOCKER_MANIFEST_SCHEMA1_PRETTYJWS) && digest != NULL) {
-            if (!sha256_valid_digest_file(file, digest)) {
+        if (verify_digest) {
+            if (!valid_fetched_digest(file, digest, use_stream ? stream : NULL)) {
                 type = BODY_ONLY;
                 if (retry_times > 0 && !desc->cancel) {
                     continue;
@@ -798,6 +866,10 @@ static int fetch_data(pull_descriptor *desc, char *path, char *file, char *conte
         break;
     }
 
+    if (verify_digest) {
+        (void)blob_cache_put(digest, file, true);
+    }
+
 out:
     util_free_array(custom_headers);
     custom_headers = NULL;
@@ -1019,7 +1091,7 @@ static int fetch_manifest_data(pull_descriptor *desc, char *file, char **content
             goto out;
         }
 
-        ret = fetch_data(desc, path, file, *content_type, *digest);
+        ret = fetch_data(desc, path, file, *content_type, *digest, NULL);
         if (ret != 0) {
             ERROR("registry: Get %s failed", path);
             goto out;
@@ -1100,7 +1172,7 @@ int fetch_config(pull_descriptor *desc)
         goto out;
     }
 
-    ret = fetch_data(desc, path, file, desc->config.media_type, desc->config.digest);
+    ret = fetch_data(desc, path, file, desc->config.media_type, desc->config.digest, NULL);
     if (ret != 0) {
         ERROR("registry: Get %s failed", path);
         goto out;
@@ -1113,13 +1185,74 @@ out:
     return ret;
 }
 
-int fetch_layer(pull_descriptor *desc, size_t index)
+static size_t get_range_parts_num(size_t size)
+{
+    size_t parts_num = 0;
+
+    if (RANGE_CONCURRENCY <= 1) {
+        return 1;
+    }
+
+    parts_num = size / MIN_RANGE_SIZE;
+    if (parts_num > (size_t)RANGE_CONCURRENCY) {
+        parts_num = (size_t)RANGE_CONCURRENCY;
+    }
+
+    return parts_num;
+}
+
+// large blobs are downloaded by parallel range requests, returns -1 if not possible, then the caller
+// falls back to download the blob by one request
+static int fetch_layer_by_ranges(pull_descriptor *desc, char *path, char *file, const layer_blob *layer)
+{
+    int ret = 0;
+    int sret = 0;
+    char accept[MAX_ELEMENT_SIZE] = { 0 };
+    char **custom_headers = NULL;
+    size_t parts_num = 0;
+    CURLcode errcode = CURLE_OK;
+
+    parts_num = get_range_parts_num(layer->size);
+    if (parts_num <= 1 || layer->digest == NULL) {
+        return -1;
+    }
+
+    sret = snprintf(accept, MAX_ACCEPT_LEN, "Accept: %s", layer->media_type);
+    if (sret < 0 || (size_t)sret >= MAX_ACCEPT_LEN) {
+        ERROR("Failed to sprintf accept media type %s", layer->media_type);
+        return -1;
+    }
+
+    ret = util_array_append(&custom_headers, accept);
+    if (ret != 0) {
+        ERROR("append accepts failed");
+        goto out;
+    }
+
+    ret = registry_request_ranges(desc, path, custom_headers, file, layer->size, parts_num, &errcode);
+    if (ret != 0) {
+        goto out;
+    }
+
+    if (!sha256_valid_digest_file(file, layer->digest)) {
+        WARN("data from %s by ranges does not have digest %s", path, layer->digest);
+        ret = -1;
+        goto out;
+    }
+
+out:
+    util_free_array(custom_headers);
+    return ret;
+}
+
+int fetch_layer(pull_descriptor *desc, size_t index, char **diffid)
 {
     int ret = 0;
     int sret = 0;
     char file[PATH_MAX] = { 0 };
     char path[PATH_MAX] = { 0 };
     layer_blob *layer = NULL;
+    layer_stream *stream = NULL;
 
     if (desc == NULL) {
         ERROR("Invalid NULL pointer");
@@ -1145,13 +1278,34 @@ int fetch_layer(pull_descriptor *desc, size_t index)
         goto out;
     }
 
-    ret = fetch_data(desc, path, file, layer->media_type, layer->digest);
+    if (blob_cache_get(layer->digest, file) == 0) {
+        goto out;
+    }
+
+    if (fetch_layer_by_ranges(desc, path, file, layer) == 0) {
+        (void)blob_cache_put(layer->digest, file, true);
+        goto out;
+    }
+    if (desc->cancel) {
+        ERROR("registry: Get %s canceled", path);
+        ret = -1;
+        goto out;
+    }
+
+    // verify and calculate diffid while downloading, fallback to read the file if failed to create stream
+    stream = layer_stream_new(diffid != NULL);
+    ret = fetch_data(desc, path, file, layer->media_type, layer->digest, stream);
     if (ret != 0) {
         ERROR("registry: Get %s failed", path);
         goto out;
     }
 
+    if (diffid != NULL && layer_stream_complete(stream, file) && layer_stream_diffid(stream) != NULL) {
+        *diffid = util_strdup_s(layer_stream_diffid(stream));
+    }
+
 out:
+    layer_stream_free(stream);
 
     return ret;
 }
@@ -1211,7 +1365,7 @@ int login_to_registry(pull_descriptor *desc)
         goto out;
     }
 
-    ret = registry_request(desc, path, NULL, NULL, &resp_buffer, HEAD_BODY, &errcode);
+    ret = registry_request(desc, path, NULL, NULL, &resp_buffer, HEAD_BODY, NULL, &errcode);
     if (ret != 0) {
         ERROR("registry: Get %s failed, resp: %s", path, resp_buffer);
         isulad_try_set_error_message("login to registry for %s failed", desc->host);
@@ -27,7 +27,8 @@ int fetch_manifest(pull_descriptor *desc);
 
 int fetch_config(pull_descriptor *desc);
 
-int fetch_layer(pull_descriptor *desc, size_t index);
+// diffid can be NULL, if not NULL, it's calculated while downloading if possible
+int fetch_layer(pull_descriptor *desc, size_t index, char **diffid);
 
 int login_to_registry(pull_descriptor *desc);
 
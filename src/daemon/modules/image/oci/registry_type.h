@@ -96,7 +96,7 @@ typedef struct {
     char *key_file;
     char *certs_dir;
 
-    int pulling_number;
+    bool high_priority;
     bool cancel;
     char *errmsg;
 
@@ -120,7 +120,6 @@ typedef struct {
     size_t layers_len;
 
     bool rollback_layers_on_failure;
-    bool register_layers_complete;
     // used to calc chain id
     char *parent_chain_id;
     // used to register layer
@@ -0,0 +1,444 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-07-24
+ * Description: provide cached filesystem usage functions
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include "fs_usage.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+
+#include <isula_libutils/log.h>
+
+#include "map.h"
+#include "utils.h"
+#include "utils_array.h"
+#include "utils_file.h"
+#include "utils_timestamp.h"
+
+// minimal idle time between two directory walks of the refresher
+#define FS_USAGE_MIN_WALK_GAP (100 * Time_Milli)
+
+struct fs_usage_entry {
+    char *path;
+    fs_usage_info info;
+    int64_t last_query;
+    bool refreshing;
+};
+
+struct fs_usage_cache {
+    pthread_mutex_t mutex;
+    // directory path --> struct fs_usage_entry *
+    map_t *entries;
+};
+
+static struct fs_usage_cache g_fs_usage_cache;
+static pthread_once_t g_fs_usage_once = PTHREAD_ONCE_INIT;
+static bool g_fs_usage_ready = false;
+
+static void fs_usage_lock()
+{
+    if (pthread_mutex_lock(&(g_fs_usage_cache.mutex)) != 0) {
+        ERROR("Failed to lock fs usage cache");
+    }
+}
+
+static void fs_usage_unlock()
+{
+    if (pthread_mutex_unlock(&(g_fs_usage_cache.mutex)) != 0) {
+        ERROR("Failed to unlock fs usage cache");
+    }
+}
+
+static void fs_usage_entry_free(struct fs_usage_entry *entry)
+{
+    if (entry == NULL) {
+        return;
+    }
+
+    free(entry->path);
+    free(entry);
+}
+
+static void fs_usage_entry_kvfree(void *key, void *value)
+{
+    free(key);
+    fs_usage_entry_free((struct fs_usage_entry *)value);
+}
+
+/* the same as util_calculate_dir_size, but do not cross into filesystems mounted under the directory */
+static void walk_dir_one_fs(const char *dirpath, dev_t dev, int recursive_depth, fs_usage_info *info)
+{
+    int nret = 0;
+    struct dirent *pdirent = NULL;
+    DIR *directory = NULL;
+    struct stat fstat;
+    char fname[PATH_MAX];
+
+    if ((recursive_depth + 1) > MAX_PATH_DEPTH) {
+        ERROR("Reach max path depth: %s", dirpath);
+        return;
+    }
+
+    directory = opendir(dirpath);
+    if (directory == NULL) {
+        ERROR("Failed to open %s", dirpath);
+        return;
+    }
+    pdirent = readdir(directory);
+    for (; pdirent != NULL; pdirent = readdir(directory)) {
+        if (!strcmp(pdirent->d_name, ".") || !strcmp(pdirent->d_name, "..")) {
+            continue;
+        }
+
+        nret = snprintf(fname, PATH_MAX, "%s/%s", dirpath, pdirent->d_name);
+        if (nret < 0 || nret >= PATH_MAX) {
+            ERROR("Pathname too long");
+            continue;
+        }
+
+        if (lstat(fname, &fstat) != 0) {
+            ERROR("Failed to stat %s", fname);
+            continue;
+        }
+
+        // a mount point such as merged dir of a mounted layer is counted as the empty dir under it
+        if (fstat.st_dev != dev) {
+            info->inodes_used++;
+            continue;
+        }
+
+        info->used_bytes += fstat.st_size;
+        info->inodes_used++;
+        if (S_ISDIR(fstat.st_mode)) {
+            walk_dir_one_fs(fname, dev, recursive_depth + 1, info);
+        }
+    }
+
+    closedir(directory);
+}
+
+static void walk_dir_usage(const char *path, fs_usage_info *info)
+{
+    struct stat fstat;
+
+    info->used_bytes = 0;
+    info->inodes_used = 0;
+    info->timestamp = util_get_now_time_nanos();
+
+    if (stat(path, &fstat) != 0 || !S_ISDIR(fstat.st_mode)) {
+        ERROR("dir not exists: %s", path);
+        return;
+    }
+    info->used_bytes = fstat.st_size;
+    info->inodes_used = 1;
+    walk_dir_one_fs(path, fstat.st_dev, 0, info);
+}
+
+/* pick the stalest entry to refresh and drop the entries nobody asks for anymore */
+static char *pick_stale_path(int64_t now)
+{
+    map_itor *itor = NULL;
+    struct fs_usage_entry *stalest = NULL;
+    char **expired = NULL;
+    char *path = NULL;
+    size_t i;
+
+    fs_usage_lock();
+
+    itor = map_itor_new(g_fs_usage_cache.entries);
+    if (itor == NULL) {
+        ERROR("Out of memory");
+        goto unlock;
+    }
+
+    for (; map_itor_valid(itor); map_itor_next(itor)) {
+        struct fs_usage_entry *entry = map_itor_value(itor);
+
+        if (now - entry->last_query > FS_USAGE_EXPIRE_SECOND * Time_Second) {
+            if (util_array_append(&expired, entry->path) != 0) {
+                ERROR("Out of memory");
+                break;
+            }
+            continue;
+        }
+
+        if (entry->refreshing || now - entry->info.timestamp < FS_USAGE_REFRESH_INTERVAL_SECOND * Time_Second) {
+            continue;
+        }
+
+        if (stalest == NULL || entry->info.timestamp < stalest->info.timestamp) {
+            stalest = entry;
+        }
+    }
+    map_itor_free(itor);
+
+    for (i = 0; expired != NULL && expired[i] != NULL; i++) {
+        if (!map_remove(g_fs_usage_cache.entries, expired[i])) {
+            WARN("Failed to remove fs usage of %s", expired[i]);
+        }
+    }
+
+    if (stalest != NULL) {
+        stalest->refreshing = true;
+        path = util_strdup_s(stalest->path);
+    }
+
+unlock:
+    fs_usage_unlock();
+    util_free_array(expired);
+    return path;
+}
+
+static void update_entry(const char *path, const fs_usage_info *info, bool exist)
+{
+    struct fs_usage_entry *entry = NULL;
+
+    fs_usage_lock();
+
+    entry = map_search(g_fs_usage_cache.entries, (void *)path);
+    if (entry == NULL) {
+        // forgotten while walking
+        goto unlock;
+    }
+
+    if (!exist) {
+        if (!map_remove(g_fs_usage_cache.entries, (void *)path)) {
+            WARN("Failed to remove fs usage of %s", path);
+        }
+        goto unlock;
+    }
+
+    entry->info = *info;
+    entry->refreshing = false;
+
+unlock:
+    fs_usage_unlock();
+}
+
+static void *fs_usage_refresh_routine(void *arg)
+{
+    int ret;
+
+    ret = pthread_detach(pthread_self());
+    if (ret != 0) {
+        CRIT("Set thread detach fail");
+        return NULL;
+    }
+
+    prctl(PR_SET_NAME, "FsUsageRefresh");
+
+    for (;;) {
+        fs_usage_info info = { 0 };
+        int64_t start = 0;
+        int64_t cost = 0;
+        bool exist = false;
+        char *path = NULL;
+
+        start = util_get_now_time_nanos();
+        path = pick_stale_path(start);
+        if (path == NULL) {
+            util_usleep_nointerupt((unsigned long)(Time_Second / Time_Micro));
+            continue;
+        }
+
+        exist = util_dir_exists(path);
+        if (exist) {
+            walk_dir_usage(path, &info);
+        }
+        update_entry(path, &info, exist);
+        free(path);
+
+        // walks are one by one and the refresher idles at least as long as the last walk took,
+        // so it never keeps the disk busy more than half of the time
+        cost = util_get_now_time_nanos() - start;
+        if (cost < FS_USAGE_MIN_WALK_GAP) {
+            cost = FS_USAGE_MIN_WALK_GAP;
+        }
+        util_usleep_nointerupt((unsigned long)(cost / Time_Micro));
+    }
+
+    return NULL;
+}
+
+static void fs_usage_cache_init(void)
+{
+    pthread_t a_thread;
+
+    if (pthread_mutex_init(&(g_fs_usage_cache.mutex), NULL) != 0) {
+        CRIT("Mutex initialization failed");
+        return;
+    }
+
+    g_fs_usage_cache.entries = map_new(MAP_STR_PTR, MAP_DEFAULT_CMP_FUNC, fs_usage_entry_kvfree);
+    if (g_fs_usage_cache.entries == NULL) {
+        ERROR("Out of memory");
+        goto err_out;
+    }
+
+    if (pthread_create(&a_thread, NULL, fs_usage_refresh_routine, NULL) != 0) {
+        CRIT("Thread creation failed");
+        goto err_out;
+    }
+
+    g_fs_usage_ready = true;
+    return;
+
+err_out:
+    map_free(g_fs_usage_cache.entries);
+    g_fs_usage_cache.entries = NULL;
+    pthread_mutex_destroy(&(g_fs_usage_cache.mutex));
+}
+
+static int add_entry(const char *path, const fs_usage_info *info, int64_t now)
+{
+    struct fs_usage_entry *entry = NULL;
+
+    entry = util_common_calloc_s(sizeof(struct fs_usage_entry));
+    if (entry == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+    entry->path = util_strdup_s(path);
+    entry->info = *info;
+    entry->last_query = now;
+
+    fs_usage_lock();
+    // another caller may have walked the same path concurrently, keep the one inserted first
+    if (map_search(g_fs_usage_cache.entries, (void *)path) == NULL &&
+        !map_insert(g_fs_usage_cache.entries, (void *)path, entry)) {
+        fs_usage_unlock();
+        ERROR("Failed to add fs usage of %s", path);
+        fs_usage_entry_free(entry);
+        return -1;
+    }
+    fs_usage_unlock();
+
+    return 0;
+}
+
+int fs_usage_get(const char *path, fs_usage_info *usage)
+{
+    struct fs_usage_entry *entry = NULL;
+    int64_t now = 0;
+
+    if (path == NULL || usage == NULL) {
+        ERROR("Invalid input arguments");
+        return -1;
+    }
+
+    (void)pthread_once(&g_fs_usage_once, fs_usage_cache_init);
+    if (!g_fs_usage_ready) {
+        // no cache, fallback to walk the directory every time
+        walk_dir_usage(path, usage);
+        return 0;
+    }
+
+    now = util_get_now_time_nanos();
+
+    fs_usage_lock();
+    entry = map_search(g_fs_usage_cache.entries, (void *)path);
+    if (entry != NULL) {
+        entry->last_query = now;
+        *usage = entry->info;
+        fs_usage_unlock();
+        return 0;
+    }
+    fs_usage_unlock();
+
+    walk_dir_usage(path, usage);
+    if (add_entry(path, usage, now) != 0) {
+        WARN("Failed to cache fs usage of %s", path);
+    }
+
+    return 0;
+}
+
+void fs_usage_forget(const char *path)
+{
+    if (path == NULL || !g_fs_usage_ready) {
+        return;
+    }
+
+    fs_usage_lock();
+    if (map_search(g_fs_usage_cache.entries, (void *)path) != NULL &&
+        !map_remove(g_fs_usage_cache.entries, (void *)path)) {
+        WARN("Failed to remove fs usage of %s", path);
+    }
+    fs_usage_unlock();
+}
+
+int fs_usage_to_fs_info(const char *mountpoint, const fs_usage_info *usage, imagetool_fs_info *fs_info)
+{
+    int ret = 0;
+    imagetool_fs_info_image_filesystems_element *fs_usage_tmp = NULL;
+
+    if (mountpoint == NULL || usage == NULL || fs_info == NULL) {
+        ERROR("Invalid input arguments");
+        return -1;
+    }
+
+    fs_usage_tmp = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_element));
+    if (fs_usage_tmp == NULL) {
+        ERROR("Memory out");
+        ret = -1;
+        goto out;
+    }
+
+    // time of the measurement rather than of the query, so that callers can tell how stale it is
+    fs_usage_tmp->timestamp = usage->timestamp;
+
+    fs_usage_tmp->fs_id = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_fs_id));
+    if (fs_usage_tmp->fs_id == NULL) {
+        ERROR("Memory out");
+        ret = -1;
+        goto out;
+    }
+    fs_usage_tmp->fs_id->mountpoint = util_strdup_s(mountpoint);
+
+    fs_usage_tmp->inodes_used = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_inodes_used));
+    if (fs_usage_tmp->inodes_used == NULL) {
+        ERROR("Memory out");
+        ret = -1;
+        goto out;
+    }
+    fs_usage_tmp->inodes_used->value = usage->inodes_used;
+
+    fs_usage_tmp->used_bytes = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_used_bytes));
+    if (fs_usage_tmp->used_bytes == NULL) {
+        ERROR("Memory out");
+        ret = -1;
+        goto out;
+    }
+    fs_usage_tmp->used_bytes->value = usage->used_bytes;
+
+    fs_info->image_filesystems = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_element *));
+    if (fs_info->image_filesystems == NULL) {
+        ERROR("Memory out");
+        ret = -1;
+        goto out;
+    }
+    fs_info->image_filesystems[0] = fs_usage_tmp;
+    fs_usage_tmp = NULL;
+    fs_info->image_filesystems_len = 1;
+
+out:
+    free_imagetool_fs_info_image_filesystems_element(fs_usage_tmp);
+    return ret;
+}
@@ -0,0 +1,48 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-07-24
+ * Description: provide cached filesystem usage definition
+ ******************************************************************************/
+#ifndef DAEMON_MODULES_IMAGE_OCI_STORAGE_FS_USAGE_FS_USAGE_H
+#define DAEMON_MODULES_IMAGE_OCI_STORAGE_FS_USAGE_FS_USAGE_H
+
+#include <stdint.h>
+#include <isula_libutils/imagetool_fs_info.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// cached usage older than this is refreshed in background
+#define FS_USAGE_REFRESH_INTERVAL_SECOND 10
+// cached usage not queried for this long is dropped
+#define FS_USAGE_EXPIRE_SECOND 300
+
+typedef struct {
+    int64_t used_bytes;
+    int64_t inodes_used;
+    // time when the usage was measured, in nanoseconds
+    int64_t timestamp;
+} fs_usage_info;
+
+// get usage of directory path, only the first query of a path walks the directory in caller's context
+int fs_usage_get(const char *path, fs_usage_info *usage);
+
+void fs_usage_forget(const char *path);
+
+int fs_usage_to_fs_info(const char *mountpoint, const fs_usage_info *usage, imagetool_fs_info *fs_info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DAEMON_MODULES_IMAGE_OCI_STORAGE_FS_USAGE_FS_USAGE_H
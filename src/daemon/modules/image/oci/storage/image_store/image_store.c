@@ -47,8 +47,11 @@
 #include "mediatype.h"
 #include "storage.h"
 #include "image_type.h"
+#include "fs_usage.h"
+#include "meta_index.h"
 #include "linked_list.h"
 #include "utils_verify.h"
+#include "util_atomic.h"
 #ifdef ENABLE_REMOTE_LAYER_STORE
 #include "ro_symlink_maintain.h"
 #endif
@@ -58,6 +61,7 @@
 #define IMAGE_DIGEST_BIG_DATA_KEY "manifest"
 #define IMAGE_NAME_LEN 64
 #define IMAGE_JSON "images.json"
+#define IMAGE_INDEX "images.index"
 
 #define MAX_IMAGE_NAME_LENGTH 72
 #define DIGEST_PREFIX "@sha256:"
@@ -68,6 +72,13 @@ typedef struct digest_image {
     size_t images_list_len;
 } digest_image_t;
 
+// immutable summaries of all the images, shared by the readers until the store is modified
+typedef struct image_summary_snapshot {
+    imagetool_image_summary **summaries;
+    size_t summaries_len;
+    uint64_t refcnt;
+} image_summary_snapshot_t;
+
 typedef struct image_store {
     pthread_rwlock_t rwlock;
     char *dir;
@@ -77,6 +88,13 @@ typedef struct image_store {
     map_t *byname;
     map_t *bydigest;
 
+    // serializes the rebuild of the snapshot by concurrent readers holding the shared lock
+    pthread_mutex_t snapshot_mutex;
+    image_summary_snapshot_t *snapshot;
+
+    // images were modified since the meta index was written
+    bool index_dirty;
+
     bool loaded;
 } image_store_t;
 
@@ -84,9 +102,25 @@ enum lock_type { SHARED = 0, EXCLUSIVE };
 
 image_store_t *g_image_store = NULL;
 
+static void image_summary_snapshot_unref(image_summary_snapshot_t *snapshot)
+{
+    size_t i;
+
+    if (snapshot == NULL || !atomic_int_dec_test(&snapshot->refcnt)) {
+        return;
+    }
+
+    for (i = 0; i < snapshot->summaries_len; i++) {
+        free_imagetool_image_summary(snapshot->summaries[i]);
+    }
+    free(snapshot->summaries);
+    free(snapshot);
+}
+
 static inline bool image_store_lock(enum lock_type type)
 {
     int nret = 0;
+    image_summary_snapshot_t *snapshot = NULL;
 
     if (type == SHARED) {
         nret = pthread_rwlock_rdlock(&g_image_store->rwlock);
@@ -98,6 +132,13 @@ static inline bool image_store_lock(enum lock_type type)
         return false;
     }
 
+    if (type == EXCLUSIVE) {
+        // the holder may modify the images, readers holding the old snapshot keep their reference
+        snapshot = g_image_store->snapshot;
+        g_image_store->snapshot = NULL;
+        image_summary_snapshot_unref(snapshot);
+    }
+
     return true;
 }
 
@@ -141,6 +182,9 @@ static void free_image_store(image_store_t *store)
 
     store->images_list_len = 0;
 
+    image_summary_snapshot_unref(store->snapshot);
+    store->snapshot = NULL;
+
     free(store);
 }
 
@@ -174,6 +218,42 @@ static void image_store_digest_field_kvfree(void *key, void *value)
     }
 }
 
+static char *get_image_index_path()
+{
+    char *path = NULL;
+
+    path = util_path_join(g_image_store->dir, IMAGE_INDEX);
+    if (path == NULL) {
+        ERROR("Failed to get image index path");
+    }
+
+    return path;
+}
+
+/* must be called with the image store locked before the images or their files change */
+static int mark_index_dirty()
+{
+    int ret = -1;
+    char *index_path = NULL;
+
+    if (g_image_store->index_dirty) {
+        return 0;
+    }
+
+    index_path = get_image_index_path();
+    if (index_path == NULL) {
+        return -1;
+    }
+
+    ret = meta_index_invalidate(index_path);
+    if (ret == 0) {
+        g_image_store->index_dirty = true;
+    }
+
+    free(index_path);
+    return ret;
+}
+
 static int get_image_path(const char *id, char *path, size_t len)
 {
     int nret = snprintf(path, len, "%s/%s/%s", g_image_store->dir, id, IMAGE_JSON);
@@ -194,6 +274,11 @@ static int save_image(storage_image *img)
         return -1;
     }
 
+    if (mark_index_dirty() != 0) {
+        ERROR("Failed to invalidate image index");
+        return -1;
+    }
+
     strcpy(image_dir, image_path);
     ret = util_mkdir_p(dirname(image_dir), IMAGE_STORE_PATH_MODE);
     if (ret < 0) {
@@ -629,6 +714,9 @@ static int do_delete_image_info(const char *id)
         goto out;
     }
 
+    // the index only has to be rewritten, the files of removed images are never looked up
+    (void)mark_index_dirty();
+
     if (remove_image_from_memory(img->simage->id) != 0) {
         ERROR("Failed to remove image from memory");
         ret = -1;
@@ -1194,6 +1282,12 @@ int image_store_set_big_data(const char *id, const char *key, const char *data)
         goto out;
     }
 
+    if (mark_index_dirty() != 0) {
+        ERROR("Failed to invalidate image index");
+        ret = -1;
+        goto out;
+    }
+
     if (util_atomic_write_file(big_data_file, data, strlen(data), SECURE_CONFIG_FILE_MODE, true) != 0) {
         ERROR("Failed to save big data file: %s", big_data_file);
         ret = -1;
@@ -2231,12 +2325,17 @@ out:
     return ret;
 }
 
-static int pack_oci_image_spec(const char *filename, imagetool_image *info)
+static int pack_oci_image_spec(const char *spec_json, imagetool_image *info)
 {
     int ret = 0;
     parser_error err = NULL;
 
-    info->spec = oci_image_spec_parse_file(filename, NULL, &err);
+    if (spec_json == NULL) {
+        ERROR("Oci image spec is not loaded");
+        return -1;
+    }
+
+    info->spec = oci_image_spec_parse_data(spec_json, NULL, &err);
     if (info->spec == NULL) {
         ERROR("Failed to parse oci image spec file: %s", err);
         ret = -1;
@@ -2357,31 +2456,7 @@ out:
 static imagetool_image *get_image_info(image_t *img)
 {
     int ret = 0;
-    int nret = 0;
     imagetool_image *info = NULL;
-    char *base_name = NULL;
-    char *config_file = NULL;
-    char *sha256_key = NULL;
-
-    sha256_key = util_full_digest(img->simage->id);
-    if (sha256_key == NULL) {
-        ERROR("Failed to get sha256 key");
-        return NULL;
-    }
-
-    base_name = make_big_data_base_name(sha256_key);
-    if (base_name == NULL) {
-        ERROR("Failed to retrieve oci image spec file's base name");
-        ret = -1;
-        goto out;
-    }
-
-    nret = asprintf(&config_file, "%s/%s/%s", g_image_store->dir, img->simage->id, base_name);
-    if (nret < 0 || nret > PATH_MAX) {
-        ERROR("Failed to retrieve oci image spac file");
-        ret = -1;
-        goto out;
-    }
 
     info = util_common_calloc_s(sizeof(imagetool_image));
     if (info == NULL) {
@@ -2390,7 +2465,8 @@ static imagetool_image *get_image_info(image_t *img)
         goto out;
     }
 
-    if (pack_oci_image_spec(config_file, info) != 0) {
+    // the config loaded with the image, so image status never reads the disk
+    if (pack_oci_image_spec(img->spec_json, info) != 0) {
         ERROR("Failed to pack oci image spec");
         ret = -1;
         goto out;
@@ -2419,9 +2495,6 @@ out:
         free_imagetool_image(info);
         info = NULL;
     }
-    free(base_name);
-    free(config_file);
-    free(sha256_key);
 
     return info;
 }
@@ -2646,11 +2719,158 @@ unlock:
     return img_summary;
 }
 
-int image_store_get_all_images(imagetool_images_list *images_list)
+static char **dup_string_array(char **src, size_t len)
+{
+    size_t i;
+    char **dst = NULL;
+
+    if (src == NULL || len == 0) {
+        return NULL;
+    }
+
+    dst = util_smart_calloc_s(sizeof(char *), len + 1);
+    if (dst == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+    for (i = 0; i < len; i++) {
+        dst[i] = util_strdup_s(src[i]);
+    }
+
+    return dst;
+}
+
+static imagetool_image_summary *dup_image_summary(const imagetool_image_summary *src)
+{
+    imagetool_image_summary *dst = NULL;
+
+    dst = util_common_calloc_s(sizeof(imagetool_image_summary));
+    if (dst == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+
+    dst->id = util_strdup_s(src->id);
+    dst->created = util_strdup_s(src->created);
+    dst->loaded = util_strdup_s(src->loaded);
+    dst->size = src->size;
+    dst->top_layer = util_strdup_s(src->top_layer);
+    dst->username = util_strdup_s(src->username);
+
+    if (src->uid != NULL) {
+        dst->uid = util_common_calloc_s(sizeof(imagetool_image_summary_uid));
+        if (dst->uid == NULL) {
+            ERROR("Out of memory");
+            goto err_out;
+        }
+        dst->uid->value = src->uid->value;
+    }
+
+    if (src->repo_tags_len > 0) {
+        dst->repo_tags = dup_string_array(src->repo_tags, src->repo_tags_len);
+        if (dst->repo_tags == NULL) {
+            goto err_out;
+        }
+        dst->repo_tags_len = src->repo_tags_len;
+    }
+
+    if (src->repo_digests_len > 0) {
+        dst->repo_digests = dup_string_array(src->repo_digests, src->repo_digests_len);
+        if (dst->repo_digests == NULL) {
+            goto err_out;
+        }
+        dst->repo_digests_len = src->repo_digests_len;
+    }
+
+    if (src->labels != NULL) {
+        dst->labels = util_common_calloc_s(sizeof(json_map_string_string));
+        if (dst->labels == NULL || dup_json_map_string_string(src->labels, dst->labels) != 0) {
+            ERROR("Failed to dup image labels");
+            goto err_out;
+        }
+    }
+
+    return dst;
+
+err_out:
+    free_imagetool_image_summary(dst);
+    return NULL;
+}
+
+/* must be called with the image store shared lock held */
+static image_summary_snapshot_t *build_image_summary_snapshot()
 {
-    int ret = 0;
     struct linked_list *item = NULL;
     struct linked_list *next = NULL;
+    image_summary_snapshot_t *snapshot = NULL;
+
+    snapshot = util_common_calloc_s(sizeof(image_summary_snapshot_t));
+    if (snapshot == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+    atomic_int_set(&snapshot->refcnt, 1);
+
+    if (g_image_store->images_list_len == 0) {
+        return snapshot;
+    }
+
+    snapshot->summaries = util_smart_calloc_s(sizeof(imagetool_image_summary *), g_image_store->images_list_len);
+    if (snapshot->summaries == NULL) {
+        ERROR("Out of memory");
+        free(snapshot);
+        return NULL;
+    }
+
+    linked_list_for_each_safe (item, &(g_image_store->images_list), next) {
+        imagetool_image_summary *imginfo = NULL;
+        image_t *img = (image_t *)item->elem;
+        imginfo = get_image_summary(img);
+        if (imginfo == NULL) {
+            ERROR("Failed to get summary info of image: %s", img->simage->id);
+            continue;
+        }
+        snapshot->summaries[snapshot->summaries_len++] = imginfo;
+    }
+
+    return snapshot;
+}
+
+/* take a reference of the current snapshot, rebuilding it if the store was modified since the last read */
+static image_summary_snapshot_t *get_image_summary_snapshot()
+{
+    image_summary_snapshot_t *snapshot = NULL;
+
+    if (!image_store_lock(SHARED)) {
+        ERROR("Failed to lock image store with shared lock, not allowed to get all the known images");
+        return NULL;
+    }
+
+    if (pthread_mutex_lock(&g_image_store->snapshot_mutex) != 0) {
+        ERROR("Failed to lock image store snapshot");
+        goto unlock;
+    }
+
+    if (g_image_store->snapshot == NULL) {
+        g_image_store->snapshot = build_image_summary_snapshot();
+    }
+    snapshot = g_image_store->snapshot;
+    if (snapshot != NULL) {
+        atomic_int_inc(&snapshot->refcnt);
+    }
+
+    (void)pthread_mutex_unlock(&g_image_store->snapshot_mutex);
+
+unlock:
+    image_store_unlock();
+    return snapshot;
+}
+
+int image_store_get_all_images(imagetool_images_list *images_list)
+{
+    int ret = 0;
+    size_t i;
+    image_summary_snapshot_t *snapshot = NULL;
 
     if (images_list == NULL) {
         ERROR("Invalid input paratemer, memory should be allocated first");
@@ -2662,36 +2882,34 @@ int image_store_get_all_images(imagetool_images_list *images_list)
         return -1;
     }
 
-    if (!image_store_lock(EXCLUSIVE)) {
-        ERROR("Failed to lock image store with exclusive lock, not allowed to get all the known images");
+    snapshot = get_image_summary_snapshot();
+    if (snapshot == NULL) {
         return -1;
     }
 
-    if (g_image_store->images_list_len == 0) {
-        goto unlock;
+    // the copies are made out of the image store lock, so listing never blocks pulls and removals
+    if (snapshot->summaries_len == 0) {
+        goto out;
     }
 
-    images_list->images = util_smart_calloc_s(g_image_store->images_list_len, sizeof(imagetool_image *));
+    images_list->images = util_smart_calloc_s(sizeof(imagetool_image_summary *), snapshot->summaries_len);
     if (images_list->images == NULL) {
         ERROR("Out of memory");
         ret = -1;
-        goto unlock;
+        goto out;
     }
 
-    linked_list_for_each_safe (item, &(g_image_store->images_list), next) {
-        imagetool_image_summary *imginfo = NULL;
-        image_t *img = (image_t *)item->elem;
-        imginfo = get_image_summary(img);
+    for (i = 0; i < snapshot->summaries_len; i++) {
+        imagetool_image_summary *imginfo = dup_image_summary(snapshot->summaries[i]);
         if (imginfo == NULL) {
-            ERROR("Failed to get summary info of image: %s", img->simage->id);
+            ERROR("Failed to copy summary info of image: %s", snapshot->summaries[i]->id);
             continue;
         }
         images_list->images[images_list->images_len++] = imginfo;
-        imginfo = NULL;
     }
 
-unlock:
-    image_store_unlock();
+out:
+    image_summary_snapshot_unref(snapshot);
     return ret;
 }
 
@@ -2717,10 +2935,7 @@ size_t image_store_get_images_number()
 
 int image_store_get_fs_info(imagetool_fs_info *fs_info)
 {
-    int ret = 0;
-    imagetool_fs_info_image_filesystems_element *fs_usage_tmp = NULL;
-    int64_t total_size = 0;
-    int64_t total_inodes = 0;
+    fs_usage_info usage = { 0 };
 
     if (fs_info == NULL) {
         ERROR("Invalid input arguments");
@@ -2732,54 +2947,12 @@ int image_store_get_fs_info(imagetool_fs_info *fs_info)
         return -1;
     }
 
-    fs_usage_tmp = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_element));
-    if (fs_usage_tmp == NULL) {
-        ERROR("Memory out");
-        ret = -1;
-        goto out;
-    }
-
-    fs_usage_tmp->timestamp = util_get_now_time_nanos();
-
-    fs_usage_tmp->fs_id = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_fs_id));
-    if (fs_usage_tmp->fs_id == NULL) {
-        ERROR("Memory out");
-        ret = -1;
-        goto out;
-    }
-    fs_usage_tmp->fs_id->mountpoint = util_strdup_s(g_image_store->dir);
-
-    util_calculate_dir_size(g_image_store->dir, 0, &total_size, &total_inodes);
-
-    fs_usage_tmp->inodes_used = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_inodes_used));
-    if (fs_usage_tmp->inodes_used == NULL) {
-        ERROR("Memory out");
-        ret = -1;
-        goto out;
-    }
-    fs_usage_tmp->inodes_used->value = total_inodes;
-
-    fs_usage_tmp->used_bytes = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_used_bytes));
-    if (fs_usage_tmp->used_bytes == NULL) {
-        ERROR("Memory out");
-        ret = -1;
-        goto out;
-    }
-    fs_usage_tmp->used_bytes->value = total_size;
-
-    fs_info->image_filesystems = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_element *));
-    if (fs_info->image_filesystems == NULL) {
-        ERROR("Memory out");
-        ret = -1;
-        goto out;
+    if (fs_usage_get(g_image_store->dir, &usage) != 0) {
+        ERROR("Failed to get fs usage of %s", g_image_store->dir);
+        return -1;
     }
-    fs_info->image_filesystems[0] = fs_usage_tmp;
-    fs_usage_tmp = NULL;
-    fs_info->image_filesystems_len = 1;
 
-out:
-    free_imagetool_fs_info_image_filesystems_element(fs_usage_tmp);
-    return ret;
+    return fs_usage_to_fs_info(g_image_store->dir, &usage, fs_info);
 }
 
 static int implicit_digest(map_t *digests, image_t *img)
@@ -2879,17 +3052,10 @@ out:
     return ret;
 }
 
-static int do_append_image(storage_image *im)
+static int append_image_to_store(image_t *img)
 {
-    image_t *img = NULL;
     struct linked_list *item = NULL;
 
-    img = new_image(im, g_image_store->dir);
-    if (img == NULL) {
-        ERROR("Out of memory");
-        return -1;
-    }
-
     item = util_smart_calloc_s(sizeof(struct linked_list), 1);
     if (item == NULL) {
         ERROR("Out of memory");
@@ -2910,6 +3076,19 @@ static int do_append_image(storage_image *im)
     return 0;
 }
 
+static int do_append_image(storage_image *im)
+{
+    image_t *img = NULL;
+
+    img = new_image(im, g_image_store->dir);
+    if (img == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+
+    return append_image_to_store(img);
+}
+
 static void strip_host_prefix(char **name)
 {
     char *new_image_name = NULL;
@@ -3099,7 +3278,8 @@ out:
     return ret;
 }
 
-int image_store_validate_manifest_schema_version_1(const char *path, bool *valid)
+/* manifest_json is the content of the manifest when it is already read, NULL to read it from path */
+static int validate_manifest_schema_version_1(const char *path, const char *manifest_json, bool *valid)
 {
     int ret = 0;
     int nret;
@@ -3118,7 +3298,8 @@ int image_store_validate_manifest_schema_version_1(const char *path, bool *valid
         goto out;
     }
 
-    manifest_v2 = registry_manifest_schema2_parse_file(manifest_path, NULL, &err);
+    manifest_v2 = manifest_json != NULL ? registry_manifest_schema2_parse_data(manifest_json, NULL, &err) :
+                  registry_manifest_schema2_parse_file(manifest_path, NULL, &err);
     if (manifest_v2 != NULL) {
         goto out;
     }
@@ -3126,7 +3307,8 @@ int image_store_validate_manifest_schema_version_1(const char *path, bool *valid
     free(err);
     err = NULL;
 
-    manifest_oci = oci_image_manifest_parse_file(manifest_path, NULL, &err);
+    manifest_oci = manifest_json != NULL ? oci_image_manifest_parse_data(manifest_json, NULL, &err) :
+                   oci_image_manifest_parse_file(manifest_path, NULL, &err);
     if (manifest_oci != NULL) {
         goto out;
     }
@@ -3134,7 +3316,8 @@ int image_store_validate_manifest_schema_version_1(const char *path, bool *valid
     free(err);
     err = NULL;
 
-    manifest_v1 = registry_manifest_schema1_parse_file(manifest_path, NULL, &err);
+    manifest_v1 = manifest_json != NULL ? registry_manifest_schema1_parse_data(manifest_json, NULL, &err) :
+                  registry_manifest_schema1_parse_file(manifest_path, NULL, &err);
     if (manifest_v1 == NULL) {
         ERROR("Invalid manifest format");
         ret = -1;
@@ -3157,6 +3340,11 @@ out:
     return ret;
 }
 
+int image_store_validate_manifest_schema_version_1(const char *path, bool *valid)
+{
+    return validate_manifest_schema_version_1(path, NULL, valid);
+}
+
 static int get_layers_from_manifest(const registry_manifest_schema1 *manifest, layer_blob **ls, size_t *len)
 {
     int ret = 0;
@@ -3473,6 +3661,220 @@ out:
     return ret;
 }
 
+struct image_load_item {
+    char *dir;
+    int ret;
+    // manifest schema version 1 image, converted after the parallel load
+    bool v1;
+    storage_image *simage;
+    char *spec_json;
+};
+
+struct image_load_ctx {
+    struct image_load_item *items;
+    meta_index_t *idx;
+};
+
+static char *read_image_file(meta_index_t *idx, const char *path)
+{
+    const char *content = meta_index_lookup(idx, path);
+
+    if (content != NULL) {
+        return util_strdup_s(content);
+    }
+
+    return util_file_exists(path) ? util_read_text_file(path) : NULL;
+}
+
+/* parse the metadata of one image, it runs in parallel and must not touch the store */
+static void load_image_metadata_cb(size_t index, void *arg)
+{
+    int nret;
+    struct image_load_ctx *ctx = (struct image_load_ctx *)arg;
+    struct image_load_item *item = &ctx->items[index];
+    char path[PATH_MAX] = { 0x00 };
+    const char *indexed = NULL;
+    char *content = NULL;
+    char *spec_path = NULL;
+    parser_error err = NULL;
+
+    item->ret = -1;
+
+    nret = snprintf(path, sizeof(path), "%s/%s", item->dir, IMAGE_JSON);
+    if (nret < 0 || (size_t)nret >= sizeof(path)) {
+        ERROR("Failed to get image path");
+        return;
+    }
+
+    // only images already loaded as v2 images are indexed, so the manifest is checked for the others only
+    indexed = meta_index_lookup(ctx->idx, path);
+    if (indexed == NULL) {
+        nret = snprintf(path, sizeof(path), "%s/%s", item->dir, IMAGE_DIGEST_BIG_DATA_KEY);
+        if (nret < 0 || (size_t)nret >= sizeof(path)) {
+            ERROR("Failed to get big data manifest path");
+            return;
+        }
+        content = util_file_exists(path) ? util_read_text_file(path) : NULL;
+        if (validate_manifest_schema_version_1(item->dir, content, &item->v1) != 0) {
+            ERROR("Failed to validate manifest schema version 1 format");
+            goto out;
+        }
+        if (item->v1) {
+            item->ret = 0;
+            goto out;
+        }
+        free(content);
+        content = NULL;
+
+        nret = snprintf(path, sizeof(path), "%s/%s", item->dir, IMAGE_JSON);
+        if (nret < 0 || (size_t)nret >= sizeof(path)) {
+            ERROR("Failed to get image path");
+            goto out;
+        }
+        content = util_read_text_file(path);
+        if (content == NULL) {
+            ERROR("Failed to read image json %s", path);
+            goto out;
+        }
+        indexed = content;
+    }
+
+    item->simage = storage_image_parse_data(indexed, NULL, &err);
+    if (item->simage == NULL) {
+        ERROR("Failed to parse images path: %s", err);
+        goto out;
+    }
+
+    // it may fail when restore v1 image
+    spec_path = image_spec_file_path(item->simage->id, g_image_store->dir);
+    if (spec_path != NULL) {
+        item->spec_json = read_image_file(ctx->idx, spec_path);
+    }
+
+    item->ret = 0;
+
+out:
+    free(spec_path);
+    free(content);
+    free(err);
+}
+
+static int append_loaded_image(struct image_load_item *item)
+{
+    image_t *img = NULL;
+
+    if (strip_default_hostname(item->simage) != 0) {
+        ERROR("Failed to strip default hostname");
+        return -1;
+    }
+
+    img = new_image_with_spec_json(item->simage, item->spec_json);
+    item->spec_json = NULL;
+    if (img == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+    item->simage = NULL;
+
+    return append_image_to_store(img);
+}
+
+/* must be called with the image store locked, or before the store is used */
+static int image_store_write_index()
+{
+    int ret = -1;
+    size_t i;
+    size_t count = 0;
+    char *index_path = NULL;
+    char **paths = NULL;
+    char **datas = NULL;
+    meta_index_file_t *files = NULL;
+    struct linked_list *item = NULL;
+    struct linked_list *next = NULL;
+    parser_error err = NULL;
+
+    index_path = get_image_index_path();
+    if (index_path == NULL) {
+        return -1;
+    }
+
+    // image json and oci image config of each image, the contents are taken from memory
+    if (g_image_store->images_list_len > 0) {
+        paths = util_smart_calloc_s(sizeof(char *), g_image_store->images_list_len * 2);
+        datas = util_smart_calloc_s(sizeof(char *), g_image_store->images_list_len);
+        files = util_smart_calloc_s(sizeof(meta_index_file_t), g_image_store->images_list_len * 2);
+        if (paths == NULL || datas == NULL || files == NULL) {
+            ERROR("Out of memory");
+            goto out;
+        }
+    }
+
+    i = 0;
+    linked_list_for_each_safe (item, &(g_image_store->images_list), next) {
+        image_t *img = (image_t *)item->elem;
+        char path[PATH_MAX] = { 0x00 };
+
+        if (get_image_path(img->simage->id, path, sizeof(path)) != 0) {
+            ERROR("Failed to add image %s to index", img->simage->id);
+            goto out;
+        }
+        datas[i] = storage_image_generate_json(img->simage, NULL, &err);
+        if (datas[i] == NULL) {
+            ERROR("Failed to generate image json of %s: %s", img->simage->id, err);
+            goto out;
+        }
+        paths[count] = util_strdup_s(path);
+        files[count].path = paths[count];
+        files[count].data = datas[i];
+        count++;
+
+        if (img->spec_json != NULL) {
+            paths[count] = image_spec_file_path(img->simage->id, g_image_store->dir);
+            files[count].path = paths[count];
+            files[count].data = img->spec_json;
+            count++;
+        }
+        i++;
+    }
+
+    ret = meta_index_write(index_path, files, count);
+    if (ret == 0) {
+        g_image_store->index_dirty = false;
+    }
+
+out:
+    for (i = 0; paths != NULL && i < g_image_store->images_list_len * 2; i++) {
+        free(paths[i]);
+    }
+    for (i = 0; datas != NULL && i < g_image_store->images_list_len; i++) {
+        free(datas[i]);
+    }
+    free(paths);
+    free(datas);
+    free(files);
+    free(err);
+    free(index_path);
+    return ret;
+}
+
+void image_store_save_index()
+{
+    if (g_image_store == NULL) {
+        return;
+    }
+
+    if (!image_store_lock(SHARED)) {
+        ERROR("Failed to lock image store with shared lock, not allowed to save image index");
+        return;
+    }
+
+    if (g_image_store->index_dirty && image_store_write_index() != 0) {
+        WARN("Failed to save image index");
+    }
+
+    image_store_unlock();
+}
+
 static int get_images_from_json()
 {
     int ret = 0;
@@ -3480,8 +3882,11 @@ static int get_images_from_json()
     char **image_dirs = NULL;
     size_t image_dirs_num = 0;
     size_t i;
+    size_t count = 0;
     char *id_patten = "^[a-f0-9]{64}$";
     char image_path[PATH_MAX] = { 0x00 };
+    char *index_path = NULL;
+    struct image_load_ctx ctx = { 0 };
 
     ret = util_list_all_subdir(g_image_store->dir, &image_dirs);
     if (ret != 0) {
@@ -3489,42 +3894,74 @@ static int get_images_from_json()
         goto out;
     }
     image_dirs_num = util_array_len((const char **)image_dirs);
+    if (image_dirs_num == 0) {
+        goto out;
+    }
 
-    for (i = 0; i < image_dirs_num; i++) {
-        bool valid_v1_image = false;
+    ctx.items = util_smart_calloc_s(sizeof(struct image_load_item), image_dirs_num);
+    if (ctx.items == NULL) {
+        ERROR("Out of memory");
+        ret = -1;
+        goto out;
+    }
 
+    for (i = 0; i < image_dirs_num; i++) {
         if (util_reg_match(id_patten, image_dirs[i]) != 0) {
             DEBUG("Image's json is placed inside image's data directory, so skip any other file or directory: %s",
                   image_dirs[i]);
             continue;
         }
 
-        DEBUG("Restore the images:%s", image_dirs[i]);
         nret = snprintf(image_path, sizeof(image_path), "%s/%s", g_image_store->dir, image_dirs[i]);
         if (nret < 0 || (size_t)nret >= sizeof(image_path)) {
             ERROR("Failed to get image path");
             continue;
         }
+        ctx.items[count++].dir = util_strdup_s(image_path);
+    }
 
-        if (image_store_validate_manifest_schema_version_1(image_path, &valid_v1_image) != 0) {
-            ERROR("Failed to validate manifest schema version 1 format");
+    index_path = get_image_index_path();
+    ctx.idx = meta_index_open(index_path);
+
+    // parse the metadata in parallel, then add the images in order as before
+    (void)meta_index_parallel_load(count, load_image_metadata_cb, &ctx);
+
+    for (i = 0; i < count; i++) {
+        struct image_load_item *item = &ctx.items[i];
+
+        DEBUG("Restore the images:%s", item->dir);
+        if (item->ret != 0) {
+            ERROR("Found image path but load json failed: %s", item->dir);
             continue;
         }
 
-        if (!valid_v1_image) {
-            if (append_image_by_directory(image_path) != 0) {
-                ERROR("Found image path but load json failed: %s", image_dirs[i]);
+        if (!item->v1) {
+            if (append_loaded_image(item) != 0) {
+                ERROR("Found image path but load json failed: %s", item->dir);
                 continue;
             }
         } else {
-            if (convert_to_v2_image_and_load(image_path) != 0) {
+            if (convert_to_v2_image_and_load(item->dir) != 0) {
                 ERROR("Failed to convert image to v2 format image and load to store");
                 continue;
             }
         }
     }
 
+    if (ctx.idx == NULL || meta_index_misses(ctx.idx) > 0) {
+        INFO("Image index is stale, %lu files read from disk", (unsigned long)meta_index_misses(ctx.idx));
+        (void)mark_index_dirty();
+    }
+
 out:
+    meta_index_close(ctx.idx);
+    for (i = 0; ctx.items != NULL && i < count; i++) {
+        free(ctx.items[i].dir);
+        free_storage_image(ctx.items[i].simage);
+        free(ctx.items[i].spec_json);
+    }
+    free(ctx.items);
+    free(index_path);
     util_free_array(image_dirs);
     return ret;
 }
@@ -3568,6 +4005,11 @@ static int image_store_load()
 
     image_store_check_all_images();
 
+    // rewrite a stale index now, so the next startup is fast even if the daemon does not exit cleanly
+    if (g_image_store->index_dirty && image_store_write_index() != 0) {
+        WARN("Failed to write image index");
+    }
+
     g_image_store->loaded = true;
 
     return 0;
@@ -3609,6 +4051,13 @@ int image_store_init(struct storage_module_init_options *opts)
         goto out;
     }
 
+    ret = pthread_mutex_init(&(g_image_store->snapshot_mutex), NULL);
+    if (ret != 0) {
+        ERROR("Failed to init image store snapshot mutex");
+        ret = -1;
+        goto out;
+    }
+
     g_image_store->dir = root_dir;
     root_dir = NULL;
 
@@ -3681,9 +4130,11 @@ int remote_append_image_by_directory_with_lock(const char *id)
     nret = snprintf(image_path, sizeof(image_path), "%s/%s", g_image_store->dir, id);
     if (nret < 0 || (size_t)nret >= sizeof(image_path)) {
         ERROR("Failed to get image path");
-        return -1;
+        ret = -1;
+        goto out;
     }
 
+    (void)mark_index_dirty();
     ret = append_image_by_directory(image_path);
 
 out:
@@ -3711,6 +4162,7 @@ int remote_remove_image_from_memory_with_lock(const char *id)
         goto out;
     }
 
+    (void)mark_index_dirty();
     ret = remove_image_from_memory(id);
 
 out:
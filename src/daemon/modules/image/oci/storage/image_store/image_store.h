@@ -106,6 +106,9 @@ int image_store_get_fs_info(imagetool_fs_info *fs_info);
 // Free memory of image store, but will not delete the persisted files
 void image_store_free();
 
+// Write the meta index of the images if they were modified since it was written
+void image_store_save_index();
+
 imagetool_image_summary *image_store_get_image_summary(const char *id);
 
 #ifdef ENABLE_REMOTE_LAYER_STORE
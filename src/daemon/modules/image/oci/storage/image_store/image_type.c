@@ -22,6 +22,7 @@
 #include "isula_libutils/storage_image.h"
 #include "util_atomic.h"
 #include "utils.h"
+#include "utils_file.h"
 #include "isula_libutils/log.h"
 
 #include "utils_images.h"
@@ -44,52 +45,87 @@ err_out:
     return NULL;
 }
 
-int try_fill_image_spec(image_t *img, const char *id, const char *image_store_dir)
+char *image_spec_file_path(const char *id, const char *image_store_dir)
 {
-    int ret = 0;
     int nret = 0;
     char *base_name = NULL;
     char *config_file = NULL;
     char *sha256_key = NULL;
-    parser_error err = NULL;
 
-    if (img == NULL || id == NULL || image_store_dir == NULL) {
-        return -1;
+    if (id == NULL || image_store_dir == NULL) {
+        return NULL;
     }
 
     sha256_key = util_full_digest(id);
     if (sha256_key == NULL) {
         ERROR("Failed to get sha256 key");
-        return -1;
+        return NULL;
     }
 
     base_name = make_big_data_base_name(sha256_key);
     if (base_name == NULL) {
         ERROR("Failed to retrieve oci image spec file's base name");
-        ret = -1;
         goto out;
     }
 
     nret = asprintf(&config_file, "%s/%s/%s", image_store_dir, id, base_name);
     if (nret < 0 || nret > PATH_MAX) {
         ERROR("Failed to retrieve oci image spac file");
-        ret = -1;
+        if (nret >= 0) {
+            free(config_file);
+        }
+        config_file = NULL;
         goto out;
     }
 
-    img->spec = oci_image_spec_parse_file(config_file, NULL, &err);
+out:
+    free(base_name);
+    free(sha256_key);
+    return config_file;
+}
+
+static int fill_image_spec_with_json(image_t *img, char *spec_json)
+{
+    parser_error err = NULL;
+
+    img->spec = oci_image_spec_parse_data(spec_json, NULL, &err);
     if (img->spec == NULL) {
         ERROR("Failed to parse oci image spec: %s", err);
+        free(spec_json);
+        free(err);
+        return -1;
+    }
+    img->spec_json = spec_json;
+
+    return 0;
+}
+
+int try_fill_image_spec(image_t *img, const char *id, const char *image_store_dir)
+{
+    int ret = 0;
+    char *config_file = NULL;
+    char *spec_json = NULL;
+
+    if (img == NULL || id == NULL || image_store_dir == NULL) {
+        return -1;
+    }
+
+    config_file = image_spec_file_path(id, image_store_dir);
+    if (config_file == NULL) {
+        return -1;
+    }
+
+    spec_json = util_read_text_file(config_file);
+    if (spec_json == NULL) {
+        ERROR("Failed to read oci image spec %s", config_file);
         ret = -1;
         goto out;
     }
 
+    ret = fill_image_spec_with_json(img, spec_json);
+
 out:
-    free(base_name);
     free(config_file);
-    free(sha256_key);
-    free(err);
-
     return ret;
 }
 
@@ -115,6 +151,31 @@ image_t *new_image(storage_image *simg, const char *image_store_dir)
     return img;
 }
 
+image_t *new_image_with_spec_json(storage_image *simg, char *spec_json)
+{
+    image_t *img = NULL;
+
+    if (simg == NULL) {
+        ERROR("Empty storage image");
+        free(spec_json);
+        return NULL;
+    }
+
+    img = create_empty_image();
+    if (img == NULL) {
+        free(spec_json);
+        return NULL;
+    }
+
+    if (spec_json != NULL) {
+        (void)fill_image_spec_with_json(img, spec_json);
+    }
+
+    img->simage = simg;
+
+    return img;
+}
+
 void image_ref_inc(image_t *img)
 {
     if (img == NULL) {
@@ -148,6 +209,8 @@ void free_image_t(image_t *ptr)
     ptr->simage = NULL;
     free_oci_image_spec(ptr->spec);
     ptr->spec = NULL;
+    free(ptr->spec_json);
+    ptr->spec_json = NULL;
 
     free(ptr);
 }
@@ -30,11 +30,16 @@ extern "C" {
 typedef struct _image_t_ {
     storage_image *simage;
     oci_image_spec *spec;
+    // raw oci image config of spec, image status is packed from it instead of the config file
+    char *spec_json;
     uint64_t refcnt;
 } image_t;
 
+char *image_spec_file_path(const char *id, const char *image_store_dir);
 int try_fill_image_spec(image_t *img, const char *id, const char *image_store_dir);
 image_t *new_image(storage_image *simg, const char *image_store_dir);
+// spec_json is the oci image config already read, it is taken over even if it fails
+image_t *new_image_with_spec_json(storage_image *simg, char *spec_json);
 void image_ref_inc(image_t *img);
 void image_ref_dec(image_t *img);
 void free_image_t(image_t *ptr);
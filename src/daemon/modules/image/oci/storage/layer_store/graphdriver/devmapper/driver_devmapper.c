@@ -367,6 +367,7 @@ int devmapper_apply_diff(const char *id, const struct graphdriver *driver, const
     }
 
     options.whiteout_format = REMOVE_WHITEOUT_FORMATE;
+    options.parallel_decompress = DEFAULT_PARALLEL_DECOMPRESS;
     if (archive_unpack(content, layer_fs, &options, &err) != 0) {
         ERROR("devmapper: failed to unpack to %s: %s", layer_fs, err);
         ret = -1;
@@ -34,6 +34,7 @@
 #include "utils.h"
 #include "util_archive.h"
 #include "project_quota.h"
+#include "fs_usage.h"
 #include "driver.h"
 #include "driver_overlay2_types.h"
 #include "image_api.h"
@@ -45,6 +46,9 @@
 #include "utils_timestamp.h"
 #include "selinux_label.h"
 #include "err_msg.h"
+#if !defined(DISABLE_CLEANUP) && !defined(LIB_ISULAD_IMG_SO)
+#include "leftover_cleanup_api.h"
+#endif
 #ifdef ENABLE_REMOTE_LAYER_STORE
 #include "ro_symlink_maintain.h"
 #endif
@@ -1160,6 +1164,16 @@ out:
     return lower;
 }
 
+static int remove_layer_dir(const char *layer_dir)
+{
+#if !defined(DISABLE_CLEANUP) && !defined(LIB_ISULAD_IMG_SO)
+    // large writable layers take long to remove, so only move them to trash under the layer store lock
+    return clean_module_remove_dir_async(layer_dir);
+#else
+    return util_recursive_rmdir(layer_dir, 0);
+#endif
+}
+
 int overlay2_rm_layer(const char *id, const struct graphdriver *driver)
 {
     int ret = 0;
@@ -1218,20 +1232,22 @@ int overlay2_rm_layer(const char *id, const struct graphdriver *driver)
             goto out;
         }
     } else {
-        if (util_recursive_rmdir(layer_dir, 0) != 0) {
+        if (remove_layer_dir(layer_dir) != 0) {
             SYSERROR("Failed to remove layer directory %s", layer_dir);
             ret = -1;
             goto out;
         }
     }
 #else
-    if (util_recursive_rmdir(layer_dir, 0) != 0) {
+    if (remove_layer_dir(layer_dir) != 0) {
         SYSERROR("Failed to remove layer directory %s", layer_dir);
         ret = -1;
         goto out;
     }
 #endif
 
+    fs_usage_forget(layer_dir);
+
 out:
     free(layer_dir);
     free(link_id);
@@ -1922,6 +1938,7 @@ int overlay2_apply_diff(const char *id, const struct graphdriver *driver, const
     }
 
     options.whiteout_format = OVERLAY_WHITEOUT_FORMATE;
+    options.parallel_decompress = DEFAULT_PARALLEL_DECOMPRESS;
 
 #ifdef ENABLE_USERNS_REMAP
     if (userns_remap != NULL) {
@@ -2216,61 +2233,27 @@ out:
     return ret;
 }
 
-static int do_cal_layer_fs_info(const char *layer_diff, imagetool_fs_info *fs_info)
+static int do_cal_layer_fs_info(const char *layer_dir, const char *layer_diff, const struct graphdriver *driver,
+                                imagetool_fs_info *fs_info)
 {
-    int ret = 0;
-    imagetool_fs_info_image_filesystems_element *fs_usage_tmp = NULL;
-    int64_t total_size = 0;
-    int64_t total_inodes = 0;
-
-    fs_usage_tmp = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_element));
-    if (fs_usage_tmp == NULL) {
-        ERROR("Memory out");
-        ret = -1;
-        goto out;
-    }
-
-    fs_usage_tmp->timestamp = util_get_now_time_nanos();
-
-    fs_usage_tmp->fs_id = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_fs_id));
-    if (fs_usage_tmp->fs_id == NULL) {
-        ERROR("Memory out");
-        ret = -1;
-        goto out;
-    }
-    fs_usage_tmp->fs_id->mountpoint = util_strdup_s(layer_diff);
-
-    util_calculate_dir_size(layer_diff, 0, &total_size, &total_inodes);
+    fs_usage_info usage = { 0 };
 
-    fs_usage_tmp->inodes_used = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_inodes_used));
-    if (fs_usage_tmp->inodes_used == NULL) {
-        ERROR("Memory out");
-        ret = -1;
-        goto out;
+    /*
+     * the project quota accounts usage of the whole layer directory, so kernel keeps it up to date for us.
+     * Without quota the layer directory is walked too, except the merged dir mounted on it.
+     */
+    if (driver->quota_ctrl != NULL && driver->quota_ctrl->get_quota_usage != NULL &&
+        driver->quota_ctrl->get_quota_usage(layer_dir, driver->quota_ctrl, &usage.used_bytes, &usage.inodes_used) == 0) {
+        usage.timestamp = util_get_now_time_nanos();
+        return fs_usage_to_fs_info(layer_diff, &usage, fs_info);
     }
-    fs_usage_tmp->inodes_used->value = total_inodes;
 
-    fs_usage_tmp->used_bytes = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_used_bytes));
-    if (fs_usage_tmp->used_bytes == NULL) {
-        ERROR("Memory out");
-        ret = -1;
-        goto out;
-    }
-    fs_usage_tmp->used_bytes->value = total_size;
-
-    fs_info->image_filesystems = util_common_calloc_s(sizeof(imagetool_fs_info_image_filesystems_element *));
-    if (fs_info->image_filesystems == NULL) {
-        ERROR("Memory out");
-        ret = -1;
-        goto out;
+    if (fs_usage_get(layer_dir, &usage) != 0) {
+        ERROR("Failed to get fs usage of %s", layer_dir);
+        return -1;
     }
-    fs_info->image_filesystems[0] = fs_usage_tmp;
-    fs_usage_tmp = NULL;
-    fs_info->image_filesystems_len = 1;
 
-out:
-    free_imagetool_fs_info_image_filesystems_element(fs_usage_tmp);
-    return ret;
+    return fs_usage_to_fs_info(layer_diff, &usage, fs_info);
 }
 
 int overlay2_get_layer_fs_info(const char *id, const struct graphdriver *driver, imagetool_fs_info *fs_info)
@@ -2302,7 +2285,7 @@ int overlay2_get_layer_fs_info(const char *id, const struct graphdriver *driver,
         goto out;
     }
 
-    if (do_cal_layer_fs_info(layer_diff, fs_info) != 0) {
+    if (do_cal_layer_fs_info(layer_dir, layer_diff, driver, fs_info) != 0) {
         ERROR("Failed to cal layer diff :%s fs info", layer_diff);
         ret = -1;
         goto out;
@@ -251,6 +251,75 @@ out:
     return ret;
 }
 
+static int get_target_project_id(const char *target, const struct pquota_control *ctrl, uint32_t *project_id)
+{
+    if (get_project_quota_id(target, project_id) != 0) {
+        return -1;
+    }
+
+    // directories without own project id inherit the id of driver home, nothing is accounted to them alone
+    if (*project_id == 0 || *project_id <= ctrl->home_project_id) {
+        DEBUG("Directory %s has no project id of its own", target);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int ext4_get_quota_usage(const char *target, struct pquota_control *ctrl, int64_t *used_bytes,
+                                int64_t *inodes_used)
+{
+    uint32_t project_id = 0;
+    struct dqblk d = { 0 };
+
+    if (target == NULL || ctrl == NULL || used_bytes == NULL || inodes_used == NULL) {
+        return -1;
+    }
+
+    if (get_target_project_id(target, ctrl, &project_id) != 0) {
+        return -1;
+    }
+
+    if (quotactl(QCMD(Q_GETQUOTA, FS_PROJ_QUOTA), ctrl->backing_fs_device, project_id, (caddr_t)&d) != 0) {
+        SYSWARN("Failed to get quota usage for projid %u on %s", project_id, ctrl->backing_fs_device);
+        return -1;
+    }
+
+    if ((d.dqb_valid & QIF_USAGE) != QIF_USAGE) {
+        WARN("Quota usage for projid %u on %s is not valid", project_id, ctrl->backing_fs_device);
+        return -1;
+    }
+
+    *used_bytes = (int64_t)d.dqb_curspace;
+    *inodes_used = (int64_t)d.dqb_curinodes;
+    return 0;
+}
+
+static int xfs_get_quota_usage(const char *target, struct pquota_control *ctrl, int64_t *used_bytes,
+                               int64_t *inodes_used)
+{
+    uint32_t project_id = 0;
+    fs_disk_quota_t d = { 0 };
+
+    if (target == NULL || ctrl == NULL || used_bytes == NULL || inodes_used == NULL) {
+        return -1;
+    }
+
+    if (get_target_project_id(target, ctrl, &project_id) != 0) {
+        return -1;
+    }
+
+    if (quotactl(QCMD(Q_XGETQUOTA, FS_PROJ_QUOTA), ctrl->backing_fs_device, project_id, (caddr_t)&d) != 0) {
+        SYSWARN("Failed to get quota usage for projid %u on %s", project_id, ctrl->backing_fs_device);
+        return -1;
+    }
+
+    // d_bcount is counted in 512 bytes basic blocks
+    *used_bytes = (int64_t)d.d_bcount * 512;
+    *inodes_used = (int64_t)d.d_icount;
+    return 0;
+}
+
 static void get_next_project_id(const char *dirpath, struct pquota_control *ctrl)
 {
     int nret = 0;
@@ -389,6 +458,7 @@ struct pquota_control *project_quota_control_init(const char *home_dir, const ch
         ERROR("Failed to get mininal project id %s", home_dir);
         goto err_out;
     }
+    ctrl->home_project_id = min_project_id;
     min_project_id++;
     ctrl->next_project_id = min_project_id;
     get_next_project_id(home_dir, ctrl);
@@ -408,8 +478,10 @@ struct pquota_control *project_quota_control_init(const char *home_dir, const ch
 
     if (strcmp(ctrl->backing_fs_type, "extfs") == 0) {
         ctrl->set_quota = ext4_set_quota;
+        ctrl->get_quota_usage = ext4_get_quota_usage;
     } else {
         ctrl->set_quota = xfs_set_quota;
+        ctrl->get_quota_usage = xfs_get_quota_usage;
     }
 
     return ctrl;
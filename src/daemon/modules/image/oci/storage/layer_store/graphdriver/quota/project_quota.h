@@ -77,9 +77,14 @@ struct pquota_control {
     char *backing_fs_type;
     char *backing_fs_device;
     uint32_t next_project_id;
+    // project id of the driver home directory, ids above it are assigned to layers
+    uint32_t home_project_id;
     pthread_rwlock_t rwlock;
     // ops
     int (*set_quota)(const char *target, struct pquota_control *ctrl, uint64_t size);
+    // usage accounted to the project id of target, fails if target has no own project id
+    int (*get_quota_usage)(const char *target, struct pquota_control *ctrl, int64_t *used_bytes,
+                           int64_t *inodes_used);
 };
 
 struct pquota_control *project_quota_control_init(const char *home_dir, const char *fs);
@@ -119,6 +119,11 @@ void layer_ref_dec(layer_t *layer)
 }
 
 layer_t *load_layer(const char *fname, const char *mountpoint_fname)
+{
+    return load_layer_with_data(fname, NULL, mountpoint_fname);
+}
+
+layer_t *load_layer_with_data(const char *fname, const char *data, const char *mountpoint_fname)
 {
     parser_error err = NULL;
     layer_t *result = NULL;
@@ -128,7 +133,7 @@ layer_t *load_layer(const char *fname, const char *mountpoint_fname)
     if (fname == NULL) {
         return result;
     }
-    slayer = storage_layer_parse_file(fname, NULL, &err);
+    slayer = data != NULL ? storage_layer_parse_data(data, NULL, &err) : storage_layer_parse_file(fname, NULL, &err);
     if (slayer == NULL) {
         ERROR("Parse layer failed: %s", err);
         goto free_out;
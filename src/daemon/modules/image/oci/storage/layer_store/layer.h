@@ -49,6 +49,8 @@ void free_layer_t(layer_t *ptr);
 void layer_ref_inc(layer_t *layer);
 void layer_ref_dec(layer_t *layer);
 layer_t *load_layer(const char *fname, const char *mountpoint_fname);
+// data is the content of fname when it is already read
+layer_t *load_layer_with_data(const char *fname, const char *data, const char *mountpoint_fname);
 int save_layer(layer_t *layer);
 int save_mount_point(layer_t *layer);
 
@@ -48,11 +48,13 @@
 #include "utils_base64.h"
 #include "constants.h"
 #include "path.h"
+#include "meta_index.h"
 #ifdef ENABLE_REMOTE_LAYER_STORE
 #include "ro_symlink_maintain.h"
 #endif
 
 #define PAYLOAD_CRC_LEN 12
+#define LAYER_INDEX "layers.index"
 
 typedef struct __layer_store_metadata_t {
     pthread_rwlock_t rwlock;
@@ -62,6 +64,8 @@ typedef struct __layer_store_metadata_t {
     map_t *by_uncompress_digest;
     struct linked_list layers_list;
     size_t layers_list_len;
+    // layers were modified since the meta index was written
+    bool index_dirty;
 } layer_store_metadata;
 
 typedef struct digest_layer {
@@ -119,6 +123,52 @@ static inline void layer_store_unlock()
     }
 }
 
+static char *get_layer_index_path()
+{
+    char *path = NULL;
+
+    path = util_path_join(g_root_dir, LAYER_INDEX);
+    if (path == NULL) {
+        ERROR("Failed to get layer index path");
+    }
+
+    return path;
+}
+
+/* must be called with the layer store locked before the layers or their files change */
+static int mark_index_dirty()
+{
+    int ret = -1;
+    char *index_path = NULL;
+
+    if (g_metadata.index_dirty) {
+        return 0;
+    }
+
+    index_path = get_layer_index_path();
+    if (index_path == NULL) {
+        return -1;
+    }
+
+    ret = meta_index_invalidate(index_path);
+    if (ret == 0) {
+        g_metadata.index_dirty = true;
+    }
+
+    free(index_path);
+    return ret;
+}
+
+static int save_layer_json(layer_t *l)
+{
+    if (mark_index_dirty() != 0) {
+        ERROR("Failed to invalidate layer index");
+        return -1;
+    }
+
+    return save_layer(l);
+}
+
 void layer_store_cleanup()
 {
     struct linked_list *item = NULL;
@@ -1293,7 +1343,7 @@ int layer_store_create(const char *id, const struct layer_opts *opts, const stru
         goto clear_memory;
     }
     l->slayer->incompelte = true;
-    if (save_layer(l) != 0) {
+    if (save_layer_json(l) != 0) {
         ret = -1;
         goto clear_memory;
     }
@@ -1309,7 +1359,7 @@ int layer_store_create(const char *id, const struct layer_opts *opts, const stru
 
     l->slayer->incompelte = false;
 
-    ret = save_layer(l);
+    ret = save_layer_json(l);
     if (ret == 0) {
         DEBUG("create layer success");
         if (new_id != NULL) {
@@ -1382,6 +1432,9 @@ static int do_delete_layer(const char *id)
         goto free_out;
     }
 
+    // the index only has to be rewritten, the files of removed layers are never looked up
+    (void)mark_index_dirty();
+
     if (umount_helper(l, true) != 0) {
         ret = -1;
         ERROR("Failed to umount layer %s", l->slayer->id);
@@ -1789,66 +1842,119 @@ out:
     return ret;
 }
 
-static bool load_layer_json_cb(const char *path_name, const struct dirent *sub_dir, void *context)
-{
 #define LAYER_NAME_LEN 64
-    bool flag = false;
+struct layer_load_item {
+    char *id;
+    layer_t *layer;
+    // failed for lack of memory, the layer dir is kept
+    bool keep_dir;
+};
+
+struct layer_load_ctx {
+    struct layer_load_item *items;
+    meta_index_t *idx;
+};
+
+static bool collect_layer_dir_cb(const char *path_name, const struct dirent *sub_dir, void *context)
+{
     char tmpdir[PATH_MAX] = { 0 };
     int nret = 0;
-    char *rpath = NULL;
-    char *mount_point_path = NULL;
-    layer_t *l = NULL;
+    char ***ids = (char ***)context;
 
     nret = snprintf(tmpdir, PATH_MAX, "%s/%s", path_name, sub_dir->d_name);
     if (nret < 0 || nret >= PATH_MAX) {
         ERROR("Sprintf: %s failed", sub_dir->d_name);
-        goto free_out;
+        return true;
     }
 
 #ifdef ENABLE_REMOTE_LAYER_STORE
     // skip RO dir
     // otherwise, RO dir will be treat as invalid layer dir
     if (strcmp(sub_dir->d_name, REMOTE_RO_LAYER_DIR) == 0) {
-        goto free_out;
+        return true;
     }
 #endif
 
     if (!util_dir_exists(tmpdir)) {
         // ignore non-dir
         DEBUG("%s is not directory", sub_dir->d_name);
-        goto free_out;
+        return true;
+    }
+
+    if (util_array_append(ids, sub_dir->d_name) != 0) {
+        ERROR("Out of memory");
     }
 
-    mount_point_path = mountpoint_json_path(sub_dir->d_name);
+    // always return true;
+    return true;
+}
+
+/* parse the json of one layer, it runs in parallel and must not touch the store */
+static void load_layer_json_cb(size_t index, void *arg)
+{
+    struct layer_load_ctx *ctx = (struct layer_load_ctx *)arg;
+    struct layer_load_item *item = &ctx->items[index];
+    char *rpath = NULL;
+    char *mount_point_path = NULL;
+
+    mount_point_path = mountpoint_json_path(item->id);
     if (mount_point_path == NULL) {
         ERROR("Out of Memory");
-        goto free_out;
+        item->keep_dir = true;
+        return;
     }
 
-    if (strlen(sub_dir->d_name) != LAYER_NAME_LEN) {
-        ERROR("%s is invalid subdir name", sub_dir->d_name);
-        goto remove_invalid_dir;
+    if (strlen(item->id) != LAYER_NAME_LEN) {
+        goto out;
     }
 
-    rpath = layer_json_path(sub_dir->d_name);
+    rpath = layer_json_path(item->id);
     if (rpath == NULL) {
-        ERROR("%s is invalid layer", sub_dir->d_name);
+        goto out;
+    }
+
+    item->layer = load_layer_with_data(rpath, meta_index_lookup(ctx->idx, rpath), mount_point_path);
+
+out:
+    free(rpath);
+    free(mount_point_path);
+}
+
+static void restore_loaded_layer(struct layer_load_item *item)
+{
+    char tmpdir[PATH_MAX] = { 0 };
+    int nret = 0;
+    layer_t *l = item->layer;
+
+    item->layer = NULL;
+
+    nret = snprintf(tmpdir, PATH_MAX, "%s/%s", g_root_dir, item->id);
+    if (nret < 0 || nret >= PATH_MAX) {
+        ERROR("Sprintf: %s failed", item->id);
+        goto free_out;
+    }
+
+    if (item->keep_dir) {
+        goto free_out;
+    }
+
+    if (strlen(item->id) != LAYER_NAME_LEN) {
+        ERROR("%s is invalid subdir name", item->id);
         goto remove_invalid_dir;
     }
 
-    l = load_layer(rpath, mount_point_path);
     if (l == NULL) {
-        ERROR("load layer: %s failed, remove it", sub_dir->d_name);
+        ERROR("load layer: %s failed, remove it", item->id);
         goto remove_invalid_dir;
     }
 
     if (do_validate_image_layer(tmpdir, l) != 0) {
-        ERROR("%s is invalid image layer", sub_dir->d_name);
+        ERROR("%s is invalid image layer", item->id);
         goto remove_invalid_dir;
     }
 
     if (do_validate_rootfs_layer(l) != 0) {
-        ERROR("%s is invalid rootfs layer", sub_dir->d_name);
+        ERROR("%s is invalid rootfs layer", item->id);
         goto remove_invalid_dir;
     }
 
@@ -1857,14 +1963,13 @@ static bool load_layer_json_cb(const char *path_name, const struct dirent *sub_d
         goto remove_invalid_dir;
     }
 
-    flag = true;
-    goto free_out;
+    return;
 
 remove_invalid_dir:
-    (void)graphdriver_umount_layer(sub_dir->d_name);
+    (void)graphdriver_umount_layer(item->id);
     // layer not removed successfully, we can't remove layer.json
-    if (graphdriver_rm_layer(sub_dir->d_name) != 0) {
-        ERROR("failed to rm layer: %s when handing invalid rootfs", sub_dir->d_name);
+    if (graphdriver_rm_layer(item->id) != 0) {
+        ERROR("failed to rm layer: %s when handing invalid rootfs", item->id);
         goto free_out;
     }
     ERROR("tmpdir is %s", tmpdir);
@@ -1873,14 +1978,93 @@ remove_invalid_dir:
     }
 
 free_out:
-    free(rpath);
-    free(mount_point_path);
-    if (!flag) {
-        free_layer_t(l);
+    free_layer_t(l);
+}
+
+/* parse the layer jsons in parallel, then validate and append the layers in order as before */
+static int load_layers_from_dirs(const char **ids, size_t ids_len, meta_index_t *idx)
+{
+    size_t i;
+    struct layer_load_ctx ctx = { 0 };
+
+    if (ids_len == 0) {
+        return 0;
     }
-    // always return true;
-    // if load layer failed, just remove it
-    return true;
+
+    ctx.items = util_smart_calloc_s(sizeof(struct layer_load_item), ids_len);
+    if (ctx.items == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+    ctx.idx = idx;
+    for (i = 0; i < ids_len; i++) {
+        ctx.items[i].id = (char *)ids[i];
+    }
+
+    (void)meta_index_parallel_load(ids_len, load_layer_json_cb, &ctx);
+
+    for (i = 0; i < ids_len; i++) {
+        restore_loaded_layer(&ctx.items[i]);
+    }
+
+    free(ctx.items);
+    return 0;
+}
+
+/* must be called with the layer store locked */
+static int layer_store_write_index()
+{
+    int ret = -1;
+    size_t i;
+    size_t count = 0;
+    char *index_path = NULL;
+    meta_index_file_t *files = NULL;
+    struct linked_list *item = NULL;
+    struct linked_list *next = NULL;
+    parser_error err = NULL;
+
+    index_path = get_layer_index_path();
+    if (index_path == NULL) {
+        return -1;
+    }
+
+    if (g_metadata.layers_list_len > 0) {
+        files = util_smart_calloc_s(sizeof(meta_index_file_t), g_metadata.layers_list_len);
+        if (files == NULL) {
+            ERROR("Out of memory");
+            goto out;
+        }
+    }
+
+    // the layer jsons are generated from memory instead of read again
+    linked_list_for_each_safe (item, &(g_metadata.layers_list), next) {
+        layer_t *l = (layer_t *)item->elem;
+
+        if (l->layer_json_path == NULL) {
+            continue;
+        }
+        files[count].path = l->layer_json_path;
+        files[count].data = storage_layer_generate_json(l->slayer, NULL, &err);
+        if (files[count].data == NULL) {
+            ERROR("Failed to generate layer json of %s: %s", l->slayer->id, err);
+            goto out;
+        }
+        count++;
+    }
+
+    ret = meta_index_write(index_path, files, count);
+    if (ret == 0) {
+        g_metadata.index_dirty = false;
+    }
+
+out:
+    for (i = 0; i < count; i++) {
+        free((char *)files[i].data);
+    }
+    free(files);
+    free(err);
+    free(index_path);
+    return ret;
 }
 
 static int load_layers_from_json_files()
@@ -1889,12 +2073,23 @@ static int load_layers_from_json_files()
     struct linked_list *item = NULL;
     struct linked_list *next = NULL;
     bool should_save = false;
+    char **ids = NULL;
+    char *index_path = NULL;
+    meta_index_t *idx = NULL;
 
     if (!layer_store_lock(true)) {
         return -1;
     }
 
-    ret = util_scan_subdirs(g_root_dir, load_layer_json_cb, NULL);
+    ret = util_scan_subdirs(g_root_dir, collect_layer_dir_cb, &ids);
+    if (ret != 0) {
+        goto unlock_out;
+    }
+
+    index_path = get_layer_index_path();
+    idx = meta_index_open(index_path);
+
+    ret = load_layers_from_dirs((const char **)ids, util_array_len((const char **)ids), idx);
     if (ret != 0) {
         goto unlock_out;
     }
@@ -1942,16 +2137,28 @@ static int load_layers_from_json_files()
             should_save = true;
         }
 
-        if (should_save && save_layer(tl) != 0) {
+        if (should_save && save_layer_json(tl) != 0) {
             ERROR("save layer: %s failed", tl->slayer->id);
             ret = -1;
             goto unlock_out;
         }
     }
 
+    // rewrite a stale index now, so the next startup is fast even if the daemon does not exit cleanly
+    if (idx == NULL || meta_index_misses(idx) > 0) {
+        INFO("Layer index is stale, %lu files read from disk", (unsigned long)meta_index_misses(idx));
+        (void)mark_index_dirty();
+    }
+    if (g_metadata.index_dirty && layer_store_write_index() != 0) {
+        WARN("Failed to write layer index");
+    }
+
     ret = 0;
     goto unlock_out;
 unlock_out:
+    meta_index_close(idx);
+    free(index_path);
+    util_free_array(ids);
     layer_store_unlock();
     return ret;
 }
@@ -2026,6 +2233,12 @@ free_out:
 
 void layer_store_exit()
 {
+    if (g_root_dir != NULL && layer_store_lock(false)) {
+        if (g_metadata.index_dirty && layer_store_write_index() != 0) {
+            WARN("Failed to save layer index");
+        }
+        layer_store_unlock();
+    }
     graphdriver_cleanup();
 }
 
@@ -2473,6 +2686,7 @@ int remote_load_one_layer(const char *id)
         ret = -1;
         goto unlock_out;
     }
+    (void)mark_index_dirty();
 
     if (!map_insert(g_metadata.by_id, (void *)tl->slayer->id, (void *)tl)) {
         ERROR("Insert id: %s for layer failed", tl->slayer->id);
@@ -0,0 +1,432 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-14
+ * Description: provide metadata index functions
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include "meta_index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <isula_libutils/log.h>
+
+#include "constants.h"
+#include "util_atomic.h"
+#include "utils.h"
+#include "utils_file.h"
+
+#define META_INDEX_CRC_CHUNK (1024 * 1024 * 1024)
+
+/*
+ * layout: header | entries sorted by path | strings
+ * offsets of the entries are relative to the end of the header, and both the path and
+ * the data of an entry are followed by a '\0', so they are used in place from the mmap
+ */
+struct meta_index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t payload_len;
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+struct meta_index_entry {
+    uint64_t path_off;
+    uint64_t data_off;
+    uint64_t data_len;
+};
+
+struct meta_index {
+    void *addr;
+    size_t len;
+    const struct meta_index_entry *entries;
+    uint32_t count;
+    const char *payload;
+    uint64_t payload_len;
+    volatile uint64_t misses;
+};
+
+static uint32_t payload_crc(const char *payload, uint64_t len)
+{
+    uLong crc = crc32(0L, Z_NULL, 0);
+
+    while (len > 0) {
+        uInt n = len > META_INDEX_CRC_CHUNK ? META_INDEX_CRC_CHUNK : (uInt)len;
+        crc = crc32(crc, (const Bytef *)payload, n);
+        payload += n;
+        len -= n;
+    }
+
+    return (uint32_t)crc;
+}
+
+static bool valid_string(const struct meta_index *idx, uint64_t off, uint64_t len)
+{
+    if (off >= idx->payload_len || len >= idx->payload_len - off) {
+        return false;
+    }
+
+    return idx->payload[off + len] == '\0';
+}
+
+static bool valid_entries(const struct meta_index *idx)
+{
+    uint32_t i;
+
+    for (i = 0; i < idx->count; i++) {
+        const struct meta_index_entry *e = &idx->entries[i];
+
+        if (e->path_off >= idx->payload_len ||
+            memchr(idx->payload + e->path_off, '\0', idx->payload_len - e->path_off) == NULL) {
+            return false;
+        }
+        if (!valid_string(idx, e->data_off, e->data_len)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+meta_index_t *meta_index_open(const char *index_path)
+{
+    int fd = -1;
+    struct stat st;
+    const struct meta_index_header *header = NULL;
+    meta_index_t *idx = NULL;
+
+    if (index_path == NULL) {
+        return NULL;
+    }
+
+    fd = util_open(index_path, O_RDONLY, 0);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            SYSWARN("Failed to open meta index %s", index_path);
+        }
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct meta_index_header)) {
+        WARN("Invalid meta index %s", index_path);
+        goto err_out;
+    }
+
+    idx = util_common_calloc_s(sizeof(meta_index_t));
+    if (idx == NULL) {
+        ERROR("Out of memory");
+        goto err_out;
+    }
+
+    idx->len = (size_t)st.st_size;
+    idx->addr = mmap(NULL, idx->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (idx->addr == MAP_FAILED) {
+        SYSWARN("Failed to mmap meta index %s", index_path);
+        idx->addr = NULL;
+        goto err_out;
+    }
+
+    header = (const struct meta_index_header *)idx->addr;
+    if (memcmp(header->magic, META_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != META_INDEX_VERSION) {
+        WARN("Unknown format of meta index %s, ignore it", index_path);
+        goto err_out;
+    }
+
+    idx->payload = (const char *)idx->addr + sizeof(struct meta_index_header);
+    idx->payload_len = idx->len - sizeof(struct meta_index_header);
+    idx->entries = (const struct meta_index_entry *)idx->payload;
+    idx->count = header->count;
+
+    if (header->payload_len != idx->payload_len ||
+        (uint64_t)idx->count * sizeof(struct meta_index_entry) > idx->payload_len) {
+        WARN("Truncated meta index %s, ignore it", index_path);
+        goto err_out;
+    }
+
+    if (payload_crc(idx->payload, idx->payload_len) != header->crc || !valid_entries(idx)) {
+        WARN("Corrupted meta index %s, ignore it", index_path);
+        goto err_out;
+    }
+
+    close(fd);
+    return idx;
+
+err_out:
+    meta_index_close(idx);
+    close(fd);
+    return NULL;
+}
+
+static const struct meta_index_entry *search_entry(const meta_index_t *idx, const char *path)
+{
+    uint32_t low = 0;
+    uint32_t high = idx->count;
+
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        int cmp = strcmp(idx->payload + idx->entries[mid].path_off, path);
+
+        if (cmp == 0) {
+            return &idx->entries[mid];
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return NULL;
+}
+
+const char *meta_index_lookup(meta_index_t *idx, const char *path)
+{
+    const struct meta_index_entry *e = NULL;
+
+    if (idx == NULL || path == NULL) {
+        return NULL;
+    }
+
+    e = search_entry(idx, path);
+    if (e == NULL) {
+        atomic_int_inc(&idx->misses);
+        return NULL;
+    }
+
+    return idx->payload + e->data_off;
+}
+
+uint64_t meta_index_misses(const meta_index_t *idx)
+{
+    return idx != NULL ? idx->misses : 0;
+}
+
+void meta_index_close(meta_index_t *idx)
+{
+    if (idx == NULL) {
+        return;
+    }
+
+    if (idx->addr != NULL) {
+        (void)munmap(idx->addr, idx->len);
+    }
+    free(idx);
+}
+
+static int record_cmp(const void *a, const void *b)
+{
+    return strcmp(((const meta_index_file_t *)a)->path, ((const meta_index_file_t *)b)->path);
+}
+
+static char *build_index(const meta_index_file_t *files, size_t count, size_t *total_len)
+{
+    size_t i;
+    uint64_t payload_len = 0;
+    uint64_t off = 0;
+    char *buf = NULL;
+    char *payload = NULL;
+    struct meta_index_header *header = NULL;
+    struct meta_index_entry *entries = NULL;
+
+    payload_len = count * sizeof(struct meta_index_entry);
+    for (i = 0; i < count; i++) {
+        payload_len += strlen(files[i].path) + 1 + strlen(files[i].data) + 1;
+    }
+
+    buf = util_common_calloc_s(sizeof(struct meta_index_header) + payload_len);
+    if (buf == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+
+    header = (struct meta_index_header *)buf;
+    payload = buf + sizeof(struct meta_index_header);
+    entries = (struct meta_index_entry *)payload;
+    off = count * sizeof(struct meta_index_entry);
+
+    for (i = 0; i < count; i++) {
+        size_t path_len = strlen(files[i].path);
+        size_t data_len = strlen(files[i].data);
+
+        entries[i].path_off = off;
+        (void)memcpy(payload + off, files[i].path, path_len);
+        off += path_len + 1;
+
+        entries[i].data_off = off;
+        entries[i].data_len = data_len;
+        (void)memcpy(payload + off, files[i].data, data_len);
+        off += data_len + 1;
+    }
+
+    (void)memcpy(header->magic, META_INDEX_MAGIC, sizeof(header->magic));
+    header->version = META_INDEX_VERSION;
+    header->count = (uint32_t)count;
+    header->payload_len = payload_len;
+    header->crc = payload_crc(payload, payload_len);
+
+    *total_len = sizeof(struct meta_index_header) + payload_len;
+    return buf;
+}
+
+int meta_index_write(const char *index_path, const meta_index_file_t *files, size_t files_len)
+{
+    int ret = -1;
+    size_t i;
+    size_t count = 0;
+    size_t total_len = 0;
+    char *buf = NULL;
+    meta_index_file_t *sorted = NULL;
+
+    if (index_path == NULL || (files == NULL && files_len != 0) || files_len > UINT32_MAX) {
+        ERROR("Invalid input arguments");
+        return -1;
+    }
+
+    if (files_len > 0) {
+        sorted = util_smart_calloc_s(sizeof(meta_index_file_t), files_len);
+        if (sorted == NULL) {
+            ERROR("Out of memory");
+            return -1;
+        }
+    }
+
+    for (i = 0; i < files_len; i++) {
+        if (files[i].path == NULL || files[i].data == NULL) {
+            continue;
+        }
+        sorted[count++] = files[i];
+    }
+
+    if (count > 0) {
+        qsort(sorted, count, sizeof(meta_index_file_t), record_cmp);
+    }
+
+    buf = build_index(sorted, count, &total_len);
+    if (buf == NULL) {
+        goto out;
+    }
+
+    if (util_atomic_write_file(index_path, buf, total_len, SECURE_CONFIG_FILE_MODE, true) != 0) {
+        ERROR("Failed to write meta index %s", index_path);
+        goto out;
+    }
+
+    DEBUG("Write meta index %s with %zu files", index_path, count);
+    ret = 0;
+
+out:
+    free(sorted);
+    free(buf);
+    return ret;
+}
+
+int meta_index_invalidate(const char *index_path)
+{
+    if (index_path == NULL) {
+        ERROR("Invalid input arguments");
+        return -1;
+    }
+
+    if (unlink(index_path) != 0 && errno != ENOENT) {
+        SYSERROR("Failed to remove meta index %s", index_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+struct parallel_load_ctx {
+    pthread_mutex_t mutex;
+    size_t next;
+    size_t count;
+    meta_index_load_cb_t cb;
+    void *arg;
+};
+
+static void *parallel_load_worker(void *arg)
+{
+    struct parallel_load_ctx *ctx = (struct parallel_load_ctx *)arg;
+    size_t index;
+
+    for (;;) {
+        (void)pthread_mutex_lock(&ctx->mutex);
+        index = ctx->next++;
+        (void)pthread_mutex_unlock(&ctx->mutex);
+
+        if (index >= ctx->count) {
+            break;
+        }
+        ctx->cb(index, ctx->arg);
+    }
+
+    return NULL;
+}
+
+int meta_index_parallel_load(size_t count, meta_index_load_cb_t cb, void *arg)
+{
+    size_t i;
+    size_t workers = 0;
+    size_t started = 0;
+    long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_t tids[META_INDEX_MAX_LOAD_WORKERS] = { 0 };
+    struct parallel_load_ctx ctx = { 0 };
+
+    if (cb == NULL) {
+        ERROR("Invalid input arguments");
+        return -1;
+    }
+
+    if (pthread_mutex_init(&ctx.mutex, NULL) != 0) {
+        ERROR("Mutex initialization failed");
+        return -1;
+    }
+    ctx.count = count;
+    ctx.cb = cb;
+    ctx.arg = arg;
+
+    // the caller is one of the workers
+    workers = nprocs > 1 ? (size_t)nprocs - 1 : 0;
+    if (workers > META_INDEX_MAX_LOAD_WORKERS) {
+        workers = META_INDEX_MAX_LOAD_WORKERS;
+    }
+    if (workers >= count) {
+        workers = count > 0 ? count - 1 : 0;
+    }
+
+    for (i = 0; i < workers; i++) {
+        if (pthread_create(&tids[i], NULL, parallel_load_worker, &ctx) != 0) {
+            WARN("Failed to create load worker, continue with %zu workers", started);
+            break;
+        }
+        started++;
+    }
+
+    (void)parallel_load_worker(&ctx);
+
+    for (i = 0; i < started; i++) {
+        (void)pthread_join(tids[i], NULL);
+    }
+
+    pthread_mutex_destroy(&ctx.mutex);
+    return 0;
+}
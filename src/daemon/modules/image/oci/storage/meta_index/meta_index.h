@@ -0,0 +1,70 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-14
+ * Description: provide metadata index definition
+ ******************************************************************************/
+#ifndef DAEMON_MODULES_IMAGE_OCI_STORAGE_META_INDEX_META_INDEX_H
+#define DAEMON_MODULES_IMAGE_OCI_STORAGE_META_INDEX_META_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define META_INDEX_MAGIC "ISMETAIX"
+#define META_INDEX_VERSION 2
+#define META_INDEX_MAX_LOAD_WORKERS 16
+
+/*
+ * A meta index is a single file holding the contents of many small metadata files, so that
+ * the stores are loaded at startup from one mmap instead of opening and reading every file.
+ * It is written from the in-memory store, and the store invalidates it before it changes any
+ * of the files, so an existing index is in sync with the files and is used without a stat.
+ */
+typedef struct meta_index meta_index_t;
+
+typedef struct {
+    const char *path;
+    // content of the file as the store holds it in memory
+    const char *data;
+} meta_index_file_t;
+
+// returns NULL if the index is missing, corrupted or of another version
+meta_index_t *meta_index_open(const char *index_path);
+
+// content of the file path from the index, NULL terminated and valid until the index is closed,
+// returns NULL if the path is not indexed
+const char *meta_index_lookup(meta_index_t *idx, const char *path);
+
+// number of lookups which had to fallback to the file
+uint64_t meta_index_misses(const meta_index_t *idx);
+
+void meta_index_close(meta_index_t *idx);
+
+// write a new index with the contents of files, files without data are skipped
+int meta_index_write(const char *index_path, const meta_index_file_t *files, size_t files_len);
+
+// remove the index, must be called before the indexed files change
+int meta_index_invalidate(const char *index_path);
+
+typedef void (*meta_index_load_cb_t)(size_t index, void *arg);
+
+// call cb for each index in [0, count) on a bounded pool of threads, and wait for all of them
+int meta_index_parallel_load(size_t count, meta_index_load_cb_t cb, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DAEMON_MODULES_IMAGE_OCI_STORAGE_META_INDEX_META_INDEX_H
@@ -28,6 +28,8 @@
 
 static map_t *image_byid_old = NULL;
 static map_t *image_byid_new = NULL;
+// some image dirs could not be read by the last scan, they may be still being written
+static bool image_scan_incomplete = false;
 
 struct remote_image_data *remote_image_create(const char *remote_home, const char *remote_ro)
 {
@@ -67,6 +69,7 @@ static int remote_dir_scan(void *data)
     bool exist = true;
     struct remote_image_data *img_data = (struct remote_image_data *)data;
 
+    image_scan_incomplete = false;
     ret = util_list_all_subdir(img_data->image_home, &image_dirs);
     if (ret != 0) {
         ERROR("Failed to get images directory");
@@ -91,6 +94,7 @@ static int remote_dir_scan(void *data)
 
         if (image_store_validate_manifest_schema_version_1(image_path, &is_v1_image) != 0) {
             ERROR("Failed to validate manifest schema version 1 format");
+            image_scan_incomplete = true;
             continue;
         }
 
@@ -158,13 +162,17 @@ static int remote_image_add(void *data)
     return ret;
 }
 
-void remote_image_refresh(struct remote_image_data *data) {
+int remote_image_refresh(struct remote_image_data *data)
+{
     if (remote_dir_scan(data) != 0) {
         ERROR("remote overlay failed to scan dir, skip refresh");
-        return;
+        return -1;
     }
 
     if (remote_image_add(data) != 0) {
         ERROR("refresh overlay failed");
+        return -1;
     }
+
+    return image_scan_incomplete ? -1 : 0;
 }
@@ -207,16 +207,19 @@ static int remote_layer_add(struct remote_layer_data *data)
     return ret;
 }
 
-void remote_layer_refresh(struct remote_layer_data *data)
+int remote_layer_refresh(struct remote_layer_data *data)
 {
     if (remote_dir_scan(data) != 0) {
         ERROR("remote layer failed to scan dir, skip refresh");
-        return;
+        return -1;
     }
 
     if (remote_layer_add(data) != 0) {
         ERROR("refresh overlay failed");
+        return -1;
     }
+
+    return 0;
 }
 
 
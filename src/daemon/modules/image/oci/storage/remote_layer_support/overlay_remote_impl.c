@@ -15,7 +15,15 @@
 #define _GNU_SOURCE
 #include "remote_support.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "map.h"
 #include "ro_symlink_maintain.h"
@@ -24,16 +32,42 @@
 #include "utils.h"
 #include "utils_array.h"
 #include "utils_file.h"
+#include "utils_string.h"
 #include "path.h"
 
 #define OVERLAY_LINK_DIR "l"
 #define OVERLAY_LAYER_LINK "link"
+#define OVERLAY_LAYER_DIFF "diff"
+// files of the layer to read ahead, one path relative to the diff dir per line
+#define OVERLAY_PREFETCH_LIST "prefetch"
+#define OVERLAY_PREFETCH_MAX_FILES 4096
+#define OVERLAY_PREFETCH_BUF_SIZE (128 * 1024)
+// layers waiting for the prefetch worker, layers added beyond it are not prefetched
+#define OVERLAY_PREFETCH_MAX_QUEUED 256
+// a file is read up to this size and for this long, so one huge or slow file does not stall the others
+#define OVERLAY_PREFETCH_MAX_FILE_SIZE (64 * 1024 * 1024)
+#define OVERLAY_PREFETCH_FILE_TIMEOUT 10
 
 // key: id, value: short id in 'l' dir
 // store short id to delete symbol link in 'l' dir
 static map_t *overlay_byid_old = NULL;
 static map_t *overlay_byid_new = NULL;
 static map_t *overlay_id_link = NULL;
+// dirs of layers added by the last refresh which have a prefetch list
+static char **overlay_prefetch_dirs = NULL;
+
+// a single worker prefetches the queued layers one after another
+struct overlay_prefetcher {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    char **queue;
+    bool started;
+};
+
+static struct overlay_prefetcher g_prefetcher = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
 
 struct remote_overlay_data *remote_overlay_create(const char *remote_home, const char *remote_ro)
 {
@@ -60,6 +94,8 @@ void remote_overlay_destroy(struct remote_overlay_data *data)
     map_free(overlay_byid_old);
     map_free(overlay_byid_new);
     map_free(overlay_id_link);
+    util_free_array(overlay_prefetch_dirs);
+    overlay_prefetch_dirs = NULL;
     free(data);
 }
 
@@ -198,6 +234,7 @@ static int add_one_remote_overlay_layer(struct remote_overlay_data *data, const
     char *layer_dir = NULL;
     char *link_file = NULL;
     char *diff_symlink = NULL;
+    char *prefetch_list = NULL;
     int ret = 0;
 
     if (overlay_id == NULL) {
@@ -259,11 +296,17 @@ static int add_one_remote_overlay_layer(struct remote_overlay_data *data, const
         ret = -1;
     }
 
+    prefetch_list = util_path_join(layer_dir, OVERLAY_PREFETCH_LIST);
+    if (ret == 0 && prefetch_list != NULL && util_file_exists(prefetch_list)) {
+        (void)util_array_append(&overlay_prefetch_dirs, layer_dir);
+    }
+
 free_out:
     free(ro_symlink);
     free(layer_dir);
     free(link_file);
     free(diff_symlink);
+    free(prefetch_list);
 
     return ret;
 }
@@ -311,16 +354,267 @@ static int remote_image_add(struct remote_overlay_data *data)
     return ret;
 }
 
-void remote_overlay_refresh(struct remote_overlay_data *data)
+int remote_overlay_refresh(struct remote_overlay_data *data)
 {
     if (remote_dir_scan(data) != 0) {
         ERROR("remote overlay failed to scan dir, skip refresh");
-        return;
+        return -1;
     }
 
     if (remote_image_add(data) != 0) {
         ERROR("refresh overlay failed");
+        return -1;
+    }
+
+    return 0;
+}
+
+char *remote_overlay_prefetch_path(const char *diff_dir, const char *file)
+{
+    char *joined = NULL;
+    char clean_path[PATH_MAX] = { 0 };
+    char *ret = NULL;
+
+    if (diff_dir == NULL || file == NULL) {
+        return NULL;
+    }
+
+    joined = util_path_join(diff_dir, file);
+    if (joined == NULL || util_clean_path(joined, clean_path, sizeof(clean_path)) == NULL) {
+        goto out;
+    }
+    // the list is written by whoever provides the layer, never read outside of it
+    if (!util_has_prefix(clean_path, diff_dir) || clean_path[strlen(diff_dir)] != '/') {
+        WARN("Skip prefetch of %s outside of %s", file, diff_dir);
+        goto out;
+    }
+
+    ret = util_strdup_s(clean_path);
+
+out:
+    free(joined);
+    return ret;
+}
+
+static int64_t prefetch_now_seconds()
+{
+    struct timespec ts = { 0 };
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec;
+}
+
+// walk the path one component at a time, so a symlink at any level can not lead out of diff_dir
+int remote_overlay_prefetch_open(const char *diff_dir, const char *file)
+{
+    char *path = NULL;
+    char **parts = NULL;
+    struct stat st = { 0 };
+    size_t len = 0;
+    size_t i;
+    int dirfd = -1;
+    int nfd = -1;
+    int fd = -1;
+
+    path = remote_overlay_prefetch_path(diff_dir, file);
+    if (path == NULL) {
+        return -1;
+    }
+
+    parts = util_string_split_multi(path + strlen(diff_dir) + 1, '/');
+    len = util_array_len((const char **)parts);
+    if (len == 0) {
+        goto out;
+    }
+
+    dirfd = util_open(diff_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC, 0);
+    if (dirfd < 0) {
+        goto out;
+    }
+
+    for (i = 0; i + 1 < len; i++) {
+        nfd = openat(dirfd, parts[i], O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        close(dirfd);
+        dirfd = nfd;
+        if (dirfd < 0) {
+            DEBUG("Skip prefetch of %s: %s", path, strerror(errno));
+            goto out;
+        }
+    }
+
+    // never open a fifo or a device
+    if (fstatat(dirfd, parts[len - 1], &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(st.st_mode)) {
+        goto out;
+    }
+    fd = openat(dirfd, parts[len - 1], O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+    // replaced after the check
+    if (fd >= 0 && (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))) {
+        close(fd);
+        fd = -1;
+    }
+
+out:
+    if (dirfd >= 0) {
+        close(dirfd);
+    }
+    util_free_array(parts);
+    free(path);
+    return fd;
+}
+
+// read the file so a lazily fetched layer gets its chunks before the container needs them
+static void prefetch_one_file(const char *diff_dir, const char *file, char *buf)
+{
+    ssize_t len = 0;
+    size_t total = 0;
+    int64_t deadline = prefetch_now_seconds() + OVERLAY_PREFETCH_FILE_TIMEOUT;
+    int fd = -1;
+
+    fd = remote_overlay_prefetch_open(diff_dir, file);
+    if (fd < 0) {
+        return;
+    }
+
+    while (total < OVERLAY_PREFETCH_MAX_FILE_SIZE) {
+        len = util_read_nointr(fd, buf, OVERLAY_PREFETCH_BUF_SIZE);
+        if (len <= 0) {
+            break;
+        }
+        total += (size_t)len;
+        if (prefetch_now_seconds() >= deadline) {
+            WARN("Prefetch of %s timed out after %zu bytes", file, total);
+            break;
+        }
+    }
+
+    close(fd);
+}
+
+static void prefetch_one_layer(const char *layer_dir, char *buf)
+{
+    char *list_file = NULL;
+    char *content = NULL;
+    char *diff_dir = NULL;
+    char **files = NULL;
+    size_t i;
+
+    list_file = util_path_join(layer_dir, OVERLAY_PREFETCH_LIST);
+    diff_dir = util_path_join(layer_dir, OVERLAY_LAYER_DIFF);
+    if (list_file == NULL || diff_dir == NULL) {
+        goto out;
+    }
+
+    content = util_read_content_from_file(list_file);
+    if (content == NULL) {
+        WARN("Failed to read prefetch list of layer %s", layer_dir);
+        goto out;
+    }
+
+    files = util_string_split_multi(content, '\n');
+    for (i = 0; files != NULL && files[i] != NULL && i < OVERLAY_PREFETCH_MAX_FILES; i++) {
+        if (files[i][0] == '\0') {
+            continue;
+        }
+        prefetch_one_file(diff_dir, files[i], buf);
     }
+    DEBUG("Prefetched %zu files of layer %s", i, layer_dir);
+
+out:
+    util_free_array(files);
+    free(content);
+    free(diff_dir);
+    free(list_file);
+}
+
+static void *overlay_prefetch_routine(void *arg)
+{
+    char **layer_dirs = NULL;
+    char *buf = NULL;
+    size_t i;
+
+    prctl(PR_SET_NAME, "RoLayerPrefetch");
+
+    buf = util_common_calloc_s(OVERLAY_PREFETCH_BUF_SIZE);
+    if (buf == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+
+    for (;;) {
+        (void)pthread_mutex_lock(&g_prefetcher.mutex);
+        while (g_prefetcher.queue == NULL) {
+            (void)pthread_cond_wait(&g_prefetcher.cond, &g_prefetcher.mutex);
+        }
+        layer_dirs = g_prefetcher.queue;
+        g_prefetcher.queue = NULL;
+        (void)pthread_mutex_unlock(&g_prefetcher.mutex);
+
+        for (i = 0; layer_dirs[i] != NULL; i++) {
+            prefetch_one_layer(layer_dirs[i], buf);
+        }
+        util_free_array(layer_dirs);
+    }
+
+    return NULL;
+}
+
+static int start_prefetch_worker_locked()
+{
+    pthread_t a_thread;
+
+    if (g_prefetcher.started) {
+        return 0;
+    }
+
+    if (pthread_create(&a_thread, NULL, overlay_prefetch_routine, NULL) != 0) {
+        ERROR("Failed to start prefetch thread");
+        return -1;
+    }
+
+    if (pthread_detach(a_thread) != 0) {
+        SYSERROR("Failed to detach 0x%lx", a_thread);
+    }
+    g_prefetcher.started = true;
+
+    return 0;
+}
+
+void remote_overlay_prefetch(struct remote_overlay_data *data)
+{
+    char **layer_dirs = overlay_prefetch_dirs;
+    size_t queued = 0;
+    size_t i;
+
+    if (data == NULL || layer_dirs == NULL) {
+        return;
+    }
+    overlay_prefetch_dirs = NULL;
+
+    (void)pthread_mutex_lock(&g_prefetcher.mutex);
+    if (start_prefetch_worker_locked() != 0) {
+        goto unlock_out;
+    }
+
+    queued = util_array_len((const char **)g_prefetcher.queue);
+    for (i = 0; layer_dirs[i] != NULL; i++) {
+        if (util_strings_in_slice((const char **)g_prefetcher.queue, queued, layer_dirs[i])) {
+            continue;
+        }
+        if (queued >= OVERLAY_PREFETCH_MAX_QUEUED) {
+            WARN("Too many layers to prefetch, skip layer %s", layer_dirs[i]);
+            continue;
+        }
+        if (util_array_append(&g_prefetcher.queue, layer_dirs[i]) != 0) {
+            ERROR("Out of memory");
+            break;
+        }
+        queued++;
+    }
+    (void)pthread_cond_signal(&g_prefetcher.cond);
+
+unlock_out:
+    (void)pthread_mutex_unlock(&g_prefetcher.mutex);
+    util_free_array(layer_dirs);
 }
 
 bool remote_overlay_layer_valid(const char *layer_id)
@@ -15,11 +15,22 @@
 
 #include "remote_support.h"
 
+#include <errno.h>
+#include <poll.h>
 #include <pthread.h>
+#include <unistd.h>
+#include <sys/inotify.h>
 
 #include "isula_libutils/log.h"
 #include "utils.h"
 
+#define REMOTE_POLL_INTERVAL_MS (5 * 1000)
+// a burst of changes, e.g. a new layer dir and its files, is refreshed once it is quiet for this long
+#define REMOTE_DEBOUNCE_MS 200
+#define REMOTE_RETRY_MIN_MS 1000
+// full refresh even without events, in case of a missed or overflowed event queue
+#define REMOTE_FALLBACK_MS (60 * 1000)
+
 struct supporters {
     struct remote_image_data *image_data;
     struct remote_layer_data *layer_data;
@@ -56,23 +67,107 @@ static inline void remote_refresh_unlock(pthread_rwlock_t *remote_lock)
     }
 }
 
+static int remote_refresh_all(struct supporters *refresh_supporters)
+{
+    int ret = 0;
+
+    DEBUG("remote refresh start\n");
+
+    remote_refresh_lock(refresh_supporters->remote_lock, true);
+    if (remote_overlay_refresh(refresh_supporters->overlay_data) != 0) {
+        ret = -1;
+    }
+    if (remote_layer_refresh(refresh_supporters->layer_data) != 0) {
+        ret = -1;
+    }
+    if (remote_image_refresh(refresh_supporters->image_data) != 0) {
+        ret = -1;
+    }
+    remote_refresh_unlock(refresh_supporters->remote_lock);
+
+    remote_overlay_prefetch(refresh_supporters->overlay_data);
+
+    DEBUG("remote refresh end\n");
+    return ret;
+}
+
+static int remote_watch_init(struct supporters *refresh_supporters)
+{
+    uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+    const char *dirs[] = { refresh_supporters->overlay_data->overlay_ro, refresh_supporters->layer_data->layer_ro,
+                           refresh_supporters->image_data->image_home };
+    size_t i;
+    int fd = -1;
+
+    fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0) {
+        SYSWARN("Failed to init inotify");
+        return -1;
+    }
+
+    for (i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        if (dirs[i] != NULL && inotify_add_watch(fd, dirs[i], mask) < 0) {
+            SYSWARN("Failed to watch %s", dirs[i]);
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+// wait until the watched dirs change and stay quiet for a while, returns false on timeout
+static bool remote_wait_changes(int fd, int timeout_ms)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int nret = 0;
+
+    nret = poll(&pfd, 1, timeout_ms);
+    if (nret < 0 && errno != EINTR) {
+        SYSERROR("Failed to wait for remote dir changes");
+        util_usleep_nointerupt(REMOTE_RETRY_MIN_MS * 1000);
+    }
+    if (nret <= 0) {
+        return false;
+    }
+
+    // only whether anything changed matters, the refresh rescans the dirs
+    do {
+        while (util_read_nointr(fd, buf, sizeof(buf)) > 0) {
+        }
+    } while (poll(&pfd, 1, REMOTE_DEBOUNCE_MS) > 0);
+
+    return true;
+}
+
 static void *remote_refresh_ro_symbol_link(void *arg)
 {
     struct supporters *refresh_supporters = (struct supporters *)arg;
-    prctl(PR_SET_NAME, "RoLayerRefresh");
+    int retry_ms = REMOTE_RETRY_MIN_MS;
+    bool failed = true;
+    int fd = -1;
 
-    while (true) {
-        util_usleep_nointerupt(5 * 1000 * 1000);
-        DEBUG("remote refresh start\n");
+    prctl(PR_SET_NAME, "RoLayerRefresh");
 
-        remote_refresh_lock(supporters.remote_lock, true);
-        remote_overlay_refresh(refresh_supporters->overlay_data);
-        remote_layer_refresh(refresh_supporters->layer_data);
-        remote_image_refresh(refresh_supporters->image_data);
-        remote_refresh_unlock(supporters.remote_lock);
+    fd = remote_watch_init(refresh_supporters);
+    if (fd < 0) {
+        WARN("Refresh remote layers by polling");
+        while (true) {
+            util_usleep_nointerupt(REMOTE_POLL_INTERVAL_MS * 1000);
+            (void)remote_refresh_all(refresh_supporters);
+        }
+    }
 
-        DEBUG("remote refresh end\n");
+    // changes made before the watches were added are picked up by the first refresh soon after start
+    while (true) {
+        (void)remote_wait_changes(fd, failed ? retry_ms : REMOTE_FALLBACK_MS);
+        failed = remote_refresh_all(refresh_supporters) != 0;
+        // entries still being written are retried soon, broken ones less and less often
+        retry_ms = failed ? (retry_ms * 2 > REMOTE_FALLBACK_MS ? REMOTE_FALLBACK_MS : retry_ms * 2) :
+                   REMOTE_RETRY_MIN_MS;
     }
+
     return NULL;
 }
 
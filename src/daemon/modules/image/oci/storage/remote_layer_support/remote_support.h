@@ -45,14 +45,15 @@ struct remote_image_data *remote_image_create(const char *image_home, const char
 
 void remote_image_destroy(struct remote_image_data *data);
 
-void remote_image_refresh(struct remote_image_data *data);
+// returns -1 if some entries could not be refreshed yet and should be tried again
+int remote_image_refresh(struct remote_image_data *data);
 
 // layer impl
 struct remote_layer_data *remote_layer_create(const char *layer_home, const char *layer_ro);
 
 void remote_layer_destroy(struct remote_layer_data *data);
 
-void remote_layer_refresh(struct remote_layer_data *data);
+int remote_layer_refresh(struct remote_layer_data *data);
 
 bool remote_layer_layer_valid(const char *layer_id);
 
@@ -61,7 +62,16 @@ struct remote_overlay_data *remote_overlay_create(const char *overlay_home, cons
 
 void remote_overlay_destroy(struct remote_overlay_data *data);
 
-void remote_overlay_refresh(struct remote_overlay_data *data);
+int remote_overlay_refresh(struct remote_overlay_data *data);
+
+// queue the layers added since the last call for the prefetch worker, which reads ahead the files they list
+void remote_overlay_prefetch(struct remote_overlay_data *data);
+
+// path of a file listed for prefetch in diff_dir, NULL if it is outside of diff_dir
+char *remote_overlay_prefetch_path(const char *diff_dir, const char *file);
+
+// open a regular file listed for prefetch without following any symlink under diff_dir, -1 if failed
+int remote_overlay_prefetch_open(const char *diff_dir, const char *file);
 
 bool remote_overlay_layer_valid(const char *layer_id);
 
@@ -1065,6 +1065,7 @@ void storage_module_exit()
 {
     free(g_storage_run_root);
     g_storage_run_root = NULL;
+    image_store_save_index();
     layer_store_exit();
 }
 
@@ -31,6 +31,9 @@
 #include "err_msg.h"
 #include "runtime_api.h"
 #include "utils_file.h"
+#ifndef DISABLE_CLEANUP
+#include "leftover_cleanup_api.h"
+#endif
 
 bool rt_lcr_detect(const char *runtime)
 {
@@ -207,7 +210,11 @@ static int remove_container_rootpath(const char *id, const char *root_path)
         ret = -1;
         goto out;
     }
+#ifndef DISABLE_CLEANUP
+    ret = clean_module_remove_dir_async(cont_root_path);
+#else
     ret = util_recursive_rmdir(cont_root_path, 0);
+#endif
     if (ret != 0) {
         const char *tmp_err = (errno != 0) ? strerror(errno) : "error";
         ERROR("Failed to delete container's root directory %s: %s", cont_root_path, tmp_err);
@@ -0,0 +1,185 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ * Description: client of the exec service in the container shim
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include "isula_exec_service.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include "isula_libutils/log.h"
+#include "err_msg.h"
+#include "utils_file.h"
+#include "utils_timestamp.h"
+
+#define EXEC_SERVICE_WAIT_TIME 10
+// same as waiting for the pid file of a new exec shim
+#define EXEC_PID_WAIT_TIME 120
+
+static int exec_service_connect(const char *state, const char *id)
+{
+    struct sockaddr_un addr;
+    int nret;
+    int fd = -1;
+
+    (void)memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    nret = snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%s/%s", state, id, EXEC_SOCK_NAME);
+    if (nret < 0 || (size_t)nret >= sizeof(addr.sun_path)) {
+        DEBUG("Exec service path of %s is too long", id);
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        SYSERROR("Failed to create socket for exec service");
+        return -1;
+    }
+
+    // shims started by old versions have no exec service
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        DEBUG("Failed to connect exec service %s: %s", addr.sun_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int exec_wait_timeout(int64_t deadline)
+{
+    int64_t now;
+
+    if (deadline < 0) {
+        return -1;
+    }
+
+    now = util_get_now_time_nanos();
+    if (now >= deadline) {
+        return 0;
+    }
+
+    return (int)((deadline - now + Time_Milli - 1) / Time_Milli);
+}
+
+// returns -2 if no message is received before deadline, deadline < 0 means no limit
+static int read_exec_msg(int fd, exec_msg_t *msg, int64_t deadline)
+{
+    size_t total = 0;
+
+    while (total < sizeof(*msg)) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        ssize_t nread;
+        int nret;
+
+        nret = poll(&pfd, 1, exec_wait_timeout(deadline));
+        if (nret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (nret == 0) {
+            return -2;
+        }
+
+        nread = util_read_nointr(fd, (char *)msg + total, sizeof(*msg) - total);
+        if (nread <= 0) {
+            return -1;
+        }
+        total += (size_t)nread;
+    }
+
+    return 0;
+}
+
+static int exec_by_service(int fd, const char *workdir, bool fg, int64_t timeout, int *exit_code)
+{
+    exec_msg_t msg = { 0 };
+    pid_t shim_pid = -1;
+    int64_t deadline = -1;
+    int nret;
+
+    if (util_write_nointr(fd, workdir, strlen(workdir) + 1) != (ssize_t)(strlen(workdir) + 1)) {
+        return EXEC_SERVICE_UNAVAILABLE;
+    }
+
+    // the exec is started only after the shim pid is sent, it is safe to start a new shim if it is not received
+    nret = read_exec_msg(fd, &msg, util_get_now_time_nanos() + EXEC_SERVICE_WAIT_TIME * Time_Second);
+    if (nret == -1) {
+        return EXEC_SERVICE_UNAVAILABLE;
+    }
+    if (nret != 0 || msg.type != EXEC_MSG_SHIM_PID) {
+        ERROR("Exec service does not respond");
+        return -1;
+    }
+    shim_pid = msg.value;
+
+    if (timeout > 0) {
+        deadline = util_get_now_time_nanos() + timeout * Time_Second;
+    } else if (!fg) {
+        deadline = util_get_now_time_nanos() + EXEC_PID_WAIT_TIME * Time_Second;
+    }
+
+    nret = read_exec_msg(fd, &msg, deadline);
+    if (nret == 0 && msg.type == EXEC_MSG_PID && !fg) {
+        *exit_code = 0;
+        return 0;
+    }
+    if (nret == 0 && msg.type == EXEC_MSG_PID) {
+        nret = read_exec_msg(fd, &msg, deadline);
+    }
+
+    if (nret == -2) {
+        kill(shim_pid, SIGKILL);
+        isulad_set_error_message("Exec container error;exec timeout");
+        return -1;
+    }
+    if (nret != 0 || msg.type != EXEC_MSG_EXIT) {
+        ERROR("Exec shim %d exited without exit status", shim_pid);
+        return -1;
+    }
+
+    *exit_code = msg.value;
+    return 0;
+}
+
+int isula_exec_by_service(const char *state, const char *id, const char *workdir, bool fg, int64_t timeout,
+                          int *exit_code)
+{
+    int fd = -1;
+    int ret = 0;
+
+    if (state == NULL || id == NULL || workdir == NULL || exit_code == NULL) {
+        ERROR("Invalid NULL param");
+        return -1;
+    }
+
+    fd = exec_service_connect(state, id);
+    if (fd < 0) {
+        return EXEC_SERVICE_UNAVAILABLE;
+    }
+
+    ret = exec_by_service(fd, workdir, fg, timeout, exit_code);
+    close(fd);
+    return ret;
+}
@@ -0,0 +1,43 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ * Description: client of the exec service in the container shim
+ ******************************************************************************/
+
+#ifndef DAEMON_MODULES_RUNTIME_ISULA_ISULA_EXEC_SERVICE_H
+#define DAEMON_MODULES_RUNTIME_ISULA_ISULA_EXEC_SERVICE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "container_exec_service.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the exec service did not take the exec, start a new shim for it
+#define EXEC_SERVICE_UNAVAILABLE 1
+
+/*
+ * Run the exec prepared in workdir by the exec service of the shim of container id.
+ * Return EXEC_SERVICE_UNAVAILABLE if there is no service or it closes the connection
+ * before taking the exec, 0 if the exec is done or, for a detached exec, started.
+ */
+int isula_exec_by_service(const char *state, const char *id, const char *workdir, bool fg, int64_t timeout,
+                          int *exit_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DAEMON_MODULES_RUNTIME_ISULA_ISULA_EXEC_SERVICE_H
@@ -49,6 +49,10 @@
 #include "utils_convert.h"
 #include "utils_file.h"
 #include "console.h"
+#include "isula_exec_service.h"
+#ifndef DISABLE_CLEANUP
+#include "leftover_cleanup_api.h"
+#endif
 
 #define SHIM_BINARY "isulad-shim"
 #define RESIZE_FIFO_NAME "resize_fifo"
@@ -1080,7 +1084,11 @@ int rt_isula_rm(const char *id, const char *runtime, const rt_rm_params_t *param
         return -1;
     }
 
+#ifndef DISABLE_CLEANUP
+    if (clean_module_remove_dir_async(libdir) != 0) {
+#else
     if (util_recursive_rmdir(libdir, 0) != 0) {
+#endif
         ERROR("failed rmdir -r shim workdir");
         return -1;
     }
@@ -1157,7 +1165,7 @@ int rt_isula_exec(const char *id, const char *runtime, const rt_exec_params_t *p
         return -1;
     }
 
-    ret = snprintf(workdir, sizeof(workdir), "%s/%s/exec/%s", params->state, id, exec_id);
+    ret = snprintf(workdir, sizeof(workdir), "%s/%s/%s/%s", params->state, id, EXEC_DIR_NAME, exec_id);
     if (ret < 0) {
         ERROR("failed join exec full path");
         goto out;
@@ -1195,6 +1203,15 @@ int rt_isula_exec(const char *id, const char *runtime, const rt_exec_params_t *p
         goto del_out;
     }
 
+    ret = isula_exec_by_service(params->state, id, workdir, fg_exec(params), params->timeout, exit_code);
+    if (ret != EXEC_SERVICE_UNAVAILABLE) {
+        if (ret != 0) {
+            ERROR("%s: failed exec %s by exec service", id, exec_id);
+        }
+        goto errlog_out;
+    }
+    INFO("%s: exec service is unavailable, create shim process for exec %s", id, exec_id);
+
     get_runtime_cmd(runtime, &cmd);
     ret = shim_create(fg_exec(params), id, workdir, bundle, cmd, exit_code, params->timeout);
     if (ret != 0) {
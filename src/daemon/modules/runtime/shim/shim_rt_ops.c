@@ -29,6 +29,9 @@
 #include "error.h"
 #include "err_msg.h"
 #include "engine.h"
+#ifndef DISABLE_CLEANUP
+#include "leftover_cleanup_api.h"
+#endif
 
 #define EXIT_SIGNAL_OFFSET_X 128
 
@@ -470,7 +473,11 @@ int rt_shim_rm(const char *id, const char *runtime, const rt_rm_params_t *params
         goto out;
     }
 
+#ifndef DISABLE_CLEANUP
+    if (clean_module_remove_dir_async(libdir) != 0) {
+#else
     if (util_recursive_rmdir(libdir, 0) != 0) {
+#endif
         ERROR("failed to get shim workdir");
         ret = -1;
         goto out;
@@ -845,3 +845,120 @@ out:
     }
     return inspect;
 }
+
+// fields of common config packed here are fixed once the container is created
+static int pack_status_fixed_data(const container_t *cont, container_inspect *inspect)
+{
+    const container_config *config = cont->common_config->config;
+
+    inspect->id = util_strdup_s(cont->common_config->id);
+    inspect->created = util_strdup_s(cont->common_config->created);
+    inspect->log_path = util_strdup_s(cont->common_config->log_path);
+    inspect->process_label = util_strdup_s(cont->common_config->process_label);
+
+    inspect->config = util_common_calloc_s(sizeof(container_inspect_config));
+    if (inspect->config == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+    inspect->config->image =
+        cont->common_config->image ? util_strdup_s(cont->common_config->image) : util_strdup_s("none");
+
+    if (config != NULL) {
+        inspect->config->image_ref = util_strdup_s(config->image_ref);
+        if (dup_container_config_labels(config, inspect->config) != 0 ||
+            dup_container_config_annotations(config, inspect->config) != 0) {
+            ERROR("Failed to dup labels and annotations");
+            return -1;
+        }
+    }
+
+    if (mount_point_to_inspect(cont, inspect) != 0) {
+        ERROR("Failed to transform to mount point");
+        return -1;
+    }
+
+    return 0;
+}
+
+// only namespace modes of host config are needed by the status of sandbox
+static int pack_status_network_data(const container_t *cont, container_inspect *inspect)
+{
+    if (pack_inspect_network_settings(cont, inspect) != 0) {
+        return -1;
+    }
+
+    if (cont->hostconfig == NULL) {
+        return 0;
+    }
+
+    inspect->host_config = util_common_calloc_s(sizeof(host_config));
+    if (inspect->host_config == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+    inspect->host_config->network_mode = util_strdup_s(cont->hostconfig->network_mode);
+    inspect->host_config->pid_mode = util_strdup_s(cont->hostconfig->pid_mode);
+    inspect->host_config->ipc_mode = util_strdup_s(cont->hostconfig->ipc_mode);
+
+    return 0;
+}
+
+container_inspect *inspect_container_status(const char *id, int timeout, bool with_network)
+{
+    int ret = -1;
+    container_inspect *inspect = NULL;
+    container_t *cont = NULL;
+
+    if (!util_valid_container_id_or_name(id)) {
+        ERROR("Inspect invalid name %s", id);
+        isulad_set_error_message("Inspect invalid name %s", id);
+        goto out;
+    }
+
+    cont = containers_store_get(id);
+    if (cont == NULL) {
+        isulad_try_set_error_message("No such image or container or accelerator:%s", id);
+        goto out;
+    }
+
+    inspect = util_common_calloc_s(sizeof(container_inspect));
+    if (inspect == NULL) {
+        ERROR("Out of memory");
+        goto out;
+    }
+
+    if (pack_status_fixed_data(cont, inspect) != 0) {
+        goto out;
+    }
+
+    // state is protected by its own lock
+    if (pack_inspect_container_state(cont, inspect) != 0) {
+        goto out;
+    }
+
+    if (!with_network) {
+        ret = 0;
+        goto out;
+    }
+
+    if (container_timedlock(cont, timeout) != 0) {
+        ERROR("Container %s inspect failed due to trylock timeout for %ds.", id, timeout);
+        isulad_try_set_error_message("Container %s inspect failed due to trylock timeout for %ds.", id, timeout);
+        goto out;
+    }
+    if (pack_status_network_data(cont, inspect) != 0) {
+        ERROR("Failed to pack network data of %s", id);
+    } else {
+        ret = 0;
+    }
+    container_unlock(cont);
+
+out:
+    container_unref(cont);
+    if (ret != 0) {
+        free_container_inspect(inspect);
+        inspect = NULL;
+    }
+    return inspect;
+}
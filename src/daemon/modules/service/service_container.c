@@ -65,6 +65,7 @@
 #include "volume_api.h"
 #include "utils_network.h"
 #include "network_namespace.h"
+#include "state_journal.h"
 #ifdef ENABLE_NATIVE_NETWORK
 #include "service_network_api.h"
 #endif
@@ -1252,6 +1253,10 @@ static int do_delete_container(container_t *cont)
     // clean residual mount points
     cleanup_mounts_by_id(id, rootpath);
 
+    if (container_state_journal_remove(rootpath, id) != 0) {
+        WARN("Failed to write journal state of container %s", id);
+    }
+
     if (do_runtime_rm_helper(id, runtime, rootpath) != 0) {
         ret = -1;
         goto out;
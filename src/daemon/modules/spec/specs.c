@@ -35,6 +35,7 @@
 #include "isulad_config.h"
 #include "namespace.h"
 #include "specs_security.h"
+#include "specs_cache.h"
 #include "specs_mount.h"
 #include "specs_extend.h"
 #include "specs_namespace.h"
@@ -387,7 +388,7 @@ oci_runtime_spec *default_spec(bool system_container)
     parser_error err = NULL;
 
     /* parse the input oci file */
-    oci_spec = oci_runtime_spec_parse_file(oci_file, NULL, &err);
+    oci_spec = specs_cache_get_spec_template(oci_file, &err);
     if (oci_spec == NULL) {
         ERROR("Failed to parse OCI specification file \"%s\", error message: %s", oci_file, err);
         isulad_set_error_message("Can not read the default /etc/default/isulad/config.json file: %s", err);
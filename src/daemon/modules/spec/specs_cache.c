@@ -0,0 +1,494 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ * Description: provide spec template cache functions
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include "specs_cache.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <yajl/yajl_tree.h>
+#include <isula_libutils/json_common.h>
+
+#include "isula_libutils/log.h"
+#include "map.h"
+#include "sha256.h"
+#include "utils.h"
+#include "utils_file.h"
+#include "utils_string.h"
+
+// translated seccomp profiles are dropped all together when there are too many
+#define SECCOMP_CACHE_MAX 64
+
+typedef struct cached_file {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    char *data;
+    // data parsed as spec template on first use
+    yajl_val tree;
+} cached_file_t;
+
+typedef struct specs_cache {
+    pthread_mutex_t mutex;
+    // file path --> cached_file_t *
+    map_t *files;
+    // profile version and capabilities --> oci_runtime_config_linux_seccomp *
+    map_t *seccomps;
+} specs_cache_t;
+
+static specs_cache_t g_specs_cache = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void specs_cache_lock()
+{
+    if (pthread_mutex_lock(&g_specs_cache.mutex) != 0) {
+        ERROR("Failed to lock specs cache");
+    }
+}
+
+static void specs_cache_unlock()
+{
+    if (pthread_mutex_unlock(&g_specs_cache.mutex) != 0) {
+        ERROR("Failed to unlock specs cache");
+    }
+}
+
+static void cached_files_kvfree(void *key, void *value)
+{
+    cached_file_t *cfile = (cached_file_t *)value;
+
+    free(key);
+    if (cfile != NULL) {
+        yajl_tree_free(cfile->tree);
+        free(cfile->data);
+        free(cfile);
+    }
+}
+
+static void cached_seccomps_kvfree(void *key, void *value)
+{
+    free(key);
+    free_oci_runtime_config_linux_seccomp((oci_runtime_config_linux_seccomp *)value);
+}
+
+static bool same_file(const cached_file_t *cfile, const struct stat *st)
+{
+    return cfile->dev == st->st_dev && cfile->ino == st->st_ino && cfile->size == st->st_size &&
+           cfile->mtime.tv_sec == st->st_mtim.tv_sec && cfile->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static char *file_version(const cached_file_t *cfile)
+{
+    char version[PATH_MAX] = { 0 };
+    int nret;
+
+    nret = snprintf(version, sizeof(version), "%llu:%llu:%lld:%lld.%ld", (unsigned long long)cfile->dev,
+                    (unsigned long long)cfile->ino, (long long)cfile->size, (long long)cfile->mtime.tv_sec,
+                    cfile->mtime.tv_nsec);
+    if (nret < 0 || (size_t)nret >= sizeof(version)) {
+        return NULL;
+    }
+
+    return util_strdup_s(version);
+}
+
+static cached_file_t *load_file_locked(const char *file, const struct stat *st)
+{
+    cached_file_t *cfile = NULL;
+
+    cfile = util_common_calloc_s(sizeof(cached_file_t));
+    if (cfile == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+
+    cfile->data = util_read_text_file(file);
+    if (cfile->data == NULL) {
+        ERROR("Failed to read %s", file);
+        free(cfile);
+        return NULL;
+    }
+    cfile->dev = st->st_dev;
+    cfile->ino = st->st_ino;
+    cfile->size = st->st_size;
+    cfile->mtime = st->st_mtim;
+
+    // the file may be replaced while reading, it is read again on next use then
+    if (!map_replace(g_specs_cache.files, (void *)file, cfile)) {
+        ERROR("Failed to cache %s", file);
+        free(cfile->data);
+        free(cfile);
+        return NULL;
+    }
+
+    return cfile;
+}
+
+static cached_file_t *get_file_locked(const char *file, const struct stat *st)
+{
+    cached_file_t *cfile = NULL;
+
+    if (g_specs_cache.files == NULL) {
+        g_specs_cache.files = map_new(MAP_STR_PTR, MAP_DEFAULT_CMP_FUNC, cached_files_kvfree);
+        if (g_specs_cache.files == NULL) {
+            ERROR("Out of memory");
+            return NULL;
+        }
+    }
+
+    cfile = map_search(g_specs_cache.files, (void *)file);
+    if (cfile != NULL && same_file(cfile, st)) {
+        return cfile;
+    }
+
+    return load_file_locked(file, st);
+}
+
+// returns content of file, and the version of content if version is not NULL
+static char *get_file_data(const char *file, char **version)
+{
+    struct stat st;
+    cached_file_t *cfile = NULL;
+    char *data = NULL;
+
+    if (stat(file, &st) != 0) {
+        SYSERROR("Failed to stat %s", file);
+        return NULL;
+    }
+
+    specs_cache_lock();
+    cfile = get_file_locked(file, &st);
+    if (cfile == NULL) {
+        goto out;
+    }
+
+    if (version != NULL) {
+        *version = file_version(cfile);
+        if (*version == NULL) {
+            ERROR("Out of memory");
+            goto out;
+        }
+    }
+    data = util_strdup_s(cfile->data);
+
+out:
+    specs_cache_unlock();
+    return data;
+}
+
+oci_runtime_spec *specs_cache_get_spec_template(const char *file, parser_error *err)
+{
+    struct parser_context ctx = { 0 };
+    char errbuf[BUFSIZ] = { 0 };
+    struct stat st;
+    cached_file_t *cfile = NULL;
+    oci_runtime_spec *spec = NULL;
+
+    if (file == NULL || err == NULL) {
+        return NULL;
+    }
+
+    if (stat(file, &st) != 0) {
+        // parse the file directly for the error message
+        return oci_runtime_spec_parse_file(file, NULL, err);
+    }
+
+    specs_cache_lock();
+    cfile = get_file_locked(file, &st);
+    if (cfile == NULL) {
+        specs_cache_unlock();
+        return oci_runtime_spec_parse_file(file, NULL, err);
+    }
+
+    if (cfile->tree == NULL) {
+        cfile->tree = yajl_tree_parse(cfile->data, errbuf, sizeof(errbuf));
+        if (cfile->tree == NULL) {
+            // parse the data directly for the error message
+            spec = oci_runtime_spec_parse_data(cfile->data, NULL, err);
+            goto out;
+        }
+    }
+
+    // the parsed template is shared, every caller gets its own spec made from it
+    spec = make_oci_runtime_spec(cfile->tree, &ctx, err);
+
+out:
+    specs_cache_unlock();
+    return spec;
+}
+
+static defs_syscall *dup_syscall(const defs_syscall *src)
+{
+    defs_syscall *dst = NULL;
+    size_t i;
+
+    dst = util_common_calloc_s(sizeof(defs_syscall));
+    if (dst == NULL) {
+        return NULL;
+    }
+
+    if (src->names_len > 0) {
+        dst->names = util_str_array_dup((const char **)src->names, src->names_len);
+        if (dst->names == NULL) {
+            goto err_out;
+        }
+        dst->names_len = src->names_len;
+    }
+    dst->action = util_strdup_s(src->action);
+
+    if (src->args_len == 0) {
+        return dst;
+    }
+    dst->args = util_smart_calloc_s(sizeof(defs_syscall_arg *), src->args_len);
+    if (dst->args == NULL) {
+        goto err_out;
+    }
+    for (i = 0; i < src->args_len; i++) {
+        dst->args[i] = util_common_calloc_s(sizeof(defs_syscall_arg));
+        if (dst->args[i] == NULL) {
+            goto err_out;
+        }
+        dst->args_len++;
+        dst->args[i]->index = src->args[i]->index;
+        dst->args[i]->value = src->args[i]->value;
+        dst->args[i]->value_two = src->args[i]->value_two;
+        dst->args[i]->op = util_strdup_s(src->args[i]->op);
+    }
+
+    return dst;
+
+err_out:
+    free_defs_syscall(dst);
+    return NULL;
+}
+
+// copy the fields set by the translation from docker seccomp profile
+static oci_runtime_config_linux_seccomp *dup_seccomp(const oci_runtime_config_linux_seccomp *src)
+{
+    oci_runtime_config_linux_seccomp *dst = NULL;
+    size_t i;
+
+    dst = util_common_calloc_s(sizeof(oci_runtime_config_linux_seccomp));
+    if (dst == NULL) {
+        goto err_out;
+    }
+
+    dst->default_action = util_strdup_s(src->default_action);
+
+    if (src->architectures_len > 0) {
+        dst->architectures = util_str_array_dup((const char **)src->architectures, src->architectures_len);
+        if (dst->architectures == NULL) {
+            goto err_out;
+        }
+        dst->architectures_len = src->architectures_len;
+    }
+
+    if (src->syscalls_len == 0) {
+        return dst;
+    }
+    dst->syscalls = util_smart_calloc_s(sizeof(defs_syscall *), src->syscalls_len);
+    if (dst->syscalls == NULL) {
+        goto err_out;
+    }
+    for (i = 0; i < src->syscalls_len; i++) {
+        dst->syscalls[i] = dup_syscall(src->syscalls[i]);
+        if (dst->syscalls[i] == NULL) {
+            goto err_out;
+        }
+        dst->syscalls_len++;
+    }
+
+    return dst;
+
+err_out:
+    ERROR("Out of memory");
+    free_oci_runtime_config_linux_seccomp(dst);
+    return NULL;
+}
+
+static char *seccomp_cache_key(const char *version, const defs_process_capabilities *capabilities)
+{
+    const char *parts[2] = { version, "" };
+    char *caps = NULL;
+    char *key = NULL;
+
+    if (capabilities != NULL && capabilities->bounding_len > 0) {
+        caps = util_string_join(",", (const char **)capabilities->bounding, capabilities->bounding_len);
+        if (caps == NULL) {
+            return NULL;
+        }
+        parts[1] = caps;
+    }
+
+    key = util_string_join(";", parts, 2);
+    free(caps);
+    return key;
+}
+
+static oci_runtime_config_linux_seccomp *search_seccomp(const char *key)
+{
+    oci_runtime_config_linux_seccomp *cached = NULL;
+    oci_runtime_config_linux_seccomp *seccomp = NULL;
+
+    specs_cache_lock();
+    if (g_specs_cache.seccomps != NULL) {
+        cached = map_search(g_specs_cache.seccomps, (void *)key);
+    }
+    if (cached != NULL) {
+        seccomp = dup_seccomp(cached);
+    }
+    specs_cache_unlock();
+
+    return seccomp;
+}
+
+static void add_seccomp(const char *key, const oci_runtime_config_linux_seccomp *seccomp)
+{
+    oci_runtime_config_linux_seccomp *cached = NULL;
+
+    cached = dup_seccomp(seccomp);
+    if (cached == NULL) {
+        return;
+    }
+
+    specs_cache_lock();
+    if (g_specs_cache.seccomps != NULL && map_size(g_specs_cache.seccomps) >= SECCOMP_CACHE_MAX) {
+        map_free(g_specs_cache.seccomps);
+        g_specs_cache.seccomps = NULL;
+    }
+    if (g_specs_cache.seccomps == NULL) {
+        g_specs_cache.seccomps = map_new(MAP_STR_PTR, MAP_DEFAULT_CMP_FUNC, cached_seccomps_kvfree);
+        if (g_specs_cache.seccomps == NULL) {
+            ERROR("Out of memory");
+            goto out;
+        }
+    }
+    if (!map_replace(g_specs_cache.seccomps, (void *)key, cached)) {
+        WARN("Failed to cache seccomp profile");
+        goto out;
+    }
+    cached = NULL;
+
+out:
+    specs_cache_unlock();
+    free_oci_runtime_config_linux_seccomp(cached);
+}
+
+static oci_runtime_config_linux_seccomp *get_seccomp(const char *version, const char *profile,
+                                                     const defs_process_capabilities *capabilities,
+                                                     seccomp_trans_func_t trans)
+{
+    oci_runtime_config_linux_seccomp *seccomp = NULL;
+    docker_seccomp *docker_seccomp_spec = NULL;
+    parser_error err = NULL;
+    char *key = NULL;
+
+    key = seccomp_cache_key(version, capabilities);
+    if (key != NULL) {
+        seccomp = search_seccomp(key);
+        if (seccomp != NULL) {
+            goto out;
+        }
+    }
+
+    docker_seccomp_spec = docker_seccomp_parse_data(profile, NULL, &err);
+    if (docker_seccomp_spec == NULL) {
+        ERROR("Failed to parse seccomp profile: %s", err);
+        goto out;
+    }
+
+    seccomp = trans(docker_seccomp_spec, capabilities);
+    if (seccomp != NULL && key != NULL) {
+        add_seccomp(key, seccomp);
+    }
+
+out:
+    free(err);
+    free(key);
+    free_docker_seccomp(docker_seccomp_spec);
+    return seccomp;
+}
+
+oci_runtime_config_linux_seccomp *specs_cache_get_file_seccomp(const char *file,
+                                                               const defs_process_capabilities *capabilities,
+                                                               seccomp_trans_func_t trans)
+{
+    oci_runtime_config_linux_seccomp *seccomp = NULL;
+    char *profile = NULL;
+    char *version = NULL;
+    char *file_key = NULL;
+    const char *parts[3] = { "file", file, NULL };
+
+    if (file == NULL || trans == NULL) {
+        return NULL;
+    }
+
+    profile = get_file_data(file, &version);
+    if (profile == NULL) {
+        return NULL;
+    }
+
+    parts[2] = version;
+    file_key = util_string_join(":", parts, 3);
+    if (file_key == NULL) {
+        ERROR("Out of memory");
+        goto out;
+    }
+
+    seccomp = get_seccomp(file_key, profile, capabilities, trans);
+
+out:
+    free(file_key);
+    free(version);
+    free(profile);
+    return seccomp;
+}
+
+oci_runtime_config_linux_seccomp *specs_cache_get_profile_seccomp(const char *profile,
+                                                                  const defs_process_capabilities *capabilities,
+                                                                  seccomp_trans_func_t trans)
+{
+    oci_runtime_config_linux_seccomp *seccomp = NULL;
+    char *digest = NULL;
+    char *profile_key = NULL;
+
+    if (profile == NULL || trans == NULL) {
+        return NULL;
+    }
+
+    // profiles from host config are usually the same default profile of cri
+    digest = sha256_digest_str(profile);
+    if (digest == NULL) {
+        ERROR("Failed to get digest of seccomp profile");
+        return NULL;
+    }
+    profile_key = util_string_append(digest, "data:");
+    if (profile_key == NULL) {
+        ERROR("Out of memory");
+        free(digest);
+        return NULL;
+    }
+
+    seccomp = get_seccomp(profile_key, profile, capabilities, trans);
+
+    free(profile_key);
+    free(digest);
+    return seccomp;
+}
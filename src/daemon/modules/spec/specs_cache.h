@@ -0,0 +1,50 @@
+/******************************************************************************
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ * Description: provide spec template cache definition
+ ******************************************************************************/
+#ifndef DAEMON_MODULES_SPEC_SPECS_CACHE_H
+#define DAEMON_MODULES_SPEC_SPECS_CACHE_H
+
+#include <isula_libutils/defs.h>
+#include <isula_libutils/docker_seccomp.h>
+#include <isula_libutils/oci_runtime_spec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Spec templates and seccomp profiles are kept in memory after the first use, a file is
+ * read again only when its inode, size or mtime changes. Spec templates are kept parsed,
+ * and seccomp profiles are kept in the translated oci form for each set of bounding
+ * capabilities. Callers always get own copies.
+ */
+
+typedef oci_runtime_config_linux_seccomp *(*seccomp_trans_func_t)(const docker_seccomp *docker_seccomp_spec,
+                                                                  const defs_process_capabilities *capabilities);
+
+oci_runtime_spec *specs_cache_get_spec_template(const char *file, parser_error *err);
+
+oci_runtime_config_linux_seccomp *specs_cache_get_file_seccomp(const char *file,
+                                                               const defs_process_capabilities *capabilities,
+                                                               seccomp_trans_func_t trans);
+
+oci_runtime_config_linux_seccomp *specs_cache_get_profile_seccomp(const char *profile,
+                                                                  const defs_process_capabilities *capabilities,
+                                                                  seccomp_trans_func_t trans);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DAEMON_MODULES_SPEC_SPECS_CACHE_H
@@ -33,6 +33,7 @@
 #include "err_msg.h"
 #include "specs_extend.h"
 #include "specs_api.h"
+#include "specs_cache.h"
 #include "constants.h"
 #include "utils_array.h"
 #include "utils_string.h"
@@ -698,23 +699,16 @@ done:
 int merge_default_seccomp_spec(oci_runtime_spec *oci_spec, const defs_process_capabilities *capabilities)
 {
     oci_runtime_config_linux_seccomp *oci_seccomp_spec = NULL;
-    docker_seccomp *docker_seccomp_spec = NULL;
 
     if (oci_spec->process == NULL || oci_spec->process->capabilities == NULL) {
         return 0;
     }
 
-    docker_seccomp_spec = get_seccomp_security_opt_spec(SECCOMP_DEFAULT_PATH);
-    if (docker_seccomp_spec == NULL) {
-        ERROR("Failed to parse docker format seccomp specification file \"%s\"", SECCOMP_DEFAULT_PATH);
-        isulad_set_error_message("failed to parse seccomp file: %s", SECCOMP_DEFAULT_PATH);
-        return -1;
-    }
-    oci_seccomp_spec = trans_docker_seccomp_to_oci_format(docker_seccomp_spec, capabilities);
-    free_docker_seccomp(docker_seccomp_spec);
+    oci_seccomp_spec = specs_cache_get_file_seccomp(SECCOMP_DEFAULT_PATH, capabilities,
+                                                    trans_docker_seccomp_to_oci_format);
     if (oci_seccomp_spec == NULL) {
-        ERROR("Failed to trans docker format seccomp profile to oci standard");
-        isulad_set_error_message("Failed to trans docker format seccomp profile to oci standard");
+        ERROR("Failed to get seccomp profile from specification file \"%s\"", SECCOMP_DEFAULT_PATH);
+        isulad_set_error_message("failed to parse seccomp file: %s", SECCOMP_DEFAULT_PATH);
         return -1;
     }
 
@@ -1058,8 +1052,6 @@ out:
 int merge_seccomp(oci_runtime_spec *oci_spec, const char *seccomp_profile)
 {
     int ret = 0;
-    parser_error err = NULL;
-    docker_seccomp *docker_seccomp = NULL;
 
     if (seccomp_profile == NULL) {
         return 0;
@@ -1076,13 +1068,8 @@ int merge_seccomp(oci_runtime_spec *oci_spec, const char *seccomp_profile)
     if (strcmp(seccomp_profile, "unconfined") == 0) {
         goto out;
     }
-    docker_seccomp = docker_seccomp_parse_data((const char *)seccomp_profile, NULL, &err);
-    if (docker_seccomp == NULL) {
-        ERROR("Failed to parse host config data:%s", err);
-        ret = -1;
-        goto out;
-    }
-    oci_spec->linux->seccomp = trans_docker_seccomp_to_oci_format(docker_seccomp, oci_spec->process->capabilities);
+    oci_spec->linux->seccomp = specs_cache_get_profile_seccomp(seccomp_profile, oci_spec->process->capabilities,
+                                                               trans_docker_seccomp_to_oci_format);
     if (oci_spec->linux->seccomp == NULL) {
         ERROR("Failed to trans docker seccomp format to oci profile");
         ret = -1;
@@ -1090,7 +1077,5 @@ int merge_seccomp(oci_runtime_spec *oci_spec, const char *seccomp_profile)
     }
 
 out:
-    free(err);
-    free_docker_seccomp(docker_seccomp);
     return ret;
 }
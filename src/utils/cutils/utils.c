@@ -1597,3 +1597,86 @@ out:
 
     return dst;
 }
+
+json_map_string_bool *dup_json_map_string_bool(const json_map_string_bool *src)
+{
+    size_t i = 0;
+    json_map_string_bool *dst = NULL;
+
+    if (src == NULL) {
+        return NULL;
+    }
+
+    dst = util_common_calloc_s(sizeof(json_map_string_bool));
+    if (dst == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+
+    if (src->len == 0) {
+        return dst;
+    }
+
+    dst->keys = util_smart_calloc_s(sizeof(char *), src->len);
+    dst->values = util_smart_calloc_s(sizeof(bool), src->len);
+    if (dst->keys == NULL || dst->values == NULL) {
+        ERROR("Out of memory");
+        goto err_out;
+    }
+
+    for (i = 0; i < src->len; i++) {
+        dst->keys[i] = util_strdup_s(src->keys[i]);
+        dst->values[i] = src->values[i];
+        dst->len++;
+    }
+
+    return dst;
+
+err_out:
+    free_json_map_string_bool(dst);
+    return NULL;
+}
+
+defs_filters *dup_defs_filters(const defs_filters *src)
+{
+    size_t i = 0;
+    defs_filters *dst = NULL;
+
+    if (src == NULL) {
+        return NULL;
+    }
+
+    dst = util_common_calloc_s(sizeof(defs_filters));
+    if (dst == NULL) {
+        ERROR("Out of memory");
+        return NULL;
+    }
+
+    if (src->len == 0) {
+        return dst;
+    }
+
+    dst->keys = util_smart_calloc_s(sizeof(char *), src->len);
+    dst->values = util_smart_calloc_s(sizeof(json_map_string_bool *), src->len);
+    if (dst->keys == NULL || dst->values == NULL) {
+        ERROR("Out of memory");
+        goto err_out;
+    }
+
+    for (i = 0; i < src->len; i++) {
+        if (src->values[i] != NULL) {
+            dst->values[i] = dup_json_map_string_bool(src->values[i]);
+            if (dst->values[i] == NULL) {
+                goto err_out;
+            }
+        }
+        dst->keys[i] = util_strdup_s(src->keys[i]);
+        dst->len++;
+    }
+
+    return dst;
+
+err_out:
+    free_defs_filters(dst);
+    return NULL;
+}
@@ -396,6 +396,11 @@ void util_parse_user_group(const char *username, char **user, char **group, char
 
 defs_map_string_object * dup_map_string_empty_object(defs_map_string_object *src);
 
+// structural copies of generated types, cheaper than generating json and parsing it again
+json_map_string_bool *dup_json_map_string_bool(const json_map_string_bool *src);
+
+defs_filters *dup_defs_filters(const defs_filters *src);
+
 /**
  * retry_cnt: max count of call cb;
  * interval_us: how many us to sleep, after call cb;
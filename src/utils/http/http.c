@@ -12,6 +12,7 @@
  * Create: 2018-11-08
  * Description: provide container http function
  ******************************************************************************/
+#define _GNU_SOURCE
 #include "http.h"
 #include <curl/curl.h>
 #include <sys/stat.h>
@@ -19,6 +20,9 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "buffer.h"
 #include "isula_libutils/log.h"
@@ -26,6 +30,11 @@
 #include "utils_array.h"
 #include "utils_file.h"
 
+/* shared by all requests, so tls sessions and dns results are reused. Connection cache is not
+ * shared, an easy handle may be used by any thread and libcurl does not support sharing it so */
+static CURLSH *g_share;
+static pthread_mutex_t g_share_locks[CURL_LOCK_DATA_LAST];
+
 size_t fwrite_buffer(const char *ptr, size_t eltsize, size_t nmemb, void *buffer_)
 {
     size_t size = eltsize * nmemb;
@@ -45,6 +54,26 @@ size_t fwrite_file(const void *ptr, size_t size, size_t nmemb, void *stream)
     return written;
 }
 
+struct file_write_context {
+    FILE *fp;
+    const struct http_get_options *options;
+};
+
+static size_t fwrite_file_with_hook(const void *ptr, size_t size, size_t nmemb, void *data)
+{
+    struct file_write_context *context = (struct file_write_context *)data;
+    size_t written = fwrite(ptr, size, nmemb, context->fp);
+
+    if (written != nmemb) {
+        return written;
+    }
+    if (context->options->write_hook_op(context->options->write_hook, ptr, size * nmemb) != 0) {
+        // returning a short count aborts the transfer
+        return 0;
+    }
+    return written;
+}
+
 size_t fwrite_null(char *ptr, size_t eltsize, size_t nmemb, void *strbuf)
 {
     return eltsize * nmemb;
@@ -84,13 +113,57 @@ void free_http_get_options(struct http_get_options *options)
     return;
 }
 
+static void share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr)
+{
+    if (data >= CURL_LOCK_DATA_LAST) {
+        return;
+    }
+    (void)pthread_mutex_lock(&g_share_locks[data]);
+}
+
+static void share_unlock(CURL *handle, curl_lock_data data, void *userptr)
+{
+    if (data >= CURL_LOCK_DATA_LAST) {
+        return;
+    }
+    (void)pthread_mutex_unlock(&g_share_locks[data]);
+}
+
+static void http_share_init(void)
+{
+    int i;
+
+    for (i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        if (pthread_mutex_init(&g_share_locks[i], NULL) != 0) {
+            WARN("Failed to init curl share lock, tls sessions and dns results will not be reused");
+            return;
+        }
+    }
+
+    g_share = curl_share_init();
+    if (g_share == NULL) {
+        WARN("Failed to init curl share, tls sessions and dns results will not be reused");
+        return;
+    }
+
+    curl_share_setopt(g_share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(g_share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
 void http_global_init(void)
 {
     curl_global_init(CURL_GLOBAL_ALL);
+    http_share_init();
 }
 
 void http_global_cleanup(void)
 {
+    if (g_share != NULL) {
+        curl_share_cleanup(g_share);
+        g_share = NULL;
+    }
     curl_global_cleanup();
 }
 
@@ -407,6 +480,52 @@ static char *replace_url(const char *url)
     return replaced_url;
 }
 
+static int http_setup_easy_handle(CURL *curl_handle, const char *url, const struct http_get_options *options,
+                                  char *errbuf, struct curl_slist **chunk)
+{
+    /* set URL to get here */
+    curl_easy_setopt(curl_handle, CURLOPT_URL, url);
+    curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
+    if (g_share != NULL) {
+        curl_easy_setopt(curl_handle, CURLOPT_SHARE, g_share);
+    }
+
+    /* provide a buffer to store errors in */
+    curl_easy_setopt(curl_handle, CURLOPT_ERRORBUFFER, errbuf);
+    /* libcurl support option CURL_HTTP_VERSION_2TLS when version >= 7.47.0
+     * #define CURL_VERSION_BITS(x,y,z) ((x)<<16|(y)<<8|(z))
+     * CURL_VERSION_BITS(7,47,0) = 0x072f00 */
+#if (LIBCURL_VERSION_NUM >= 0x072f00)
+    if (options->http2) {
+        curl_easy_setopt(curl_handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    } else {
+        curl_easy_setopt(curl_handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+    }
+#else
+    curl_easy_setopt(curl_handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+#endif
+    /* libcurl support option CURLOPT_SUPPRESS_CONNECT_HEADERS when version >= 7.54.0
+     * #define CURL_VERSION_BITS(x,y,z) ((x)<<16|(y)<<8|(z))
+     * CURL_VERSION_BITS(7,54,0) = 0x073600 */
+#if (LIBCURL_VERSION_NUM >= 0x073600)
+    curl_easy_setopt(curl_handle, CURLOPT_SUPPRESS_CONNECT_HEADERS, 1L);
+#endif
+
+    /* libcurl support option CURL_SSLVERSION_TLSv1_2 when version >= 7.34.0
+     * #define CURL_VERSION_BITS(x,y,z) ((x)<<16|(y)<<8|(z))
+     * CURL_VERSION_BITS(7,34,0) = 0x072200 */
+#if (LIBCURL_VERSION_NUM >= 0x072200)
+    curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
+#endif
+
+    if (http_custom_options(curl_handle, options) != 0) {
+        return -1;
+    }
+    *chunk = set_custom_header(curl_handle, options);
+
+    return 0;
+}
+
 int http_request(const char *url, struct http_get_options *options, long *response_code, int recursive_len)
 {
 #define MAX_REDIRCT_NUMS 32
@@ -423,6 +542,7 @@ int http_request(const char *url, struct http_get_options *options, long *respon
     char *tmp = NULL;
     size_t fsize = 0;
     char *replaced_url = 0;
+    struct file_write_context write_context = { 0 };
 
     if (url == NULL || options == NULL) {
         ERROR("must set url and options to use http request");
@@ -446,32 +566,10 @@ int http_request(const char *url, struct http_get_options *options, long *respon
         goto out;
     }
 
-    /* set URL to get here */
-    curl_easy_setopt(curl_handle, CURLOPT_URL, replaced_url);
-    curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
-
-    /* provide a buffer to store errors in */
-    curl_easy_setopt(curl_handle, CURLOPT_ERRORBUFFER, errbuf);
-    curl_easy_setopt(curl_handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
-    /* libcurl support option CURLOPT_SUPPRESS_CONNECT_HEADERS when version >= 7.54.0
-     * #define CURL_VERSION_BITS(x,y,z) ((x)<<16|(y)<<8|(z))
-     * CURL_VERSION_BITS(7,54,0) = 0x073600 */
-#if (LIBCURL_VERSION_NUM >= 0x073600)
-    curl_easy_setopt(curl_handle, CURLOPT_SUPPRESS_CONNECT_HEADERS, 1L);
-#endif
-
-    /* libcurl support option CURL_SSLVERSION_TLSv1_2 when version >= 7.34.0
-     * #define CURL_VERSION_BITS(x,y,z) ((x)<<16|(y)<<8|(z))
-     * CURL_VERSION_BITS(7,34,0) = 0x072200 */
-#if (LIBCURL_VERSION_NUM >= 0x072200)
-    curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
-#endif
-
-    ret = http_custom_options(curl_handle, options);
-    if (ret) {
+    ret = http_setup_easy_handle(curl_handle, replaced_url, options, errbuf, &chunk);
+    if (ret != 0) {
         goto out;
     }
-    chunk = set_custom_header(curl_handle, options);
 
     strbuf_args = options->output && options->outputtype == HTTP_REQUEST_STRBUF;
     file_args = options->output && options->outputtype == HTTP_REQUEST_FILE;
@@ -488,8 +586,15 @@ int http_request(const char *url, struct http_get_options *options, long *respon
             curl_easy_setopt(curl_handle, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)fsize);
         }
         curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1L);
-        curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, pagefile);
-        curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, fwrite_file);
+        if (options->write_hook_op != NULL) {
+            write_context.fp = pagefile;
+            write_context.options = options;
+            curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, &write_context);
+            curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, fwrite_file_with_hook);
+        } else {
+            curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, pagefile);
+            curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, fwrite_file);
+        }
     } else {
         /* do nothing */
     }
@@ -529,6 +634,295 @@ out:
     return ret;
 }
 
+struct range_part {
+    CURL *curl_handle;
+    struct curl_slist *chunk;
+    int fd;
+    curl_off_t start;
+    curl_off_t len;
+    curl_off_t written;
+    /* server answered without 206 or with more data than requested */
+    bool not_partial;
+    char errbuf[CURL_ERROR_SIZE];
+};
+
+static int pwrite_full(int fd, const char *buf, size_t len, curl_off_t offset)
+{
+    ssize_t nret = 0;
+
+    while (len > 0) {
+        nret = pwrite(fd, buf, len, (off_t)offset);
+        if (nret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += nret;
+        len -= (size_t)nret;
+        offset += nret;
+    }
+
+    return 0;
+}
+
+static size_t fwrite_range_part(const void *ptr, size_t size, size_t nmemb, void *data)
+{
+    struct range_part *part = (struct range_part *)data;
+    size_t len = size * nmemb;
+    long response_code = 0;
+
+    if (part->written == 0) {
+        curl_easy_getinfo(part->curl_handle, CURLINFO_RESPONSE_CODE, &response_code);
+        if (response_code != StatusPartialContent) {
+            part->not_partial = true;
+            return 0;
+        }
+    }
+
+    if ((curl_off_t)len > part->len - part->written) {
+        part->not_partial = true;
+        return 0;
+    }
+
+    if (pwrite_full(part->fd, ptr, len, part->start + part->written) != 0) {
+        ERROR("Failed to write range data: %s", strerror(errno));
+        return 0;
+    }
+    part->written += (curl_off_t)len;
+
+    return len;
+}
+
+static int open_preallocated_file(char **rpath, const char *output, size_t size)
+{
+    int fd = -1;
+    int nret = 0;
+
+    if (util_ensure_path(rpath, output) != 0) {
+        return -1;
+    }
+
+    fd = util_open(*rpath, O_WRONLY | O_CREAT | O_TRUNC, 0640);
+    if (fd < 0) {
+        ERROR("Failed to open file %s: %s", output, strerror(errno));
+        return -1;
+    }
+
+    // reserve all blocks up front so ranges written out of order do not fragment the file
+    nret = posix_fallocate(fd, 0, (off_t)size);
+    if (nret != 0 && ftruncate(fd, (off_t)size) != 0) {
+        ERROR("Failed to preallocate %zu bytes for %s: %s", size, output, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int setup_range_part(struct range_part *part, const char *url, const struct http_get_options *options)
+{
+    int nret = 0;
+    char range[64] = { 0 };
+
+    part->curl_handle = curl_easy_init();
+    if (part->curl_handle == NULL) {
+        return -1;
+    }
+
+    if (http_setup_easy_handle(part->curl_handle, url, options, part->errbuf, &part->chunk) != 0) {
+        return -1;
+    }
+
+    nret = snprintf(range, sizeof(range), "%lld-%lld", (long long)part->start,
+                    (long long)(part->start + part->len - 1));
+    if (nret < 0 || (size_t)nret >= sizeof(range)) {
+        ERROR("Failed to print range");
+        return -1;
+    }
+    curl_easy_setopt(part->curl_handle, CURLOPT_RANGE, range);
+    curl_easy_setopt(part->curl_handle, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(part->curl_handle, CURLOPT_WRITEDATA, part);
+    curl_easy_setopt(part->curl_handle, CURLOPT_WRITEFUNCTION, fwrite_range_part);
+    /* libcurl support option CURLOPT_PIPEWAIT when version >= 7.43.0
+     * #define CURL_VERSION_BITS(x,y,z) ((x)<<16|(y)<<8|(z))
+     * CURL_VERSION_BITS(7,43,0) = 0x072b00 */
+#if (LIBCURL_VERSION_NUM >= 0x072b00)
+    // prefer to wait for a multiplexed http/2 connection rather than open a new one
+    curl_easy_setopt(part->curl_handle, CURLOPT_PIPEWAIT, 1L);
+#endif
+
+    return 0;
+}
+
+static int perform_range_parts(CURLM *multi)
+{
+    CURLMcode mret = CURLM_OK;
+    int running = 0;
+
+    do {
+        mret = curl_multi_perform(multi, &running);
+        if (mret != CURLM_OK) {
+            ERROR("curl multi perform failed: %s", curl_multi_strerror(mret));
+            return -1;
+        }
+        if (running == 0) {
+            break;
+        }
+        mret = curl_multi_wait(multi, NULL, 0, 1000, NULL);
+        if (mret != CURLM_OK) {
+            ERROR("curl multi wait failed: %s", curl_multi_strerror(mret));
+            return -1;
+        }
+    } while (running > 0);
+
+    return 0;
+}
+
+static void set_range_unsupported(struct http_get_options *options)
+{
+    free(options->errmsg);
+    options->errmsg = util_strdup_s("server does not support range requests");
+    options->errcode = CURLE_RANGE_ERROR;
+}
+
+static int check_range_parts(CURLM *multi, struct range_part *parts, size_t parts_num,
+                             struct http_get_options *options)
+{
+    CURLMsg *msg = NULL;
+    int msgs_left = 0;
+    size_t i;
+    int ret = 0;
+
+    while ((msg = curl_multi_info_read(multi, &msgs_left)) != NULL) {
+        if (msg->msg != CURLMSG_DONE || msg->data.result == CURLE_OK) {
+            continue;
+        }
+        for (i = 0; i < parts_num; i++) {
+            if (parts[i].curl_handle == msg->easy_handle) {
+                break;
+            }
+        }
+        if (i == parts_num) {
+            continue;
+        }
+        if (parts[i].not_partial) {
+            set_range_unsupported(options);
+        } else {
+            check_buf_len(options, parts[i].errbuf, msg->data.result);
+        }
+        ret = -1;
+    }
+
+    for (i = 0; ret == 0 && i < parts_num; i++) {
+        if (parts[i].written != parts[i].len) {
+            ERROR("Range %zu got %lld bytes, expect %lld", i, (long long)parts[i].written, (long long)parts[i].len);
+            set_range_unsupported(options);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int http_request_ranges(const char *url, struct http_get_options *options, size_t total_size, size_t parts_num)
+{
+    CURLM *multi = NULL;
+    struct range_part *parts = NULL;
+    char *replaced_url = NULL;
+    char *rpath = NULL;
+    int fd = -1;
+    int ret = 0;
+    size_t i;
+    curl_off_t part_size = 0;
+
+    if (url == NULL || options == NULL || options->output == NULL || options->outputtype != HTTP_REQUEST_FILE ||
+        total_size == 0 || parts_num == 0) {
+        ERROR("Invalid arguments for range request");
+        return -1;
+    }
+
+    if (parts_num > total_size) {
+        parts_num = total_size;
+    }
+
+    replaced_url = replace_url(url);
+    if (replaced_url == NULL) {
+        return -1;
+    }
+
+    fd = open_preallocated_file(&rpath, options->output, total_size);
+    if (fd < 0) {
+        ret = -1;
+        goto out;
+    }
+
+    parts = util_smart_calloc_s(sizeof(struct range_part), parts_num);
+    if (parts == NULL) {
+        ERROR("Out of memory");
+        ret = -1;
+        goto out;
+    }
+
+    multi = curl_multi_init();
+    if (multi == NULL) {
+        ret = -1;
+        goto out;
+    }
+    /* libcurl support option CURLPIPE_MULTIPLEX when version >= 7.43.0
+     * #define CURL_VERSION_BITS(x,y,z) ((x)<<16|(y)<<8|(z))
+     * CURL_VERSION_BITS(7,43,0) = 0x072b00 */
+#if (LIBCURL_VERSION_NUM >= 0x072b00)
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)parts_num);
+
+    part_size = (curl_off_t)(total_size / parts_num);
+    for (i = 0; i < parts_num; i++) {
+        parts[i].fd = fd;
+        parts[i].start = (curl_off_t)i * part_size;
+        parts[i].len = (i == parts_num - 1) ? (curl_off_t)total_size - parts[i].start : part_size;
+        if (setup_range_part(&parts[i], replaced_url, options) != 0) {
+            ret = -1;
+            goto out;
+        }
+        if (curl_multi_add_handle(multi, parts[i].curl_handle) != CURLM_OK) {
+            curl_easy_cleanup(parts[i].curl_handle);
+            parts[i].curl_handle = NULL;
+            ret = -1;
+            goto out;
+        }
+    }
+
+    ret = perform_range_parts(multi);
+    if (ret != 0) {
+        goto out;
+    }
+
+    ret = check_range_parts(multi, parts, parts_num, options);
+
+out:
+    for (i = 0; parts != NULL && i < parts_num; i++) {
+        if (parts[i].curl_handle != NULL) {
+            if (multi != NULL) {
+                curl_multi_remove_handle(multi, parts[i].curl_handle);
+            }
+            curl_easy_cleanup(parts[i].curl_handle);
+        }
+        curl_slist_free_all(parts[i].chunk);
+    }
+    if (multi != NULL) {
+        curl_multi_cleanup(multi);
+    }
+    free(parts);
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(rpath);
+    free(replaced_url);
+    return ret;
+}
+
 int authz_http_request(const char *username, const char *action, char **resp)
 {
     char *request_body = NULL;
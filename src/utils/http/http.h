@@ -29,6 +29,8 @@ typedef int(*progress_info_func)(void *p,
 typedef int(*xferinfo_func)(void *p,
                             curl_off_t dltotal, curl_off_t dlnow,
                             curl_off_t ultotal, curl_off_t ulnow);
+/* called with data written to output file, return nonzero to abort the transfer */
+typedef int(*write_hook_func)(void *p, const void *data, size_t len);
 
 struct http_get_options {
     unsigned with_head : 1, /* if set, means write output with response HEADER */
@@ -79,11 +81,18 @@ struct http_get_options {
 
     bool timeout;
 
+    /* if set, negotiate http/2 over tls and fallback to http/1.1 */
+    bool http2;
+
     void *progressinfo;
     progress_info_func progress_info_op;
 
     void *xferinfo;
     xferinfo_func xferinfo_op;
+
+    /* only used if outputtype is HTTP_REQUEST_FILE */
+    void *write_hook;
+    write_hook_func write_hook_op;
 };
 
 #define HTTP_RES_OK                 0
@@ -180,6 +189,13 @@ void free_http_get_options(struct http_get_options *options);
 int http_request(const char *url, struct http_get_options *options,
                  long *response_code, int recursive_len);
 
+/*
+ * download url into the file options->output by parts_num parallel range requests, the file is
+ * preallocated to total_size, requests share connections and are multiplexed over http/2 if possible.
+ * if the server does not answer a range with 206, options->errcode is set to CURLE_RANGE_ERROR
+ */
+int http_request_ranges(const char *url, struct http_get_options *options, size_t total_size, size_t parts_num);
+
 int authz_http_request(const char *username, const char *action, char **resp);
 
 void http_global_init(void);
@@ -20,233 +20,332 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 #include <openssl/sha.h>
-#if OPENSSL_VERSION_MAJOR >= 3
 #include <openssl/evp.h>
+#if OPENSSL_VERSION_MAJOR >= 3
 #include <openssl/err.h>
 #endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#elif defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
 
 #include "isula_libutils/log.h"
 #include "utils.h"
 #include "utils_file.h"
 #include "utils_string.h"
 
-#define BLKSIZE 32768
+// large blocks make less read syscalls and let the sha256 implementation run in long batches
+#define BLKSIZE (1024 * 1024)
+#define GZ_BUFFER_SIZE (128 * 1024)
+
+/*
+ * OpenSSL selects the sha256 implementation by cpu features at runtime, such as SHA
+ * extensions or AVX2 on x86 and crypto extensions on aarch64. Fetch the algorithm once
+ * instead of every digest, it costs much for small data since OpenSSL 3.
+ */
+static pthread_once_t g_sha256_once = PTHREAD_ONCE_INIT;
+static const EVP_MD *g_sha256_md;
+static const char *g_sha256_engine = "generic";
 
-static bool stream_check_eof(void *stream, bool isgzip)
+static void sha256_engine_init(void)
 {
-    if (isgzip) {
-        if (gzeof(stream)) {
-            return true;
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax = 0;
+    unsigned int ebx = 0;
+    unsigned int ecx = 0;
+    unsigned int edx = 0;
+    bool avx = false;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) != 0) {
+        // AVX and OSXSAVE
+        avx = (ecx & (1U << 28)) != 0 && (ecx & (1U << 27)) != 0;
+    }
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) != 0) {
+        if ((ebx & (1U << 29)) != 0) {
+            g_sha256_engine = "sha-ni";
+        } else if (avx && (ebx & (1U << 5)) != 0) {
+            g_sha256_engine = "avx2";
         }
+    }
+#elif defined(__aarch64__)
+    if ((getauxval(AT_HWCAP) & HWCAP_SHA2) != 0) {
+        g_sha256_engine = "armv8-ce";
     } else {
-        if (feof(stream)) {
-            return true;
-        }
+        g_sha256_engine = "neon";
     }
-    return false;
+#endif
+
+    INFO("Cpu features for sha256: %s", g_sha256_engine);
+
+#if OPENSSL_VERSION_MAJOR >= 3
+    g_sha256_md = EVP_MD_fetch(NULL, "SHA256", NULL);
+    if (g_sha256_md == NULL) {
+        ERROR("Failed to fetch the SHA256 algorithm implementation for doing the digest");
+        ERR_print_errors_fp(stderr);
+    }
+#else
+    g_sha256_md = EVP_sha256();
+#endif
 }
 
-static bool stream_check_error(void *stream, bool isgzip)
+static const EVP_MD *get_sha256_md(void)
 {
-    const char *gzerr = NULL;
-    if (isgzip) {
-        int errnum;
-        gzerr = gzerror(stream, &errnum);
-    } else if (ferror(stream)) {
-        return true;
+    (void)pthread_once(&g_sha256_once, sha256_engine_init);
+    return g_sha256_md;
+}
+
+const char *sha256_engine_name(void)
+{
+    (void)pthread_once(&g_sha256_once, sha256_engine_init);
+    return g_sha256_engine;
+}
+
+struct sha256_context {
+    EVP_MD_CTX *ctx;
+};
+
+sha256_context *sha256_context_new(void)
+{
+    sha256_context *ctx = NULL;
+    const EVP_MD *md = get_sha256_md();
+
+    if (md == NULL) {
+        return NULL;
     }
-    if (gzerr != NULL && strcmp(gzerr, "") != 0) {
-        ERROR("gzread error: %s", gzerr);
-        return true;
+
+    ctx = util_common_calloc_s(sizeof(sha256_context));
+    if (ctx == NULL) {
+        ERROR("Out of memory");
+        return NULL;
     }
-    return false;
+
+    ctx->ctx = EVP_MD_CTX_new();
+    if (ctx->ctx == NULL) {
+        ERROR("Failed to create a context for the digest operation");
+        goto err_out;
+    }
+    if (!EVP_DigestInit_ex(ctx->ctx, md, NULL)) {
+        ERROR("Failed to initialise the digest operation");
+        goto err_out;
+    }
+
+    return ctx;
+
+err_out:
+    sha256_context_free(ctx);
+    return NULL;
 }
 
-char *sha256_digest_str(const char *val)
+int sha256_context_update(sha256_context *ctx, const void *data, size_t len)
 {
-#if OPENSSL_VERSION_MAJOR < 3
-    SHA256_CTX ctx;
-#endif
-    unsigned char hash[SHA256_DIGEST_LENGTH] = { 0x00 };
-    char output_buffer[(SHA256_DIGEST_LENGTH * 2) + 1] = { 0x00 };
-    int i = 0;
+    if (ctx == NULL || (data == NULL && len > 0)) {
+        ERROR("Invalid NULL param");
+        return -1;
+    }
 
-    if (val == NULL) {
-        return NULL;
+    if (!EVP_DigestUpdate(ctx->ctx, data, len)) {
+        ERROR("Failed to pass the message to be digested");
+        return -1;
     }
 
-#if OPENSSL_VERSION_MAJOR >= 3
-    SHA256((const unsigned char *)val, strlen(val), hash);
-#else
-    SHA256_Init(&ctx);
-    SHA256_Update(&ctx, val, strlen(val));
-    SHA256_Final(hash, &ctx);
-#endif
+    return 0;
+}
+
+static int hash_to_hex(const unsigned char *hash, char *output_buffer)
+{
+    int i = 0;
 
     for (i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        int ret = snprintf(output_buffer + (i * 2), 3, "%02x", (unsigned int)hash[i]);
-        if (ret >= 3 || ret < 0) {
-            return NULL;
+        int sret = snprintf(output_buffer + (i * 2), 3, "%02x", (unsigned int)hash[i]);
+        if (sret >= 3 || sret < 0) {
+            return -1;
         }
     }
     output_buffer[SHA256_DIGEST_LENGTH * 2] = '\0';
 
-    return util_strdup_s(output_buffer);
+    return 0;
 }
 
-char *sha256_digest_file(const char *filename, bool isgzip)
+static char *sha256_context_hex_digest(sha256_context *ctx)
 {
-#if OPENSSL_VERSION_MAJOR >= 3
-    EVP_MD_CTX *ctx = NULL;
-    EVP_MD *sha256 = NULL;
-    unsigned char *outdigest = NULL;
-    unsigned int len = 0;
-#else
-    SHA256_CTX ctx;
-    unsigned char hash[SHA256_DIGEST_LENGTH] = { 0x00 };
-#endif
+    unsigned char hash[EVP_MAX_MD_SIZE] = { 0x00 };
     char output_buffer[(SHA256_DIGEST_LENGTH * 2) + 1] = { 0x00 };
-    int i = 0;
-    char *buffer = NULL;
-    int n = 0;
-    int ret = 0;
-    void *stream = NULL;
+    unsigned int len = 0;
 
-    if (filename == NULL) {
-        ERROR("Invalid NULL pointer");
+    if (ctx == NULL) {
+        ERROR("Invalid NULL param");
         return NULL;
     }
 
-    if (isgzip) {
-        stream = (void *)gzopen(filename, "r");
-    } else {
-        stream = (void *)fopen(filename, "r");
+    if (!EVP_DigestFinal_ex(ctx->ctx, hash, &len) || len != SHA256_DIGEST_LENGTH) {
+        ERROR("Failed to calculate the digest itself");
+        return NULL;
     }
-    if (stream == NULL) {
-        ERROR("open file %s failed: %s", filename, strerror(errno));
+
+    if (hash_to_hex(hash, output_buffer) != 0) {
         return NULL;
     }
 
-    buffer = util_common_calloc_s(BLKSIZE);
-    if (buffer == NULL) {
-        ERROR("out of memory");
+    return util_strdup_s(output_buffer);
+}
+
+char *sha256_context_full_digest(sha256_context *ctx)
+{
+    char *digest = NULL;
+    char *full_digest = NULL;
+
+    digest = sha256_context_hex_digest(ctx);
+    if (digest == NULL) {
         return NULL;
     }
+    full_digest = util_full_digest(digest);
+    free(digest);
 
-#if OPENSSL_VERSION_MAJOR >= 3
-    ctx = EVP_MD_CTX_new();
+    return full_digest;
+}
+
+void sha256_context_free(sha256_context *ctx)
+{
     if (ctx == NULL) {
-        ERROR("Failed to create a context for the digest operation");
-        ERR_print_errors_fp(stderr);
-        ret = -1;
-        goto out;
+        return;
     }
-    sha256 = EVP_MD_fetch(NULL, "SHA256", NULL);
-    if (sha256 == NULL) {
-        ERROR("Failed to fetch the SHA256 algorithm implementation for doing the digest");
-        ERR_print_errors_fp(stderr);
-        ret = -1;
-        goto out;
+
+    EVP_MD_CTX_free(ctx->ctx);
+    free(ctx);
+}
+
+char *sha256_digest_str(const char *val)
+{
+    unsigned char hash[EVP_MAX_MD_SIZE] = { 0x00 };
+    char output_buffer[(SHA256_DIGEST_LENGTH * 2) + 1] = { 0x00 };
+    unsigned int len = 0;
+    const EVP_MD *md = get_sha256_md();
+
+    if (val == NULL || md == NULL) {
+        return NULL;
     }
-    if (!EVP_DigestInit_ex(ctx, sha256, NULL)) {
-        ERROR("Failed to initialise the digest operation");
-        ERR_print_errors_fp(stderr);
-        ret = -1;
-        goto out;
+
+    if (!EVP_Digest(val, strlen(val), hash, &len, md, NULL) || len != SHA256_DIGEST_LENGTH) {
+        ERROR("Failed to calculate the digest itself");
+        return NULL;
     }
-#else
-    SHA256_Init(&ctx);
-#endif
 
-    while (true) {
-        if (isgzip) {
-            n = gzread((gzFile)stream, buffer, BLKSIZE);
-        } else {
-            n = fread(buffer, 1, BLKSIZE, (FILE *)stream);
-        }
-        if (n <= 0) {
-            if (stream_check_error(stream, isgzip)) {
-                ret = -1;
-                goto out;
-            }
+    if (hash_to_hex(hash, output_buffer) != 0) {
+        return NULL;
+    }
+
+    return util_strdup_s(output_buffer);
+}
+
+static int digest_plain_file(const char *filename, sha256_context *ctx, char *buffer)
+{
+    int fd = -1;
+    ssize_t n = 0;
+    int ret = 0;
+
+    fd = util_open(filename, O_RDONLY, 0);
+    if (fd < 0) {
+        ERROR("open file %s failed: %s", filename, strerror(errno));
+        return -1;
+    }
+    (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    for (;;) {
+        n = util_read_nointr(fd, buffer, BLKSIZE);
+        if (n < 0) {
+            ERROR("read file %s failed: %s", filename, strerror(errno));
+            ret = -1;
             break;
         }
-
-        if (n > 0) {
-#if OPENSSL_VERSION_MAJOR >= 3
-            if (!EVP_DigestUpdate(ctx, (unsigned char *)buffer, n)) {
-                ERROR("Failed to pass the message to be digested");
-                ERR_print_errors_fp(stderr);
-                ret = -1;
-                goto out;
-            }
-#else
-            SHA256_Update(&ctx, buffer, n);
-#endif
+        if (n == 0) {
+            break;
         }
-
-        if (stream_check_eof(stream, isgzip)) {
+        if (sha256_context_update(ctx, buffer, (size_t)n) != 0) {
+            ret = -1;
             break;
         }
     }
 
-#if OPENSSL_VERSION_MAJOR >= 3
-    outdigest = OPENSSL_malloc(EVP_MD_get_size(sha256));
-    if (outdigest == NULL) {
-        ERROR("Failed to allocate the output buffer");
-        ERR_print_errors_fp(stderr);
-        ret = -1;
-        goto out;
-    }
-    if (!EVP_DigestFinal_ex(ctx, outdigest, &len)) {
-        ERROR("Failed to calculate the digest itself");
-        ERR_print_errors_fp(stderr);
-        ret = -1;
-        goto out;
+    close(fd);
+    return ret;
+}
+
+static int digest_gzip_file(const char *filename, sha256_context *ctx, char *buffer)
+{
+    gzFile stream = NULL;
+    const char *gzerr = NULL;
+    int errnum = 0;
+    int n = 0;
+    int ret = 0;
+
+    stream = gzopen(filename, "r");
+    if (stream == NULL) {
+        ERROR("open file %s failed: %s", filename, strerror(errno));
+        return -1;
     }
-    for (i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        int sret = snprintf(output_buffer + (i * 2), 3, "%02x", (unsigned int)outdigest[i]);
-        if (sret >= 3 || sret < 0) {
-            ERROR("snprintf failed when calc sha256 from file %s, result is %d", filename, sret);
-            return NULL;
+    (void)gzbuffer(stream, GZ_BUFFER_SIZE);
+
+    for (;;) {
+        n = gzread(stream, buffer, BLKSIZE);
+        if (n < 0) {
+            gzerr = gzerror(stream, &errnum);
+            ERROR("gzread error: %s", gzerr != NULL ? gzerr : "unknown");
+            ret = -1;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (sha256_context_update(ctx, buffer, (size_t)n) != 0) {
+            ret = -1;
+            break;
         }
     }
 
-    output_buffer[SHA256_DIGEST_LENGTH * 2] = '\0';
-#else
-    SHA256_Final(hash, &ctx);
+    gzclose(stream);
+    return ret;
+}
 
-    for (i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        int sret = snprintf(output_buffer + (i * 2), 3, "%02x", (unsigned int)hash[i]);
-        if (sret >= 3 || sret < 0) {
-            ERROR("snprintf failed when calc sha256 from file %s, result is %d", filename, sret);
-            return NULL;
-        }
+char *sha256_digest_file(const char *filename, bool isgzip)
+{
+    sha256_context *ctx = NULL;
+    char *buffer = NULL;
+    char *digest = NULL;
+    int ret = 0;
+
+    if (filename == NULL) {
+        ERROR("Invalid NULL pointer");
+        return NULL;
     }
-    output_buffer[SHA256_DIGEST_LENGTH * 2] = '\0';
-#endif
 
-out:
-#if OPENSSL_VERSION_MAJOR >= 3
-    OPENSSL_free(outdigest);
-    EVP_MD_free(sha256);
-    EVP_MD_CTX_free(ctx);
-#endif
-    if (isgzip) {
-        gzclose((gzFile)stream);
-    } else {
-        fclose((FILE *)stream);
+    buffer = util_common_calloc_s(BLKSIZE);
+    if (buffer == NULL) {
+        ERROR("out of memory");
+        return NULL;
     }
 
-    free(buffer);
-    buffer = NULL;
+    ctx = sha256_context_new();
+    if (ctx == NULL) {
+        goto out;
+    }
 
-    if (ret == 0) {
-        return util_strdup_s(output_buffer);
+    if (isgzip) {
+        ret = digest_gzip_file(filename, ctx, buffer);
     } else {
-        return NULL;
+        ret = digest_plain_file(filename, ctx, buffer);
     }
+    if (ret == 0) {
+        digest = sha256_context_hex_digest(ctx);
+    }
+
+out:
+    sha256_context_free(ctx);
+    free(buffer);
+    return digest;
 }
 
 static char *cal_file_digest(const char *filename)
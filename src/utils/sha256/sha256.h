@@ -38,6 +38,21 @@ char *sha256_full_digest_str(char *str);
 
 char *util_without_sha256_prefix(char *digest);
 
+// name of the sha256 implementation selected for this cpu, such as sha-ni or armv8-ce
+const char *sha256_engine_name(void);
+
+// incremental digest of data arriving in pieces, update it with large blocks for best throughput
+typedef struct sha256_context sha256_context;
+
+sha256_context *sha256_context_new(void);
+
+int sha256_context_update(sha256_context *ctx, const void *data, size_t len);
+
+// return full digest with sha256 prefix of all data updated
+char *sha256_context_full_digest(sha256_context *ctx);
+
+void sha256_context_free(sha256_context *ctx);
+
 #ifdef __cplusplus
 }
 #endif
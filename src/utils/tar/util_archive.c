@@ -39,6 +39,7 @@
 #include "utils.h"
 #include "utils_file.h"
 #include "utils_string.h"
+#include "util_gzip.h"
 
 struct archive;
 struct archive_entry;
@@ -423,6 +424,7 @@ static void try_to_replace_exited_dst(const char *dst_path, struct archive_entry
 int archive_unpack_handler(const struct io_read_wrapper *content, const struct archive_options *options)
 {
     int ret = 0;
+    struct io_read_wrapper decompressed = { 0 };
     struct archive *a = NULL;
     struct archive *ext = NULL;
     struct archive_content_data *mydata = NULL;
@@ -449,6 +451,16 @@ int archive_unpack_handler(const struct io_read_wrapper *content, const struct a
     }
     mydata->content = content;
 
+    if (options->parallel_decompress) {
+        if (util_gzip_read_ahead_open(content, &decompressed) != 0) {
+            ERROR("Failed to start read ahead decompression");
+            fprintf(stderr, "Failed to start read ahead decompression");
+            ret = -1;
+            goto out;
+        }
+        mydata->content = &decompressed;
+    }
+
     flags = ARCHIVE_EXTRACT_TIME;
     flags |= ARCHIVE_EXTRACT_OWNER;
     flags |= ARCHIVE_EXTRACT_PERM;
@@ -576,6 +588,11 @@ out:
     archive_read_free(a);
     archive_write_close(ext);
     archive_write_free(ext);
+    if (decompressed.close != NULL && decompressed.close(decompressed.context, NULL) != 0 && ret == 0) {
+        ERROR("Failed to decompress archive");
+        fprintf(stderr, "Failed to decompress archive");
+        ret = -1;
+    }
     free(mydata);
     return ret;
 }
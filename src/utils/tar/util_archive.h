@@ -31,6 +31,11 @@ typedef enum {
     REMOVE_WHITEOUT_FORMATE = 2, // handle whiteouts by removing the target files
 } whiteout_format_type;
 
+// decompress layers on a read-ahead thread by default, it is a build option until daemon configs can carry it
+#ifndef DEFAULT_PARALLEL_DECOMPRESS
+#define DEFAULT_PARALLEL_DECOMPRESS true
+#endif
+
 struct archive_options {
     whiteout_format_type whiteout_format;
 
@@ -41,6 +46,8 @@ struct archive_options {
     // rename archive entry's name from src_base to dst_base
     const char *src_base;
     const char *dst_base;
+    // decompress gzip data on a separate thread ahead of unpacking
+    bool parallel_decompress;
 };
 
 int archive_unpack(const struct io_read_wrapper *content, const char *dstdir, const struct archive_options *options,
@@ -15,6 +15,7 @@
 #define _GNU_SOURCE /* See feature_test_macros(7) */
 #include "util_gzip.h"
 #include <zlib.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -22,9 +23,46 @@
 #include "utils.h"
 #include "isula_libutils/log.h"
 #include "utils_file.h"
+#include "io_wrapper.h"
 
 #define BLKSIZE 32768
 
+#define READ_AHEAD_BLOCK_SIZE (1024 * 1024)
+#define READ_AHEAD_BLOCKS 8
+#define READ_AHEAD_IN_SIZE (256 * 1024)
+
+struct read_ahead_block {
+    char *data;
+    size_t len;
+    size_t pos;
+};
+
+struct gzip_read_ahead {
+    const struct io_read_wrapper *src;
+    pthread_t worker;
+    bool worker_started;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    // blocks[head] to blocks[(head + count - 1) % READ_AHEAD_BLOCKS] are filled by worker
+    struct read_ahead_block blocks[READ_AHEAD_BLOCKS];
+    size_t head;
+    size_t count;
+    bool eof;
+    bool failed;
+    bool stop;
+
+    // only accessed by worker
+    bool gzip;
+    bool src_eof;
+    z_stream strm;
+    bool strm_inited;
+    size_t members;
+    unsigned char *in;
+    size_t in_len;
+    size_t in_pos;
+};
+
 // Compress
 int util_gzip_z(const char *srcfile, const char *dstfile, const mode_t mode)
 {
@@ -220,3 +258,311 @@ int gzip(const char *filename, size_t len)
     }
     return status;
 }
+
+static int read_ahead_fill_input(struct gzip_read_ahead *ra)
+{
+    ssize_t n = 0;
+
+    if (ra->src_eof || ra->in_pos < ra->in_len) {
+        return 0;
+    }
+
+    n = ra->src->read(ra->src->context, ra->in, READ_AHEAD_IN_SIZE);
+    if (n < 0) {
+        ERROR("Read compressed data failed");
+        return -1;
+    }
+    if (n == 0) {
+        ra->src_eof = true;
+    }
+    ra->in_len = (size_t)n;
+    ra->in_pos = 0;
+
+    return 0;
+}
+
+static int read_ahead_copy_block(struct gzip_read_ahead *ra, struct read_ahead_block *block, bool *eof)
+{
+    size_t n = 0;
+
+    while (block->len < READ_AHEAD_BLOCK_SIZE) {
+        if (read_ahead_fill_input(ra) != 0) {
+            return -1;
+        }
+        if (ra->in_pos == ra->in_len) {
+            *eof = true;
+            break;
+        }
+        n = ra->in_len - ra->in_pos;
+        if (n > READ_AHEAD_BLOCK_SIZE - block->len) {
+            n = READ_AHEAD_BLOCK_SIZE - block->len;
+        }
+        (void)memcpy(block->data + block->len, ra->in + ra->in_pos, n);
+        block->len += n;
+        ra->in_pos += n;
+    }
+
+    return 0;
+}
+
+static int read_ahead_inflate_block(struct gzip_read_ahead *ra, struct read_ahead_block *block, bool *eof)
+{
+    int nret = 0;
+
+    ra->strm.next_out = (Bytef *)block->data;
+    ra->strm.avail_out = READ_AHEAD_BLOCK_SIZE;
+
+    while (ra->strm.avail_out > 0) {
+        if (read_ahead_fill_input(ra) != 0) {
+            return -1;
+        }
+        ra->strm.next_in = ra->in + ra->in_pos;
+        ra->strm.avail_in = (uInt)(ra->in_len - ra->in_pos);
+        if (ra->strm.avail_in == 0 && ra->src_eof) {
+            if (ra->strm.total_in == 0) {
+                // all gzip members are finished
+                *eof = true;
+                break;
+            }
+            ERROR("Unexpected end of gzip data");
+            return -1;
+        }
+
+        nret = inflate(&ra->strm, Z_NO_FLUSH);
+        ra->in_pos = ra->in_len - ra->strm.avail_in;
+        if (nret == Z_STREAM_END) {
+            // data may be concatenated by several gzip members
+            ra->members++;
+            (void)inflateReset(&ra->strm);
+            continue;
+        }
+        if (nret == Z_DATA_ERROR && ra->members > 0 && ra->strm.total_out == 0) {
+            // ignore trailing garbage after the last gzip member, the same as gzip
+            *eof = true;
+            break;
+        }
+        if (nret != Z_OK && nret != Z_BUF_ERROR) {
+            ERROR("Inflate gzip data failed: %s", ra->strm.msg != NULL ? ra->strm.msg : "unknown error");
+            return -1;
+        }
+    }
+
+    block->len = READ_AHEAD_BLOCK_SIZE - ra->strm.avail_out;
+    return 0;
+}
+
+static int read_ahead_detect_gzip(struct gzip_read_ahead *ra)
+{
+    // gzip magic may be split into several reads
+    while (!ra->src_eof && ra->in_len < 2) {
+        ssize_t n = ra->src->read(ra->src->context, ra->in + ra->in_len, READ_AHEAD_IN_SIZE - ra->in_len);
+        if (n < 0) {
+            ERROR("Read compressed data failed");
+            return -1;
+        }
+        if (n == 0) {
+            ra->src_eof = true;
+        }
+        ra->in_len += (size_t)n;
+    }
+
+    ra->gzip = ra->in_len >= 2 && ra->in[0] == 0x1f && ra->in[1] == 0x8b;
+    if (!ra->gzip) {
+        return 0;
+    }
+
+    if (inflateInit2(&ra->strm, 16 + MAX_WBITS) != Z_OK) {
+        ERROR("Init inflate failed");
+        return -1;
+    }
+    ra->strm_inited = true;
+
+    return 0;
+}
+
+static void *read_ahead_worker(void *arg)
+{
+    struct gzip_read_ahead *ra = (struct gzip_read_ahead *)arg;
+    struct read_ahead_block *block = NULL;
+    bool eof = false;
+    int ret = 0;
+
+    ret = read_ahead_detect_gzip(ra);
+
+    while (ret == 0 && !eof) {
+        pthread_mutex_lock(&ra->mutex);
+        while (ra->count == READ_AHEAD_BLOCKS && !ra->stop) {
+            pthread_cond_wait(&ra->cond, &ra->mutex);
+        }
+        if (ra->stop) {
+            pthread_mutex_unlock(&ra->mutex);
+            break;
+        }
+        // the free block is only accessed by worker until it is counted
+        block = &ra->blocks[(ra->head + ra->count) % READ_AHEAD_BLOCKS];
+        pthread_mutex_unlock(&ra->mutex);
+
+        block->len = 0;
+        block->pos = 0;
+        if (ra->gzip) {
+            ret = read_ahead_inflate_block(ra, block, &eof);
+        } else {
+            ret = read_ahead_copy_block(ra, block, &eof);
+        }
+
+        pthread_mutex_lock(&ra->mutex);
+        if (ret == 0 && block->len > 0) {
+            ra->count++;
+        }
+        pthread_cond_broadcast(&ra->cond);
+        pthread_mutex_unlock(&ra->mutex);
+    }
+
+    pthread_mutex_lock(&ra->mutex);
+    if (ret != 0) {
+        ra->failed = true;
+    }
+    ra->eof = true;
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->mutex);
+
+    return NULL;
+}
+
+static ssize_t read_ahead_read(void *context, void *buf, size_t len)
+{
+    struct gzip_read_ahead *ra = (struct gzip_read_ahead *)context;
+    struct read_ahead_block *block = NULL;
+    size_t n = 0;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&ra->mutex);
+    while (ra->count == 0 && !ra->eof) {
+        pthread_cond_wait(&ra->cond, &ra->mutex);
+    }
+    if (ra->count == 0) {
+        pthread_mutex_unlock(&ra->mutex);
+        return ra->failed ? -1 : 0;
+    }
+    // the head block is only accessed by reader until it is released
+    block = &ra->blocks[ra->head];
+    pthread_mutex_unlock(&ra->mutex);
+
+    n = block->len - block->pos;
+    if (n > len) {
+        n = len;
+    }
+    (void)memcpy(buf, block->data + block->pos, n);
+    block->pos += n;
+
+    if (block->pos == block->len) {
+        pthread_mutex_lock(&ra->mutex);
+        ra->head = (ra->head + 1) % READ_AHEAD_BLOCKS;
+        ra->count--;
+        pthread_cond_broadcast(&ra->cond);
+        pthread_mutex_unlock(&ra->mutex);
+    }
+
+    return (ssize_t)n;
+}
+
+static void free_gzip_read_ahead(struct gzip_read_ahead *ra)
+{
+    size_t i;
+
+    if (ra == NULL) {
+        return;
+    }
+
+    for (i = 0; i < READ_AHEAD_BLOCKS; i++) {
+        free(ra->blocks[i].data);
+    }
+    if (ra->strm_inited) {
+        (void)inflateEnd(&ra->strm);
+    }
+    free(ra->in);
+    pthread_cond_destroy(&ra->cond);
+    pthread_mutex_destroy(&ra->mutex);
+    free(ra);
+}
+
+static int read_ahead_close(void *context, char **err)
+{
+    struct gzip_read_ahead *ra = (struct gzip_read_ahead *)context;
+    int ret = 0;
+
+    if (ra == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&ra->mutex);
+    ra->stop = true;
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->mutex);
+
+    if (ra->worker_started) {
+        (void)pthread_join(ra->worker, NULL);
+    }
+
+    if (ra->failed) {
+        if (err != NULL) {
+            *err = util_strdup_s("decompress data failed");
+        }
+        ret = -1;
+    }
+    free_gzip_read_ahead(ra);
+
+    return ret;
+}
+
+int util_gzip_read_ahead_open(const struct io_read_wrapper *src, struct io_read_wrapper *reader)
+{
+    struct gzip_read_ahead *ra = NULL;
+    size_t i;
+
+    if (src == NULL || src->read == NULL || reader == NULL) {
+        ERROR("Invalid NULL param");
+        return -1;
+    }
+
+    ra = util_common_calloc_s(sizeof(struct gzip_read_ahead));
+    if (ra == NULL) {
+        ERROR("Out of memory");
+        return -1;
+    }
+    ra->src = src;
+    (void)pthread_mutex_init(&ra->mutex, NULL);
+    (void)pthread_cond_init(&ra->cond, NULL);
+
+    ra->in = util_common_calloc_s(READ_AHEAD_IN_SIZE);
+    if (ra->in == NULL) {
+        ERROR("Out of memory");
+        goto err_out;
+    }
+    for (i = 0; i < READ_AHEAD_BLOCKS; i++) {
+        ra->blocks[i].data = util_common_calloc_s(READ_AHEAD_BLOCK_SIZE);
+        if (ra->blocks[i].data == NULL) {
+            ERROR("Out of memory");
+            goto err_out;
+        }
+    }
+
+    if (pthread_create(&ra->worker, NULL, read_ahead_worker, ra) != 0) {
+        ERROR("Failed to create read ahead thread");
+        goto err_out;
+    }
+    ra->worker_started = true;
+
+    reader->context = ra;
+    reader->read = read_ahead_read;
+    reader->close = read_ahead_close;
+
+    return 0;
+
+err_out:
+    free_gzip_read_ahead(ra);
+    return -1;
+}
@@ -18,6 +18,8 @@
 #include <stdio.h>
 #include <sys/types.h>
 
+struct io_read_wrapper;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -28,6 +30,14 @@ int util_gzip_z(const char *srcfile, const char *dstfile, const mode_t mode);
 // Decompress
 int util_gzip_d(const char *srcfile, const FILE *destfp);
 
+/*
+ * Wrap src into reader which returns the decompressed data of src. Data is read from src and
+ * inflated ahead by a separate thread, so decompression runs in parallel with the consumer of
+ * reader. Data which is not gzip compressed is read ahead and returned as is.
+ * src must be valid until reader is closed, and it is not closed by reader->close.
+ */
+int util_gzip_read_ahead_open(const struct io_read_wrapper *src, struct io_read_wrapper *reader);
+
 /*
  * compress file.
  * param filename:      archive file to compres.
@@ -7,12 +7,23 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/socket.h>
 #include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <isula_libutils/logger_json_file.h>
 
 #include "process.h"
 #include "common.h"
+#include "terminal.h"
+#include "exec_service.h"
 
 int g_log_fd = -1;
 
@@ -120,3 +131,355 @@ TEST_F(IsuladShimUnitTest, test_combined_output)
     params[0] = non_cmd.c_str();
     EXPECT_EQ(cmd_combined_output(non_cmd.c_str(), params, output, &output_len), -1);
 }
+
+TEST_F(IsuladShimUnitTest, test_exec_service_is_exec_dir)
+{
+    string service_dir = "/run/isulad/aaaabbbbccccdddd";
+
+    EXPECT_TRUE(exec_service_is_exec_dir(service_dir.c_str(), (service_dir + "/" + EXEC_DIR_NAME + "/1234").c_str()));
+
+    EXPECT_FALSE(exec_service_is_exec_dir(service_dir.c_str(), (service_dir + "/" + EXEC_DIR_NAME + "/").c_str()));
+    EXPECT_FALSE(exec_service_is_exec_dir(service_dir.c_str(), (service_dir + "/" + EXEC_DIR_NAME).c_str()));
+    EXPECT_FALSE(exec_service_is_exec_dir(service_dir.c_str(),
+                                          (service_dir + "/" + EXEC_DIR_NAME + "/1234/rootfs").c_str()));
+    EXPECT_FALSE(exec_service_is_exec_dir(service_dir.c_str(), (service_dir + "/" + EXEC_DIR_NAME + "1234").c_str()));
+    EXPECT_FALSE(exec_service_is_exec_dir(service_dir.c_str(), (service_dir + "e/" + EXEC_DIR_NAME + "/1234").c_str()));
+    EXPECT_FALSE(exec_service_is_exec_dir(service_dir.c_str(), "/run/isulad/eeeeffff/exec/1234"));
+    EXPECT_FALSE(exec_service_is_exec_dir(service_dir.c_str(), (service_dir + "/1234").c_str()));
+}
+
+TEST_F(IsuladShimUnitTest, test_exec_service_read_request)
+{
+    string workdir = "/run/isulad/aaaabbbbccccdddd/exec/1234";
+    char buf[PATH_MAX] = { 0 };
+    char small[8] = { 0 };
+    int fds[2] = { -1, -1 };
+
+    // request is sent in pieces
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ASSERT_EQ(write(fds[1], workdir.c_str(), 10), 10);
+    ASSERT_EQ(write(fds[1], workdir.c_str() + 10, workdir.size() + 1 - 10), (ssize_t)(workdir.size() + 1 - 10));
+    EXPECT_EQ(exec_service_read_request(fds[0], buf, sizeof(buf)), SHIM_OK);
+    EXPECT_EQ(string(buf), workdir);
+    close(fds[0]);
+    close(fds[1]);
+
+    // connection closed before the end of request
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ASSERT_EQ(write(fds[1], workdir.c_str(), workdir.size()), (ssize_t)workdir.size());
+    close(fds[1]);
+    EXPECT_EQ(exec_service_read_request(fds[0], buf, sizeof(buf)), SHIM_ERR);
+    close(fds[0]);
+
+    // request is longer than the buffer
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ASSERT_EQ(write(fds[1], workdir.c_str(), workdir.size() + 1), (ssize_t)(workdir.size() + 1));
+    EXPECT_EQ(exec_service_read_request(fds[0], small, sizeof(small)), SHIM_ERR);
+    EXPECT_EQ(small[sizeof(small) - 1], '\0');
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static log_terminal *new_test_terminal(const string &path, uint64_t maxsize)
+{
+    log_terminal *terminal = (log_terminal *)calloc(1, sizeof(log_terminal));
+    if (terminal == nullptr) {
+        return nullptr;
+    }
+    (void)pthread_rwlock_init(&terminal->log_terminal_rwlock, nullptr);
+    terminal->log_path = (char *)path.c_str();
+    terminal->log_maxsize = maxsize;
+    terminal->log_maxfile = 2;
+    terminal->fd = -1;
+    terminal->idx_fd = -1;
+    if (shim_create_container_log_file(terminal) != SHIM_OK) {
+        free(terminal);
+        return nullptr;
+    }
+    return terminal;
+}
+
+static void free_test_terminal(log_terminal *terminal)
+{
+    close(terminal->fd);
+    if (terminal->idx_fd >= 0) {
+        close(terminal->idx_fd);
+    }
+    free(terminal->batch);
+    free(terminal->idx_batch);
+    (void)pthread_rwlock_destroy(&terminal->log_terminal_rwlock);
+    free(terminal);
+}
+
+TEST_F(IsuladShimUnitTest, test_write_container_log_file)
+{
+    string log_path = "/tmp/test_shim_container_log";
+    string line1 = "hello \"world\"\t\\ \x01\x7f\xe4\xb8\xad\n";
+    string line2 = "second line\r\n";
+    string out = line1 + line2;
+    string err = "error line\n";
+    vector<string> logs;
+    vector<string> streams;
+    string json;
+
+    (void)unlink(log_path.c_str());
+    log_terminal *terminal = new_test_terminal(log_path, 1024 * 1024);
+    ASSERT_NE(terminal, nullptr);
+
+    shim_write_container_log_file(terminal, STDID_OUT, (char *)out.c_str(), out.size());
+    shim_write_container_log_file(terminal, STDID_ERR, (char *)err.c_str(), err.size());
+    shim_flush_container_log_file(terminal);
+    ASSERT_FALSE(shim_container_log_has_pending(terminal));
+
+    std::ifstream file(log_path);
+    while (std::getline(file, json)) {
+        parser_error perr = nullptr;
+        logger_json_file *msg = logger_json_file_parse_data(json.c_str(), nullptr, &perr);
+        ASSERT_NE(msg, nullptr) << perr;
+        logs.push_back(string((char *)msg->log, msg->log_len));
+        streams.push_back(msg->stream);
+        ASSERT_EQ(strlen(msg->time), strlen("2006-01-02T15:04:05.999999999Z"));
+        free_logger_json_file(msg);
+        free(perr);
+    }
+
+    ASSERT_EQ(logs.size(), 3);
+    EXPECT_EQ(logs[0], line1);
+    EXPECT_EQ(streams[0], "stdout");
+    EXPECT_EQ(logs[1], line2);
+    EXPECT_EQ(logs[2], err);
+    EXPECT_EQ(streams[2], "stderr");
+    struct stat st;
+    ASSERT_EQ(stat(log_path.c_str(), &st), 0);
+    EXPECT_EQ(terminal->log_size, st.st_size);
+
+    free_test_terminal(terminal);
+    (void)unlink(log_path.c_str());
+    (void)unlink((log_path + CONTAINER_LOG_INDEX_SUFFIX).c_str());
+}
+
+TEST_F(IsuladShimUnitTest, test_write_container_log_file_rotate)
+{
+    string log_path = "/tmp/test_shim_container_log_rotate";
+    string rotated_path = log_path + ".1";
+    string line(100, 'a');
+    struct stat st;
+    int i;
+
+    line += "\n";
+    (void)unlink(log_path.c_str());
+    (void)unlink(rotated_path.c_str());
+    log_terminal *terminal = new_test_terminal(log_path, 4096);
+    ASSERT_NE(terminal, nullptr);
+
+    for (i = 0; i < 100; i++) {
+        shim_write_container_log_file(terminal, STDID_OUT, (char *)line.c_str(), line.size());
+    }
+    shim_flush_container_log_file(terminal);
+
+    ASSERT_EQ(stat(log_path.c_str(), &st), 0);
+    EXPECT_LE(st.st_size, 4096);
+    EXPECT_EQ(st.st_size, terminal->log_size);
+    ASSERT_EQ(stat(rotated_path.c_str(), &st), 0);
+    EXPECT_LE(st.st_size, 4096);
+
+    free_test_terminal(terminal);
+    (void)unlink(log_path.c_str());
+    (void)unlink(rotated_path.c_str());
+    (void)unlink((log_path + CONTAINER_LOG_INDEX_SUFFIX).c_str());
+    (void)unlink((rotated_path + CONTAINER_LOG_INDEX_SUFFIX).c_str());
+}
+
+TEST_F(IsuladShimUnitTest, test_write_container_log_file_index)
+{
+    string log_path = "/tmp/test_shim_container_log_index";
+    string idx_path = log_path + CONTAINER_LOG_INDEX_SUFFIX;
+    string line = "indexed line\n";
+    vector<uint64_t> offsets;
+    container_log_index_header header;
+    container_log_index_entry entry;
+    size_t lines = CONTAINER_LOG_INDEX_INTERVAL * 3 + 1;
+    string json;
+    size_t i;
+
+    (void)unlink(log_path.c_str());
+    (void)unlink(idx_path.c_str());
+    log_terminal *terminal = new_test_terminal(log_path, 1024 * 1024);
+    ASSERT_NE(terminal, nullptr);
+    for (i = 0; i < lines; i++) {
+        shim_write_container_log_file(terminal, STDID_OUT, (char *)line.c_str(), line.size());
+    }
+    shim_flush_container_log_file(terminal);
+    free_test_terminal(terminal);
+
+    std::ifstream file(log_path);
+    uint64_t offset = 0;
+    while (std::getline(file, json)) {
+        offsets.push_back(offset);
+        offset += json.size() + 1;
+    }
+    ASSERT_EQ(offsets.size(), lines);
+
+    // one entry every CONTAINER_LOG_INDEX_INTERVAL lines, starts with the first line
+    std::ifstream idx(idx_path, std::ios::binary);
+    ASSERT_TRUE(idx.read((char *)&header, sizeof(header)));
+    EXPECT_EQ(memcmp(header.magic, CONTAINER_LOG_INDEX_MAGIC, sizeof(header.magic)), 0);
+    EXPECT_EQ(header.version, CONTAINER_LOG_INDEX_VERSION);
+    EXPECT_EQ(header.interval, CONTAINER_LOG_INDEX_INTERVAL);
+    for (i = 0; idx.read((char *)&entry, sizeof(entry)); i++) {
+        EXPECT_EQ(entry.line, i * CONTAINER_LOG_INDEX_INTERVAL);
+        ASSERT_LT(entry.line, offsets.size());
+        EXPECT_EQ(entry.offset, offsets[entry.line]);
+        EXPECT_GT(entry.time, 0);
+    }
+    EXPECT_EQ(i, lines / CONTAINER_LOG_INDEX_INTERVAL + 1);
+
+    (void)unlink(log_path.c_str());
+    (void)unlink(idx_path.c_str());
+}
+
+// the previous log path: generate json by libocispec and fstat before each write
+static void legacy_logger_write(log_terminal *terminal, const char *type, const char *buf, int read_count)
+{
+    logger_json_file *msg = (logger_json_file *)calloc(sizeof(logger_json_file), 1);
+    char *json = nullptr;
+    parser_error err = nullptr;
+    struct parser_context ctx = { OPT_GEN_SIMPLIFY | OPT_GEN_NO_VALIDATE_UTF8, stderr };
+    struct timespec ts;
+    struct tm tm_utc;
+    char timebuffer[64] = { 0 };
+    struct stat st;
+    size_t len;
+
+    msg->log = (uint8_t *)calloc(read_count, 1);
+    memcpy(msg->log, buf, read_count);
+    msg->log_len = read_count;
+    msg->stream = strdup(type);
+    (void)clock_gettime(CLOCK_REALTIME, &ts);
+    gmtime_r(&ts.tv_sec, &tm_utc);
+    len = strftime(timebuffer, sizeof(timebuffer), "%Y-%m-%dT%H:%M:%S", &tm_utc);
+    (void)snprintf(timebuffer + len, sizeof(timebuffer) - len, ".%09ldZ", ts.tv_nsec);
+    msg->time = strdup(timebuffer);
+    json = logger_json_file_generate_json(msg, &ctx, &err);
+    if (json != nullptr) {
+        len = strlen(json);
+        json[len] = '\n';
+        (void)pthread_rwlock_wrlock(&terminal->log_terminal_rwlock);
+        if (fstat(terminal->fd, &st) == 0) {
+            (void)write_nointr_in_total(terminal->fd, json, len + 1);
+        }
+        (void)pthread_rwlock_unlock(&terminal->log_terminal_rwlock);
+    }
+    free(json);
+    free_logger_json_file(msg);
+    free(err);
+}
+
+// microbenchmark: log throughput of current log path against the previous one
+TEST_F(IsuladShimUnitTest, bench_write_container_log_file)
+{
+    const size_t total = 64 * 1024 * 1024;
+    string log_path = "/tmp/test_shim_container_log_bench";
+    string chunk;
+    size_t written = 0;
+
+    // 16k reads with 128 bytes lines, like a chatty workload
+    while (chunk.size() + 128 <= 16 * 1024) {
+        chunk += string(127, 'x') + "\n";
+    }
+
+    (void)unlink(log_path.c_str());
+    log_terminal *terminal = new_test_terminal(log_path, 1ULL << 40);
+    ASSERT_NE(terminal, nullptr);
+    auto start = std::chrono::steady_clock::now();
+    for (written = 0; written < total; written += chunk.size()) {
+        shim_write_container_log_file(terminal, STDID_OUT, (char *)chunk.c_str(), chunk.size());
+    }
+    shim_flush_container_log_file(terminal);
+    double fast = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    free_test_terminal(terminal);
+    (void)unlink(log_path.c_str());
+    (void)unlink((log_path + CONTAINER_LOG_INDEX_SUFFIX).c_str());
+
+    terminal = new_test_terminal(log_path, 1ULL << 40);
+    ASSERT_NE(terminal, nullptr);
+    start = std::chrono::steady_clock::now();
+    for (written = 0; written < total; written += chunk.size()) {
+        size_t begin = 0;
+        size_t i;
+        for (i = 0; i < chunk.size(); i++) {
+            if (chunk[i] == '\n') {
+                legacy_logger_write(terminal, "stdout", chunk.c_str() + begin, i - begin + 1);
+                begin = i + 1;
+            }
+        }
+    }
+    double legacy = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    free_test_terminal(terminal);
+    (void)unlink(log_path.c_str());
+    (void)unlink((log_path + CONTAINER_LOG_INDEX_SUFFIX).c_str());
+
+    std::cout << "log throughput: current " << total / fast / 1024 / 1024 << " MB/s, previous "
+              << total / legacy / 1024 / 1024 << " MB/s" << std::endl;
+}
+
+static bool wait_readable(int fd, int timeout_ms)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+
+    return poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN);
+}
+
+// stdout of container is not read by isulad, stdin must still be copied to container
+TEST_F(IsuladShimUnitTest, test_io_copy_stdin_with_slow_stdout_reader)
+{
+    string in_fifo = "/tmp/test_shim_io_stdin";
+    string out_fifo = "/tmp/test_shim_io_stdout";
+    string msg = "hello from stdin";
+    char chunk[4096] = { 0 };
+    char buf[64] = { 0 };
+    pthread_t tid_accept;
+    int i;
+
+    (void)unlink(in_fifo.c_str());
+    (void)unlink(out_fifo.c_str());
+    ASSERT_EQ(mkfifo(in_fifo.c_str(), 0600), 0);
+    ASSERT_EQ(mkfifo(out_fifo.c_str(), 0600), 0);
+    // the shim opens the stdout fifo for write, so there must be a reader already
+    int out_reader = open(out_fifo.c_str(), O_RDONLY | O_NONBLOCK);
+    ASSERT_GE(out_reader, 0);
+
+    process_t *p = (process_t *)calloc(1, sizeof(process_t));
+    ASSERT_NE(p, nullptr);
+    p->state = (shim_client_process_state *)calloc(1, sizeof(shim_client_process_state));
+    ASSERT_NE(p->state, nullptr);
+    p->state->isulad_stdin = (char *)in_fifo.c_str();
+    p->state->isulad_stdout = (char *)out_fifo.c_str();
+    p->state->open_stdin = true;
+    p->io_loop_fd = -1;
+    p->exit_fd = -1;
+    ASSERT_EQ(sem_init(&p->sem_mainloop, 0, 0), 0);
+    ASSERT_EQ(process_io_init(p), SHIM_OK);
+    ASSERT_EQ(open_io(p, &tid_accept), SHIM_OK);
+    int in_writer = open(in_fifo.c_str(), O_WRONLY | O_NONBLOCK);
+    ASSERT_GE(in_writer, 0);
+
+    // container writes until stdout pipe and fifo are full, nobody reads the fifo
+    (void)memset(chunk, 'o', sizeof(chunk));
+    for (i = 0; i < 64; i++) {
+        (void)write(p->stdio->out, chunk, sizeof(chunk));
+    }
+
+    ASSERT_EQ(write(in_writer, msg.c_str(), msg.size()), (ssize_t)msg.size());
+    ASSERT_TRUE(wait_readable(p->stdio->in, 5000));
+    ASSERT_EQ(read(p->stdio->in, buf, sizeof(buf)), (ssize_t)msg.size());
+    EXPECT_EQ(string(buf, msg.size()), msg);
+
+    // the blocked stdout copy goes on once the reader drains the fifo
+    ASSERT_TRUE(wait_readable(out_reader, 5000));
+    EXPECT_GT(read(out_reader, chunk, sizeof(chunk)), 0);
+
+    // io threads live as long as the process, keep the process and its fds for them
+    (void)unlink(in_fifo.c_str());
+    (void)unlink(out_fifo.c_str());
+}
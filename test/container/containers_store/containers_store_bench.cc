@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: containers store microbenchmark, not run by ctest
+ * Author: iSulad Team
+ * Create: 2023-07-12
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <isula_libutils/container_config_v2.h>
+#include "container_api.h"
+#include "utils.h"
+#include "utils_array.h"
+
+static const size_t BENCH_CONTAINERS = 10000;
+static const size_t BENCH_OPS_PER_READER = 200000;
+
+void container_refinc(container_t *cont)
+{
+    if (cont == nullptr) {
+        return;
+    }
+    atomic_int_inc(&cont->refcnt);
+}
+
+void container_unref(container_t *cont)
+{
+    if (cont == nullptr) {
+        return;
+    }
+    if (!atomic_int_dec_test(&cont->refcnt)) {
+        return;
+    }
+    free_container_config_v2_common_config(cont->common_config);
+    free(cont);
+}
+
+static container_t *new_fake_container(const std::string &id)
+{
+    container_t *cont = static_cast<container_t *>(util_common_calloc_s(sizeof(container_t)));
+    if (cont == nullptr) {
+        return nullptr;
+    }
+    cont->common_config = static_cast<container_config_v2_common_config *>(
+                              util_common_calloc_s(sizeof(container_config_v2_common_config)));
+    if (cont->common_config == nullptr) {
+        free(cont);
+        return nullptr;
+    }
+    cont->common_config->id = util_strdup_s(id.c_str());
+    cont->refcnt = 1;
+    return cont;
+}
+
+// 64 hex chars id, unique for each index
+static std::string make_id(size_t index)
+{
+    char buf[65] = { 0 };
+    uint64_t seed = index * 0x9E3779B97F4A7C15ULL + 1;
+    size_t i;
+
+    for (i = 0; i < 64; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        buf[i] = "0123456789abcdef"[seed & 0xf];
+    }
+    // keep ids unique even if the generated prefix collides
+    (void)snprintf(buf + 48, sizeof(buf) - 48, "%016zx", index);
+    return std::string(buf);
+}
+
+static std::string make_name(size_t index)
+{
+    return "container_" + std::to_string(index);
+}
+
+class ContainersStoreBenchmark : public testing::Test {
+public:
+    static void SetUpTestCase()
+    {
+        ASSERT_EQ(containers_store_init(), 0);
+        ASSERT_EQ(container_name_index_init(), 0);
+    }
+
+protected:
+    void AddContainer(const std::string &id, const std::string &name)
+    {
+        container_t *cont = new_fake_container(id);
+        ASSERT_NE(cont, nullptr);
+        ASSERT_TRUE(containers_store_add(id.c_str(), cont));
+        ASSERT_TRUE(container_name_index_add(name.c_str(), id.c_str()));
+    }
+};
+
+static double ops_per_second(size_t ops, std::chrono::steady_clock::duration elapsed)
+{
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return seconds > 0 ? ops / seconds : 0;
+}
+
+// microbenchmark: insert and lookup throughput with 10k containers and concurrent readers
+TEST_F(ContainersStoreBenchmark, lookup_with_concurrent_readers)
+{
+    std::vector<std::string> ids;
+    size_t i;
+    size_t readers = std::thread::hardware_concurrency();
+    std::atomic<size_t> misses(0);
+    std::atomic<bool> stop_writer(false);
+
+    if (readers < 2) {
+        readers = 2;
+    }
+
+    for (i = 0; i < BENCH_CONTAINERS; i++) {
+        ids.push_back(make_id(i));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (i = 0; i < BENCH_CONTAINERS; i++) {
+        AddContainer(ids[i], make_name(i));
+    }
+    auto insert_elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "insert " << BENCH_CONTAINERS << " containers: "
+              << ops_per_second(BENCH_CONTAINERS, insert_elapsed) << " ops/s" << std::endl;
+
+    // a writer keeps creating and removing containers while readers are running
+    std::thread writer([&stop_writer]() {
+        size_t n = 0;
+        while (!stop_writer.load()) {
+            std::string id = make_id(BENCH_CONTAINERS + (n % 64));
+            container_t *cont = new_fake_container(id);
+            if (cont != nullptr && !containers_store_add(id.c_str(), cont)) {
+                container_unref(cont);
+            }
+            containers_store_remove(id.c_str());
+            n++;
+        }
+    });
+
+    std::vector<std::thread> workers;
+    start = std::chrono::steady_clock::now();
+    for (i = 0; i < readers; i++) {
+        workers.emplace_back([&ids, &misses, i]() {
+            size_t j;
+            for (j = 0; j < BENCH_OPS_PER_READER; j++) {
+                size_t idx = (j * 7919 + i * 104729) % BENCH_CONTAINERS;
+                container_t *cont = nullptr;
+                switch (j % 3) {
+                    case 0:
+                        cont = containers_store_get(ids[idx].c_str());
+                        break;
+                    case 1:
+                        cont = containers_store_get(make_name(idx).c_str());
+                        break;
+                    default:
+                        cont = containers_store_get(ids[idx].substr(0, 12).c_str());
+                        break;
+                }
+                if (cont == nullptr) {
+                    misses++;
+                }
+                container_unref(cont);
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    auto lookup_elapsed = std::chrono::steady_clock::now() - start;
+    stop_writer.store(true);
+    writer.join();
+
+    std::cout << "lookup (id/name/short id) with " << readers << " readers: "
+              << ops_per_second(readers * BENCH_OPS_PER_READER, lookup_elapsed) << " ops/s" << std::endl;
+
+    ASSERT_EQ(misses.load(), 0);
+}
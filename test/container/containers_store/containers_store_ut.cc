@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: containers store unit test
+ * Author: iSulad Team
+ * Create: 2023-07-12
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <isula_libutils/container_config_v2.h>
+#include "container_api.h"
+#include "utils.h"
+#include "utils_array.h"
+
+void container_refinc(container_t *cont)
+{
+    if (cont == nullptr) {
+        return;
+    }
+    atomic_int_inc(&cont->refcnt);
+}
+
+void container_unref(container_t *cont)
+{
+    if (cont == nullptr) {
+        return;
+    }
+    if (!atomic_int_dec_test(&cont->refcnt)) {
+        return;
+    }
+    free_container_config_v2_common_config(cont->common_config);
+    free(cont);
+}
+
+static container_t *new_fake_container(const std::string &id)
+{
+    container_t *cont = static_cast<container_t *>(util_common_calloc_s(sizeof(container_t)));
+    if (cont == nullptr) {
+        return nullptr;
+    }
+    cont->common_config = static_cast<container_config_v2_common_config *>(
+                              util_common_calloc_s(sizeof(container_config_v2_common_config)));
+    if (cont->common_config == nullptr) {
+        free(cont);
+        return nullptr;
+    }
+    cont->common_config->id = util_strdup_s(id.c_str());
+    cont->refcnt = 1;
+    return cont;
+}
+
+// 64 hex chars id, unique for each index
+static std::string make_id(size_t index)
+{
+    char buf[65] = { 0 };
+    uint64_t seed = index * 0x9E3779B97F4A7C15ULL + 1;
+    size_t i;
+
+    for (i = 0; i < 64; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        buf[i] = "0123456789abcdef"[seed & 0xf];
+    }
+    // keep ids unique even if the generated prefix collides
+    (void)snprintf(buf + 48, sizeof(buf) - 48, "%016zx", index);
+    return std::string(buf);
+}
+
+static std::string make_name(size_t index)
+{
+    return "container_" + std::to_string(index);
+}
+
+class ContainersStoreUnitTest : public testing::Test {
+public:
+    static void SetUpTestCase()
+    {
+        ASSERT_EQ(containers_store_init(), 0);
+        ASSERT_EQ(container_name_index_init(), 0);
+    }
+
+protected:
+    void TearDown() override
+    {
+        char **ids = containers_store_list_ids();
+        size_t i;
+
+        for (i = 0; ids != nullptr && ids[i] != nullptr; i++) {
+            containers_store_remove(ids[i]);
+        }
+        util_free_array(ids);
+
+        for (const auto &name : m_names) {
+            container_name_index_remove(name.c_str());
+        }
+        m_names.clear();
+    }
+
+    void AddContainer(const std::string &id, const std::string &name)
+    {
+        container_t *cont = new_fake_container(id);
+        ASSERT_NE(cont, nullptr);
+        ASSERT_TRUE(containers_store_add(id.c_str(), cont));
+        ASSERT_TRUE(container_name_index_add(name.c_str(), id.c_str()));
+        m_names.push_back(name);
+    }
+
+    std::vector<std::string> m_names;
+};
+
+TEST_F(ContainersStoreUnitTest, test_get_by_id_name_and_prefix)
+{
+    container_t *cont = nullptr;
+
+    AddContainer("abcdef0123", "first");
+    AddContainer("abc9990000", "second");
+    AddContainer("ffff000011", "third");
+
+    cont = containers_store_get("abcdef0123");
+    ASSERT_NE(cont, nullptr);
+    ASSERT_STREQ(cont->common_config->id, "abcdef0123");
+    container_unref(cont);
+
+    cont = containers_store_get("second");
+    ASSERT_NE(cont, nullptr);
+    ASSERT_STREQ(cont->common_config->id, "abc9990000");
+    container_unref(cont);
+
+    cont = containers_store_get("ff");
+    ASSERT_NE(cont, nullptr);
+    ASSERT_STREQ(cont->common_config->id, "ffff000011");
+    container_unref(cont);
+
+    cont = containers_store_get("abcd");
+    ASSERT_NE(cont, nullptr);
+    ASSERT_STREQ(cont->common_config->id, "abcdef0123");
+    container_unref(cont);
+
+    // ambiguous prefix
+    ASSERT_EQ(containers_store_get("abc"), nullptr);
+    ASSERT_EQ(containers_store_get_by_prefix("abc"), nullptr);
+    // no match
+    ASSERT_EQ(containers_store_get("0000"), nullptr);
+
+    ASSERT_TRUE(containers_store_remove("abc9990000"));
+    ASSERT_FALSE(containers_store_remove("abc9990000"));
+    cont = containers_store_get("abc");
+    ASSERT_NE(cont, nullptr);
+    ASSERT_STREQ(cont->common_config->id, "abcdef0123");
+    container_unref(cont);
+}
+
+TEST_F(ContainersStoreUnitTest, test_list_is_sorted)
+{
+    container_t **conts = nullptr;
+    size_t size = 0;
+    char **ids = nullptr;
+    size_t i;
+
+    AddContainer("cc", "c");
+    AddContainer("aa", "a");
+    AddContainer("bb", "b");
+    // replace existing one
+    AddContainer("aa", "a2");
+
+    ids = containers_store_list_ids();
+    ASSERT_NE(ids, nullptr);
+    ASSERT_EQ(util_array_len((const char **)ids), 3);
+    ASSERT_STREQ(ids[0], "aa");
+    ASSERT_STREQ(ids[1], "bb");
+    ASSERT_STREQ(ids[2], "cc");
+    util_free_array(ids);
+
+    ASSERT_EQ(containers_store_list(&conts, &size), 0);
+    ASSERT_EQ(size, 3);
+    ASSERT_STREQ(conts[0]->common_config->id, "aa");
+    ASSERT_STREQ(conts[1]->common_config->id, "bb");
+    ASSERT_STREQ(conts[2]->common_config->id, "cc");
+    for (i = 0; i < size; i++) {
+        container_unref(conts[i]);
+    }
+    free(conts);
+}
+
+TEST_F(ContainersStoreUnitTest, test_name_index_rename)
+{
+    char *id = nullptr;
+    map_t *all = nullptr;
+
+    AddContainer("0123456789", "old_name");
+    ASSERT_TRUE(container_name_index_rename("new_name", "old_name", "0123456789"));
+    m_names.push_back("new_name");
+
+    ASSERT_EQ(container_name_index_get("old_name"), nullptr);
+    id = container_name_index_get("new_name");
+    ASSERT_STREQ(id, "0123456789");
+    free(id);
+
+    all = container_name_index_get_all();
+    ASSERT_NE(all, nullptr);
+    ASSERT_EQ(map_size(all), 1);
+    ASSERT_STREQ((const char *)map_search(all, (void *)"0123456789"), "new_name");
+    map_free(all);
+}
+
+TEST_F(ContainersStoreUnitTest, test_concurrent_lookup)
+{
+    const size_t containers = 1000;
+    const size_t readers = 4;
+    std::vector<std::string> ids;
+    std::atomic<size_t> misses(0);
+    std::atomic<bool> stop_writer(false);
+    size_t i;
+
+    for (i = 0; i < containers; i++) {
+        ids.push_back(make_id(i));
+        AddContainer(ids[i], make_name(i));
+    }
+
+    // a writer keeps creating and removing other containers while readers are running
+    std::thread writer([&stop_writer, containers]() {
+        size_t n = 0;
+        while (!stop_writer.load()) {
+            std::string id = make_id(containers + (n % 64));
+            container_t *cont = new_fake_container(id);
+            if (cont != nullptr && !containers_store_add(id.c_str(), cont)) {
+                container_unref(cont);
+            }
+            containers_store_remove(id.c_str());
+            n++;
+        }
+    });
+
+    std::vector<std::thread> workers;
+    for (i = 0; i < readers; i++) {
+        workers.emplace_back([&ids, &misses, containers, i]() {
+            size_t j;
+            for (j = 0; j < 3 * containers; j++) {
+                size_t idx = (j * 7919 + i * 104729) % containers;
+                container_t *cont = nullptr;
+                switch (j % 3) {
+                    case 0:
+                        cont = containers_store_get(ids[idx].c_str());
+                        break;
+                    case 1:
+                        cont = containers_store_get(make_name(idx).c_str());
+                        break;
+                    default:
+                        cont = containers_store_get(ids[idx].substr(0, 12).c_str());
+                        break;
+                }
+                if (cont == nullptr) {
+                    misses++;
+                }
+                container_unref(cont);
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    stop_writer.store(true);
+    writer.join();
+
+    ASSERT_EQ(misses.load(), 0);
+}
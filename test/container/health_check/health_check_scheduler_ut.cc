@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: health check scheduler unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "health_check_scheduler.h"
+
+static const int64_t SHORT_INTERVAL = 100 * Time_Milli;
+static const int64_t LONG_INTERVAL = 100 * Time_Second;
+static const int64_t PROBE_TIMEOUT = 100 * Time_Milli;
+
+// callbacks of the scheduler are shared by all tests, each test uses its own container ids
+static std::mutex g_mutex;
+static std::condition_variable g_cond;
+static std::map<std::string, int> g_probes;
+static std::map<std::string, std::vector<uint64_t>> g_ends;
+// probe action is given the number of probes run so far
+static std::map<std::string, std::function<bool(int)>> g_probe_actions;
+static std::map<std::string, std::function<void(uint64_t)>> g_end_actions;
+
+static bool test_probe(const char *id)
+{
+    std::function<bool(int)> action;
+    int probes = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        probes = ++g_probes[id];
+        g_cond.notify_all();
+        if (g_probe_actions.count(id) != 0) {
+            action = g_probe_actions[id];
+        }
+    }
+
+    return action ? action(probes) : true;
+}
+
+static void test_monitor_end(const char *id, uint64_t generation)
+{
+    std::function<void(uint64_t)> action;
+
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (g_end_actions.count(id) != 0) {
+            action = g_end_actions[id];
+        }
+    }
+    if (action) {
+        action(generation);
+    }
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_ends[id].push_back(generation);
+    g_cond.notify_all();
+}
+
+static bool wait_for(const std::function<bool()> &done, int seconds = 5)
+{
+    std::unique_lock<std::mutex> lock(g_mutex);
+
+    return g_cond.wait_for(lock, std::chrono::seconds(seconds), done);
+}
+
+// blocks probes or end callbacks until opened
+class Gate {
+public:
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_waiters++;
+        m_cond.notify_all();
+        m_cond.wait(lock, [this]() {
+            return m_open;
+        });
+    }
+
+    bool WaitWaiters(int waiters)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cond.wait_for(lock, std::chrono::seconds(5), [this, waiters]() {
+            return m_waiters >= waiters;
+        });
+    }
+
+    void Open()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_open = true;
+        m_cond.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    int m_waiters { 0 };
+    bool m_open { false };
+};
+
+class HealthCheckSchedulerUnitTest : public testing::Test {
+public:
+    static void SetUpTestCase()
+    {
+        ASSERT_EQ(health_check_scheduler_init(test_probe, test_monitor_end), 0);
+    }
+};
+
+TEST_F(HealthCheckSchedulerUnitTest, test_invalid_args)
+{
+    ASSERT_EQ(health_check_scheduler_add(nullptr, SHORT_INTERVAL, PROBE_TIMEOUT, 1), -1);
+    ASSERT_EQ(health_check_scheduler_add("invalid", 0, PROBE_TIMEOUT, 1), -1);
+    ASSERT_EQ(health_check_scheduler_add("invalid", SHORT_INTERVAL, 0, 1), -1);
+    ASSERT_TRUE(health_check_scheduler_cancel(nullptr));
+    ASSERT_TRUE(health_check_scheduler_cancel("invalid"));
+}
+
+TEST_F(HealthCheckSchedulerUnitTest, test_probe_until_end)
+{
+    const std::string id = "probe_until_end";
+
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_probe_actions[id] = [](int probes) {
+            return probes < 3;
+        };
+    }
+
+    ASSERT_EQ(health_check_scheduler_add(id.c_str(), SHORT_INTERVAL, PROBE_TIMEOUT, 1), 0);
+    ASSERT_EQ(health_check_scheduler_add(id.c_str(), SHORT_INTERVAL, PROBE_TIMEOUT, 2), -1);
+    ASSERT_TRUE(wait_for([id]() {
+        return g_ends[id].size() == 1;
+    }));
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    ASSERT_EQ(g_probes[id], 3);
+    ASSERT_EQ(g_ends[id][0], 1U);
+}
+
+TEST_F(HealthCheckSchedulerUnitTest, test_cancel_waiting)
+{
+    const std::string id = "cancel_waiting";
+
+    ASSERT_EQ(health_check_scheduler_add(id.c_str(), LONG_INTERVAL, PROBE_TIMEOUT, 7), 0);
+    ASSERT_TRUE(health_check_scheduler_cancel(id.c_str()));
+
+    // ended by cancel itself
+    std::lock_guard<std::mutex> lock(g_mutex);
+    ASSERT_EQ(g_probes[id], 0);
+    ASSERT_EQ(g_ends[id], std::vector<uint64_t>({ 7 }));
+}
+
+TEST_F(HealthCheckSchedulerUnitTest, test_cancel_running)
+{
+    const std::string id = "cancel_running";
+    Gate gate;
+
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_probe_actions[id] = [&gate](int probes) {
+            gate.Wait();
+            return true;
+        };
+    }
+
+    ASSERT_EQ(health_check_scheduler_add(id.c_str(), SHORT_INTERVAL, LONG_INTERVAL, 1), 0);
+    ASSERT_TRUE(gate.WaitWaiters(1));
+
+    // the running probe ends the monitor when it returns
+    ASSERT_FALSE(health_check_scheduler_cancel(id.c_str()));
+    ASSERT_EQ(health_check_scheduler_add(id.c_str(), SHORT_INTERVAL, LONG_INTERVAL, 2), -1);
+    gate.Open();
+    ASSERT_TRUE(wait_for([id]() {
+        return g_ends[id].size() == 1;
+    }));
+
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        ASSERT_EQ(g_probes[id], 1);
+        ASSERT_EQ(g_ends[id][0], 1U);
+        g_probe_actions.erase(id);
+    }
+
+    ASSERT_EQ(health_check_scheduler_add(id.c_str(), LONG_INTERVAL, LONG_INTERVAL, 2), 0);
+    ASSERT_TRUE(health_check_scheduler_cancel(id.c_str()));
+}
+
+TEST_F(HealthCheckSchedulerUnitTest, test_end_of_previous_monitor)
+{
+    const std::string id = "end_of_previous_monitor";
+    Gate gate;
+
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_probe_actions[id] = [](int probes) {
+            return false;
+        };
+        g_end_actions[id] = [&gate](uint64_t generation) {
+            if (generation == 1) {
+                gate.Wait();
+            }
+        };
+    }
+
+    ASSERT_EQ(health_check_scheduler_add(id.c_str(), SHORT_INTERVAL, PROBE_TIMEOUT, 1), 0);
+    ASSERT_TRUE(gate.WaitWaiters(1));
+
+    // the scheduler has dropped the monitor, a new one starts before the end of the old one is handled
+    ASSERT_TRUE(health_check_scheduler_cancel(id.c_str()));
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_probe_actions.erase(id);
+    }
+    ASSERT_EQ(health_check_scheduler_add(id.c_str(), LONG_INTERVAL, PROBE_TIMEOUT, 2), 0);
+    gate.Open();
+    ASSERT_TRUE(wait_for([id]() {
+        return g_ends[id].size() == 1;
+    }));
+
+    ASSERT_TRUE(health_check_scheduler_cancel(id.c_str()));
+    std::lock_guard<std::mutex> lock(g_mutex);
+    ASSERT_EQ(g_ends[id], std::vector<uint64_t>({ 1, 2 }));
+    g_end_actions.erase(id);
+}
+
+TEST_F(HealthCheckSchedulerUnitTest, test_hung_probes)
+{
+    const std::string healthy = "healthy";
+    health_check_metrics_t metrics = { 0 };
+    std::vector<std::string> hung;
+    Gate gate;
+
+    health_check_scheduler_get_metrics(&metrics);
+    const uint64_t workers = metrics.workers;
+    ASSERT_GT(workers, 0U);
+
+    // every worker runs a probe which never returns in time
+    for (uint64_t i = 0; i < workers; i++) {
+        hung.push_back("hung" + std::to_string(i));
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_probe_actions[hung.back()] = [&gate](int probes) {
+            gate.Wait();
+            return false;
+        };
+    }
+    for (const auto &id : hung) {
+        ASSERT_EQ(health_check_scheduler_add(id.c_str(), SHORT_INTERVAL, PROBE_TIMEOUT, 1), 0);
+    }
+    ASSERT_TRUE(gate.WaitWaiters((int)workers));
+
+    // other containers are still probed
+    ASSERT_EQ(health_check_scheduler_add(healthy.c_str(), SHORT_INTERVAL, PROBE_TIMEOUT, 1), 0);
+    ASSERT_TRUE(wait_for([healthy]() {
+        return g_probes[healthy] >= 2;
+    }));
+    health_check_scheduler_get_metrics(&metrics);
+    ASSERT_GE(metrics.probes_timeout, workers);
+    ASSERT_GT(metrics.workers, workers);
+    ASSERT_LE(metrics.workers, workers + HEALTH_MAX_REPLACEMENT_WORKERS);
+
+    // replacement workers exit once the hung probes return
+    gate.Open();
+    ASSERT_TRUE(wait_for([hung]() {
+        for (const auto &id : hung) {
+            if (g_ends[id].size() != 1) {
+                return false;
+            }
+        }
+        return true;
+    }));
+    ASSERT_TRUE(health_check_scheduler_cancel(healthy.c_str()) || wait_for([healthy]() {
+        return g_ends[healthy].size() == 1;
+    }));
+    for (int i = 0; i < 50; i++) {
+        health_check_scheduler_get_metrics(&metrics);
+        if (metrics.workers == workers) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_EQ(metrics.workers, workers);
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: background directory reaper unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "mock.h"
+#include "dir_reaper.h"
+#include "isulad_config_mock.h"
+#include "utils.h"
+#include "utils_file.h"
+
+using ::testing::NiceMock;
+using ::testing::Invoke;
+
+extern "C" {
+    DECLARE_WRAPPER_V(rename, int, (const char *oldpath, const char *newpath));
+    DEFINE_WRAPPER_V(rename, int, (const char *oldpath, const char *newpath), (oldpath, newpath));
+}
+
+static const std::string ROOT_DIR = "/tmp/isulad_dir_reaper_ut";
+static const std::string TRASH_DIR = ROOT_DIR + "/" + DIR_REAPER_TRASH_NAME;
+static const std::string CONTAINERS_DIR = ROOT_DIR + "/containers";
+
+static std::vector<std::string> g_renamed;
+
+static int rename_record(const char *oldpath, const char *newpath)
+{
+    g_renamed.push_back(newpath);
+    return __real_rename(oldpath, newpath);
+}
+
+// the trash dir is on another filesystem
+static int rename_exdev(const char *oldpath, const char *newpath)
+{
+    errno = EXDEV;
+    return -1;
+}
+
+static size_t count_entries(const std::string &dir)
+{
+    DIR *d = opendir(dir.c_str());
+    struct dirent *entry = nullptr;
+    size_t count = 0;
+
+    if (d == nullptr) {
+        return 0;
+    }
+    while ((entry = readdir(d)) != nullptr) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            count++;
+        }
+    }
+    closedir(d);
+    return count;
+}
+
+// the trash is removed in background
+static bool wait_trash_empty()
+{
+    for (int i = 0; i < 500; i++) {
+        if (count_entries(TRASH_DIR) == 0) {
+            return true;
+        }
+        usleep(10 * 1000);
+    }
+    return false;
+}
+
+static void make_dir_with_files(const std::string &dir)
+{
+    ASSERT_EQ(util_mkdir_p((dir + "/rootfs/etc").c_str(), 0700), 0);
+    std::ofstream(dir + "/config.v2.json") << "{}";
+    std::ofstream(dir + "/rootfs/etc/hosts") << "127.0.0.1 localhost";
+}
+
+class DirReaperUnitTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        MockIsuladConf_SetMock(&m_isulad_conf);
+        ON_CALL(m_isulad_conf, ConfGetISuladRootDir()).WillByDefault(Invoke([]() {
+            return util_strdup_s(ROOT_DIR.c_str());
+        }));
+
+        // the reaper keeps the trash dir created on first use
+        ASSERT_EQ(util_recursive_rmdir(CONTAINERS_DIR.c_str(), 0), 0);
+        ASSERT_EQ(util_mkdir_p(TRASH_DIR.c_str(), 0700), 0);
+        ASSERT_TRUE(wait_trash_empty());
+        g_renamed.clear();
+    }
+
+    void TearDown() override
+    {
+        MOCK_CLEAR(rename);
+        MockIsuladConf_SetMock(nullptr);
+    }
+
+    NiceMock<MockIsuladConf> m_isulad_conf;
+};
+
+TEST_F(DirReaperUnitTest, test_rename_then_reap)
+{
+    const std::string dir = CONTAINERS_DIR + "/c1";
+
+    ASSERT_EQ(dir_reaper_remove(nullptr), -1);
+
+    // the same dir is created and removed again before the old one is reaped
+    MOCK_SET_V(rename, rename_record);
+    for (int i = 0; i < 3; i++) {
+        make_dir_with_files(dir);
+        ASSERT_EQ(dir_reaper_remove(dir.c_str()), 0);
+        ASSERT_FALSE(util_dir_exists(dir.c_str()));
+    }
+
+    ASSERT_EQ(g_renamed.size(), 3U);
+    for (size_t i = 0; i < g_renamed.size(); i++) {
+        ASSERT_EQ(g_renamed[i].find(TRASH_DIR + "/c1-"), 0U);
+        for (size_t j = 0; j < i; j++) {
+            ASSERT_NE(g_renamed[i], g_renamed[j]);
+        }
+    }
+    ASSERT_TRUE(wait_trash_empty());
+    ASSERT_TRUE(util_dir_exists(CONTAINERS_DIR.c_str()));
+}
+
+TEST_F(DirReaperUnitTest, test_exdev_fallback)
+{
+    const std::string dir = CONTAINERS_DIR + "/c2";
+
+    make_dir_with_files(dir);
+    MOCK_SET_V(rename, rename_exdev);
+
+    // removed before it returns
+    ASSERT_EQ(dir_reaper_remove(dir.c_str()), 0);
+    ASSERT_FALSE(util_dir_exists(dir.c_str()));
+    ASSERT_EQ(count_entries(TRASH_DIR), 0U);
+
+    MOCK_CLEAR(rename);
+    ASSERT_EQ(dir_reaper_remove((CONTAINERS_DIR + "/not_exist").c_str()), 0);
+}
+
+TEST_F(DirReaperUnitTest, test_resume_after_restart)
+{
+    // left in the trash by the last run
+    make_dir_with_files(TRASH_DIR + "/c3-1-1");
+    make_dir_with_files(TRASH_DIR + "/c4-2-2");
+    ASSERT_EQ(count_entries(TRASH_DIR), 2U);
+
+    ASSERT_EQ(trash_dir_cleaner(nullptr), 0);
+    ASSERT_TRUE(wait_trash_empty());
+    ASSERT_TRUE(util_dir_exists(TRASH_DIR.c_str()));
+
+    ASSERT_EQ(trash_dir_cleaner(nullptr), 0);
+}
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: containers restore unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <dirent.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "mock.h"
+#include "restore.h"
+#include "isulad_config.h"
+#include "container_api.h"
+#include "supervisor.h"
+#include "containers_gc.h"
+#include "image_api.h"
+#include "runtime_api.h"
+#include "service_container_api.h"
+#include "restartmanager.h"
+#ifdef ENABLE_NATIVE_NETWORK
+#include "service_network_api.h"
+#endif
+#include "utils.h"
+#include "utils_file.h"
+
+static const std::string ROOT_DIR = "/tmp/isulad_restore_ut";
+static const std::string RUNTIME = "lcr";
+// runtimes to restore are the subdirs of the engine root
+static const std::string ENGINE_DIR = ROOT_DIR + "/engines";
+static const std::string ROOTPATH = ENGINE_DIR + "/" + RUNTIME;
+static const std::string STATEPATH = ROOT_DIR + "/state/" + RUNTIME;
+
+static std::mutex g_mutex;
+// id --> name of the containers to load, ids not in it fail to load
+static std::map<std::string, std::string> g_names;
+static std::set<std::string> g_missing_images;
+static std::map<std::string, int> g_load_times;
+static std::set<std::thread::id> g_load_threads;
+// name --> id
+static std::map<std::string, std::string> g_name_index;
+static std::vector<container_t *> g_store;
+
+static void free_fake_container(container_t *cont)
+{
+    free(cont->common_config->id);
+    free(cont->common_config->name);
+    free(cont->common_config->image);
+    free(cont->common_config->image_type);
+    free(cont->common_config);
+    free(cont->state->state);
+    free(cont->state);
+    free(cont->runtime);
+    free(cont->root_path);
+    free(cont->state_path);
+    free(cont);
+}
+
+extern "C" {
+    char *conf_get_engine_rootpath()
+    {
+        return util_strdup_s(ENGINE_DIR.c_str());
+    }
+
+    char *conf_get_routine_rootdir(const char *runtime)
+    {
+        return util_strdup_s((ENGINE_DIR + "/" + runtime).c_str());
+    }
+
+    char *conf_get_routine_statedir(const char *runtime)
+    {
+        return util_strdup_s((ROOT_DIR + "/state/" + runtime).c_str());
+    }
+
+    container_t *container_load(const char *runtime, const char *rootpath, const char *statepath, const char *id)
+    {
+        container_t *cont = nullptr;
+        std::string name;
+
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_load_times[id]++;
+            g_load_threads.insert(std::this_thread::get_id());
+            if (g_names.count(id) == 0) {
+                return nullptr;
+            }
+            name = g_names[id];
+        }
+        // loading reads config files
+        usleep(2000);
+
+        cont = (container_t *)util_common_calloc_s(sizeof(container_t));
+        cont->common_config = (container_config_v2_common_config *)util_common_calloc_s(
+                                  sizeof(container_config_v2_common_config));
+        cont->common_config->id = util_strdup_s(id);
+        cont->common_config->name = util_strdup_s(name.c_str());
+        cont->common_config->image = util_strdup_s(id);
+        cont->common_config->image_type = util_strdup_s(IMAGE_TYPE_OCI);
+        cont->state = (container_state_t *)util_common_calloc_s(sizeof(container_state_t));
+        cont->state->state = (container_state *)util_common_calloc_s(sizeof(container_state));
+        cont->runtime = util_strdup_s(runtime);
+        cont->root_path = util_strdup_s(rootpath);
+        cont->state_path = util_strdup_s(statepath);
+        return cont;
+    }
+
+    bool im_oci_image_exist(const char *name)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        return g_missing_images.count(name) == 0;
+    }
+
+    int runtime_status(const char *name, const char *runtime, const rt_status_params_t *params,
+                       struct runtime_container_status_info *status)
+    {
+        status->status = RUNTIME_CONTAINER_STATUS_STOPPED;
+        return 0;
+    }
+
+    Container_Status container_state_get_status(container_state_t *s)
+    {
+        return CONTAINER_STATUS_STOPPED;
+    }
+
+    bool container_name_index_add(const char *name, const char *id)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        return g_name_index.insert({ name, id }).second;
+    }
+
+    bool container_name_index_remove(const char *name)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        return g_name_index.erase(name) > 0;
+    }
+
+    bool containers_store_add(const char *id, container_t *cont)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_store.push_back(cont);
+        return true;
+    }
+
+    // restored containers are handled by other tests
+    int containers_store_list(container_t ***out, size_t *size)
+    {
+        *out = nullptr;
+        *size = 0;
+        return 0;
+    }
+
+    void container_unref(container_t *cont)
+    {
+        if (cont != nullptr) {
+            free_fake_container(cont);
+        }
+    }
+
+    DEFINE_STUB(cleanup_mounts_by_id, int, (const char *id, const char *engine_root_path), 0);
+    DEFINE_STUB(im_remove_container_rootfs, int, (const char *image_type, const char *container_id), 0);
+    DEFINE_STUB(container_exit_on_next, int, (container_t *cont), 0);
+    DEFINE_STUB(container_state_to_disk, int, (const container_t *cont), 0);
+    DEFINE_STUB(container_is_removal_in_progress, bool, (container_state_t *s), false);
+    DEFINE_STUB_V(container_state_reset_removal_in_progress, (container_state_t *s));
+    DEFINE_STUB_V(container_state_set_running, (container_state_t *s, const pid_ppid_info_t *pid_info, bool initial));
+    DEFINE_STUB_V(container_state_set_stopped, (container_state_t *s, int exit_code));
+    DEFINE_STUB_V(container_state_set_paused, (container_state_t *s));
+    DEFINE_STUB_V(container_state_reset_has_been_manual_stopped, (container_state_t *s));
+    DEFINE_STUB(container_is_running, bool, (container_state_t *s), false);
+    DEFINE_STUB(container_state_get_started_at, char *, (container_state_t *s), nullptr);
+    DEFINE_STUB(container_state_get_exitcode, uint32_t, (container_state_t *s), 0);
+    DEFINE_STUB(container_state_get_has_been_manual_stopped, bool, (container_state_t *s), false);
+    DEFINE_STUB_V(container_state_increase_restart_count, (container_state_t *s));
+    DEFINE_STUB_V(container_lock, (container_t *cont));
+    DEFINE_STUB_V(container_unlock, (container_t *cont));
+    DEFINE_STUB(container_reset_restart_manager, bool, (container_t *cont, bool reset_count), true);
+    DEFINE_STUB(container_is_in_gc_progress, bool, (const char *id), false);
+    DEFINE_STUB_V(container_init_health_monitor, (const char *id));
+    DEFINE_STUB(container_restart_in_thread, int, (const char *id, uint64_t timeout, int exit_code), 0);
+    DEFINE_STUB(restart_manager_should_restart, bool, (const char *id, uint32_t exit_code,
+                                                       bool has_been_manually_stopped, int64_t exec_duration,
+                                                       uint64_t *timeout), false);
+    DEFINE_STUB(exit_fifo_name, char *, (const char *cont_state_path), nullptr);
+    DEFINE_STUB(container_exit_fifo_open, int, (const char *cont_exit_fifo), -1);
+    DEFINE_STUB(container_supervisor_add_exit_monitor, int, (int fd, const pid_ppid_info_t *pid_info,
+                                                             const char *name, const char *runtime), -1);
+    DEFINE_STUB(gc_add_container, int, (const char *id, const char *runtime, const pid_ppid_info_t *pid_info), 0);
+    DEFINE_STUB(set_container_to_removal, int, (const container_t *cont), 0);
+    DEFINE_STUB(delete_container, int, (container_t *cont, bool force), 0);
+#ifdef ENABLE_NATIVE_NETWORK
+    DEFINE_STUB(network_store_container_list_add, bool, (container_t *cont), true);
+#endif
+}
+
+static std::string container_id(int i)
+{
+    char id[65] = { 0 };
+
+    (void)snprintf(id, sizeof(id), "%064x", i);
+    return std::string(id);
+}
+
+// the order of containers to restore
+static std::vector<std::string> list_subdirs(const std::string &path)
+{
+    std::vector<std::string> names;
+    DIR *dir = opendir(path.c_str());
+    struct dirent *entry = nullptr;
+
+    if (dir == nullptr) {
+        return names;
+    }
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+    return names;
+}
+
+static std::vector<std::string> stored_ids()
+{
+    std::vector<std::string> ids;
+
+    for (const auto &cont : g_store) {
+        ids.push_back(cont->common_config->id);
+    }
+    return ids;
+}
+
+class RestoreUnitTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(util_recursive_rmdir(ROOT_DIR.c_str(), 0), 0);
+        ASSERT_EQ(util_mkdir_p(ROOTPATH.c_str(), 0700), 0);
+        ASSERT_EQ(util_mkdir_p(STATEPATH.c_str(), 0700), 0);
+    }
+
+    void TearDown() override
+    {
+        for (auto cont : g_store) {
+            free_fake_container(cont);
+        }
+        g_store.clear();
+        g_names.clear();
+        g_missing_images.clear();
+        g_load_times.clear();
+        g_load_threads.clear();
+        g_name_index.clear();
+        util_recursive_rmdir(ROOT_DIR.c_str(), 0);
+    }
+
+    void AddContainer(const std::string &id, const std::string &name)
+    {
+        ASSERT_EQ(util_mkdir_p((ROOTPATH + "/" + id).c_str(), 0700), 0);
+        ASSERT_EQ(util_mkdir_p((STATEPATH + "/" + id).c_str(), 0700), 0);
+        if (!name.empty()) {
+            g_names[id] = name;
+        }
+    }
+};
+
+TEST_F(RestoreUnitTest, test_restore_in_parallel)
+{
+    const int count = 64;
+    std::vector<std::string> order;
+
+    for (int i = 0; i < count; i++) {
+        AddContainer(container_id(i), "name" + std::to_string(i));
+    }
+    order = list_subdirs(ROOTPATH);
+
+    containers_restore();
+
+    ASSERT_EQ(g_load_times.size(), (size_t)count);
+    for (const auto &it : g_load_times) {
+        ASSERT_EQ(it.second, 1);
+    }
+    // loaded by workers, committed in directory order
+    if (sysconf(_SC_NPROCESSORS_ONLN) > 1) {
+        ASSERT_GT(g_load_threads.size(), 1U);
+    }
+    ASSERT_EQ(stored_ids(), order);
+    ASSERT_EQ(g_name_index.size(), (size_t)count);
+}
+
+TEST_F(RestoreUnitTest, test_remove_invalid_containers)
+{
+    std::string broken = container_id(1);
+    std::string no_image = container_id(2);
+    std::vector<std::string> dups { container_id(3), container_id(4) };
+    std::vector<std::string> order;
+    std::vector<std::string> expected;
+
+    AddContainer(container_id(0), "valid");
+    AddContainer(broken, "");
+    AddContainer(no_image, "no_image");
+    g_missing_images.insert(no_image);
+    AddContainer(dups[0], "dup");
+    AddContainer(dups[1], "dup");
+
+    // the first one of the same name in directory order is kept
+    std::string kept_dup;
+    std::string removed_dup;
+    order = list_subdirs(ROOTPATH);
+    for (const auto &id : order) {
+        if (id == dups[0] || id == dups[1]) {
+            if (!kept_dup.empty()) {
+                removed_dup = id;
+                continue;
+            }
+            kept_dup = id;
+        }
+        if (id == container_id(0) || id == kept_dup) {
+            expected.push_back(id);
+        }
+    }
+
+    containers_restore();
+
+    ASSERT_EQ(stored_ids(), expected);
+    ASSERT_EQ(g_name_index.size(), 2U);
+    ASSERT_EQ(g_name_index["dup"], kept_dup);
+    for (const auto &id : { broken, no_image, removed_dup }) {
+        ASSERT_FALSE(util_dir_exists((ROOTPATH + "/" + id).c_str()));
+        ASSERT_FALSE(util_dir_exists((STATEPATH + "/" + id).c_str()));
+    }
+    for (const auto &id : expected) {
+        ASSERT_TRUE(util_dir_exists((ROOTPATH + "/" + id).c_str()));
+    }
+}
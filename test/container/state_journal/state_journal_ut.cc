@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: container state journal unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "state_journal.h"
+#include "container_unix_mock.h"
+#include "isulad_config_mock.h"
+#include "utils.h"
+#include "utils_file.h"
+
+using ::testing::NiceMock;
+using ::testing::Invoke;
+using ::testing::_;
+
+static const std::string ROOT_DIR = "/tmp/isulad_state_journal_ut";
+static const std::string JOURNAL_PATH = ROOT_DIR + "/" + STATE_JOURNAL_FILE;
+static const std::string COMPACTING_PATH = ROOT_DIR + "/" + STATE_JOURNAL_COMPACTING_FILE;
+
+static std::string container_id(int i)
+{
+    char id[65] = { 0 };
+
+    (void)snprintf(id, sizeof(id), "%064x", i);
+    return std::string(id);
+}
+
+static std::string state_json(int pid)
+{
+    return "{\"Pid\":" + std::to_string(pid) + "}";
+}
+
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path);
+    std::stringstream ss;
+
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static void write_file(const std::string &path, const std::string &content)
+{
+    std::ofstream out(path, std::ios::trunc);
+
+    out << content;
+}
+
+static off_t file_size(const std::string &path)
+{
+    struct stat st = { 0 };
+
+    if (stat(path.c_str(), &st) != 0) {
+        return -1;
+    }
+    return st.st_size;
+}
+
+class StateJournalUnitTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        MockContainerUnix_SetMock(&m_container_unix);
+        MockIsuladConf_SetMock(&m_isulad_conf);
+
+        ASSERT_EQ(util_recursive_rmdir(ROOT_DIR.c_str(), 0), 0);
+        ASSERT_EQ(util_mkdir_p(ROOT_DIR.c_str(), 0700), 0);
+        for (int i = 0; i < CONTAINERS; i++) {
+            ASSERT_EQ(util_mkdir_p((ROOT_DIR + "/" + container_id(i)).c_str(), 0700), 0);
+        }
+
+        m_save_calls = 0;
+        m_save_fail = false;
+        m_saved_ids.clear();
+        m_on_save = nullptr;
+        ON_CALL(m_isulad_conf, ConfGetISuladRootDir()).WillByDefault(Invoke([]() {
+            return util_strdup_s(ROOT_DIR.c_str());
+        }));
+        ON_CALL(m_container_unix, SaveContainerStateConfig(_, _, _)).WillByDefault(Invoke(
+        [this](const char *id, const char *rootpath, const char *state_configstr) {
+            m_save_calls++;
+            {
+                std::lock_guard<std::mutex> lock(m_saved_mutex);
+                m_saved_ids[id]++;
+            }
+            if (m_on_save) {
+                m_on_save(id);
+            }
+            if (m_save_fail) {
+                return -1;
+            }
+            write_file(std::string(rootpath) + "/" + id + "/container_state.json", state_configstr);
+            return 0;
+        }));
+    }
+
+    void TearDown() override
+    {
+        MockContainerUnix_SetMock(nullptr);
+        MockIsuladConf_SetMock(nullptr);
+        util_recursive_rmdir(ROOT_DIR.c_str(), 0);
+    }
+
+    std::string saved_state(int i)
+    {
+        return read_file(ROOT_DIR + "/" + container_id(i) + "/container_state.json");
+    }
+
+    void append_states(int count, int pid)
+    {
+        for (int i = 0; i < count; i++) {
+            ASSERT_EQ(container_state_journal_append(ROOT_DIR.c_str(), container_id(i).c_str(),
+                                                     state_json(pid).c_str()), 0);
+        }
+    }
+
+    // compaction runs in background
+    bool wait_for(const std::function<bool()> &done)
+    {
+        for (int i = 0; i < 500; i++) {
+            if (done()) {
+                return true;
+            }
+            usleep(10 * 1000);
+        }
+        return false;
+    }
+
+    int saved_times(int i)
+    {
+        std::lock_guard<std::mutex> lock(m_saved_mutex);
+        return m_saved_ids[container_id(i)];
+    }
+
+    bool all_saved(int pid)
+    {
+        for (int i = 0; i < CONTAINERS; i++) {
+            if (saved_state(i) != state_json(pid)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static const int CONTAINERS = 100;
+    NiceMock<MockContainerUnix> m_container_unix;
+    NiceMock<MockIsuladConf> m_isulad_conf;
+    std::atomic<int> m_save_calls;
+    std::atomic<bool> m_save_fail;
+    std::mutex m_saved_mutex;
+    std::map<std::string, int> m_saved_ids;
+    std::function<void(const char *)> m_on_save;
+};
+
+TEST_F(StateJournalUnitTest, test_append)
+{
+    std::string expected;
+
+    ASSERT_EQ(container_state_journal_init(), 0);
+
+    ASSERT_EQ(container_state_journal_append(nullptr, container_id(0).c_str(), state_json(1).c_str()), -1);
+    ASSERT_EQ(container_state_journal_append(ROOT_DIR.c_str(), nullptr, state_json(1).c_str()), -1);
+    ASSERT_EQ(container_state_journal_append(ROOT_DIR.c_str(), container_id(0).c_str(), nullptr), -1);
+
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(container_state_journal_append(ROOT_DIR.c_str(), container_id(i).c_str(), state_json(i).c_str()), 0);
+        expected += ROOT_DIR + "\t" + container_id(i) + "\t" + state_json(i) + "\n";
+    }
+
+    ASSERT_EQ(read_file(JOURNAL_PATH), expected);
+    ASSERT_EQ(m_save_calls, 0);
+}
+
+TEST_F(StateJournalUnitTest, test_replay_torn_tail)
+{
+    std::string content;
+
+    content += ROOT_DIR + "\t" + container_id(0) + "\t" + state_json(1) + "\n";
+    content += ROOT_DIR + "\t" + container_id(1) + "\t" + state_json(1) + "\n";
+    content += ROOT_DIR + "\t" + container_id(0) + "\t" + state_json(2) + "\n";
+    content += ROOT_DIR + "\tinvalid id\t" + state_json(3) + "\n";
+    content += ROOT_DIR + "\t" + container_id(2) + "\tnot json\n";
+    // crashed while writing the last record
+    content += ROOT_DIR + "\t" + container_id(3) + "\t{\"Pid\":";
+    write_file(JOURNAL_PATH, content);
+
+    ASSERT_EQ(container_state_journal_init(), 0);
+
+    ASSERT_EQ(m_save_calls, 2);
+    ASSERT_EQ(saved_state(0), state_json(2));
+    ASSERT_EQ(saved_state(1), state_json(1));
+    ASSERT_FALSE(util_file_exists((ROOT_DIR + "/" + container_id(3) + "/container_state.json").c_str()));
+    ASSERT_EQ(file_size(JOURNAL_PATH), 0);
+}
+
+TEST_F(StateJournalUnitTest, test_replay_interrupted_compaction)
+{
+    write_file(COMPACTING_PATH, ROOT_DIR + "\t" + container_id(0) + "\t" + state_json(1) + "\n" +
+               ROOT_DIR + "\t" + container_id(1) + "\t" + state_json(1) + "\n");
+    write_file(JOURNAL_PATH, ROOT_DIR + "\t" + container_id(0) + "\t" + state_json(2) + "\n");
+
+    ASSERT_EQ(container_state_journal_init(), 0);
+
+    ASSERT_EQ(saved_state(0), state_json(2));
+    ASSERT_EQ(saved_state(1), state_json(1));
+    ASSERT_FALSE(util_file_exists(COMPACTING_PATH.c_str()));
+    ASSERT_EQ(file_size(JOURNAL_PATH), 0);
+}
+
+TEST_F(StateJournalUnitTest, test_compaction)
+{
+    ASSERT_EQ(container_state_journal_init(), 0);
+
+    append_states(CONTAINERS, 1);
+    ASSERT_TRUE(wait_for([this]() {
+        return m_save_calls > 0 && !util_file_exists(COMPACTING_PATH.c_str()) &&
+               file_size(JOURNAL_PATH) < STATE_JOURNAL_COMPACT_SIZE;
+    }));
+
+    // each record is either in its state file or still in the journal
+    std::string journal = read_file(JOURNAL_PATH);
+    for (int i = 0; i < CONTAINERS; i++) {
+        bool saved = saved_state(i) == state_json(1);
+        bool journaled = journal.find(container_id(i)) != std::string::npos;
+        ASSERT_NE(saved, journaled);
+    }
+
+    ASSERT_EQ(container_state_journal_init(), 0);
+    ASSERT_TRUE(all_saved(1));
+}
+
+TEST_F(StateJournalUnitTest, test_failed_compaction)
+{
+    int calls = 0;
+
+    ASSERT_EQ(container_state_journal_init(), 0);
+
+    // crosses the compaction size once
+    m_save_fail = true;
+    append_states(CONTAINERS / 2, 1);
+    ASSERT_TRUE(wait_for([this]() {
+        return m_save_calls > 0 && !util_file_exists(COMPACTING_PATH.c_str());
+    }));
+    calls = m_save_calls;
+
+    // records are kept in the new journal, and no retry until it grows again
+    ASSERT_GE(file_size(JOURNAL_PATH), STATE_JOURNAL_COMPACT_SIZE);
+    ASSERT_EQ(container_state_journal_append(ROOT_DIR.c_str(), container_id(0).c_str(), state_json(2).c_str()), 0);
+    usleep(200 * 1000);
+    ASSERT_EQ(m_save_calls, calls);
+
+    // replayed at restart
+    m_save_fail = false;
+    ASSERT_EQ(container_state_journal_init(), 0);
+    ASSERT_EQ(saved_state(0), state_json(2));
+    for (int i = 1; i < CONTAINERS / 2; i++) {
+        ASSERT_EQ(saved_state(i), state_json(1));
+    }
+    ASSERT_EQ(file_size(JOURNAL_PATH), 0);
+}
+
+TEST_F(StateJournalUnitTest, test_replay_failed)
+{
+    write_file(JOURNAL_PATH, ROOT_DIR + "\t" + container_id(0) + "\t" + state_json(1) + "\n");
+
+    m_save_fail = true;
+    ASSERT_EQ(container_state_journal_init(), 0);
+    ASSERT_EQ(m_save_calls, 1);
+
+    // records are kept in the journal for the next startup
+    m_save_fail = false;
+    ASSERT_EQ(container_state_journal_init(), 0);
+    ASSERT_EQ(saved_state(0), state_json(1));
+    ASSERT_EQ(file_size(JOURNAL_PATH), 0);
+}
+
+TEST_F(StateJournalUnitTest, test_remove)
+{
+    ASSERT_EQ(container_state_journal_init(), 0);
+
+    ASSERT_EQ(container_state_journal_remove(nullptr, container_id(0).c_str()), -1);
+    ASSERT_EQ(container_state_journal_remove(ROOT_DIR.c_str(), nullptr), -1);
+
+    // nothing journaled
+    ASSERT_EQ(container_state_journal_remove(ROOT_DIR.c_str(), container_id(0).c_str()), 0);
+    ASSERT_EQ(m_save_calls, 0);
+
+    // the state file is written before the container is removed
+    ASSERT_EQ(container_state_journal_append(ROOT_DIR.c_str(), container_id(0).c_str(), state_json(1).c_str()), 0);
+    ASSERT_EQ(container_state_journal_remove(ROOT_DIR.c_str(), container_id(0).c_str()), 0);
+    ASSERT_EQ(saved_state(0), state_json(1));
+    ASSERT_EQ(saved_times(0), 1);
+
+    // the removed container is not compacted
+    ASSERT_EQ(util_recursive_rmdir((ROOT_DIR + "/" + container_id(0)).c_str(), 0), 0);
+    append_states(CONTAINERS, 2);
+    ASSERT_EQ(container_state_journal_remove(ROOT_DIR.c_str(), container_id(0).c_str()), 0);
+    ASSERT_TRUE(wait_for([this]() {
+        return saved_times(1) > 0 && !util_file_exists(COMPACTING_PATH.c_str());
+    }));
+    ASSERT_EQ(saved_times(0), 1);
+    ASSERT_FALSE(util_dir_exists((ROOT_DIR + "/" + container_id(0)).c_str()));
+}
+
+TEST_F(StateJournalUnitTest, test_remove_while_compacting)
+{
+    std::mutex gate;
+    std::atomic<bool> removed { false };
+    std::atomic<int> saved_after_remove { 0 };
+    std::thread appender;
+
+    ASSERT_EQ(container_state_journal_init(), 0);
+
+    // compaction writes the containers in order, hold it at the first one
+    gate.lock();
+    m_on_save = [&](const char *id) {
+        if (container_id(0) == id) {
+            std::lock_guard<std::mutex> lock(gate);
+        }
+        if (removed && container_id(1) == id) {
+            saved_after_remove++;
+        }
+    };
+    // blocked by the held compaction
+    appender = std::thread([this]() {
+        append_states(CONTAINERS, 1);
+    });
+    ASSERT_TRUE(wait_for([this]() {
+        return saved_times(0) > 0;
+    }));
+
+    std::thread remover([&]() {
+        ASSERT_EQ(container_state_journal_remove(ROOT_DIR.c_str(), container_id(1).c_str()), 0);
+        removed = true;
+    });
+    gate.unlock();
+    remover.join();
+    appender.join();
+
+    ASSERT_TRUE(wait_for([this]() {
+        return !util_file_exists(COMPACTING_PATH.c_str());
+    }));
+    // waits for a running compaction
+    ASSERT_EQ(container_state_journal_init(), 0);
+    m_on_save = nullptr;
+
+    ASSERT_EQ(saved_times(1), 1);
+    ASSERT_EQ(saved_after_remove, 0);
+    ASSERT_EQ(saved_state(1), state_json(1));
+    ASSERT_TRUE(all_saved(1));
+}
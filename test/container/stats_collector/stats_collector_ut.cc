@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: container stats collector unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fstream>
+#include <map>
+#include <string>
+#include <gtest/gtest.h>
+#include "mock.h"
+#include "cgroup.h"
+#include "container_api.h"
+#include "stats_collector.h"
+#include "utils.h"
+#include "utils_file.h"
+
+extern "C" {
+    DECLARE_WRAPPER_V(util_fopen, FILE *, (const char *filename, const char *mode));
+    DEFINE_WRAPPER_V(util_fopen, FILE *, (const char *filename, const char *mode), (filename, mode));
+
+    DECLARE_WRAPPER_V(util_open, int, (const char *filename, int flags, mode_t mode));
+    DEFINE_WRAPPER_V(util_open, int, (const char *filename, int flags, mode_t mode), (filename, flags, mode));
+}
+
+static const std::string ROOT_DIR = "/tmp/isulad_stats_collector_ut";
+static const std::string V1_DIR = ROOT_DIR + "/v1";
+static const std::string V2_DIR = ROOT_DIR + "/v2";
+static const std::string PROC_DIR = ROOT_DIR + "/proc";
+
+static int g_cgroup_version = CGROUP_VERSION_1;
+// controller --> cgroup root of its mount
+static std::map<std::string, std::string> g_v1_roots;
+
+extern "C" {
+    int get_cgroup_version(void)
+    {
+        return g_cgroup_version;
+    }
+
+    int find_cgroup_mountpoint_and_root(const char *subsystem, char **mountpoint, char **root)
+    {
+        if (g_v1_roots.count(subsystem) == 0) {
+            return -1;
+        }
+        *mountpoint = util_strdup_s((V1_DIR + "/" + subsystem).c_str());
+        *root = util_strdup_s(g_v1_roots[subsystem].c_str());
+        return 0;
+    }
+}
+
+// /proc/<pid>/cgroup is read from PROC_DIR/<pid>
+static FILE *fopen_fake_proc(const char *filename, const char *mode)
+{
+    int pid = 0;
+
+    if (sscanf(filename, "/proc/%d/cgroup", &pid) == 1) {
+        return __real_util_fopen((PROC_DIR + "/" + std::to_string(pid)).c_str(), mode);
+    }
+    return __real_util_fopen(filename, mode);
+}
+
+// the unified hierarchy is at V2_DIR
+static int open_fake_cgroup(const char *filename, int flags, mode_t mode)
+{
+    std::string path = filename;
+
+    if (path.compare(0, strlen(CGROUP_MOUNTPOINT), CGROUP_MOUNTPOINT) == 0) {
+        path = V2_DIR + path.substr(strlen(CGROUP_MOUNTPOINT));
+    }
+    return __real_util_open(path.c_str(), flags, mode);
+}
+
+static void write_file(const std::string &path, const std::string &content)
+{
+    std::ofstream out(path, std::ios::trunc);
+
+    out << content;
+}
+
+static void write_cgroup_file(const std::string &dir, const std::string &name, const std::string &content)
+{
+    ASSERT_EQ(util_mkdir_p(dir.c_str(), 0700), 0);
+    write_file(dir + "/" + name, content);
+}
+
+class StatsCollectorUnitTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(util_recursive_rmdir(ROOT_DIR.c_str(), 0), 0);
+        ASSERT_EQ(util_mkdir_p(PROC_DIR.c_str(), 0700), 0);
+        MOCK_SET_V(util_fopen, fopen_fake_proc);
+        MOCK_SET_V(util_open, open_fake_cgroup);
+    }
+
+    void TearDown() override
+    {
+        container_stats_collector_remove("c1");
+        container_stats_collector_remove("c2");
+        MOCK_CLEAR(util_fopen);
+        MOCK_CLEAR(util_open);
+        g_v1_roots.clear();
+        util_recursive_rmdir(ROOT_DIR.c_str(), 0);
+    }
+
+    void InitV1()
+    {
+        g_cgroup_version = CGROUP_VERSION_1;
+        g_v1_roots["cpuacct"] = "/";
+        // the cgroup of the memory mount starts below its root
+        g_v1_roots["memory"] = "/docker";
+        g_v1_roots["pids"] = "/";
+        g_v1_roots["blkio"] = "/";
+        ASSERT_EQ(new_stats_collector(), 0);
+    }
+
+    void InitV2()
+    {
+        g_cgroup_version = CGROUP_VERSION_2;
+        ASSERT_EQ(new_stats_collector(), 0);
+    }
+
+    void WriteV1Cgroup(int pid, const std::string &path, uint64_t cpu_usage)
+    {
+        write_file(PROC_DIR + "/" + std::to_string(pid),
+                   "5:pids:" + path + "\n4:memory:" + path + "\n3:cpu,cpuacct:" + path + "\n2:blkio:" + path +
+                   "\n1:name=systemd:/\n");
+        write_cgroup_file(V1_DIR + "/cpuacct" + path, "cpuacct.usage", std::to_string(cpu_usage) + "\n");
+        write_cgroup_file(V1_DIR + "/cpuacct" + path, "cpuacct.stat", "user 10\nsystem 20\n");
+        write_cgroup_file(V1_DIR + "/memory" + path.substr(strlen("/docker")), "memory.usage_in_bytes", "1000\n");
+        write_cgroup_file(V1_DIR + "/memory" + path.substr(strlen("/docker")), "memory.limit_in_bytes", "4000\n");
+        write_cgroup_file(V1_DIR + "/memory" + path.substr(strlen("/docker")), "memory.stat",
+                          "cache 5\ntotal_cache 6\ntotal_rss 7\ntotal_inactive_file 8\ntotal_pgfault 9\n"
+                          "total_pgmajfault 10\n");
+        write_cgroup_file(V1_DIR + "/pids" + path, "pids.current", "3\n");
+        write_cgroup_file(V1_DIR + "/blkio" + path, "blkio.throttle.io_service_bytes",
+                          "8:0 Read 100\n8:0 Write 200\n8:16 Read 1\n8:16 Write 2\nTotal 303\n");
+    }
+};
+
+TEST_F(StatsCollectorUnitTest, test_invalid_args)
+{
+    struct runtime_container_resources_stats_info info = { 0 };
+
+    InitV1();
+    ASSERT_EQ(container_stats_collector_get(nullptr, 1, &info), -1);
+    ASSERT_EQ(container_stats_collector_get("c1", 0, &info), -1);
+    ASSERT_EQ(container_stats_collector_get("c1", 1, nullptr), -1);
+    // no cgroup of the process
+    ASSERT_EQ(container_stats_collector_get("c1", 1, &info), -1);
+    container_stats_collector_remove(nullptr);
+}
+
+TEST_F(StatsCollectorUnitTest, test_v1_stats)
+{
+    struct runtime_container_resources_stats_info info = { 0 };
+    uint64_t clk_tck = (uint64_t)sysconf(_SC_CLK_TCK);
+
+    InitV1();
+    WriteV1Cgroup(100, "/docker/c1", 123456789);
+
+    ASSERT_EQ(container_stats_collector_get("c1", 100, &info), 0);
+    ASSERT_EQ(info.cpu_use_nanos, 123456789U);
+    ASSERT_EQ(info.cpu_system_use, 20 * (1000000000 / clk_tck));
+    ASSERT_EQ(info.mem_used, 1000U);
+    ASSERT_EQ(info.mem_limit, 4000U);
+    ASSERT_EQ(info.usage_bytes, 1000U);
+    ASSERT_EQ(info.avaliable_bytes, 3000U);
+    ASSERT_EQ(info.cache, 5U);
+    ASSERT_EQ(info.cache_total, 6U);
+    ASSERT_EQ(info.rss_bytes, 7U);
+    ASSERT_EQ(info.inactive_file_total, 8U);
+    ASSERT_EQ(info.page_faults, 9U);
+    ASSERT_EQ(info.major_page_faults, 10U);
+    // missing kmem files are not collected
+    ASSERT_EQ(info.kmem_used, 0U);
+    ASSERT_EQ(info.kmem_limit, 0U);
+    ASSERT_EQ(info.pids_current, 3U);
+    ASSERT_EQ(info.blkio_read, 101U);
+    ASSERT_EQ(info.blkio_write, 202U);
+}
+
+TEST_F(StatsCollectorUnitTest, test_v2_stats)
+{
+    struct runtime_container_resources_stats_info info = { 0 };
+    std::string dir = V2_DIR + "/kubepods/c2";
+
+    InitV2();
+    write_file(PROC_DIR + "/200", "0::/kubepods/c2\n");
+    write_cgroup_file(dir, "cpu.stat", "usage_usec 100\nuser_usec 70\nsystem_usec 30\n");
+    write_cgroup_file(dir, "memory.current", "1000\n");
+    write_cgroup_file(dir, "memory.max", "max\n");
+    write_cgroup_file(dir, "memory.stat", "anon 7\nfile 6\ninactive_file 8\npgfault 9\npgmajfault 10\nkernel 11\n");
+    write_cgroup_file(dir, "pids.current", "3\n");
+    write_cgroup_file(dir, "io.stat", "8:0 rbytes=100 wbytes=200 rios=1 wios=2 dbytes=0 dios=0\n"
+                      "8:16 rbytes=1 wbytes=2 rios=1 wios=1 dbytes=0 dios=0\n");
+
+    ASSERT_EQ(container_stats_collector_get("c2", 200, &info), 0);
+    ASSERT_EQ(info.cpu_use_nanos, 100000U);
+    ASSERT_EQ(info.cpu_system_use, 30000U);
+    ASSERT_EQ(info.mem_used, 1000U);
+    ASSERT_EQ(info.mem_limit, UINT64_MAX);
+    ASSERT_EQ(info.avaliable_bytes, UINT64_MAX - 1000);
+    ASSERT_EQ(info.rss_bytes, 7U);
+    ASSERT_EQ(info.cache, 6U);
+    ASSERT_EQ(info.cache_total, 6U);
+    ASSERT_EQ(info.inactive_file_total, 8U);
+    ASSERT_EQ(info.page_faults, 9U);
+    ASSERT_EQ(info.major_page_faults, 10U);
+    ASSERT_EQ(info.kmem_used, 11U);
+    ASSERT_EQ(info.pids_current, 3U);
+    ASSERT_EQ(info.blkio_read, 101U);
+    ASSERT_EQ(info.blkio_write, 202U);
+}
+
+TEST_F(StatsCollectorUnitTest, test_cached_stats)
+{
+    struct runtime_container_resources_stats_info info = { 0 };
+
+    InitV1();
+    WriteV1Cgroup(100, "/docker/c1", 1);
+    ASSERT_EQ(container_stats_collector_get("c1", 100, &info), 0);
+    ASSERT_EQ(info.cpu_use_nanos, 1U);
+
+    // queries are served from the latest sample until the next sampling
+    write_file(V1_DIR + "/cpuacct/docker/c1/cpuacct.usage", "2\n");
+    ASSERT_EQ(container_stats_collector_get("c1", 100, &info), 0);
+    ASSERT_EQ(info.cpu_use_nanos, 1U);
+
+    // the container is restarted in another cgroup
+    WriteV1Cgroup(101, "/docker/c1-new", 3);
+    ASSERT_EQ(container_stats_collector_get("c1", 101, &info), 0);
+    ASSERT_EQ(info.cpu_use_nanos, 3U);
+
+    // removed when the container stops
+    container_stats_collector_remove("c1");
+    write_file(V1_DIR + "/cpuacct/docker/c1-new/cpuacct.usage", "4\n");
+    ASSERT_EQ(container_stats_collector_get("c1", 101, &info), 0);
+    ASSERT_EQ(info.cpu_use_nanos, 4U);
+}
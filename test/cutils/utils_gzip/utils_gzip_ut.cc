@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: util_gzip unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <atomic>
+#include <string>
+#include <gtest/gtest.h>
+#include "util_gzip.h"
+#include "io_wrapper.h"
+
+namespace {
+// source of compressed data, returns at most chunk bytes for each read
+struct mem_source {
+    std::string data;
+    size_t pos;
+    size_t chunk;
+    std::atomic<size_t> reads;
+};
+
+ssize_t mem_source_read(void *context, void *buf, size_t len)
+{
+    struct mem_source *src = (struct mem_source *)context;
+    size_t n = src->data.size() - src->pos;
+
+    src->reads++;
+    if (n > len) {
+        n = len;
+    }
+    if (n > src->chunk) {
+        n = src->chunk;
+    }
+    (void)memcpy(buf, src->data.data() + src->pos, n);
+    src->pos += n;
+    return (ssize_t)n;
+}
+
+std::string gzip_data(const std::string &plain)
+{
+    z_stream strm = {};
+    std::string out;
+
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return out;
+    }
+    out.resize(deflateBound(&strm, plain.size()));
+    strm.next_in = (Bytef *)plain.data();
+    strm.avail_in = plain.size();
+    strm.next_out = (Bytef *)&out[0];
+    strm.avail_out = out.size();
+    (void)deflate(&strm, Z_FINISH);
+    out.resize(strm.total_out);
+    (void)deflateEnd(&strm);
+    return out;
+}
+
+std::string test_plain_data(size_t size)
+{
+    std::string plain(size, '\0');
+    unsigned int seed = 1;
+    size_t i;
+
+    // compressible but not trivial, spans several read ahead blocks
+    for (i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        plain[i] = "abcdefgh"[(seed >> 16) % 8];
+    }
+    return plain;
+}
+
+int read_all(struct io_read_wrapper *reader, std::string &out)
+{
+    char buf[7777];
+    ssize_t n = 0;
+
+    for (;;) {
+        n = reader->read(reader->context, buf, sizeof(buf));
+        if (n <= 0) {
+            return (int)n;
+        }
+        out.append(buf, (size_t)n);
+    }
+}
+
+void init_source(struct mem_source &src, const std::string &data, size_t chunk)
+{
+    src.data = data;
+    src.pos = 0;
+    src.chunk = chunk;
+    src.reads = 0;
+}
+}
+
+TEST(utils_gzip, test_util_gzip_read_ahead_round_trip)
+{
+    std::string plain = test_plain_data(5 * 1024 * 1024 + 123);
+    struct mem_source src;
+    struct io_read_wrapper wrapper = { 0 };
+    struct io_read_wrapper reader = { 0 };
+    std::string out;
+    char *err = nullptr;
+
+    init_source(src, gzip_data(plain), 1000);
+    wrapper.context = &src;
+    wrapper.read = mem_source_read;
+    ASSERT_EQ(util_gzip_read_ahead_open(&wrapper, &reader), 0);
+    ASSERT_EQ(read_all(&reader, out), 0);
+    ASSERT_EQ(reader.close(reader.context, &err), 0);
+    ASSERT_EQ(err, nullptr);
+    ASSERT_EQ(out.size(), plain.size());
+    ASSERT_TRUE(out == plain);
+
+    // several gzip members are concatenated
+    out.clear();
+    init_source(src, gzip_data(plain.substr(0, 1000)) + gzip_data(plain.substr(1000)), 4096);
+    ASSERT_EQ(util_gzip_read_ahead_open(&wrapper, &reader), 0);
+    ASSERT_EQ(read_all(&reader, out), 0);
+    ASSERT_EQ(reader.close(reader.context, &err), 0);
+    ASSERT_TRUE(out == plain);
+
+    // data which is not compressed is returned as is, magic is split into two reads
+    out.clear();
+    init_source(src, plain, 1);
+    ASSERT_EQ(util_gzip_read_ahead_open(&wrapper, &reader), 0);
+    ASSERT_EQ(read_all(&reader, out), 0);
+    ASSERT_EQ(reader.close(reader.context, &err), 0);
+    ASSERT_TRUE(out == plain);
+
+    ASSERT_NE(util_gzip_read_ahead_open(nullptr, &reader), 0);
+    ASSERT_NE(util_gzip_read_ahead_open(&wrapper, nullptr), 0);
+}
+
+TEST(utils_gzip, test_util_gzip_read_ahead_corrupt)
+{
+    std::string plain = test_plain_data(3 * 1024 * 1024);
+    std::string compressed = gzip_data(plain);
+    struct mem_source src;
+    struct io_read_wrapper wrapper = { 0 };
+    struct io_read_wrapper reader = { 0 };
+    std::string out;
+    char *err = nullptr;
+
+    wrapper.context = &src;
+    wrapper.read = mem_source_read;
+
+    // corrupt deflate data after the gzip header
+    std::string corrupt = compressed;
+    for (size_t i = 10; i < 200 && i < corrupt.size(); i++) {
+        corrupt[i] = (char)0xff;
+    }
+    init_source(src, corrupt, 4096);
+    ASSERT_EQ(util_gzip_read_ahead_open(&wrapper, &reader), 0);
+    ASSERT_EQ(read_all(&reader, out), -1);
+    ASSERT_NE(reader.close(reader.context, &err), 0);
+    ASSERT_NE(err, nullptr);
+    free(err);
+    err = nullptr;
+
+    // truncated gzip data
+    out.clear();
+    init_source(src, compressed.substr(0, compressed.size() / 2), 4096);
+    ASSERT_EQ(util_gzip_read_ahead_open(&wrapper, &reader), 0);
+    ASSERT_EQ(read_all(&reader, out), -1);
+    ASSERT_LT(out.size(), plain.size());
+    ASSERT_NE(reader.close(reader.context, &err), 0);
+    free(err);
+}
+
+TEST(utils_gzip, test_util_gzip_read_ahead_early_close)
+{
+    // much more data than the read ahead blocks can hold, so the worker waits for free blocks
+    std::string plain = test_plain_data(16 * 1024 * 1024);
+    std::string compressed = gzip_data(plain);
+    struct mem_source src;
+    struct io_read_wrapper wrapper = { 0 };
+    struct io_read_wrapper reader = { 0 };
+    char buf[100];
+    char *err = nullptr;
+
+    init_source(src, compressed, 64 * 1024);
+    wrapper.context = &src;
+    wrapper.read = mem_source_read;
+    ASSERT_EQ(util_gzip_read_ahead_open(&wrapper, &reader), 0);
+    ASSERT_EQ(reader.read(reader.context, buf, sizeof(buf)), (ssize_t)sizeof(buf));
+    ASSERT_EQ(memcmp(buf, plain.data(), sizeof(buf)), 0);
+
+    // close joins the worker, so the source is not read after close
+    ASSERT_EQ(reader.close(reader.context, &err), 0);
+    ASSERT_EQ(err, nullptr);
+    size_t reads = src.reads;
+    ASSERT_LT(src.pos, src.data.size());
+    usleep(100 * 1000);
+    ASSERT_EQ(src.reads, reads);
+
+    // close right after open, the worker may be still detecting the format
+    init_source(src, compressed, 64 * 1024);
+    ASSERT_EQ(util_gzip_read_ahead_open(&wrapper, &reader), 0);
+    ASSERT_EQ(reader.close(reader.context, &err), 0);
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: sha256 unit test and microbenchmark
+ * Author: iSulad Team
+ * Create: 2023-07-16
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "sha256.h"
+#include "utils.h"
+
+static const char *ABC_DIGEST = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+
+static std::vector<char> make_data(size_t size)
+{
+    std::vector<char> data(size);
+    uint32_t seed = 0x12345678;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (char)(seed >> 16);
+    }
+    return data;
+}
+
+static void write_file(const std::string &path, const std::vector<char> &data)
+{
+    FILE *fp = fopen(path.c_str(), "w");
+    ASSERT_NE(fp, nullptr);
+    ASSERT_EQ(fwrite(data.data(), 1, data.size(), fp), data.size());
+    fclose(fp);
+}
+
+static void write_gzip_file(const std::string &path, const std::vector<char> &data)
+{
+    gzFile gz = gzopen(path.c_str(), "w");
+    ASSERT_NE(gz, nullptr);
+    ASSERT_EQ(gzwrite(gz, data.data(), data.size()), (int)data.size());
+    gzclose(gz);
+}
+
+static std::string context_digest(const std::vector<char> &data, size_t block)
+{
+    sha256_context *ctx = sha256_context_new();
+    size_t pos;
+    std::string result;
+
+    if (ctx == nullptr) {
+        return result;
+    }
+    for (pos = 0; pos < data.size(); pos += block) {
+        size_t n = data.size() - pos < block ? data.size() - pos : block;
+        if (sha256_context_update(ctx, data.data() + pos, n) != 0) {
+            sha256_context_free(ctx);
+            return result;
+        }
+    }
+    char *digest = sha256_context_full_digest(ctx);
+    if (digest != nullptr) {
+        result = digest;
+    }
+    free(digest);
+    sha256_context_free(ctx);
+    return result;
+}
+
+TEST(utils_sha256, test_sha256_digest_str)
+{
+    char *digest = sha256_digest_str("abc");
+    ASSERT_STREQ(digest, ABC_DIGEST);
+    free(digest);
+
+    digest = sha256_full_digest_str((char *)"abc");
+    ASSERT_STREQ(digest, (std::string("sha256:") + ABC_DIGEST).c_str());
+    free(digest);
+
+    ASSERT_EQ(sha256_digest_str(nullptr), nullptr);
+    ASSERT_NE(sha256_engine_name(), nullptr);
+}
+
+TEST(utils_sha256, test_sha256_context_and_file)
+{
+    std::string path = "/tmp/test_utils_sha256_file";
+    std::string gz_path = path + ".gz";
+    std::vector<char> data = make_data(3 * 1024 * 1024 + 17);
+    std::string expected = context_digest(data, data.size());
+    char *digest = nullptr;
+
+    ASSERT_FALSE(expected.empty());
+    // result does not depend on how data is split
+    ASSERT_EQ(context_digest(data, 7), expected);
+    ASSERT_EQ(context_digest(data, 4096 + 3), expected);
+
+    write_file(path, data);
+    write_gzip_file(gz_path, data);
+
+    digest = sha256_full_file_digest(path.c_str());
+    ASSERT_STREQ(digest, expected.c_str());
+    free(digest);
+    ASSERT_TRUE(sha256_valid_digest_file(path.c_str(), expected.c_str()));
+
+    // digest of uncompressed data
+    digest = sha256_full_gzip_digest(gz_path.c_str());
+    ASSERT_STREQ(digest, expected.c_str());
+    free(digest);
+
+    (void)unlink(path.c_str());
+    (void)unlink(gz_path.c_str());
+}
+
+// the previous path: 32k blocks and look up the algorithm for each digest
+static std::string legacy_digest(const std::vector<char> &data)
+{
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    unsigned char hash[EVP_MAX_MD_SIZE] = { 0 };
+    char out[SHA256_DIGEST_LENGTH * 2 + 1] = { 0 };
+    unsigned int len = 0;
+    size_t pos;
+    int i;
+
+    (void)EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+    for (pos = 0; pos < data.size(); pos += 32768) {
+        size_t n = data.size() - pos < 32768 ? data.size() - pos : 32768;
+        (void)EVP_DigestUpdate(ctx, data.data() + pos, n);
+    }
+    (void)EVP_DigestFinal_ex(ctx, hash, &len);
+    EVP_MD_CTX_free(ctx);
+    for (i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+        (void)snprintf(out + i * 2, 3, "%02x", hash[i]);
+    }
+    return std::string("sha256:") + out;
+}
+
+static double gb_per_second(size_t bytes, std::chrono::steady_clock::duration elapsed)
+{
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return seconds > 0 ? bytes / seconds / 1024 / 1024 / 1024 : 0;
+}
+
+// microbenchmark: throughput of each hashing path
+TEST(utils_sha256, bench_sha256)
+{
+    const size_t rounds = 4;
+    std::vector<char> data = make_data(64 * 1024 * 1024);
+    std::string path = "/tmp/test_utils_sha256_bench";
+    std::string expected;
+    std::string digest;
+    size_t i;
+
+    auto start = std::chrono::steady_clock::now();
+    for (i = 0; i < rounds; i++) {
+        expected = legacy_digest(data);
+    }
+    double legacy = gb_per_second(rounds * data.size(), std::chrono::steady_clock::now() - start);
+
+    start = std::chrono::steady_clock::now();
+    for (i = 0; i < rounds; i++) {
+        digest = context_digest(data, 1024 * 1024);
+    }
+    double context = gb_per_second(rounds * data.size(), std::chrono::steady_clock::now() - start);
+    ASSERT_EQ(digest, expected);
+
+    write_file(path, data);
+    start = std::chrono::steady_clock::now();
+    for (i = 0; i < rounds; i++) {
+        char *file_digest = sha256_full_file_digest(path.c_str());
+        ASSERT_STREQ(file_digest, expected.c_str());
+        free(file_digest);
+    }
+    double file = gb_per_second(rounds * data.size(), std::chrono::steady_clock::now() - start);
+    (void)unlink(path.c_str());
+
+    start = std::chrono::steady_clock::now();
+    for (i = 0; i < 100000; i++) {
+        free(sha256_digest_str("sha256:0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"));
+    }
+    double small = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "sha256 engine " << sha256_engine_name() << ": legacy 32k blocks " << legacy
+              << " GB/s, context 1m blocks " << context << " GB/s, file " << file << " GB/s, short string "
+              << (small > 0 ? 100000 / small : 0) << " ops/s" << std::endl;
+}
@@ -296,6 +296,51 @@ TEST(utils_utils, test_dup_map_string_empty_object)
     ASSERT_EQ(dup_map_string_empty_object(nullptr), nullptr);
 }
 
+TEST(utils_utils, test_dup_defs_filters)
+{
+    defs_filters *filters = nullptr;
+    defs_filters *dup = nullptr;
+
+    ASSERT_EQ(dup_defs_filters(nullptr), nullptr);
+    ASSERT_EQ(dup_json_map_string_bool(nullptr), nullptr);
+
+    filters = static_cast<defs_filters *>(util_common_calloc_s(sizeof(defs_filters)));
+    ASSERT_NE(filters, nullptr);
+    dup = dup_defs_filters(filters);
+    ASSERT_NE(dup, nullptr);
+    ASSERT_EQ(dup->len, 0);
+    free_defs_filters(dup);
+
+    filters->keys = static_cast<char **>(util_smart_calloc_s(sizeof(char *), 2));
+    filters->values = static_cast<json_map_string_bool **>(util_smart_calloc_s(sizeof(json_map_string_bool *), 2));
+    ASSERT_NE(filters->keys, nullptr);
+    ASSERT_NE(filters->values, nullptr);
+    filters->keys[0] = util_strdup_s("label");
+    filters->values[0] = static_cast<json_map_string_bool *>(util_common_calloc_s(sizeof(json_map_string_bool)));
+    ASSERT_NE(filters->values[0], nullptr);
+    ASSERT_EQ(append_json_map_string_bool(filters->values[0], "a=b", true), 0);
+    ASSERT_EQ(append_json_map_string_bool(filters->values[0], "c=d", false), 0);
+    filters->keys[1] = util_strdup_s("id");
+    filters->len = 2;
+
+    dup = dup_defs_filters(filters);
+    ASSERT_NE(dup, nullptr);
+    ASSERT_EQ(dup->len, 2);
+    ASSERT_STREQ(dup->keys[0], "label");
+    ASSERT_NE(dup->keys[0], filters->keys[0]);
+    ASSERT_NE(dup->values[0], filters->values[0]);
+    ASSERT_EQ(dup->values[0]->len, 2);
+    ASSERT_STREQ(dup->values[0]->keys[0], "a=b");
+    ASSERT_TRUE(dup->values[0]->values[0]);
+    ASSERT_STREQ(dup->values[0]->keys[1], "c=d");
+    ASSERT_FALSE(dup->values[0]->values[1]);
+    ASSERT_STREQ(dup->keys[1], "id");
+    ASSERT_EQ(dup->values[1], nullptr);
+
+    free_defs_filters(filters);
+    free_defs_filters(dup);
+}
+
 int global_total = 0;
 int retry_call_test(int success_idx)
 {
@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: events collector ring unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "container_api.h"
+#include "events_collector_api.h"
+#include "events_format.h"
+#include "monitord.h"
+#include "utils.h"
+
+// EVENTS_RING_SIZE in collector.c
+static const size_t RING_SIZE = 256;
+
+static std::mutex g_freed_mutex;
+static std::set<std::string> g_freed;
+
+extern "C" {
+    void isulad_events_format_free(struct isulad_events_format *value)
+    {
+        size_t i;
+
+        if (value == nullptr) {
+            return;
+        }
+        if (value->id != nullptr) {
+            std::lock_guard<std::mutex> lock(g_freed_mutex);
+            g_freed.insert(value->id);
+        }
+        free(value->id);
+        free(value->opt);
+        for (i = 0; i < value->annotations_len; i++) {
+            free(value->annotations[i]);
+        }
+        free(value->annotations);
+        free(value);
+    }
+
+    int new_monitord(struct monitord_sync_data *msync)
+    {
+        *msync->exit_code = 0;
+        sem_post(msync->monitord_sem);
+        return 0;
+    }
+
+    int container_events_handler_post_events(const struct isulad_events_format *event)
+    {
+        return 0;
+    }
+
+    container_t *containers_store_get(const char *id_or_name)
+    {
+        return nullptr;
+    }
+
+    void container_unref(container_t *cont)
+    {
+    }
+}
+
+static bool is_freed(const std::string &id)
+{
+    std::lock_guard<std::mutex> lock(g_freed_mutex);
+    return g_freed.count(id) > 0;
+}
+
+static bool wait_freed(const std::string &id)
+{
+    for (int i = 0; i < 500; i++) {
+        if (is_freed(id)) {
+            return true;
+        }
+        usleep(10 * 1000);
+    }
+    return false;
+}
+
+// image events carry the name of the message as id and need no container
+static void publish(const std::string &id)
+{
+    struct monitord_msg msg = { };
+
+    msg.type = MONITORD_MSG_STATE;
+    msg.event_type = IMAGE_EVENT;
+    (void)snprintf(msg.name, sizeof(msg.name), "%s", id.c_str());
+    msg.value = IM_PULL;
+    events_handler(&msg);
+}
+
+// an events client served by add_monitor_client() in its own thread
+class Client {
+public:
+    Client(const char *name, const std::string &prefix) : m_prefix(prefix)
+    {
+        if (name != nullptr) {
+            m_name = util_strdup_s(name);
+        }
+        m_stream.context = this;
+        m_stream.is_cancelled = IsCancelled;
+        m_stream.writer = this;
+        m_stream.write_func = Write;
+        m_thread = std::thread([this]() {
+            (void)add_monitor_client(m_name, nullptr, nullptr, &m_stream);
+        });
+    }
+
+    ~Client()
+    {
+        m_cancelled = true;
+        Unblock();
+        // wake the client to see it is cancelled
+        publish("wakeup");
+        m_thread.join();
+        free(m_name);
+    }
+
+    // the client is registered once it gets one of the events published until then,
+    // the id of them matches the name of any client of the test
+    bool WaitRegistered()
+    {
+        for (int i = 0; i < 500; i++) {
+            publish(m_prefix + ".*");
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_synced) {
+                    return true;
+                }
+            }
+            usleep(10 * 1000);
+        }
+        return false;
+    }
+
+    // writing the event of id blocks until Unblock() is called
+    void BlockOn(const std::string &id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_block_id = id;
+        m_blocked = false;
+    }
+
+    bool WaitBlocked()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cond.wait_for(lock, std::chrono::seconds(10), [this]() {
+            return m_blocked;
+        });
+    }
+
+    void Unblock()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_block_id.clear();
+        m_cond.notify_all();
+    }
+
+    bool WaitReceived(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cond.wait_for(lock, std::chrono::seconds(10), [this, count]() {
+            return m_received.size() >= count;
+        });
+    }
+
+    std::vector<std::string> Received()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_received;
+    }
+
+private:
+    static bool IsCancelled(void *context)
+    {
+        return static_cast<Client *>(context)->m_cancelled;
+    }
+
+    static bool Write(void *writer, void *data)
+    {
+        Client *c = static_cast<Client *>(writer);
+        const struct isulad_events_format *event = static_cast<const struct isulad_events_format *>(data);
+        std::string id = event->id;
+        std::unique_lock<std::mutex> lock(c->m_mutex);
+
+        if (id == c->m_prefix + ".*") {
+            c->m_synced = true;
+            return true;
+        }
+        // events of other tests
+        if (id.compare(0, c->m_prefix.size(), c->m_prefix) != 0) {
+            return true;
+        }
+
+        if (!c->m_block_id.empty() && id == c->m_block_id) {
+            c->m_blocked = true;
+            c->m_cond.notify_all();
+            c->m_cond.wait(lock, [c]() {
+                return c->m_block_id.empty();
+            });
+        }
+        c->m_received.push_back(id);
+        c->m_cond.notify_all();
+        return true;
+    }
+
+    char *m_name { nullptr };
+    std::string m_prefix;
+    stream_func_wrapper m_stream {};
+    std::atomic<bool> m_cancelled { false };
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<std::string> m_received;
+    std::string m_block_id;
+    bool m_blocked { false };
+    bool m_synced { false };
+};
+
+static std::vector<std::string> make_ids(const std::string &prefix, size_t begin, size_t end)
+{
+    std::vector<std::string> ids;
+
+    for (size_t i = begin; i < end; i++) {
+        ids.push_back(prefix + std::to_string(i));
+    }
+    return ids;
+}
+
+// events of former runs stay in the ring, ids of each run are unique
+static std::string unique_prefix(const std::string &name)
+{
+    static int runs = 0;
+
+    return name + std::to_string(runs++) + "-";
+}
+
+class EventsCollectorUnitTest : public testing::Test {
+protected:
+    static void SetUpTestCase()
+    {
+        static bool inited = false;
+
+        if (!inited) {
+            ASSERT_EQ(events_module_init(), 0);
+            inited = true;
+        }
+    }
+};
+
+TEST_F(EventsCollectorUnitTest, test_clients_have_own_cursors)
+{
+    std::string prefix = unique_prefix("cursor");
+    Client first(nullptr, prefix);
+    Client second(nullptr, prefix);
+    std::vector<std::string> expect = make_ids(prefix, 0, 100);
+
+    ASSERT_TRUE(first.WaitRegistered());
+    ASSERT_TRUE(second.WaitRegistered());
+
+    for (const auto &id : expect) {
+        publish(id);
+    }
+
+    ASSERT_TRUE(first.WaitReceived(expect.size()));
+    ASSERT_TRUE(second.WaitReceived(expect.size()));
+    ASSERT_EQ(first.Received(), expect);
+    ASSERT_EQ(second.Received(), expect);
+}
+
+TEST_F(EventsCollectorUnitTest, test_slow_client_drops_overwritten_events)
+{
+    const size_t overwritten = 44;
+    std::string prefix = unique_prefix("slow");
+    std::string block = prefix + "block";
+    Client fast(nullptr, prefix);
+    Client slow(nullptr, prefix);
+    std::vector<std::string> ids = make_ids(prefix, 0, RING_SIZE + overwritten);
+    std::vector<std::string> expect_fast { block };
+    std::vector<std::string> expect_slow { block };
+
+    ASSERT_TRUE(fast.WaitRegistered());
+    ASSERT_TRUE(slow.WaitRegistered());
+
+    slow.BlockOn(block);
+    publish(block);
+    ASSERT_TRUE(slow.WaitBlocked());
+
+    // overwrite the whole ring while the slow client writes, the fast one keeps up
+    for (size_t i = 0; i < ids.size(); i++) {
+        publish(ids[i]);
+        expect_fast.push_back(ids[i]);
+        if (i % 32 == 31) {
+            ASSERT_TRUE(fast.WaitReceived(expect_fast.size()));
+        }
+    }
+    ASSERT_TRUE(fast.WaitReceived(expect_fast.size()));
+    ASSERT_EQ(fast.Received(), expect_fast);
+
+    // the fast client is done with the evicted events, the slow one still holds its event
+    ASSERT_TRUE(wait_freed(ids[0]));
+    ASSERT_TRUE(wait_freed(ids[overwritten - 1]));
+    ASSERT_FALSE(is_freed(ids[overwritten]));
+    ASSERT_FALSE(is_freed(block));
+
+    // the slow client skips the overwritten events and goes on with the oldest kept one
+    slow.Unblock();
+    expect_slow.insert(expect_slow.end(), ids.begin() + overwritten, ids.end());
+    ASSERT_TRUE(slow.WaitReceived(expect_slow.size()));
+    ASSERT_TRUE(wait_freed(block));
+    usleep(50 * 1000);
+    ASSERT_EQ(slow.Received(), expect_slow);
+}
+
+TEST_F(EventsCollectorUnitTest, test_name_filter_is_regex_of_event_id)
+{
+    std::string prefix = unique_prefix("filter");
+    Client all(nullptr, prefix);
+    Client named((prefix + "abc").c_str(), prefix);
+    std::vector<std::string> ids { prefix + "abc", prefix + "abcd", prefix + "ab.", prefix + "x", prefix + "a(",
+                                   prefix + "[a-c]+" };
+    // the id of an event is a regex matched against the whole name, an invalid regex matches any name
+    std::vector<std::string> expect { prefix + "abc", prefix + "ab.", prefix + "a(", prefix + "[a-c]+" };
+
+    ASSERT_TRUE(all.WaitRegistered());
+    ASSERT_TRUE(named.WaitRegistered());
+
+    for (const auto &id : ids) {
+        publish(id);
+    }
+    ASSERT_TRUE(all.WaitReceived(ids.size()));
+    ASSERT_EQ(all.Received(), ids);
+
+    ASSERT_TRUE(named.WaitReceived(expect.size()));
+    usleep(50 * 1000);
+    ASSERT_EQ(named.Received(), expect);
+}
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: http range requests unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <curl/curl.h>
+#include <gtest/gtest.h>
+#include "http.h"
+#include "utils.h"
+
+static const std::string OUTPUT_FILE = "/tmp/isulad_http_ut_output";
+
+enum server_mode {
+    // answer ranges with 206
+    MODE_RANGE,
+    // answer all requests with 200 and the whole body
+    MODE_IGNORE_RANGE,
+    // answer the range starting at 0 with less data than requested
+    MODE_SHORT_RANGE,
+};
+
+// serves one body on loopback, one request per connection
+class RangeServer {
+public:
+    RangeServer(const std::string &body, server_mode mode) : m_body(body), m_mode(mode)
+    {
+        struct sockaddr_in addr = { 0 };
+        socklen_t len = sizeof(addr);
+
+        m_fd = socket(AF_INET, SOCK_STREAM, 0);
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(m_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(m_fd, 16) != 0 ||
+            getsockname(m_fd, (struct sockaddr *)&addr, &len) != 0) {
+            close(m_fd);
+            m_fd = -1;
+            return;
+        }
+        m_port = ntohs(addr.sin_port);
+        m_thread = std::thread(&RangeServer::Serve, this);
+    }
+
+    ~RangeServer()
+    {
+        m_stop = true;
+        if (m_fd >= 0) {
+            shutdown(m_fd, SHUT_RDWR);
+        }
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    std::string Url() const
+    {
+        return "http://127.0.0.1:" + std::to_string(m_port) + "/blob";
+    }
+
+    std::set<std::string> Ranges()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_ranges;
+    }
+
+private:
+    void Serve()
+    {
+        while (!m_stop) {
+            int conn = accept(m_fd, nullptr, nullptr);
+            if (conn < 0) {
+                break;
+            }
+            Handle(conn);
+            close(conn);
+        }
+    }
+
+    static std::string ReadRequest(int conn)
+    {
+        std::string req;
+        char buf[1024];
+
+        while (req.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = read(conn, buf, sizeof(buf));
+            if (n <= 0) {
+                break;
+            }
+            req.append(buf, (size_t)n);
+        }
+        return req;
+    }
+
+    static void WriteAll(int conn, const std::string &data)
+    {
+        size_t off = 0;
+
+        while (off < data.size()) {
+            ssize_t n = write(conn, data.data() + off, data.size() - off);
+            if (n <= 0) {
+                return;
+            }
+            off += (size_t)n;
+        }
+    }
+
+    void Handle(int conn)
+    {
+        std::string req = ReadRequest(conn);
+        std::string resp;
+        size_t start = 0;
+        size_t end = 0;
+        size_t pos = req.find("Range: bytes=");
+
+        if (m_mode == MODE_IGNORE_RANGE || pos == std::string::npos ||
+            sscanf(req.c_str() + pos, "Range: bytes=%zu-%zu", &start, &end) != 2) {
+            resp = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(m_body.size()) +
+                   "\r\nConnection: close\r\n\r\n" + m_body;
+            WriteAll(conn, resp);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_ranges.insert(std::to_string(start) + "-" + std::to_string(end));
+        }
+        std::string part = m_body.substr(start, end - start + 1);
+        if (m_mode == MODE_SHORT_RANGE && start == 0) {
+            part = part.substr(0, part.size() / 2);
+        }
+        resp = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + std::to_string(start) + "-" +
+               std::to_string(start + part.size() - 1) + "/" + std::to_string(m_body.size()) +
+               "\r\nContent-Length: " + std::to_string(part.size()) + "\r\nConnection: close\r\n\r\n" + part;
+        WriteAll(conn, resp);
+    }
+
+    std::string m_body;
+    server_mode m_mode;
+    int m_fd { -1 };
+    int m_port { 0 };
+    std::atomic<bool> m_stop { false };
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::set<std::string> m_ranges;
+};
+
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path);
+    std::stringstream ss;
+
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static std::string make_body(size_t len)
+{
+    std::string body(len, '\0');
+
+    for (size_t i = 0; i < len; i++) {
+        body[i] = (char)('a' + i % 26);
+    }
+    return body;
+}
+
+static int request_ranges(const std::string &url, size_t total_size, size_t parts_num, int *errcode)
+{
+    struct http_get_options *options = nullptr;
+    int ret = 0;
+
+    options = (struct http_get_options *)util_common_calloc_s(sizeof(struct http_get_options));
+    if (options == nullptr) {
+        return -1;
+    }
+    options->with_body = 1;
+    options->outputtype = HTTP_REQUEST_FILE;
+    options->output = util_strdup_s(OUTPUT_FILE.c_str());
+
+    ret = http_request_ranges(url.c_str(), options, total_size, parts_num);
+    *errcode = options->errcode;
+
+    free(options->output);
+    options->output = nullptr;
+    free_http_get_options(options);
+    return ret;
+}
+
+class HttpUnitTest : public testing::Test {
+protected:
+    static void SetUpTestCase()
+    {
+        http_global_init();
+    }
+
+    static void TearDownTestCase()
+    {
+        http_global_cleanup();
+    }
+
+    void TearDown() override
+    {
+        (void)unlink(OUTPUT_FILE.c_str());
+    }
+};
+
+TEST_F(HttpUnitTest, test_request_ranges_split)
+{
+    std::string body = make_body(10);
+    RangeServer server(body, MODE_RANGE);
+    std::set<std::string> expect { "0-1", "2-3", "4-5", "6-9" };
+    int errcode = 0;
+
+    ASSERT_EQ(request_ranges(server.Url(), 0, 4, &errcode), -1);
+    ASSERT_EQ(request_ranges(server.Url(), body.size(), 0, &errcode), -1);
+
+    ASSERT_EQ(request_ranges(server.Url(), body.size(), 4, &errcode), 0);
+    ASSERT_EQ(read_file(OUTPUT_FILE), body);
+    ASSERT_EQ(server.Ranges(), expect);
+}
+
+TEST_F(HttpUnitTest, test_request_ranges_more_parts_than_bytes)
+{
+    std::string body = make_body(3);
+    RangeServer server(body, MODE_RANGE);
+    std::set<std::string> expect { "0-0", "1-1", "2-2" };
+    int errcode = 0;
+
+    ASSERT_EQ(request_ranges(server.Url(), body.size(), 8, &errcode), 0);
+    ASSERT_EQ(read_file(OUTPUT_FILE), body);
+    ASSERT_EQ(server.Ranges(), expect);
+}
+
+TEST_F(HttpUnitTest, test_request_ranges_large)
+{
+    std::string body = make_body(4 * 1024 * 1024 + 7);
+    RangeServer server(body, MODE_RANGE);
+    int errcode = 0;
+
+    ASSERT_EQ(request_ranges(server.Url(), body.size(), 3, &errcode), 0);
+    ASSERT_EQ(read_file(OUTPUT_FILE), body);
+    ASSERT_EQ(server.Ranges().size(), 3U);
+}
+
+TEST_F(HttpUnitTest, test_request_ranges_short_range)
+{
+    std::string body = make_body(1024);
+    RangeServer server(body, MODE_SHORT_RANGE);
+    int errcode = 0;
+
+    ASSERT_EQ(request_ranges(server.Url(), body.size(), 4, &errcode), -1);
+    ASSERT_EQ(errcode, CURLE_RANGE_ERROR);
+}
+
+TEST_F(HttpUnitTest, test_request_ranges_range_ignored)
+{
+    std::string body = make_body(1024);
+    RangeServer server(body, MODE_IGNORE_RANGE);
+    int errcode = 0;
+
+    ASSERT_EQ(request_ranges(server.Url(), body.size(), 4, &errcode), -1);
+    ASSERT_EQ(errcode, CURLE_RANGE_ERROR);
+    ASSERT_TRUE(server.Ranges().empty());
+}
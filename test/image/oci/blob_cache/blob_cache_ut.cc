@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: blob cache unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+#include "blob_cache.h"
+#include "sha256.h"
+#include "utils.h"
+#include "utils_file.h"
+
+static const std::string ROOT_DIR = "/tmp/isulad_blob_cache_ut";
+static const std::string CACHE_DIR = ROOT_DIR + "/blob-cache";
+static const std::string WORK_DIR = ROOT_DIR + "/work";
+
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path);
+    std::stringstream ss;
+
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// write a blob of len bytes and return its digest
+static std::string make_blob(const std::string &name, char c, size_t len)
+{
+    std::string path = WORK_DIR + "/" + name;
+    char *digest = nullptr;
+    std::string ret;
+
+    std::ofstream(path) << std::string(len, c);
+    digest = sha256_full_file_digest(path.c_str());
+    if (digest != nullptr) {
+        ret = digest;
+    }
+    free(digest);
+    return ret;
+}
+
+static std::string cache_path(const std::string &digest)
+{
+    return CACHE_DIR + "/" + digest.substr(strlen("sha256:"));
+}
+
+class BlobCacheUnitTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(util_recursive_rmdir(ROOT_DIR.c_str(), 0), 0);
+        ASSERT_EQ(util_mkdir_p(WORK_DIR.c_str(), 0700), 0);
+    }
+
+    void TearDown() override
+    {
+        blob_cache_exit();
+        ASSERT_EQ(util_recursive_rmdir(ROOT_DIR.c_str(), 0), 0);
+    }
+};
+
+TEST_F(BlobCacheUnitTest, test_disabled)
+{
+    std::string digest = make_blob("a", 'a', 16);
+
+    ASSERT_EQ(blob_cache_init(ROOT_DIR.c_str(), 0), 0);
+    ASSERT_EQ(blob_cache_put(digest.c_str(), (WORK_DIR + "/a").c_str(), false), 0);
+    ASSERT_EQ(blob_cache_get(digest.c_str(), (WORK_DIR + "/out").c_str()), -1);
+    ASSERT_FALSE(util_dir_exists(CACHE_DIR.c_str()));
+}
+
+TEST_F(BlobCacheUnitTest, test_put_and_get)
+{
+    std::string digest = make_blob("a", 'a', 16);
+    std::string other = make_blob("b", 'b', 16);
+    std::string out = WORK_DIR + "/out";
+    struct stat st = { 0 };
+
+    ASSERT_EQ(blob_cache_init(ROOT_DIR.c_str(), 1024), 0);
+    ASSERT_EQ(blob_cache_get(digest.c_str(), out.c_str()), -1);
+
+    // the content does not match the digest
+    ASSERT_EQ(blob_cache_put(other.c_str(), (WORK_DIR + "/a").c_str(), false), -1);
+    ASSERT_FALSE(util_file_exists(cache_path(other).c_str()));
+
+    ASSERT_EQ(blob_cache_put(digest.c_str(), (WORK_DIR + "/a").c_str(), false), 0);
+    ASSERT_EQ(stat(cache_path(digest).c_str(), &st), 0);
+    ASSERT_EQ(st.st_mode & 0777, 0440U);
+    ASSERT_EQ(st.st_nlink, 1U);
+    // put again is a no-op
+    ASSERT_EQ(blob_cache_put(digest.c_str(), (WORK_DIR + "/a").c_str(), true), 0);
+
+    // the source file and the got file do not share the cached blob
+    std::ofstream(WORK_DIR + "/a") << "changed";
+    ASSERT_EQ(blob_cache_get(digest.c_str(), out.c_str()), 0);
+    ASSERT_EQ(read_file(out), std::string(16, 'a'));
+    std::ofstream(out) << "changed";
+    ASSERT_EQ(blob_cache_get(digest.c_str(), out.c_str()), 0);
+    ASSERT_EQ(read_file(out), std::string(16, 'a'));
+    ASSERT_EQ(read_file(cache_path(digest)), std::string(16, 'a'));
+}
+
+TEST_F(BlobCacheUnitTest, test_eviction)
+{
+    std::string d1 = make_blob("1", '1', 100);
+    std::string d2 = make_blob("2", '2', 100);
+    std::string d3 = make_blob("3", '3', 100);
+    std::string d4 = make_blob("4", '4', 100);
+    std::string d5 = make_blob("5", '5', 400);
+    std::string out = WORK_DIR + "/out";
+
+    ASSERT_EQ(blob_cache_init(ROOT_DIR.c_str(), 300), 0);
+
+    // larger than the whole cache
+    ASSERT_EQ(blob_cache_put(d5.c_str(), (WORK_DIR + "/5").c_str(), false), 0);
+    ASSERT_FALSE(util_file_exists(cache_path(d5).c_str()));
+
+    ASSERT_EQ(blob_cache_put(d1.c_str(), (WORK_DIR + "/1").c_str(), false), 0);
+    ASSERT_EQ(blob_cache_put(d2.c_str(), (WORK_DIR + "/2").c_str(), false), 0);
+    ASSERT_EQ(blob_cache_put(d3.c_str(), (WORK_DIR + "/3").c_str(), false), 0);
+    // 1 is used recently, 2 is the least recently used one
+    ASSERT_EQ(blob_cache_get(d1.c_str(), out.c_str()), 0);
+    ASSERT_EQ(blob_cache_put(d4.c_str(), (WORK_DIR + "/4").c_str(), false), 0);
+
+    ASSERT_EQ(blob_cache_get(d2.c_str(), out.c_str()), -1);
+    ASSERT_FALSE(util_file_exists(cache_path(d2).c_str()));
+    ASSERT_EQ(blob_cache_get(d1.c_str(), out.c_str()), 0);
+    ASSERT_EQ(blob_cache_get(d3.c_str(), out.c_str()), 0);
+    ASSERT_EQ(blob_cache_get(d4.c_str(), out.c_str()), 0);
+    ASSERT_EQ(read_file(out), std::string(100, '4'));
+}
+
+TEST_F(BlobCacheUnitTest, test_restart)
+{
+    std::string d1 = make_blob("1", '1', 100);
+    std::string d2 = make_blob("2", '2', 100);
+    std::string d3 = make_blob("3", '3', 100);
+    std::string out = WORK_DIR + "/out";
+    struct timespec times[2] = { { 1000, 0 }, { 1000, 0 } };
+
+    ASSERT_EQ(blob_cache_init(ROOT_DIR.c_str(), 1024), 0);
+    ASSERT_EQ(blob_cache_put(d1.c_str(), (WORK_DIR + "/1").c_str(), false), 0);
+    ASSERT_EQ(blob_cache_put(d2.c_str(), (WORK_DIR + "/2").c_str(), false), 0);
+    ASSERT_EQ(blob_cache_put(d3.c_str(), (WORK_DIR + "/3").c_str(), false), 0);
+    blob_cache_exit();
+
+    // left by an interrupted put
+    std::ofstream(cache_path(d1) + ".1.tmp") << "tmp";
+    // damaged on disk with the same size
+    ASSERT_EQ(chmod(cache_path(d3).c_str(), 0640), 0);
+    std::ofstream(cache_path(d3)) << std::string(100, 'x');
+    // 1 is the least recently used one
+    ASSERT_EQ(utimensat(AT_FDCWD, cache_path(d1).c_str(), times, 0), 0);
+
+    // only the 2 newest blobs fit
+    ASSERT_EQ(blob_cache_init(ROOT_DIR.c_str(), 200), 0);
+    ASSERT_FALSE(util_file_exists((cache_path(d1) + ".1.tmp").c_str()));
+    ASSERT_FALSE(util_file_exists(cache_path(d1).c_str()));
+    ASSERT_EQ(blob_cache_get(d1.c_str(), out.c_str()), -1);
+
+    ASSERT_EQ(blob_cache_get(d2.c_str(), out.c_str()), 0);
+    ASSERT_EQ(read_file(out), std::string(100, '2'));
+
+    ASSERT_EQ(blob_cache_get(d3.c_str(), out.c_str()), -1);
+    ASSERT_FALSE(util_file_exists(cache_path(d3).c_str()));
+
+    // its space is reused
+    ASSERT_EQ(blob_cache_put(d1.c_str(), (WORK_DIR + "/1").c_str(), false), 0);
+    ASSERT_EQ(blob_cache_get(d2.c_str(), out.c_str()), 0);
+    ASSERT_EQ(blob_cache_get(d1.c_str(), out.c_str()), 0);
+    ASSERT_EQ(read_file(out), std::string(100, '1'));
+}
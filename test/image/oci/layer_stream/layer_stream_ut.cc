@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: layer stream unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <fstream>
+#include <random>
+#include <string>
+#include <gtest/gtest.h>
+#include "layer_stream.h"
+#include "sha256.h"
+
+static const std::string BLOB_FILE = "/tmp/isulad_layer_stream_ut_blob";
+static const std::string DATA_FILE = "/tmp/isulad_layer_stream_ut_data";
+
+// compressible data larger than the ring of the stream
+static std::string make_data(size_t len, unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::string data(len, '\0');
+
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (char)('a' + gen() % 4);
+    }
+    return data;
+}
+
+static std::string gzip(const std::string &data)
+{
+    z_stream zs = {};
+    std::string out(compressBound(data.size()) + 64, '\0');
+
+    EXPECT_EQ(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY), Z_OK);
+    zs.next_in = (Bytef *)data.data();
+    zs.avail_in = (uInt)data.size();
+    zs.next_out = (Bytef *)&out[0];
+    zs.avail_out = (uInt)out.size();
+    EXPECT_EQ(deflate(&zs, Z_FINISH), Z_STREAM_END);
+    out.resize(zs.total_out);
+    (void)deflateEnd(&zs);
+    return out;
+}
+
+static void write_file(const std::string &path, const std::string &content)
+{
+    std::ofstream out(path, std::ios::trunc | std::ios::binary);
+
+    out << content;
+}
+
+static std::string file_digest(const std::string &path, const std::string &content)
+{
+    char *digest = nullptr;
+    std::string ret;
+
+    write_file(path, content);
+    digest = sha256_full_file_digest(path.c_str());
+    if (digest != nullptr) {
+        ret = digest;
+    }
+    free(digest);
+    return ret;
+}
+
+// write data in pieces of random size like curl does, the blob file is the download
+static int stream_data(layer_stream *stream, const std::string &data)
+{
+    std::mt19937 gen(data.size());
+    size_t off = 0;
+
+    write_file(BLOB_FILE, data);
+    while (off < data.size()) {
+        size_t n = gen() % (64 * 1024) + 1;
+        n = n < data.size() - off ? n : data.size() - off;
+        if (layer_stream_write(stream, data.data() + off, n) != 0) {
+            return -1;
+        }
+        off += n;
+    }
+    return 0;
+}
+
+class LayerStreamUnitTest : public testing::Test {
+protected:
+    void TearDown() override
+    {
+        (void)unlink(BLOB_FILE.c_str());
+        (void)unlink(DATA_FILE.c_str());
+    }
+};
+
+TEST_F(LayerStreamUnitTest, test_invalid_args)
+{
+    layer_stream *stream = layer_stream_new(false);
+
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(layer_stream_start(nullptr), -1);
+    // not started
+    ASSERT_EQ(layer_stream_write(stream, "a", 1), -1);
+    ASSERT_EQ(layer_stream_finish(stream), -1);
+    ASSERT_FALSE(layer_stream_complete(stream, BLOB_FILE.c_str()));
+    ASSERT_EQ(layer_stream_digest(stream), nullptr);
+    ASSERT_EQ(layer_stream_diffid(stream), nullptr);
+    ASSERT_EQ(layer_stream_write(nullptr, "a", 1), -1);
+    ASSERT_FALSE(layer_stream_complete(nullptr, BLOB_FILE.c_str()));
+    ASSERT_EQ(layer_stream_digest(nullptr), nullptr);
+    layer_stream_free(nullptr);
+    layer_stream_free(stream);
+}
+
+TEST_F(LayerStreamUnitTest, test_digest)
+{
+    std::string data = make_data(10 * 1024 * 1024 + 3, 1);
+    layer_stream *stream = layer_stream_new(false);
+
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(layer_stream_start(stream), 0);
+    ASSERT_EQ(stream_data(stream, data), 0);
+    ASSERT_EQ(layer_stream_finish(stream), 0);
+
+    ASSERT_TRUE(layer_stream_complete(stream, BLOB_FILE.c_str()));
+    ASSERT_STREQ(layer_stream_digest(stream), file_digest(DATA_FILE, data).c_str());
+    ASSERT_EQ(layer_stream_diffid(stream), nullptr);
+
+    // data is appended to the file not through the stream, such as a resumed download
+    write_file(BLOB_FILE, data + "x");
+    ASSERT_FALSE(layer_stream_complete(stream, BLOB_FILE.c_str()));
+    layer_stream_free(stream);
+}
+
+TEST_F(LayerStreamUnitTest, test_gzip_diffid)
+{
+    std::string data = make_data(6 * 1024 * 1024, 2);
+    std::string blob = gzip(data);
+    layer_stream *stream = layer_stream_new(true);
+
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(layer_stream_start(stream), 0);
+    ASSERT_EQ(stream_data(stream, blob), 0);
+    ASSERT_EQ(layer_stream_finish(stream), 0);
+
+    ASSERT_TRUE(layer_stream_complete(stream, BLOB_FILE.c_str()));
+    ASSERT_STREQ(layer_stream_digest(stream), file_digest(DATA_FILE, blob).c_str());
+    ASSERT_STREQ(layer_stream_diffid(stream), file_digest(DATA_FILE, data).c_str());
+    layer_stream_free(stream);
+}
+
+TEST_F(LayerStreamUnitTest, test_gzip_members_and_trailing_garbage)
+{
+    std::string first = make_data(100 * 1024, 3);
+    std::string second = make_data(200 * 1024, 4);
+    std::string blob = gzip(first) + gzip(second) + std::string(100, '\0');
+    layer_stream *stream = layer_stream_new(true);
+    char *expect = nullptr;
+
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(layer_stream_start(stream), 0);
+    ASSERT_EQ(stream_data(stream, blob), 0);
+    ASSERT_EQ(layer_stream_finish(stream), 0);
+
+    // same as reading the blob with gzread
+    expect = sha256_full_gzip_digest(BLOB_FILE.c_str());
+    ASSERT_NE(expect, nullptr);
+    ASSERT_STREQ(layer_stream_diffid(stream), expect);
+    ASSERT_STREQ(layer_stream_diffid(stream), file_digest(DATA_FILE, first + second).c_str());
+    free(expect);
+    layer_stream_free(stream);
+}
+
+TEST_F(LayerStreamUnitTest, test_plain_diffid)
+{
+    std::string data = make_data(1024 * 1024, 5);
+    layer_stream *stream = layer_stream_new(true);
+
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(layer_stream_start(stream), 0);
+    ASSERT_EQ(stream_data(stream, data), 0);
+    ASSERT_EQ(layer_stream_finish(stream), 0);
+
+    // data not compressed is the same as its uncompressed data
+    ASSERT_STREQ(layer_stream_diffid(stream), layer_stream_digest(stream));
+    ASSERT_STREQ(layer_stream_digest(stream), file_digest(DATA_FILE, data).c_str());
+    layer_stream_free(stream);
+}
+
+TEST_F(LayerStreamUnitTest, test_incomplete_gzip)
+{
+    std::string blob = gzip(make_data(1024 * 1024, 6));
+    layer_stream *stream = layer_stream_new(true);
+
+    ASSERT_NE(stream, nullptr);
+
+    // truncated data is left to be checked by reading the file
+    ASSERT_EQ(layer_stream_start(stream), 0);
+    ASSERT_EQ(stream_data(stream, blob.substr(0, blob.size() / 2)), 0);
+    ASSERT_EQ(layer_stream_finish(stream), 0);
+    ASSERT_TRUE(layer_stream_complete(stream, BLOB_FILE.c_str()));
+    ASSERT_NE(layer_stream_digest(stream), nullptr);
+    ASSERT_EQ(layer_stream_diffid(stream), nullptr);
+
+    // so is data too short to know whether it is compressed
+    ASSERT_EQ(layer_stream_start(stream), 0);
+    ASSERT_EQ(stream_data(stream, "\x1f"), 0);
+    ASSERT_EQ(layer_stream_finish(stream), 0);
+    ASSERT_STREQ(layer_stream_digest(stream), file_digest(DATA_FILE, "\x1f").c_str());
+    ASSERT_EQ(layer_stream_diffid(stream), nullptr);
+    layer_stream_free(stream);
+}
+
+TEST_F(LayerStreamUnitTest, test_corrupted_gzip)
+{
+    std::string blob = gzip(make_data(1024 * 1024, 7));
+    layer_stream *stream = layer_stream_new(true);
+
+    ASSERT_NE(stream, nullptr);
+    for (size_t i = 20; i < 1024 && i < blob.size(); i++) {
+        blob[i] = (char)~blob[i];
+    }
+
+    ASSERT_EQ(layer_stream_start(stream), 0);
+    // writes fail once the worker sees bad data, or finish does
+    (void)stream_data(stream, blob);
+    ASSERT_EQ(layer_stream_finish(stream), -1);
+    ASSERT_FALSE(layer_stream_complete(stream, BLOB_FILE.c_str()));
+    ASSERT_EQ(layer_stream_digest(stream), nullptr);
+    layer_stream_free(stream);
+}
+
+TEST_F(LayerStreamUnitTest, test_restart)
+{
+    std::string retried = make_data(5 * 1024 * 1024, 8);
+    layer_stream *stream = layer_stream_new(false);
+
+    ASSERT_NE(stream, nullptr);
+
+    // a failed download is retried from the beginning
+    ASSERT_EQ(layer_stream_start(stream), 0);
+    ASSERT_EQ(stream_data(stream, make_data(5 * 1024 * 1024, 9)), 0);
+    ASSERT_EQ(layer_stream_start(stream), 0);
+    ASSERT_EQ(stream_data(stream, retried), 0);
+    ASSERT_EQ(layer_stream_finish(stream), 0);
+    ASSERT_TRUE(layer_stream_complete(stream, BLOB_FILE.c_str()));
+    ASSERT_STREQ(layer_stream_digest(stream), file_digest(DATA_FILE, retried).c_str());
+
+    // freed while running
+    ASSERT_EQ(layer_stream_start(stream), 0);
+    ASSERT_EQ(stream_data(stream, retried), 0);
+    layer_stream_free(stream);
+}
@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: pull scheduler unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "pull_scheduler.h"
+
+static const size_t WORKERS = 4;
+
+class Tracker;
+
+struct TaskArg {
+    Tracker *tracker;
+    std::string job;
+    std::string host;
+    // the task ends once a permit of its gate is granted
+    std::string gate;
+};
+
+class Tracker {
+public:
+    void Submit(pull_job_t *job, const std::string &name, const std::string &host, const std::string &gate,
+                size_t count)
+    {
+        for (size_t i = 0; i < count; i++) {
+            m_args.push_back({ this, name, host, gate });
+            ASSERT_EQ(pull_scheduler_submit(job, Task, &m_args.back()), 0);
+        }
+    }
+
+    void Grant(const std::string &gate, size_t count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_permits[gate] += count;
+        m_cond.notify_all();
+    }
+
+    void Cancel(const std::string &job)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cancelled[job] = true;
+    }
+
+    bool WaitStarted(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cond.wait_for(lock, std::chrono::seconds(10), [&]() {
+            return m_started.size() >= count;
+        });
+    }
+
+    // open all gates and wait for all submitted tasks
+    bool Finish()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (const auto &arg : m_args) {
+            m_permits[arg.gate] = m_args.size();
+        }
+        m_cond.notify_all();
+        return m_cond.wait_for(lock, std::chrono::seconds(10), [&]() {
+            return m_finished == m_args.size();
+        });
+    }
+
+    std::vector<std::string> Started()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_started;
+    }
+
+    int MaxRunning(const std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_max_running[key];
+    }
+
+private:
+    static int Task(void *arg)
+    {
+        TaskArg *task = (TaskArg *)arg;
+        Tracker *t = task->tracker;
+        std::unique_lock<std::mutex> lock(t->m_mutex);
+        std::string host_key = "host:" + task->host;
+
+        if (t->m_cancelled[task->job]) {
+            t->m_finished++;
+            t->m_cond.notify_all();
+            return -1;
+        }
+
+        t->m_started.push_back(task->job);
+        for (const auto &key : { task->job, host_key }) {
+            t->m_running[key]++;
+            if (t->m_running[key] > t->m_max_running[key]) {
+                t->m_max_running[key] = t->m_running[key];
+            }
+        }
+        t->m_cond.notify_all();
+
+        t->m_cond.wait(lock, [&]() {
+            return t->m_permits[task->gate] > 0;
+        });
+        t->m_permits[task->gate]--;
+        t->m_running[task->job]--;
+        t->m_running[host_key]--;
+        t->m_finished++;
+        t->m_cond.notify_all();
+        return 0;
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<TaskArg> m_args;
+    std::vector<std::string> m_started;
+    std::map<std::string, int> m_running;
+    std::map<std::string, int> m_max_running;
+    std::map<std::string, size_t> m_permits;
+    std::map<std::string, bool> m_cancelled;
+    size_t m_finished { 0 };
+};
+
+static im_pull_metrics get_metrics()
+{
+    im_pull_metrics metrics = { 0 };
+
+    pull_scheduler_get_metrics(&metrics);
+    return metrics;
+}
+
+// released jobs are freed by the workers running their last tasks
+static bool wait_jobs_freed()
+{
+    for (int i = 0; i < 500; i++) {
+        im_pull_metrics metrics = get_metrics();
+        if (metrics.pulls == 0 && metrics.running == 0) {
+            return true;
+        }
+        usleep(10 * 1000);
+    }
+    return false;
+}
+
+class PullSchedulerUnitTest : public testing::Test {
+protected:
+    static void SetUpTestCase()
+    {
+        ASSERT_EQ(pull_scheduler_init(WORKERS), 0);
+        ASSERT_EQ(pull_scheduler_init(WORKERS * 2), 0);
+        ASSERT_EQ(get_metrics().workers, WORKERS);
+    }
+
+    void TearDown() override
+    {
+        ASSERT_TRUE(wait_jobs_freed());
+    }
+};
+
+// keep all workers busy with tasks of a job released one by one
+static pull_job_t *occupy_workers(Tracker &tracker)
+{
+    pull_job_t *job = pull_scheduler_job_new("blocker", 0, 0, PULL_PRIORITY_NORMAL);
+
+    if (job != nullptr) {
+        tracker.Submit(job, "blocker", "blocker", "blocker", WORKERS);
+    }
+    return job;
+}
+
+static std::vector<std::string> release_blockers(Tracker &tracker)
+{
+    std::vector<std::string> started;
+
+    for (size_t i = 1; i <= WORKERS; i++) {
+        tracker.Grant("blocker", 1);
+        if (!tracker.WaitStarted(WORKERS + i)) {
+            break;
+        }
+    }
+    started = tracker.Started();
+    started.erase(started.begin(), started.begin() + WORKERS);
+    return started;
+}
+
+TEST_F(PullSchedulerUnitTest, test_invalid_args)
+{
+    pull_job_t *job = pull_scheduler_job_new(nullptr, 0, 0, PULL_PRIORITY_NORMAL);
+    int dummy = 0;
+
+    ASSERT_NE(job, nullptr);
+    ASSERT_EQ(pull_scheduler_submit(nullptr, [](void *arg) { return 0; }, &dummy), -1);
+    ASSERT_EQ(pull_scheduler_submit(job, nullptr, &dummy), -1);
+    pull_scheduler_job_release(job);
+    pull_scheduler_job_release(nullptr);
+}
+
+TEST_F(PullSchedulerUnitTest, test_priority)
+{
+    Tracker tracker;
+    pull_job_t *blocker = occupy_workers(tracker);
+    pull_job_t *normal = nullptr;
+    pull_job_t *high = nullptr;
+    std::vector<std::string> expect { "high", "high", "normal", "normal" };
+
+    ASSERT_NE(blocker, nullptr);
+    ASSERT_TRUE(tracker.WaitStarted(WORKERS));
+
+    // the normal job is queued first
+    normal = pull_scheduler_job_new("registry", 0, 0, PULL_PRIORITY_NORMAL);
+    high = pull_scheduler_job_new("registry", 0, 0, PULL_PRIORITY_HIGH);
+    ASSERT_NE(normal, nullptr);
+    ASSERT_NE(high, nullptr);
+    tracker.Submit(normal, "normal", "registry", "wait", 2);
+    tracker.Submit(high, "high", "registry", "wait", 2);
+
+    ASSERT_EQ(release_blockers(tracker), expect);
+
+    ASSERT_TRUE(tracker.Finish());
+    pull_scheduler_job_release(blocker);
+    pull_scheduler_job_release(normal);
+    pull_scheduler_job_release(high);
+}
+
+TEST_F(PullSchedulerUnitTest, test_fairness)
+{
+    Tracker tracker;
+    pull_job_t *blocker = occupy_workers(tracker);
+    pull_job_t *first = nullptr;
+    pull_job_t *second = nullptr;
+    std::vector<std::string> expect { "first", "second", "first", "second" };
+
+    ASSERT_NE(blocker, nullptr);
+    ASSERT_TRUE(tracker.WaitStarted(WORKERS));
+
+    // all tasks of the first job are queued before the second job
+    first = pull_scheduler_job_new("registry1", 0, 0, PULL_PRIORITY_NORMAL);
+    second = pull_scheduler_job_new("registry2", 0, 0, PULL_PRIORITY_NORMAL);
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    tracker.Submit(first, "first", "registry1", "wait", 4);
+    tracker.Submit(second, "second", "registry2", "wait", 4);
+
+    ASSERT_EQ(release_blockers(tracker), expect);
+
+    ASSERT_TRUE(tracker.Finish());
+    pull_scheduler_job_release(blocker);
+    pull_scheduler_job_release(first);
+    pull_scheduler_job_release(second);
+}
+
+TEST_F(PullSchedulerUnitTest, test_job_limit)
+{
+    Tracker tracker;
+    pull_job_t *job = pull_scheduler_job_new("registry", 2, 0, PULL_PRIORITY_NORMAL);
+
+    ASSERT_NE(job, nullptr);
+    tracker.Submit(job, "job", "registry", "wait", 6);
+
+    ASSERT_TRUE(tracker.WaitStarted(2));
+    usleep(50 * 1000);
+    ASSERT_EQ(tracker.Started().size(), 2U);
+    ASSERT_EQ(get_metrics().queued, 4U);
+
+    ASSERT_TRUE(tracker.Finish());
+    ASSERT_EQ(tracker.MaxRunning("job"), 2);
+    pull_scheduler_job_release(job);
+}
+
+TEST_F(PullSchedulerUnitTest, test_host_limit)
+{
+    Tracker tracker;
+    pull_job_t *job1 = pull_scheduler_job_new("registry", 2, 3, PULL_PRIORITY_NORMAL);
+    pull_job_t *job2 = pull_scheduler_job_new("registry", 2, 3, PULL_PRIORITY_NORMAL);
+    pull_job_t *other = nullptr;
+
+    ASSERT_NE(job1, nullptr);
+    ASSERT_NE(job2, nullptr);
+    tracker.Submit(job1, "job1", "registry", "wait", 4);
+    tracker.Submit(job2, "job2", "registry", "wait", 4);
+
+    // both jobs are below their own limit, but the host is full
+    ASSERT_TRUE(tracker.WaitStarted(3));
+    usleep(50 * 1000);
+    ASSERT_EQ(tracker.Started().size(), 3U);
+
+    // the free worker serves another host
+    other = pull_scheduler_job_new("other", 2, 3, PULL_PRIORITY_NORMAL);
+    ASSERT_NE(other, nullptr);
+    tracker.Submit(other, "other", "other", "wait", 1);
+    ASSERT_TRUE(tracker.WaitStarted(4));
+    ASSERT_EQ(tracker.Started().back(), "other");
+
+    ASSERT_TRUE(tracker.Finish());
+    ASSERT_EQ(tracker.MaxRunning("host:registry"), 3);
+    ASSERT_LE(tracker.MaxRunning("job1"), 2);
+    ASSERT_LE(tracker.MaxRunning("job2"), 2);
+    pull_scheduler_job_release(job1);
+    pull_scheduler_job_release(job2);
+    pull_scheduler_job_release(other);
+}
+
+TEST_F(PullSchedulerUnitTest, test_release_cancelled_job)
+{
+    Tracker tracker;
+    im_pull_metrics before = get_metrics();
+    im_pull_metrics after = { 0 };
+    pull_job_t *job = pull_scheduler_job_new("registry", 1, 0, PULL_PRIORITY_NORMAL);
+
+    ASSERT_NE(job, nullptr);
+    ASSERT_EQ(before.pulls, 0U);
+    ASSERT_EQ(get_metrics().pulls, 1U);
+    tracker.Submit(job, "job", "registry", "wait", 3);
+    ASSERT_TRUE(tracker.WaitStarted(1));
+
+    // the pull gives up, its queued tasks still run and return at once
+    tracker.Cancel("job");
+    pull_scheduler_job_release(job);
+    ASSERT_EQ(get_metrics().pulls, 1U);
+
+    ASSERT_TRUE(tracker.Finish());
+    ASSERT_TRUE(wait_jobs_freed());
+    after = get_metrics();
+    ASSERT_EQ(after.queued, 0U);
+    ASSERT_EQ(after.tasks_total, before.tasks_total + 3);
+    ASSERT_EQ(after.tasks_failed, before.tasks_failed + 2);
+    ASSERT_EQ(tracker.Started().size(), 1U);
+
+    // a job without tasks is freed at once
+    job = pull_scheduler_job_new("registry", 1, 0, PULL_PRIORITY_NORMAL);
+    ASSERT_NE(job, nullptr);
+    pull_scheduler_job_release(job);
+    ASSERT_EQ(get_metrics().pulls, 0U);
+}
@@ -36,13 +36,16 @@
 #include "isula_libutils/imagetool_search_result.h"
 #include "isula_libutils/log.h"
 #include "http_request.h"
+#include "mediatype.h"
 #include "registry.h"
+#include "registry_apiv2.h"
 #include "registry_type.h"
 #include "http_mock.h"
 #include "storage_mock.h"
 #include "buffer.h"
 #include "aes.h"
 #include "auths.h"
+#include "sha256.h"
 #include "oci_image_mock.h"
 #include "isulad_config_mock.h"
 
@@ -811,6 +814,132 @@ TEST_F(RegistryUnitTest, test_aes)
     free(decoded);
 }
 
+static const std::string RANGES_BLOB_DIR = "/tmp/isulad_registry_ranges_ut";
+static const std::string RANGES_LAYER_URL = "http://test.registry.com/v2/library/test/blobs/";
+
+enum ranges_mode {
+    RANGES_OK,
+    // server does not answer ranges with 206
+    RANGES_IGNORED,
+    // data fetched by ranges is not the blob
+    RANGES_MISMATCH,
+};
+
+static std::string g_ranges_blob;
+static ranges_mode g_ranges_mode;
+static size_t g_ranges_parts_num;
+static int g_ranges_calls;
+static int g_single_calls;
+
+static int invokeHttpRequestRanges(const char *url, struct http_get_options *options, size_t total_size,
+                                   size_t parts_num)
+{
+    std::string data = g_ranges_blob;
+
+    g_ranges_calls++;
+    g_ranges_parts_num = parts_num;
+    if (!util_has_prefix(url, RANGES_LAYER_URL.c_str()) || total_size != data.size()) {
+        return -1;
+    }
+    if (g_ranges_mode == RANGES_IGNORED) {
+        options->errcode = CURLE_RANGE_ERROR;
+        return -1;
+    }
+    if (g_ranges_mode == RANGES_MISMATCH) {
+        data[data.size() / 2] ^= 1;
+    }
+    return util_write_file((const char *)options->output, data.c_str(), data.size(), 0600);
+}
+
+static int invokeHttpRequestLayer(const char *url, struct http_get_options *options, long *response_code,
+                                  int recursive_len)
+{
+    g_single_calls++;
+    if (!util_has_prefix(url, RANGES_LAYER_URL.c_str()) || options->outputtype != HTTP_REQUEST_FILE) {
+        return -1;
+    }
+    return util_write_file((const char *)options->output, g_ranges_blob.c_str(), g_ranges_blob.size(), 0600);
+}
+
+static pull_descriptor *new_ranges_desc(const std::string &digest, size_t size)
+{
+    pull_descriptor *desc = (pull_descriptor *)util_common_calloc_s(sizeof(pull_descriptor));
+    if (desc == nullptr) {
+        return nullptr;
+    }
+    desc->host = util_strdup_s("test.registry.com");
+    desc->name = util_strdup_s("library/test");
+    desc->protocol = util_strdup_s("http");
+    desc->blobpath = util_strdup_s(RANGES_BLOB_DIR.c_str());
+    desc->layers = (layer_blob *)util_common_calloc_s(sizeof(layer_blob));
+    if (desc->layers == nullptr) {
+        free_pull_desc(desc);
+        return nullptr;
+    }
+    desc->layers_len = 1;
+    desc->layers[0].media_type = util_strdup_s(DOCKER_IMAGE_LAYER_TAR_GZIP);
+    desc->layers[0].digest = util_strdup_s(digest.c_str());
+    desc->layers[0].size = size;
+    return desc;
+}
+
+static void check_fetch_layer(const std::string &digest, ranges_mode mode, int ranges_calls, int single_calls)
+{
+    pull_descriptor *desc = new_ranges_desc(digest, g_ranges_blob.size());
+    std::string file = RANGES_BLOB_DIR + "/0";
+
+    ASSERT_NE(desc, nullptr);
+    g_ranges_mode = mode;
+    g_ranges_calls = 0;
+    g_single_calls = 0;
+    (void)unlink(file.c_str());
+
+    ASSERT_EQ(fetch_layer(desc, 0, nullptr), 0);
+    ASSERT_EQ(g_ranges_calls, ranges_calls);
+    ASSERT_EQ(g_single_calls, single_calls);
+    ASSERT_TRUE(sha256_valid_digest_file(file.c_str(), digest.c_str()));
+    free_pull_desc(desc);
+}
+
+TEST_F(RegistryUnitTest, test_fetch_layer_by_ranges)
+{
+    std::string file = RANGES_BLOB_DIR + "/blob";
+    char *digest = nullptr;
+
+    // large enough for 2 ranges of 16MB
+    g_ranges_blob.resize(32 * 1024 * 1024);
+    for (size_t i = 0; i < g_ranges_blob.size(); i++) {
+        g_ranges_blob[i] = (char)(i % 251);
+    }
+    ASSERT_EQ(util_mkdir_p(RANGES_BLOB_DIR.c_str(), 0700), 0);
+    ASSERT_EQ(util_write_file(file.c_str(), g_ranges_blob.c_str(), g_ranges_blob.size(), 0600), 0);
+    digest = sha256_full_file_digest(file.c_str());
+    ASSERT_NE(digest, nullptr);
+
+    EXPECT_CALL(m_http_mock, HttpRequestRanges(::testing::_, ::testing::_, ::testing::_, ::testing::_))
+    .WillRepeatedly(Invoke(invokeHttpRequestRanges));
+    EXPECT_CALL(m_http_mock, HttpRequest(::testing::_, ::testing::_, ::testing::_, ::testing::_))
+    .WillRepeatedly(Invoke(invokeHttpRequestLayer));
+
+    check_fetch_layer(digest, RANGES_OK, 1, 0);
+    ASSERT_EQ(g_ranges_parts_num, 2U);
+    // fall back to a single request
+    check_fetch_layer(digest, RANGES_IGNORED, 1, 1);
+    check_fetch_layer(digest, RANGES_MISMATCH, 1, 1);
+
+    // too small to be split
+    g_ranges_blob.resize(16 * 1024 * 1024);
+    ASSERT_EQ(util_write_file(file.c_str(), g_ranges_blob.c_str(), g_ranges_blob.size(), 0600), 0);
+    free(digest);
+    digest = sha256_full_file_digest(file.c_str());
+    ASSERT_NE(digest, nullptr);
+    check_fetch_layer(digest, RANGES_OK, 0, 1);
+
+    free(digest);
+    g_ranges_blob.clear();
+    ASSERT_EQ(util_recursive_rmdir(RANGES_BLOB_DIR.c_str(), 0), 0);
+}
+
 TEST_F(RegistryUnitTest, test_cleanup)
 {
     std::string auths_key = get_dir() + "/auths/" + AUTH_AESKEY_NAME;
@@ -665,3 +665,49 @@ TEST_F(StorageImagesUnitTest, test_image_store_remove_multi_name)
 
     Restore();
 }
+
+TEST_F(StorageImagesUnitTest, test_image_store_index)
+{
+    std::string index_path = std::string(store_real_path) + "/overlay-images/images.index";
+    struct storage_module_init_options opts = { 0 };
+    struct stat st = { 0 };
+    ino_t index_ino;
+
+    BackUp();
+
+    // written by the load, and not rewritten when only read
+    ASSERT_EQ(stat(index_path.c_str(), &st), 0);
+    index_ino = st.st_ino;
+    ASSERT_TRUE(image_store_exists(ids.at(0).c_str()));
+    image_store_save_index();
+    ASSERT_EQ(stat(index_path.c_str(), &st), 0);
+    ASSERT_EQ(st.st_ino, index_ino);
+
+    // removed before the image files change, and written from memory on save
+    ASSERT_EQ(image_store_set_metadata(ids.at(0).c_str(), "{\"index\":\"test\"}"), 0);
+    ASSERT_FALSE(util_file_exists(index_path.c_str()));
+    image_store_save_index();
+    ASSERT_TRUE(util_file_exists(index_path.c_str()));
+    ASSERT_EQ(stat(index_path.c_str(), &st), 0);
+    index_ino = st.st_ino;
+
+    // a load from an up to date index keeps it
+    image_store_free();
+    opts.storage_root = strdup(store_real_path);
+    opts.driver_name = strdup("overlay");
+    ASSERT_EQ(image_store_init(&opts), 0);
+    free(opts.storage_root);
+    free(opts.driver_name);
+    ASSERT_EQ(stat(index_path.c_str(), &st), 0);
+    ASSERT_EQ(st.st_ino, index_ino);
+
+    char *metadata = image_store_metadata(ids.at(0).c_str());
+    ASSERT_STREQ(metadata, "{\"index\":\"test\"}");
+    free(metadata);
+    auto image = image_store_get_image(ids.at(0).c_str());
+    ASSERT_NE(image, nullptr);
+    ASSERT_NE(image->spec, nullptr);
+    free_imagetool_image(image);
+
+    Restore();
+}
@@ -20,6 +20,7 @@
 #include <dirent.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/mount.h>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include "path.h"
@@ -27,6 +28,7 @@
 #include "utils_array.h"
 #include "driver_overlay2.h"
 #include "driver_quota_mock.h"
+#include "fs_usage.h"
 
 using ::testing::Args;
 using ::testing::ByRef;
@@ -278,3 +280,126 @@ TEST(StorageOverlay2QuotaOptionsTest, test_overlay2_is_quota_options)
         ASSERT_TRUE(overlay2_is_quota_options(nullptr, option.c_str()));
     }
 }
+
+namespace {
+int g_quota_usage_ret = 0;
+std::string g_quota_usage_target;
+
+int fakeGetQuotaUsage(const char *target, struct pquota_control *ctrl, int64_t *used_bytes, int64_t *inodes_used)
+{
+    g_quota_usage_target = target;
+    if (g_quota_usage_ret != 0) {
+        return g_quota_usage_ret;
+    }
+    *used_bytes = 3 * 4096;
+    *inodes_used = 7;
+    return 0;
+}
+
+void writeTestFile(const std::string &path, size_t size)
+{
+    std::string content(size, 'x');
+    ASSERT_EQ(util_write_file(path.c_str(), content.c_str(), content.size(), 0600), 0);
+}
+
+void getLayerUsage(const struct graphdriver *driver, int64_t *used_bytes, int64_t *inodes_used)
+{
+    imagetool_fs_info *fs_info = (imagetool_fs_info *)util_common_calloc_s(sizeof(imagetool_fs_info));
+    ASSERT_NE(fs_info, nullptr);
+    ASSERT_EQ(overlay2_get_layer_fs_info("layer", driver, fs_info), 0);
+    ASSERT_EQ(fs_info->image_filesystems_len, 1);
+    *used_bytes = fs_info->image_filesystems[0]->used_bytes->value;
+    *inodes_used = fs_info->image_filesystems[0]->inodes_used->value;
+    free_imagetool_fs_info(fs_info);
+}
+}
+
+TEST(StorageOverlay2FsInfoTest, test_overlay2_get_layer_fs_info)
+{
+    std::string home = "/tmp/test_overlay2_fs_info";
+    std::string layer_dir = home + "/layer";
+    std::string merged = layer_dir + "/merged";
+    struct pquota_control ctrl = {};
+    struct graphdriver driver = {};
+    int64_t used_bytes = 0;
+    int64_t inodes_used = 0;
+    int64_t walk_bytes = 0;
+    int64_t walk_inodes = 0;
+
+    ASSERT_EQ(system(("rm -rf " + home).c_str()), 0);
+    ASSERT_EQ(util_mkdir_p((layer_dir + "/diff").c_str(), 0700), 0);
+    ASSERT_EQ(util_mkdir_p((layer_dir + "/work/work").c_str(), 0700), 0);
+    ASSERT_EQ(util_mkdir_p(merged.c_str(), 0700), 0);
+    writeTestFile(layer_dir + "/diff/file", 1000);
+    writeTestFile(layer_dir + "/link", 26);
+    driver.home = home.c_str();
+    ctrl.get_quota_usage = fakeGetQuotaUsage;
+    driver.quota_ctrl = &ctrl;
+
+    // usage accounted to the project id of layer dir
+    g_quota_usage_ret = 0;
+    getLayerUsage(&driver, &used_bytes, &inodes_used);
+    EXPECT_EQ(g_quota_usage_target, layer_dir);
+    EXPECT_EQ(used_bytes, 3 * 4096);
+    EXPECT_EQ(inodes_used, 7);
+
+    // the layer has no project id of its own, the same layer dir is walked
+    g_quota_usage_ret = -1;
+    util_calculate_dir_size(layer_dir.c_str(), 0, &walk_bytes, &walk_inodes);
+    getLayerUsage(&driver, &used_bytes, &inodes_used);
+    EXPECT_EQ(used_bytes, walk_bytes);
+    EXPECT_EQ(inodes_used, walk_inodes);
+    EXPECT_EQ(inodes_used, 7);
+
+    // the content of mounted merged dir is not accounted, the same as project quota
+    struct stat merged_st;
+    ASSERT_EQ(stat(merged.c_str(), &merged_st), 0);
+    if (mount("tmpfs", merged.c_str(), "tmpfs", 0, nullptr) == 0) {
+        writeTestFile(merged + "/file", 4096);
+        fs_usage_forget(layer_dir.c_str());
+        getLayerUsage(&driver, &used_bytes, &inodes_used);
+        EXPECT_EQ(used_bytes, walk_bytes - merged_st.st_size);
+        EXPECT_EQ(inodes_used, walk_inodes);
+        (void)umount(merged.c_str());
+    }
+
+    fs_usage_forget(layer_dir.c_str());
+    ASSERT_EQ(system(("rm -rf " + home).c_str()), 0);
+}
+
+TEST(StorageFsUsageTest, test_fs_usage_get)
+{
+    std::string dir = "/tmp/test_fs_usage_get";
+    fs_usage_info usage = { 0 };
+    fs_usage_info cached = { 0 };
+    int64_t walk_bytes = 0;
+    int64_t walk_inodes = 0;
+
+    ASSERT_EQ(system(("rm -rf " + dir).c_str()), 0);
+    ASSERT_EQ(util_mkdir_p((dir + "/sub").c_str(), 0700), 0);
+    writeTestFile(dir + "/sub/file", 100);
+
+    // the first query walks the directory
+    ASSERT_EQ(fs_usage_get(dir.c_str(), &usage), 0);
+    util_calculate_dir_size(dir.c_str(), 0, &walk_bytes, &walk_inodes);
+    EXPECT_EQ(usage.used_bytes, walk_bytes);
+    EXPECT_EQ(usage.inodes_used, walk_inodes);
+    EXPECT_GT(usage.timestamp, 0);
+
+    // later queries are served from cache until it is refreshed in background
+    writeTestFile(dir + "/file", 200);
+    ASSERT_EQ(fs_usage_get(dir.c_str(), &cached), 0);
+    EXPECT_EQ(cached.used_bytes, usage.used_bytes);
+    EXPECT_EQ(cached.inodes_used, usage.inodes_used);
+    EXPECT_EQ(cached.timestamp, usage.timestamp);
+
+    // the dropped entry is walked again
+    fs_usage_forget(dir.c_str());
+    ASSERT_EQ(fs_usage_get(dir.c_str(), &cached), 0);
+    EXPECT_EQ(cached.used_bytes, usage.used_bytes + 200);
+    EXPECT_EQ(cached.inodes_used, usage.inodes_used + 1);
+
+    ASSERT_NE(fs_usage_get(nullptr, &usage), 0);
+    fs_usage_forget(dir.c_str());
+    ASSERT_EQ(system(("rm -rf " + dir).c_str()), 0);
+}
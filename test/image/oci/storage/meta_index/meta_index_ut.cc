@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: metadata index unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "meta_index.h"
+#include "utils.h"
+#include "utils_file.h"
+
+static const std::string ROOT_DIR = "/tmp/isulad_meta_index_ut";
+static const std::string INDEX_PATH = ROOT_DIR + "/test.index";
+
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path);
+    std::stringstream ss;
+
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static void write_file(const std::string &path, const std::string &content)
+{
+    std::ofstream out(path, std::ios::trunc);
+
+    out << content;
+}
+
+static off_t file_size(const std::string &path)
+{
+    struct stat st = { 0 };
+
+    if (stat(path.c_str(), &st) != 0) {
+        return -1;
+    }
+    return st.st_size;
+}
+
+class MetaIndexUnitTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(util_recursive_rmdir(ROOT_DIR.c_str(), 0), 0);
+        ASSERT_EQ(util_mkdir_p(ROOT_DIR.c_str(), 0700), 0);
+    }
+
+    void TearDown() override
+    {
+        util_recursive_rmdir(ROOT_DIR.c_str(), 0);
+    }
+
+    void write_index()
+    {
+        // unsorted, and the entry without data is skipped
+        const meta_index_file_t files[] = {
+            { "/images/b/images.json", "{\"id\":\"b\"}" },
+            { "/images/a/images.json", "{\"id\":\"a\"}" },
+            { "/images/c/images.json", nullptr },
+            { "/images/a/config", "" },
+        };
+
+        ASSERT_EQ(meta_index_write(INDEX_PATH.c_str(), files, sizeof(files) / sizeof(files[0])), 0);
+    }
+};
+
+TEST_F(MetaIndexUnitTest, test_write_and_lookup)
+{
+    meta_index_t *idx = nullptr;
+
+    ASSERT_EQ(meta_index_write(nullptr, nullptr, 0), -1);
+    ASSERT_EQ(meta_index_write(INDEX_PATH.c_str(), nullptr, 1), -1);
+
+    write_index();
+    idx = meta_index_open(INDEX_PATH.c_str());
+    ASSERT_NE(idx, nullptr);
+
+    ASSERT_STREQ(meta_index_lookup(idx, "/images/a/images.json"), "{\"id\":\"a\"}");
+    ASSERT_STREQ(meta_index_lookup(idx, "/images/b/images.json"), "{\"id\":\"b\"}");
+    ASSERT_STREQ(meta_index_lookup(idx, "/images/a/config"), "");
+    ASSERT_EQ(meta_index_misses(idx), 0);
+
+    ASSERT_EQ(meta_index_lookup(idx, "/images/c/images.json"), nullptr);
+    ASSERT_EQ(meta_index_lookup(idx, "/images/d/images.json"), nullptr);
+    ASSERT_EQ(meta_index_lookup(idx, nullptr), nullptr);
+    ASSERT_EQ(meta_index_misses(idx), 2);
+
+    meta_index_close(idx);
+}
+
+TEST_F(MetaIndexUnitTest, test_empty_index)
+{
+    meta_index_t *idx = nullptr;
+
+    ASSERT_EQ(meta_index_write(INDEX_PATH.c_str(), nullptr, 0), 0);
+    idx = meta_index_open(INDEX_PATH.c_str());
+    ASSERT_NE(idx, nullptr);
+    ASSERT_EQ(meta_index_lookup(idx, "/images/a/images.json"), nullptr);
+    ASSERT_EQ(meta_index_misses(idx), 1);
+    meta_index_close(idx);
+
+    ASSERT_EQ(meta_index_lookup(nullptr, "/images/a/images.json"), nullptr);
+    ASSERT_EQ(meta_index_misses(nullptr), 0);
+}
+
+TEST_F(MetaIndexUnitTest, test_invalidate)
+{
+    meta_index_t *idx = nullptr;
+
+    write_index();
+    idx = meta_index_open(INDEX_PATH.c_str());
+    ASSERT_NE(idx, nullptr);
+
+    ASSERT_EQ(meta_index_invalidate(INDEX_PATH.c_str()), 0);
+    ASSERT_FALSE(util_file_exists(INDEX_PATH.c_str()));
+    ASSERT_EQ(meta_index_open(INDEX_PATH.c_str()), nullptr);
+
+    // an opened index is still usable
+    ASSERT_STREQ(meta_index_lookup(idx, "/images/a/images.json"), "{\"id\":\"a\"}");
+    meta_index_close(idx);
+
+    ASSERT_EQ(meta_index_invalidate(INDEX_PATH.c_str()), 0);
+    ASSERT_EQ(meta_index_invalidate(nullptr), -1);
+}
+
+TEST_F(MetaIndexUnitTest, test_corrupted_index)
+{
+    std::string content;
+
+    write_index();
+    content = read_file(INDEX_PATH);
+    ASSERT_GT(content.size(), 40U);
+
+    // payload changed
+    std::string corrupted = content;
+    corrupted[content.size() - 2] ^= 0x1;
+    write_file(INDEX_PATH, corrupted);
+    ASSERT_EQ(meta_index_open(INDEX_PATH.c_str()), nullptr);
+
+    // truncated
+    write_file(INDEX_PATH, content.substr(0, content.size() - 1));
+    ASSERT_EQ(meta_index_open(INDEX_PATH.c_str()), nullptr);
+    write_file(INDEX_PATH, content.substr(0, 10));
+    ASSERT_EQ(meta_index_open(INDEX_PATH.c_str()), nullptr);
+
+    // unknown magic
+    corrupted = content;
+    corrupted[0] = 'X';
+    write_file(INDEX_PATH, corrupted);
+    ASSERT_EQ(meta_index_open(INDEX_PATH.c_str()), nullptr);
+
+    ASSERT_EQ(meta_index_open((ROOT_DIR + "/missing.index").c_str()), nullptr);
+    ASSERT_EQ(meta_index_open(nullptr), nullptr);
+
+    // rewritten after the corruption is detected
+    write_index();
+    ASSERT_EQ(file_size(INDEX_PATH), (off_t)content.size());
+    meta_index_close(meta_index_open(INDEX_PATH.c_str()));
+}
+
+static void record_index_cb(size_t index, void *arg)
+{
+    std::vector<std::atomic<int>> *calls = static_cast<std::vector<std::atomic<int>> *>(arg);
+
+    (*calls)[index]++;
+}
+
+TEST_F(MetaIndexUnitTest, test_parallel_load)
+{
+    std::vector<std::atomic<int>> calls(1000);
+
+    ASSERT_EQ(meta_index_parallel_load(0, record_index_cb, &calls), 0);
+    ASSERT_EQ(meta_index_parallel_load(1, nullptr, &calls), -1);
+
+    ASSERT_EQ(meta_index_parallel_load(calls.size(), record_index_cb, &calls), 0);
+    for (const auto &call : calls) {
+        ASSERT_EQ(call, 1);
+    }
+}
@@ -12,12 +12,18 @@
  * Create: 2023-03-16
  * Description: provide remote layer support ut
  ******************************************************************************/
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
 #include <gtest/gtest.h>
 
 #include "remote_store_mock.h"
 #include "ro_symlink_maintain.h"
 #include "remote_support.h"
 #include "map.h"
+#include "utils.h"
+#include "utils_file.h"
 
 using ::testing::Invoke;
 
@@ -91,3 +97,59 @@ TEST(remote_Layer_ut, test_map_diff)
     ASSERT_EQ(added[0][0], 'c');
     ASSERT_EQ(deleted[0][0], 'a');
 }
+
+TEST(remote_Layer_ut, test_prefetch_path)
+{
+    const char *diff_dir = "/var/lib/isulad/storage/overlay/RO/layer/diff";
+    char *path = NULL;
+
+    path = remote_overlay_prefetch_path(diff_dir, "usr/bin/sh");
+    ASSERT_STREQ(path, "/var/lib/isulad/storage/overlay/RO/layer/diff/usr/bin/sh");
+    free(path);
+
+    path = remote_overlay_prefetch_path(diff_dir, "/usr/../etc/./passwd");
+    ASSERT_STREQ(path, "/var/lib/isulad/storage/overlay/RO/layer/diff/etc/passwd");
+    free(path);
+
+    // escapes of the diff dir are skipped
+    ASSERT_EQ(remote_overlay_prefetch_path(diff_dir, "../../other/diff/etc/passwd"), nullptr);
+    ASSERT_EQ(remote_overlay_prefetch_path(diff_dir, "usr/../../diff2/file"), nullptr);
+    ASSERT_EQ(remote_overlay_prefetch_path(diff_dir, "../diff.bak/file"), nullptr);
+    ASSERT_EQ(remote_overlay_prefetch_path(diff_dir, ".."), nullptr);
+    ASSERT_EQ(remote_overlay_prefetch_path(diff_dir, "."), nullptr);
+    ASSERT_EQ(remote_overlay_prefetch_path(diff_dir, ""), nullptr);
+
+    ASSERT_EQ(remote_overlay_prefetch_path(nullptr, "usr/bin/sh"), nullptr);
+    ASSERT_EQ(remote_overlay_prefetch_path(diff_dir, nullptr), nullptr);
+}
+
+TEST(remote_Layer_ut, test_prefetch_open)
+{
+    const std::string root = "/tmp/isulad_remote_prefetch_ut";
+    const std::string diff_dir = root + "/layer/diff";
+    int fd = -1;
+
+    ASSERT_EQ(util_recursive_rmdir(root.c_str(), 0), 0);
+    ASSERT_EQ(util_mkdir_p((diff_dir + "/usr/bin").c_str(), 0700), 0);
+    ASSERT_EQ(util_mkdir_p((root + "/outside").c_str(), 0700), 0);
+    std::ofstream(diff_dir + "/usr/bin/sh") << "sh";
+    std::ofstream(root + "/outside/secret") << "secret";
+    ASSERT_EQ(symlink((root + "/outside").c_str(), (diff_dir + "/usr/link_dir").c_str()), 0);
+    ASSERT_EQ(symlink("bin/sh", (diff_dir + "/usr/link_file").c_str()), 0);
+    ASSERT_EQ(mkfifo((diff_dir + "/usr/fifo").c_str(), 0600), 0);
+
+    fd = remote_overlay_prefetch_open(diff_dir.c_str(), "/usr/bin/sh");
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    // a symlink in the middle or at the end of the path is not followed
+    ASSERT_EQ(remote_overlay_prefetch_open(diff_dir.c_str(), "usr/link_dir/secret"), -1);
+    ASSERT_EQ(remote_overlay_prefetch_open(diff_dir.c_str(), "usr/link_file"), -1);
+    // only regular files are opened
+    ASSERT_EQ(remote_overlay_prefetch_open(diff_dir.c_str(), "usr/fifo"), -1);
+    ASSERT_EQ(remote_overlay_prefetch_open(diff_dir.c_str(), "usr/bin"), -1);
+    ASSERT_EQ(remote_overlay_prefetch_open(diff_dir.c_str(), "usr/not_exist"), -1);
+    ASSERT_EQ(remote_overlay_prefetch_open(diff_dir.c_str(), "../../outside/secret"), -1);
+
+    ASSERT_EQ(util_recursive_rmdir(root.c_str(), 0), 0);
+}
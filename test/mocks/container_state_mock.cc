@@ -100,3 +100,11 @@ const char *container_state_to_string(Container_Status cs)
     }
     return "unknown";
 }
+
+int container_state_get_pid(container_state_t *s)
+{
+    if (g_container_state_mock != nullptr) {
+        return g_container_state_mock->ContainerStateGetPid(s);
+    }
+    return 0;
+}
@@ -31,6 +31,7 @@ public:
     MOCK_METHOD1(IsRemovalInProgress, bool(container_state_t *s));
     MOCK_METHOD1(ContainerStateGetStatus, Container_Status(container_state_t *s));
     MOCK_METHOD1(ContainerStatetoString, const char *(Container_Status cs));
+    MOCK_METHOD1(ContainerStateGetPid, int(container_state_t *s));
 };
 
 void MockContainerState_SetMock(MockContainerState *mock);
@@ -77,3 +77,19 @@ void container_update_restart_manager(container_t *cont, const host_config_resta
         return g_container_unix_mock->ContainerUpdateRestartManager(cont, policy);
     }
 }
+
+int container_stats_collector_get(const char *id, int pid, struct runtime_container_resources_stats_info *info)
+{
+    if (g_container_unix_mock != nullptr) {
+        return g_container_unix_mock->ContainerStatsCollectorGet(id, pid, info);
+    }
+    return -1;
+}
+
+int save_container_state_config(const char *id, const char *rootpath, const char *state_configstr)
+{
+    if (g_container_unix_mock != nullptr) {
+        return g_container_unix_mock->SaveContainerStateConfig(id, rootpath, state_configstr);
+    }
+    return 0;
+}
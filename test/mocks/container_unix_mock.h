@@ -29,6 +29,9 @@ public:
     MOCK_METHOD1(ContainerLock, void(const container_t *cont));
     MOCK_METHOD1(ContainerUnref, void(container_t *cont));
     MOCK_METHOD2(ContainerUpdateRestartManager, void(container_t *cont, const host_config_restart_policy *policy));
+    MOCK_METHOD3(ContainerStatsCollectorGet, int(const char *id, int pid,
+                                                 struct runtime_container_resources_stats_info *info));
+    MOCK_METHOD3(SaveContainerStateConfig, int(const char *id, const char *rootpath, const char *state_configstr));
 };
 
 void MockContainerUnix_SetMock(MockContainerUnix *mock);
@@ -32,3 +32,12 @@ int http_request(const char *url, struct http_get_options *options, long *respon
 
     return -1;
 }
+
+int http_request_ranges(const char *url, struct http_get_options *options, size_t total_size, size_t parts_num)
+{
+    if (g_http_mock != nullptr) {
+        return g_http_mock->HttpRequestRanges(url, options, total_size, parts_num);
+    }
+
+    return -1;
+}
@@ -24,6 +24,8 @@ public:
     virtual ~MockHttp() = default;
     MOCK_METHOD4(HttpRequest, int(const char *url, struct http_get_options *options, long *response_code,
                                   int recursive_len));
+    MOCK_METHOD4(HttpRequestRanges, int(const char *url, struct http_get_options *options, size_t total_size,
+                                        size_t parts_num));
 };
 
 void MockHttp_SetMock(MockHttp* mock);
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: exec service client unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "isula_exec_service.h"
+#include "utils.h"
+#include "utils_file.h"
+
+static const std::string STATE_DIR = "/tmp/isula_exec_service_ut";
+static const std::string ID = "c1";
+static const std::string WORKDIR = STATE_DIR + "/" + ID + "/" + EXEC_DIR_NAME + "/e1";
+
+// the exec service of the container shim, serves one exec with the messages given
+class FakeExecService {
+public:
+    explicit FakeExecService(const std::vector<exec_msg_t> &replies, bool wait_close = false)
+        : m_replies(replies), m_wait_close(wait_close)
+    {
+        struct sockaddr_un addr = {};
+        std::string path = STATE_DIR + "/" + ID + "/" + EXEC_SOCK_NAME;
+
+        addr.sun_family = AF_UNIX;
+        (void)snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+        m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (bind(m_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(m_fd, 1) != 0) {
+            close(m_fd);
+            m_fd = -1;
+            return;
+        }
+        m_thread = std::thread(&FakeExecService::Serve, this);
+    }
+
+    ~FakeExecService()
+    {
+        if (m_fd >= 0) {
+            // stop waiting for an exec that never comes
+            (void)shutdown(m_fd, SHUT_RDWR);
+        }
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    bool Listening() const
+    {
+        return m_fd >= 0;
+    }
+
+    std::string Request()
+    {
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        return m_request;
+    }
+
+private:
+    void Serve()
+    {
+        int conn = accept(m_fd, nullptr, nullptr);
+        char c = 0;
+
+        if (conn < 0) {
+            return;
+        }
+        // the request is the exec working directory ended with '\0'
+        while (read(conn, &c, 1) == 1) {
+            m_request.push_back(c);
+            if (c == '\0') {
+                break;
+            }
+        }
+        for (const auto &msg : m_replies) {
+            // messages may be received in pieces
+            for (size_t i = 0; i < sizeof(msg); i++) {
+                if (write(conn, (const char *)&msg + i, 1) != 1) {
+                    break;
+                }
+            }
+        }
+        // a detached exec goes on after isulad is told its pid
+        while (m_wait_close && read(conn, &c, 1) > 0) {
+        }
+        close(conn);
+    }
+
+    std::vector<exec_msg_t> m_replies;
+    bool m_wait_close;
+    int m_fd { -1 };
+    std::thread m_thread;
+    std::string m_request;
+};
+
+class IsulaExecServiceUnitTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(util_recursive_rmdir(STATE_DIR.c_str(), 0), 0);
+        ASSERT_EQ(util_mkdir_p(WORKDIR.c_str(), 0700), 0);
+    }
+
+    void TearDown() override
+    {
+        util_recursive_rmdir(STATE_DIR.c_str(), 0);
+    }
+
+    static int Exec(bool fg, int64_t timeout, int *exit_code)
+    {
+        return isula_exec_by_service(STATE_DIR.c_str(), ID.c_str(), WORKDIR.c_str(), fg, timeout, exit_code);
+    }
+};
+
+TEST_F(IsulaExecServiceUnitTest, test_invalid_args)
+{
+    int exit_code = 0;
+
+    ASSERT_EQ(isula_exec_by_service(nullptr, ID.c_str(), WORKDIR.c_str(), true, 0, &exit_code), -1);
+    ASSERT_EQ(isula_exec_by_service(STATE_DIR.c_str(), nullptr, WORKDIR.c_str(), true, 0, &exit_code), -1);
+    ASSERT_EQ(isula_exec_by_service(STATE_DIR.c_str(), ID.c_str(), nullptr, true, 0, &exit_code), -1);
+    ASSERT_EQ(isula_exec_by_service(STATE_DIR.c_str(), ID.c_str(), WORKDIR.c_str(), true, 0, nullptr), -1);
+}
+
+TEST_F(IsulaExecServiceUnitTest, test_service_down)
+{
+    int exit_code = 0;
+
+    // shims started by old versions have no exec service
+    ASSERT_EQ(Exec(true, 0, &exit_code), EXEC_SERVICE_UNAVAILABLE);
+
+    // the socket is left by a dead shim
+    {
+        FakeExecService service({});
+        ASSERT_TRUE(service.Listening());
+    }
+    ASSERT_TRUE(util_file_exists((STATE_DIR + "/" + ID + "/" + EXEC_SOCK_NAME).c_str()));
+    ASSERT_EQ(Exec(true, 0, &exit_code), EXEC_SERVICE_UNAVAILABLE);
+}
+
+TEST_F(IsulaExecServiceUnitTest, test_service_closes_before_taking_exec)
+{
+    FakeExecService service({});
+    int exit_code = 0;
+
+    ASSERT_TRUE(service.Listening());
+    // a new shim is started for the exec
+    ASSERT_EQ(Exec(true, 0, &exit_code), EXEC_SERVICE_UNAVAILABLE);
+    ASSERT_EQ(service.Request(), WORKDIR + std::string(1, '\0'));
+}
+
+TEST_F(IsulaExecServiceUnitTest, test_exec)
+{
+    FakeExecService service({ { EXEC_MSG_SHIM_PID, 100 }, { EXEC_MSG_PID, 101 }, { EXEC_MSG_EXIT, 3 } });
+    int exit_code = 0;
+
+    ASSERT_TRUE(service.Listening());
+    ASSERT_EQ(Exec(true, 0, &exit_code), 0);
+    ASSERT_EQ(exit_code, 3);
+    ASSERT_EQ(service.Request(), WORKDIR + std::string(1, '\0'));
+}
+
+TEST_F(IsulaExecServiceUnitTest, test_detached_exec)
+{
+    FakeExecService service({ { EXEC_MSG_SHIM_PID, 100 }, { EXEC_MSG_PID, 101 } }, true);
+    int exit_code = -1;
+
+    ASSERT_TRUE(service.Listening());
+    // returns once the exec process is created
+    ASSERT_EQ(Exec(false, 0, &exit_code), 0);
+    ASSERT_EQ(exit_code, 0);
+}
+
+TEST_F(IsulaExecServiceUnitTest, test_exec_failed)
+{
+    int exit_code = 0;
+
+    // the exec is taken by the service, it must not be run again by a new shim
+    {
+        FakeExecService service({ { EXEC_MSG_SHIM_PID, 100 } });
+        ASSERT_TRUE(service.Listening());
+        ASSERT_EQ(Exec(true, 0, &exit_code), -1);
+    }
+    (void)unlink((STATE_DIR + "/" + ID + "/" + EXEC_SOCK_NAME).c_str());
+    {
+        FakeExecService service({ { EXEC_MSG_SHIM_PID, 100 }, { EXEC_MSG_PID, 101 } });
+        ASSERT_TRUE(service.Listening());
+        ASSERT_EQ(Exec(true, 0, &exit_code), -1);
+    }
+    (void)unlink((STATE_DIR + "/" + ID + "/" + EXEC_SOCK_NAME).c_str());
+    {
+        FakeExecService service({ { EXEC_MSG_EXIT, 0 } });
+        ASSERT_TRUE(service.Listening());
+        ASSERT_EQ(Exec(true, 0, &exit_code), -1);
+    }
+}
+
+TEST_F(IsulaExecServiceUnitTest, test_exec_timeout)
+{
+    int exit_code = 0;
+    int status = 0;
+    pid_t shim = fork();
+
+    ASSERT_GE(shim, 0);
+    if (shim == 0) {
+        pause();
+        _exit(0);
+    }
+
+    {
+        FakeExecService service({ { EXEC_MSG_SHIM_PID, shim }, { EXEC_MSG_PID, shim } }, true);
+        auto start = std::chrono::steady_clock::now();
+
+        ASSERT_TRUE(service.Listening());
+        ASSERT_EQ(Exec(true, 1, &exit_code), -1);
+        ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    }
+
+    // the shim serving the exec is killed
+    ASSERT_EQ(waitpid(shim, &status, 0), shim);
+    ASSERT_TRUE(WIFSIGNALED(status));
+    ASSERT_EQ(WTERMSIG(status), SIGKILL);
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: container log index reading unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "execution_log_index.h"
+
+static const std::string LOG_PATH = "/tmp/isulad_log_index_ut.log";
+static const std::string IDX_PATH = LOG_PATH + CONTAINER_LOG_INDEX_SUFFIX;
+// time of line i
+static const int64_t BASE_TIME = 1000000000;
+
+class LogIndexUnitTest : public testing::Test {
+protected:
+    void TearDown() override
+    {
+        if (m_fp != nullptr) {
+            fclose(m_fp);
+        }
+        container_log_index_free(&m_index);
+        (void)unlink(LOG_PATH.c_str());
+        (void)unlink(IDX_PATH.c_str());
+    }
+
+    // lines of different length, the index covers the first indexed lines like isulad-shim writes it
+    void WriteLog(size_t lines, size_t indexed)
+    {
+        std::ofstream log(LOG_PATH, std::ios::trunc | std::ios::binary);
+        uint64_t offset = 0;
+
+        m_offsets.clear();
+        for (size_t i = 0; i < lines; i++) {
+            std::string line = "{\"log\":\"" + std::string(i % 7 + 1, 'x') + "\"}\n";
+            m_offsets.push_back(offset);
+            offset += line.size();
+            log << line;
+        }
+        m_size = offset;
+        log.close();
+
+        m_entries.clear();
+        for (size_t i = 0; i < indexed; i += CONTAINER_LOG_INDEX_INTERVAL) {
+            container_log_index_entry entry = { m_offsets[i], i, BASE_TIME + (int64_t)i };
+            m_entries.push_back(entry);
+        }
+        WriteIndex(CONTAINER_LOG_INDEX_MAGIC, m_entries);
+    }
+
+    static void WriteIndex(const char *magic, const std::vector<container_log_index_entry> &entries)
+    {
+        std::ofstream idx(IDX_PATH, std::ios::trunc | std::ios::binary);
+        container_log_index_header header = { { 0 }, CONTAINER_LOG_INDEX_VERSION, CONTAINER_LOG_INDEX_INTERVAL };
+
+        (void)memcpy(header.magic, magic, sizeof(header.magic));
+        idx.write((const char *)&header, sizeof(header));
+        for (const auto &entry : entries) {
+            idx.write((const char *)&entry, sizeof(entry));
+        }
+    }
+
+    bool Load()
+    {
+        if (m_fp != nullptr) {
+            fclose(m_fp);
+        }
+        container_log_index_free(&m_index);
+        m_fp = fopen(LOG_PATH.c_str(), "rb");
+        return m_fp != nullptr && container_log_index_load(LOG_PATH.c_str(), m_fp, &m_index);
+    }
+
+    FILE *m_fp { nullptr };
+    struct container_log_index m_index { nullptr, 0 };
+    std::vector<uint64_t> m_offsets;
+    std::vector<container_log_index_entry> m_entries;
+    uint64_t m_size { 0 };
+};
+
+TEST_F(LogIndexUnitTest, test_load)
+{
+    WriteLog(CONTAINER_LOG_INDEX_INTERVAL * 3 + 5, CONTAINER_LOG_INDEX_INTERVAL * 3 + 5);
+    ASSERT_TRUE(Load());
+    ASSERT_EQ(m_index.len, 4U);
+    ASSERT_EQ(memcmp(m_index.entries, m_entries.data(), sizeof(container_log_index_entry) * m_index.len), 0);
+
+    // an entry being appended is not used
+    {
+        std::ofstream idx(IDX_PATH, std::ios::app | std::ios::binary);
+        idx.write((const char *)&m_entries[0], sizeof(container_log_index_entry) / 2);
+    }
+    ASSERT_TRUE(Load());
+    ASSERT_EQ(m_index.len, 4U);
+}
+
+TEST_F(LogIndexUnitTest, test_load_mismatched_index)
+{
+    std::vector<container_log_index_entry> entries;
+
+    WriteLog(CONTAINER_LOG_INDEX_INTERVAL * 2, CONTAINER_LOG_INDEX_INTERVAL * 2);
+    entries = m_entries;
+
+    (void)unlink(IDX_PATH.c_str());
+    ASSERT_FALSE(Load());
+
+    WriteIndex("BADMAGIC", entries);
+    ASSERT_FALSE(Load());
+
+    // header only
+    WriteIndex(CONTAINER_LOG_INDEX_MAGIC, {});
+    ASSERT_FALSE(Load());
+
+    // the index of a former log file
+    entries.back().offset = m_size;
+    WriteIndex(CONTAINER_LOG_INDEX_MAGIC, entries);
+    ASSERT_FALSE(Load());
+
+    entries.back().offset = m_offsets[CONTAINER_LOG_INDEX_INTERVAL] + 1;
+    WriteIndex(CONTAINER_LOG_INDEX_MAGIC, entries);
+    ASSERT_FALSE(Load());
+
+    entries = m_entries;
+    entries.front().offset = m_offsets[1];
+    WriteIndex(CONTAINER_LOG_INDEX_MAGIC, entries);
+    ASSERT_FALSE(Load());
+    ASSERT_EQ(m_index.entries, nullptr);
+    ASSERT_EQ(m_index.len, 0U);
+}
+
+TEST_F(LogIndexUnitTest, test_tail_find)
+{
+    const size_t lines = CONTAINER_LOG_INDEX_INTERVAL * 4 + 10;
+    std::vector<int64_t> requires { 1, 9, 10, 11, CONTAINER_LOG_INDEX_INTERVAL, CONTAINER_LOG_INDEX_INTERVAL + 10,
+                                    CONTAINER_LOG_INDEX_INTERVAL * 4 + 9, (int64_t)lines };
+
+    // lines after the last entry are not indexed yet
+    WriteLog(lines, lines - 20);
+    ASSERT_TRUE(Load());
+
+    for (auto require : requires) {
+        int64_t get_line = 0;
+        long pos = 0;
+
+        ASSERT_EQ(container_log_index_tail_find(m_fp, &m_index, require, &get_line, &pos), 0);
+        if (require == (int64_t)lines) {
+            // the whole file is wanted, previous files are read for more lines
+            ASSERT_EQ(get_line, require);
+            ASSERT_EQ(pos, 0);
+            continue;
+        }
+        ASSERT_EQ(get_line, require);
+        ASSERT_EQ((uint64_t)pos, m_offsets[lines - (size_t)require]);
+    }
+}
+
+TEST_F(LogIndexUnitTest, test_tail_find_short_file)
+{
+    int64_t get_line = 3;
+    long pos = 0;
+
+    WriteLog(10, 10);
+    ASSERT_TRUE(Load());
+
+    // not enough lines, the lines of this file are added to the lines got from newer files
+    ASSERT_EQ(container_log_index_tail_find(m_fp, &m_index, 20, &get_line, &pos), 0);
+    ASSERT_EQ(get_line, 13);
+    ASSERT_EQ(pos, 0);
+}
+
+TEST_F(LogIndexUnitTest, test_search_time)
+{
+    WriteLog(CONTAINER_LOG_INDEX_INTERVAL * 5, CONTAINER_LOG_INDEX_INTERVAL * 5);
+    ASSERT_TRUE(Load());
+    ASSERT_EQ(m_index.len, 5U);
+
+    ASSERT_EQ(container_log_index_search_time(&m_index, 0), 0U);
+    ASSERT_EQ(container_log_index_search_time(&m_index, BASE_TIME), 0U);
+    ASSERT_EQ(container_log_index_search_time(&m_index, BASE_TIME + CONTAINER_LOG_INDEX_INTERVAL), 0U);
+    ASSERT_EQ(container_log_index_search_time(&m_index, BASE_TIME + CONTAINER_LOG_INDEX_INTERVAL + 1), 1U);
+    ASSERT_EQ(container_log_index_search_time(&m_index, BASE_TIME + CONTAINER_LOG_INDEX_INTERVAL * 3 - 1), 2U);
+    // lines after the last entry may still be after since
+    ASSERT_EQ(container_log_index_search_time(&m_index, BASE_TIME + CONTAINER_LOG_INDEX_INTERVAL * 10), 4U);
+}
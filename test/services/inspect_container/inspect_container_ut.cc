@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: container status inspect unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <string.h>
+#include <string>
+#include <gtest/gtest.h>
+#include "service_container_api.h"
+#include "container_api.h"
+#include "isulad_config.h"
+#include "image_api.h"
+#include "daemon_arguments.h"
+#include "utils.h"
+
+static const char *ID = "c0ffee0123456789c0ffee0123456789c0ffee0123456789c0ffee0123456789";
+
+static container_t *g_cont = nullptr;
+static bool g_running = true;
+static int g_lock_times = 0;
+static int g_unlock_times = 0;
+static int g_lock_ret = 0;
+
+extern "C" {
+    container_t *containers_store_get(const char *id_or_name)
+    {
+        if (g_cont == nullptr || strcmp(id_or_name, ID) != 0) {
+            return nullptr;
+        }
+        g_cont->refcnt++;
+        return g_cont;
+    }
+
+    void container_unref(container_t *cont)
+    {
+        if (cont != nullptr) {
+            cont->refcnt--;
+        }
+    }
+
+    int container_timedlock(container_t *cont, int timeout)
+    {
+        if (g_lock_ret == 0) {
+            g_lock_times++;
+        }
+        return g_lock_ret;
+    }
+
+    void container_unlock(container_t *cont)
+    {
+        g_unlock_times++;
+    }
+
+    int container_state_get_restart_count(container_state_t *s)
+    {
+        return 2;
+    }
+
+    container_inspect_state *container_state_to_inspect_state(container_state_t *s)
+    {
+        container_inspect_state *state =
+            (container_inspect_state *)util_common_calloc_s(sizeof(container_inspect_state));
+
+        state->status = util_strdup_s(g_running ? "running" : "exited");
+        state->running = g_running;
+        state->pid = g_running ? 100 : 0;
+        state->exit_code = g_running ? 0 : 3;
+        return state;
+    }
+
+    bool container_is_running(container_state_t *s)
+    {
+        return g_running;
+    }
+
+    int conf_get_isulad_default_ulimit(host_config_ulimits_element ***ulimit)
+    {
+        return 0;
+    }
+
+    size_t ulimit_array_len(host_config_ulimits_element **default_ulimit)
+    {
+        return 0;
+    }
+
+    int ulimit_array_append(host_config_ulimits_element ***default_ulimit, const host_config_ulimits_element *element,
+                            const size_t len)
+    {
+        return -1;
+    }
+
+    void free_default_ulimit(host_config_ulimits_element **default_ulimit)
+    {
+    }
+
+    container_inspect_graph_driver *im_graphdriver_get_metadata_by_container_id(const char *id)
+    {
+        return nullptr;
+    }
+}
+
+static json_map_string_string *make_map(const char *key, const char *value)
+{
+    json_map_string_string *map = (json_map_string_string *)util_common_calloc_s(sizeof(json_map_string_string));
+
+    (void)append_json_map_string_string(map, key, value);
+    return map;
+}
+
+static container_config_v2_common_config_mount_points *make_mount_points()
+{
+    container_config_v2_common_config_mount_points *mps = (container_config_v2_common_config_mount_points *)
+        util_common_calloc_s(sizeof(container_config_v2_common_config_mount_points));
+    container_config_v2_common_config_mount_points_element *mp = nullptr;
+
+    mp = (container_config_v2_common_config_mount_points_element *)util_common_calloc_s(
+             sizeof(container_config_v2_common_config_mount_points_element));
+    mp->type = util_strdup_s("bind");
+    mp->source = util_strdup_s("/data");
+    mp->destination = util_strdup_s("/mnt");
+    mp->relabel = util_strdup_s("z");
+    mp->propagation = util_strdup_s("rprivate");
+    mp->rw = true;
+
+    mps->keys = (char **)util_common_calloc_s(sizeof(char *));
+    mps->values = (container_config_v2_common_config_mount_points_element **)util_common_calloc_s(sizeof(mp));
+    mps->keys[0] = util_strdup_s(mp->destination);
+    mps->values[0] = mp;
+    mps->len = 1;
+    return mps;
+}
+
+class InspectContainerStatusUnitTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        g_cont = (container_t *)util_common_calloc_s(sizeof(container_t));
+        g_cont->refcnt = 1;
+
+        g_cont->common_config =
+            (container_config_v2_common_config *)util_common_calloc_s(sizeof(container_config_v2_common_config));
+        g_cont->common_config->id = util_strdup_s(ID);
+        g_cont->common_config->created = util_strdup_s("2023-08-18T10:00:00.000000000Z");
+        g_cont->common_config->log_path = util_strdup_s("/var/log/pods/c0.log");
+        g_cont->common_config->process_label = util_strdup_s("system_u:system_r:container_t:s0");
+        g_cont->common_config->image = util_strdup_s("busybox:latest");
+        g_cont->common_config->config = (container_config *)util_common_calloc_s(sizeof(container_config));
+        g_cont->common_config->config->image_ref = util_strdup_s("docker.io/library/busybox:latest");
+        g_cont->common_config->config->labels = make_map("io.kubernetes.container.name", "c0");
+        g_cont->common_config->config->annotations = make_map("io.kubernetes.cri.container-type", "container");
+        g_cont->common_config->mount_points = make_mount_points();
+
+        g_cont->state = (container_state_t *)util_common_calloc_s(sizeof(container_state_t));
+
+        g_cont->hostconfig = (host_config *)util_common_calloc_s(sizeof(host_config));
+        g_cont->hostconfig->network_mode = util_strdup_s("host");
+        g_cont->hostconfig->pid_mode = util_strdup_s("container:sandbox");
+        g_cont->hostconfig->ipc_mode = util_strdup_s("shareable");
+        // not packed by the status inspect
+        g_cont->hostconfig->cgroup_parent = util_strdup_s("/kubepods");
+
+        g_cont->network_settings =
+            (container_network_settings *)util_common_calloc_s(sizeof(container_network_settings));
+        g_cont->network_settings->sandbox_key = util_strdup_s("/var/run/netns/c0");
+
+        g_running = true;
+        g_lock_times = 0;
+        g_unlock_times = 0;
+        g_lock_ret = 0;
+    }
+
+    void TearDown() override
+    {
+        ASSERT_EQ(g_cont->refcnt, 1U);
+        free_container_config_v2_common_config(g_cont->common_config);
+        free(g_cont->state);
+        free_host_config(g_cont->hostconfig);
+        free_container_network_settings(g_cont->network_settings);
+        free(g_cont);
+        g_cont = nullptr;
+    }
+
+    static void CheckFixedData(const container_inspect *inspect)
+    {
+        ASSERT_STREQ(inspect->id, ID);
+        ASSERT_STREQ(inspect->created, "2023-08-18T10:00:00.000000000Z");
+        ASSERT_STREQ(inspect->log_path, "/var/log/pods/c0.log");
+        ASSERT_STREQ(inspect->process_label, "system_u:system_r:container_t:s0");
+
+        ASSERT_NE(inspect->config, nullptr);
+        ASSERT_STREQ(inspect->config->image, "busybox:latest");
+        ASSERT_STREQ(inspect->config->image_ref, "docker.io/library/busybox:latest");
+        ASSERT_NE(inspect->config->labels, nullptr);
+        ASSERT_EQ(inspect->config->labels->len, 1U);
+        ASSERT_STREQ(inspect->config->labels->keys[0], "io.kubernetes.container.name");
+        ASSERT_STREQ(inspect->config->labels->values[0], "c0");
+        ASSERT_NE(inspect->config->annotations, nullptr);
+        ASSERT_EQ(inspect->config->annotations->len, 1U);
+        ASSERT_STREQ(inspect->config->annotations->keys[0], "io.kubernetes.cri.container-type");
+        ASSERT_STREQ(inspect->config->annotations->values[0], "container");
+
+        ASSERT_EQ(inspect->mounts_len, 1U);
+        ASSERT_STREQ(inspect->mounts[0]->source, "/data");
+        ASSERT_STREQ(inspect->mounts[0]->destination, "/mnt");
+        ASSERT_STREQ(inspect->mounts[0]->mode, "z");
+        ASSERT_STREQ(inspect->mounts[0]->propagation, "rprivate");
+        ASSERT_TRUE(inspect->mounts[0]->rw);
+
+        ASSERT_EQ(inspect->restart_count, 2);
+        ASSERT_NE(inspect->state, nullptr);
+    }
+};
+
+TEST_F(InspectContainerStatusUnitTest, test_invalid_id)
+{
+    ASSERT_EQ(inspect_container_status(nullptr, 0, false), nullptr);
+    ASSERT_EQ(inspect_container_status("", 0, false), nullptr);
+    ASSERT_EQ(inspect_container_status("invalid/name", 0, true), nullptr);
+    // no such container
+    ASSERT_EQ(inspect_container_status("c1", 0, true), nullptr);
+    ASSERT_EQ(g_lock_times, 0);
+}
+
+TEST_F(InspectContainerStatusUnitTest, test_without_network)
+{
+    container_inspect *inspect = inspect_container_status(ID, 0, false);
+
+    ASSERT_NE(inspect, nullptr);
+    CheckFixedData(inspect);
+    ASSERT_STREQ(inspect->state->status, "running");
+    ASSERT_EQ(inspect->state->pid, 100);
+
+    // status of containers is served without waiting for the container lock
+    ASSERT_EQ(g_lock_times, 0);
+    ASSERT_EQ(g_unlock_times, 0);
+    ASSERT_EQ(inspect->host_config, nullptr);
+    ASSERT_EQ(inspect->network_settings, nullptr);
+    free_container_inspect(inspect);
+}
+
+TEST_F(InspectContainerStatusUnitTest, test_with_network)
+{
+    container_inspect *inspect = inspect_container_status(ID, 0, true);
+
+    ASSERT_NE(inspect, nullptr);
+    CheckFixedData(inspect);
+    ASSERT_EQ(g_lock_times, 1);
+    ASSERT_EQ(g_unlock_times, 1);
+
+    ASSERT_NE(inspect->network_settings, nullptr);
+    ASSERT_STREQ(inspect->network_settings->sandbox_key, "/var/run/netns/c0");
+    // only the namespace modes are read by the sandbox status
+    ASSERT_NE(inspect->host_config, nullptr);
+    ASSERT_STREQ(inspect->host_config->network_mode, "host");
+    ASSERT_STREQ(inspect->host_config->pid_mode, "container:sandbox");
+    ASSERT_STREQ(inspect->host_config->ipc_mode, "shareable");
+    ASSERT_EQ(inspect->host_config->cgroup_parent, nullptr);
+    free_container_inspect(inspect);
+}
+
+TEST_F(InspectContainerStatusUnitTest, test_stopped_without_config)
+{
+    container_inspect *inspect = nullptr;
+
+    g_running = false;
+    free(g_cont->common_config->image);
+    g_cont->common_config->image = nullptr;
+    free_container_config(g_cont->common_config->config);
+    g_cont->common_config->config = nullptr;
+    free_host_config(g_cont->hostconfig);
+    g_cont->hostconfig = nullptr;
+
+    inspect = inspect_container_status(ID, 0, true);
+    ASSERT_NE(inspect, nullptr);
+    ASSERT_STREQ(inspect->config->image, "none");
+    ASSERT_EQ(inspect->config->image_ref, nullptr);
+    ASSERT_EQ(inspect->config->labels, nullptr);
+    ASSERT_STREQ(inspect->state->status, "exited");
+    ASSERT_EQ(inspect->state->exit_code, 3);
+    ASSERT_EQ(inspect->host_config, nullptr);
+    ASSERT_NE(inspect->network_settings, nullptr);
+    free_container_inspect(inspect);
+}
+
+TEST_F(InspectContainerStatusUnitTest, test_lock_timeout)
+{
+    g_lock_ret = -1;
+    ASSERT_EQ(inspect_container_status(ID, 1, true), nullptr);
+    ASSERT_EQ(g_unlock_times, 0);
+
+    // the lock is not needed without network
+    container_inspect *inspect = inspect_container_status(ID, 1, false);
+    ASSERT_NE(inspect, nullptr);
+    free_container_inspect(inspect);
+}
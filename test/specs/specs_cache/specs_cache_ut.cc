@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) Huawei Technologies Co., Ltd. 2023. All rights reserved.
+ * iSulad licensed under the Mulan PSL v2.
+ * You can use this software according to the terms and conditions of the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *     http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ * PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ * Description: spec template cache unit test
+ * Author: iSulad Team
+ * Create: 2023-08-18
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <string>
+#include <gtest/gtest.h>
+#include "specs_cache.h"
+#include "utils.h"
+#include "utils_file.h"
+
+static const std::string ROOT_DIR = "/tmp/isulad_specs_cache_ut";
+
+static int g_trans_calls = 0;
+
+static void write_file(const std::string &path, const std::string &content)
+{
+    std::ofstream out(path, std::ios::trunc);
+
+    out << content;
+}
+
+static void set_mtime(const std::string &path, time_t sec)
+{
+    struct timespec times[2] = { { sec, 0 }, { sec, 0 } };
+
+    ASSERT_EQ(utimensat(AT_FDCWD, path.c_str(), times, 0), 0);
+}
+
+static std::string template_json(const std::string &hostname)
+{
+    return "{\"ociVersion\":\"1.0.1\",\"hostname\":\"" + hostname + "\"}";
+}
+
+static std::string profile_json(const std::string &action)
+{
+    return "{\"defaultAction\":\"" + action + "\"}";
+}
+
+// one syscall for the default action, and another for each bounding capability
+static oci_runtime_config_linux_seccomp *test_trans(const docker_seccomp *docker_seccomp_spec,
+                                                    const defs_process_capabilities *capabilities)
+{
+    size_t caps_len = capabilities != nullptr ? capabilities->bounding_len : 0;
+    oci_runtime_config_linux_seccomp *seccomp = nullptr;
+    size_t i;
+
+    g_trans_calls++;
+    if (strcmp(docker_seccomp_spec->default_action, "SCMP_ACT_KILL") == 0) {
+        return nullptr;
+    }
+
+    seccomp = (oci_runtime_config_linux_seccomp *)util_common_calloc_s(sizeof(oci_runtime_config_linux_seccomp));
+    seccomp->default_action = util_strdup_s(docker_seccomp_spec->default_action);
+    seccomp->architectures = (char **)util_smart_calloc_s(sizeof(char *), 2);
+    seccomp->architectures[0] = util_strdup_s("SCMP_ARCH_X86_64");
+    seccomp->architectures[1] = util_strdup_s("SCMP_ARCH_AARCH64");
+    seccomp->architectures_len = 2;
+
+    seccomp->syscalls = (defs_syscall **)util_smart_calloc_s(sizeof(defs_syscall *), caps_len + 1);
+    seccomp->syscalls_len = caps_len + 1;
+    for (i = 0; i < caps_len + 1; i++) {
+        defs_syscall *syscall = (defs_syscall *)util_common_calloc_s(sizeof(defs_syscall));
+        syscall->action = util_strdup_s("SCMP_ACT_ALLOW");
+        syscall->names = (char **)util_smart_calloc_s(sizeof(char *), 1);
+        syscall->names[0] = util_strdup_s(i == 0 ? "read" : capabilities->bounding[i - 1]);
+        syscall->names_len = 1;
+        seccomp->syscalls[i] = syscall;
+    }
+
+    seccomp->syscalls[0]->args = (defs_syscall_arg **)util_smart_calloc_s(sizeof(defs_syscall_arg *), 1);
+    seccomp->syscalls[0]->args[0] = (defs_syscall_arg *)util_common_calloc_s(sizeof(defs_syscall_arg));
+    seccomp->syscalls[0]->args[0]->index = 1;
+    seccomp->syscalls[0]->args[0]->value = 2;
+    seccomp->syscalls[0]->args[0]->value_two = 3;
+    seccomp->syscalls[0]->args[0]->op = util_strdup_s("SCMP_CMP_MASKED_EQ");
+    seccomp->syscalls[0]->args_len = 1;
+
+    return seccomp;
+}
+
+// b is a copy of a which shares no memory with it
+static void expect_seccomp_copy(const oci_runtime_config_linux_seccomp *a, const oci_runtime_config_linux_seccomp *b)
+{
+    size_t i, j;
+
+    ASSERT_NE(a, b);
+    EXPECT_STREQ(a->default_action, b->default_action);
+    EXPECT_NE(a->default_action, b->default_action);
+
+    ASSERT_EQ(a->architectures_len, b->architectures_len);
+    EXPECT_NE(a->architectures, b->architectures);
+    for (i = 0; i < a->architectures_len; i++) {
+        EXPECT_STREQ(a->architectures[i], b->architectures[i]);
+        EXPECT_NE(a->architectures[i], b->architectures[i]);
+    }
+
+    ASSERT_EQ(a->syscalls_len, b->syscalls_len);
+    EXPECT_NE(a->syscalls, b->syscalls);
+    for (i = 0; i < a->syscalls_len; i++) {
+        const defs_syscall *sa = a->syscalls[i];
+        const defs_syscall *sb = b->syscalls[i];
+
+        ASSERT_NE(sa, sb);
+        EXPECT_STREQ(sa->action, sb->action);
+        ASSERT_EQ(sa->names_len, sb->names_len);
+        for (j = 0; j < sa->names_len; j++) {
+            EXPECT_STREQ(sa->names[j], sb->names[j]);
+            EXPECT_NE(sa->names[j], sb->names[j]);
+        }
+        ASSERT_EQ(sa->args_len, sb->args_len);
+        for (j = 0; j < sa->args_len; j++) {
+            ASSERT_NE(sa->args[j], sb->args[j]);
+            EXPECT_EQ(sa->args[j]->index, sb->args[j]->index);
+            EXPECT_EQ(sa->args[j]->value, sb->args[j]->value);
+            EXPECT_EQ(sa->args[j]->value_two, sb->args[j]->value_two);
+            EXPECT_STREQ(sa->args[j]->op, sb->args[j]->op);
+        }
+    }
+}
+
+class SpecsCacheUnitTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_EQ(util_recursive_rmdir(ROOT_DIR.c_str(), 0), 0);
+        ASSERT_EQ(util_mkdir_p(ROOT_DIR.c_str(), 0700), 0);
+        g_trans_calls = 0;
+    }
+
+    void TearDown() override
+    {
+        util_recursive_rmdir(ROOT_DIR.c_str(), 0);
+    }
+
+    std::string get_hostname(const std::string &file)
+    {
+        parser_error err = nullptr;
+        oci_runtime_spec *spec = specs_cache_get_spec_template(file.c_str(), &err);
+        std::string hostname;
+
+        EXPECT_NE(spec, nullptr);
+        if (spec != nullptr && spec->hostname != nullptr) {
+            hostname = spec->hostname;
+        }
+        free_oci_runtime_spec(spec);
+        free(err);
+        return hostname;
+    }
+};
+
+TEST_F(SpecsCacheUnitTest, test_spec_template_invalidation)
+{
+    const std::string file = ROOT_DIR + "/config.json";
+    const std::string replace = ROOT_DIR + "/config.json.new";
+    parser_error err = nullptr;
+    oci_runtime_spec *first = nullptr;
+    oci_runtime_spec *second = nullptr;
+
+    write_file(file, template_json("first"));
+
+    // callers own their specs
+    first = specs_cache_get_spec_template(file.c_str(), &err);
+    ASSERT_NE(first, nullptr);
+    second = specs_cache_get_spec_template(file.c_str(), &err);
+    ASSERT_NE(second, nullptr);
+    ASSERT_NE(first, second);
+    ASSERT_NE(first->hostname, second->hostname);
+    ASSERT_STREQ(first->hostname, "first");
+    free(first->hostname);
+    first->hostname = util_strdup_s("changed");
+    ASSERT_STREQ(second->hostname, "first");
+    free_oci_runtime_spec(first);
+    free_oci_runtime_spec(second);
+    ASSERT_EQ(get_hostname(file), "first");
+
+    // size changed
+    write_file(file, template_json("second"));
+    ASSERT_EQ(get_hostname(file), "second");
+
+    // only mtime changed
+    write_file(file, template_json("thirdd"));
+    set_mtime(file, 1);
+    ASSERT_EQ(get_hostname(file), "thirdd");
+
+    // replaced by another file with the same size and mtime
+    write_file(replace, template_json("fourth"));
+    set_mtime(replace, 1);
+    ASSERT_EQ(rename(replace.c_str(), file.c_str()), 0);
+    ASSERT_EQ(get_hostname(file), "fourth");
+
+    write_file(file, "not json");
+    ASSERT_EQ(specs_cache_get_spec_template(file.c_str(), &err), nullptr);
+    ASSERT_NE(err, nullptr);
+    free(err);
+    err = nullptr;
+
+    ASSERT_EQ(unlink(file.c_str()), 0);
+    ASSERT_EQ(specs_cache_get_spec_template(file.c_str(), &err), nullptr);
+    ASSERT_NE(err, nullptr);
+    free(err);
+    err = nullptr;
+
+    ASSERT_EQ(specs_cache_get_spec_template(nullptr, &err), nullptr);
+    ASSERT_EQ(specs_cache_get_spec_template(file.c_str(), nullptr), nullptr);
+}
+
+TEST_F(SpecsCacheUnitTest, test_file_seccomp)
+{
+    const std::string file = ROOT_DIR + "/seccomp.json";
+    char caps_admin[] = "CAP_SYS_ADMIN";
+    char caps_chown[] = "CAP_CHOWN";
+    char *bounding[] = { caps_admin, caps_chown };
+    defs_process_capabilities caps = { 0 };
+    oci_runtime_config_linux_seccomp *first = nullptr;
+    oci_runtime_config_linux_seccomp *second = nullptr;
+    oci_runtime_config_linux_seccomp *other = nullptr;
+
+    caps.bounding = bounding;
+    caps.bounding_len = 2;
+    write_file(file, profile_json("SCMP_ACT_ERRNO"));
+
+    first = specs_cache_get_file_seccomp(file.c_str(), &caps, test_trans);
+    ASSERT_NE(first, nullptr);
+    ASSERT_EQ(g_trans_calls, 1);
+    ASSERT_EQ(first->syscalls_len, 3U);
+
+    // translated once for the same capabilities
+    second = specs_cache_get_file_seccomp(file.c_str(), &caps, test_trans);
+    ASSERT_NE(second, nullptr);
+    ASSERT_EQ(g_trans_calls, 1);
+    expect_seccomp_copy(first, second);
+    free_oci_runtime_config_linux_seccomp(second);
+
+    caps.bounding_len = 1;
+    other = specs_cache_get_file_seccomp(file.c_str(), &caps, test_trans);
+    ASSERT_NE(other, nullptr);
+    ASSERT_EQ(g_trans_calls, 2);
+    ASSERT_EQ(other->syscalls_len, 2U);
+    free_oci_runtime_config_linux_seccomp(other);
+
+    other = specs_cache_get_file_seccomp(file.c_str(), nullptr, test_trans);
+    ASSERT_NE(other, nullptr);
+    ASSERT_EQ(g_trans_calls, 3);
+    ASSERT_EQ(other->syscalls_len, 1U);
+    free_oci_runtime_config_linux_seccomp(other);
+
+    // translated again once the file is changed
+    caps.bounding_len = 2;
+    write_file(file, profile_json("SCMP_ACT_TRACE"));
+    second = specs_cache_get_file_seccomp(file.c_str(), &caps, test_trans);
+    ASSERT_NE(second, nullptr);
+    ASSERT_EQ(g_trans_calls, 4);
+    ASSERT_STREQ(second->default_action, "SCMP_ACT_TRACE");
+    free_oci_runtime_config_linux_seccomp(second);
+    free_oci_runtime_config_linux_seccomp(first);
+
+    ASSERT_EQ(specs_cache_get_file_seccomp((ROOT_DIR + "/missing.json").c_str(), &caps, test_trans), nullptr);
+    ASSERT_EQ(specs_cache_get_file_seccomp(nullptr, &caps, test_trans), nullptr);
+    ASSERT_EQ(specs_cache_get_file_seccomp(file.c_str(), &caps, nullptr), nullptr);
+}
+
+TEST_F(SpecsCacheUnitTest, test_profile_seccomp)
+{
+    const std::string profile = profile_json("SCMP_ACT_LOG");
+    oci_runtime_config_linux_seccomp *first = nullptr;
+    oci_runtime_config_linux_seccomp *second = nullptr;
+
+    first = specs_cache_get_profile_seccomp(profile.c_str(), nullptr, test_trans);
+    ASSERT_NE(first, nullptr);
+    second = specs_cache_get_profile_seccomp(profile.c_str(), nullptr, test_trans);
+    ASSERT_NE(second, nullptr);
+    ASSERT_EQ(g_trans_calls, 1);
+    expect_seccomp_copy(first, second);
+    free_oci_runtime_config_linux_seccomp(first);
+    free_oci_runtime_config_linux_seccomp(second);
+
+    second = specs_cache_get_profile_seccomp(profile_json("SCMP_ACT_ALLOW").c_str(), nullptr, test_trans);
+    ASSERT_NE(second, nullptr);
+    ASSERT_EQ(g_trans_calls, 2);
+    ASSERT_STREQ(second->default_action, "SCMP_ACT_ALLOW");
+    free_oci_runtime_config_linux_seccomp(second);
+
+    // failed translations are not cached
+    ASSERT_EQ(specs_cache_get_profile_seccomp(profile_json("SCMP_ACT_KILL").c_str(), nullptr, test_trans), nullptr);
+    ASSERT_EQ(specs_cache_get_profile_seccomp(profile_json("SCMP_ACT_KILL").c_str(), nullptr, test_trans), nullptr);
+    ASSERT_EQ(g_trans_calls, 4);
+
+    ASSERT_EQ(specs_cache_get_profile_seccomp("not json", nullptr, test_trans), nullptr);
+    ASSERT_EQ(g_trans_calls, 4);
+    ASSERT_EQ(specs_cache_get_profile_seccomp(nullptr, nullptr, test_trans), nullptr);
+}